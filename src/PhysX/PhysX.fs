@@ -35,6 +35,462 @@ type PhysxActorHandle =
 type PhysXGeometryHandle = 
     val mutable public Handle : nativeint
 
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXBodyTableHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXBodyHandle = 
+    val mutable public Index : uint32
+    val mutable public Generation : uint32
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXBodyRemap = 
+    val mutable public From : uint32
+    val mutable public To : uint32
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXParticleReadbackHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXParticleReadbackFrame = 
+    val mutable public Frame : uint64
+    val mutable public Count : uint32
+    val mutable public Format : uint32
+    val mutable public PositionInvMass : nativeint
+    val mutable public Velocity : nativeint
+    val mutable public Phase : nativeint
+    val mutable public Packed : nativeint
+    val mutable public BoundsMin : V3f
+    val mutable public BoundsMax : V3f
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXParticleEmitterDesc = 
+    val mutable public Type : uint32
+    val mutable public Pose : Euclidean3d
+    val mutable public Extents : V3d
+    val mutable public Velocity : V3d
+    val mutable public Speed : float32
+    val mutable public Jitter : float32
+    val mutable public Rate : float32
+    val mutable public Lifetime : float32
+    val mutable public Phase : uint32
+    val mutable public InvMass : float32
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXParticleIndexHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXFluidSurfaceHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXFluidSurfaceDesc = 
+    val mutable public ParticleRadius : float32
+    val mutable public CellSize : float32
+    val mutable public IsoLevel : float32
+    val mutable public Smoothing : float32
+    val mutable public MaxAnisotropy : float32
+    val mutable public MinNeighbors : uint32
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXParticleKillVolume = 
+    val mutable public Type : uint32
+    val mutable public Invert : uint32
+    val mutable public Pose : Euclidean3d
+    val mutable public Extents : V3d
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXInstanceExportHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXInstanceGroup = 
+    val mutable public Id : uint32
+    val mutable public GeometryType : uint32
+    val mutable public Size : V3d
+    val mutable public Mesh : nativeint
+    val mutable public Count : uint32
+    val mutable public Written : uint32
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXPoseStreamHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXReplayRecorderHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXReplayReaderHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXServerHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXServerDesc = 
+    val mutable public TickRate : float
+    val mutable public MaxCatchUpTicks : uint32
+    val mutable public Reserved : uint32
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXServerCommand = 
+    val mutable public Type : uint32
+    val mutable public Reserved : uint32
+    val mutable public Tick : uint64
+    val mutable public Body : PhysXBodyHandle
+    val mutable public Value : V3d
+    val mutable public Pose : Euclidean3d
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXServerStats = 
+    val mutable public Tick : uint64
+    val mutable public Overruns : uint64
+    val mutable public DroppedTicks : uint64
+    val mutable public CommandsApplied : uint64
+    val mutable public CommandsRejected : uint64
+    val mutable public LastStepMs : float
+    val mutable public MaxStepMs : float
+    val mutable public MeanLatenessMs : float
+    val mutable public MaxLatenessMs : float
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXSnapshotEncoderHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXSnapshotDecoderHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXSnapshotDesc = 
+    val mutable public BoundsMin : V3d
+    val mutable public BoundsMax : V3d
+    val mutable public PositionBits : uint32
+    val mutable public RotationBits : uint32
+    val mutable public DeltaBits : uint32
+    val mutable public MaxBodies : uint32
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXInterestManagerHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXObserverDesc = 
+    val mutable public Type : uint32
+    val mutable public UpdateInterval : uint32
+    val mutable public Position : V3d
+    val mutable public Radius : float
+    [<MarshalAs(UnmanagedType.ByValArray, SizeConst = 6)>]
+    val mutable public Planes : V4d[]
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXSceneBatchHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXWorldHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXWorldDesc = 
+    val mutable public Origin : V3d
+    val mutable public CellSize : float
+    val mutable public CellsX : uint32
+    val mutable public CellsY : uint32
+    val mutable public CellsZ : uint32
+    val mutable public GhostMargin : float
+    val mutable public Gravity : V3d
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXWorldStats = 
+    val mutable public Cells : uint32
+    val mutable public Bodies : uint32
+    val mutable public Ghosts : uint32
+    val mutable public Migrations : uint32
+    val mutable public TotalMigrations : uint64
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXCollisionLayersHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXTriggerManagerHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXTriggerDesc = 
+    val mutable public Type : uint32
+    val mutable public Reserved : uint32
+    val mutable public Pose : Euclidean3d
+    val mutable public HalfExtents : V3d
+    val mutable public UserData : uint64
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXTriggerEvent = 
+    val mutable public Body : PhysXBodyHandle
+    val mutable public Trigger : uint32
+    val mutable public Type : uint32
+    val mutable public UserData : uint64
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXProjectileManagerHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXProjectileDesc = 
+    val mutable public Position : V3d
+    val mutable public Velocity : V3d
+    val mutable public Radius : float32
+    val mutable public Drag : float32
+    val mutable public Mass : float32
+    val mutable public Lifetime : float32
+    val mutable public UserData : uint64
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXProjectileImpact = 
+    val mutable public Projectile : uint32
+    val mutable public Reserved : uint32
+    val mutable public Actor : PhysxActorHandle
+    val mutable public Shape : nativeint
+    val mutable public Position : V3d
+    val mutable public Normal : V3d
+    val mutable public Velocity : V3d
+    val mutable public UserData : uint64
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXCharacterManagerHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXCharacterDesc = 
+    val mutable public Position : V3d
+    val mutable public Radius : float32
+    val mutable public Height : float32
+    val mutable public StepOffset : float32
+    val mutable public SlopeLimit : float32
+    val mutable public ContactOffset : float32
+    val mutable public Density : float32
+    val mutable public Material : PhysXMaterialHandle
+    val mutable public UserData : uint64
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXCharacterObstacle = 
+    val mutable public Type : uint32
+    val mutable public Reserved : uint32
+    val mutable public Pose : Euclidean3d
+    val mutable public HalfExtents : V3d
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXVehicleFleetHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXVehicleWheelDesc = 
+    val mutable public Attachment : V3d
+    val mutable public Radius : float32
+    val mutable public HalfWidth : float32
+    val mutable public Mass : float32
+    val mutable public DampingRate : float32
+    val mutable public TravelDist : float32
+    val mutable public Stiffness : float32
+    val mutable public Damping : float32
+    val mutable public LatStiff : float32
+    val mutable public LongStiff : float32
+    val mutable public SteerMultiplier : float32
+    val mutable public BrakeMultiplier : float32
+    val mutable public HandbrakeMultiplier : float32
+    val mutable public DriveMultiplier : float32
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXVehicleDesc = 
+    val mutable public Pose : Euclidean3d
+    val mutable public HalfExtents : V3d
+    val mutable public CenterOfMass : V3d
+    val mutable public Mass : float32
+    val mutable public TireFriction : float32
+    val mutable public MaxSteer : float32
+    val mutable public MaxBrakeTorque : float32
+    val mutable public MaxHandbrakeTorque : float32
+    val mutable public MaxDriveTorque : float32
+    val mutable public MaxOmega : float32
+    val mutable public FirstRatio : float32
+    val mutable public TopRatio : float32
+    val mutable public ReverseRatio : float32
+    val mutable public FinalRatio : float32
+    val mutable public GearCount : uint32
+    val mutable public Drive : uint32
+    val mutable public Query : uint32
+    val mutable public Substeps : uint32
+    val mutable public WheelCount : uint32
+    val mutable public Material : PhysXMaterialHandle
+    val mutable public UserData : uint64
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXVehicleCommand = 
+    val mutable public Throttle : float32
+    val mutable public Brake : float32
+    val mutable public Handbrake : float32
+    val mutable public Steer : float32
+    val mutable public Gear : int
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXVehicleStatus = 
+    val mutable public Pose : Euclidean3d
+    val mutable public LinearVelocity : V3d
+    val mutable public ForwardSpeed : float32
+    val mutable public EngineOmega : float32
+    val mutable public Gear : int
+    val mutable public WheelsOnGround : uint32
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXArticulationManagerHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXArticulationLinkDesc = 
+    val mutable public Parent : uint32
+    val mutable public Shape : uint32
+    val mutable public Pose : Euclidean3d
+    val mutable public HalfExtents : V3d
+    val mutable public Density : float32
+    val mutable public Joint : uint32
+    val mutable public ParentFrame : Euclidean3d
+    val mutable public ChildFrame : Euclidean3d
+    val mutable public Lower : float32
+    val mutable public Upper : float32
+    val mutable public SwingLimit : float32
+    val mutable public Stiffness : float32
+    val mutable public Damping : float32
+    val mutable public MaxForce : float32
+    val mutable public Friction : float32
+    val mutable public MaxJointVelocity : float32
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXArticulationDesc = 
+    val mutable public LinkCount : uint32
+    val mutable public FixedBase : uint32
+    val mutable public SelfCollision : uint32
+    val mutable public PositionIterations : uint32
+    val mutable public VelocityIterations : uint32
+    val mutable public Reserved : uint32
+    val mutable public Material : PhysXMaterialHandle
+    val mutable public UserData : uint64
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXArticulationLinkState = 
+    val mutable public Pose : Euclidean3d
+    val mutable public LinearVelocity : V3d
+    val mutable public AngularVelocity : V3d
+    [<MarshalAs(UnmanagedType.ByValArray, SizeConst = 3)>]
+    val mutable public JointPosition : float32[]
+    [<MarshalAs(UnmanagedType.ByValArray, SizeConst = 3)>]
+    val mutable public JointVelocity : float32[]
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXArticulationRange = 
+    val mutable public Id : uint32
+    val mutable public FirstLink : uint32
+    val mutable public LinkCount : uint32
+    val mutable public Sleeping : uint32
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXJointManagerHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXJointDesc = 
+    val mutable public Type : uint32
+    val mutable public CollideConnected : uint32
+    val mutable public Actor0 : PhysxActorHandle
+    val mutable public Actor1 : PhysxActorHandle
+    val mutable public Frame0 : Euclidean3d
+    val mutable public Frame1 : Euclidean3d
+    val mutable public Lower : float32
+    val mutable public Upper : float32
+    val mutable public Swing1 : float32
+    val mutable public Swing2 : float32
+    val mutable public LinearLimit : float32
+    val mutable public LimitStiffness : float32
+    val mutable public LimitDamping : float32
+    val mutable public DriveStiffness : float32
+    val mutable public DriveDamping : float32
+    val mutable public DriveForceLimit : float32
+    val mutable public DriveVelocity : float32
+    val mutable public BreakForce : float32
+    val mutable public BreakTorque : float32
+    val mutable public D6Motion : uint32
+    val mutable public UserData : uint64
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXBrokenJoint = 
+    val mutable public Id : uint32
+    val mutable public Type : uint32
+    val mutable public UserData : uint64
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXDestructibleAssetHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXDestructibleManagerHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXDestructibleChunkDesc = 
+    val mutable public FirstVertex : uint32
+    val mutable public VertexCount : uint32
+    val mutable public Anchored : uint32
+    val mutable public Reserved : uint32
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXDestructibleBond = 
+    val mutable public Chunk0 : uint32
+    val mutable public Chunk1 : uint32
+    val mutable public Strength : float32
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXDestructibleDesc = 
+    val mutable public Asset : PhysXDestructibleAssetHandle
+    val mutable public Pose : Euclidean3d
+    val mutable public Density : float32
+    val mutable public Layer : uint32
+    val mutable public Group : uint32
+    val mutable public Reserved : uint32
+    val mutable public Material : PhysXMaterialHandle
+    val mutable public UserData : uint64
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXDestructiblePiece = 
+    val mutable public Id : uint32
+    val mutable public ChunkCount : uint32
+    val mutable public Actor : PhysxActorHandle
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXFractureServiceHandle = 
+    val mutable public Handle : nativeint
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXFractureRequest = 
+    val mutable public Actor : PhysxActorHandle
+    val mutable public Point : V3d
+    val mutable public Radius : float32
+    val mutable public CellCount : uint32
+    val mutable public Seed : uint32
+    val mutable public Reserved : uint32
+
+[<Struct; StructLayout(LayoutKind.Sequential)>]
+type PhysXFractureResult = 
+    val mutable public Ticket : uint32
+    val mutable public PieceCount : uint32
+    val mutable public FirstPiece : uint32
+    val mutable public Cached : uint32
+    val mutable public Original : PhysxActorHandle
+
 //[<Struct; StructLayout(LayoutKind.Sequential)>]
 //type PhysXParticleInfo = 
 //    val mutable public posInvMass : V4f[]
@@ -118,6 +574,9 @@ module PhysX =
     extern PhysXPbdHandle pxCreatePBD(PhysXSceneHandle sceneHandle, uint32 maxParticles, 
         single centerX, single centerY, single centerZ, uint32 numParticlesDim,
         single particleSpacing, single fluidDensity)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyPBD(PhysXPbdHandle handle)
     
     [<DllImport("PhysXNative")>]
     extern PhysXPbdParticleBuffer pxCreateParticleBuffer(PhysXPbdHandle handle, single centerX, single centerY, single centerZ, uint32 numParticlesDim)
@@ -125,6 +584,570 @@ module PhysX =
     [<DllImport("PhysXNative")>]
     extern void pxGetParticleProperties(
         PhysXPbdHandle handle, V4f* positionsHost, V4f* velsHost, uint32[] phasesHost)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXParticleReadbackHandle pxCreateParticleReadback(PhysXPbdHandle handle, uint32 channels, uint32 format)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyParticleReadback(PhysXParticleReadbackHandle readback)
+
+    [<DllImport("PhysXNative")>]
+    extern int pxUpdateParticleReadback(PhysXParticleReadbackHandle readback)
+
+    [<DllImport("PhysXNative")>]
+    extern int pxAcquireParticleReadback(PhysXParticleReadbackHandle readback, PhysXParticleReadbackFrame& frame)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxAddParticleEmitter(PhysXPbdHandle handle, PhysXParticleEmitterDesc& desc)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxAddParticleMeshEmitter(PhysXPbdHandle handle, PhysXParticleEmitterDesc& desc, 
+        V3f[] vertices, uint32 vertexCount, uint32[] indices, uint32 triangleCount, float32 sampleDistance)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyParticleEmitters(PhysXPbdHandle handle)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxRemoveParticleEmitter(PhysXPbdHandle handle, uint32 emitter)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxSetParticleEmitterPose(PhysXPbdHandle handle, uint32 emitter, Euclidean3d pose)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxSetParticleEmitterRate(PhysXPbdHandle handle, uint32 emitter, float32 rate)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxAddParticleKillVolume(PhysXPbdHandle handle, PhysXParticleKillVolume& volume)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxRemoveParticleKillVolume(PhysXPbdHandle handle, uint32 volume)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxEmitParticles(PhysXPbdHandle handle, uint32 count, V4f[] positionInvMass, V4f[] velocity, uint32[] phase, float32 lifetime)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxUpdateParticleEmitters(PhysXPbdHandle handle, float32 dt)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxGetParticleIds(PhysXPbdHandle handle, uint32[] ids)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXParticleIndexHandle pxCreateParticleIndex(float32 cellSize)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyParticleIndex(PhysXParticleIndexHandle index)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxBuildParticleIndex(PhysXParticleIndexHandle index, V4f[] positions, uint32 count)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxBuildParticleIndexFromPBD(PhysXParticleIndexHandle index, PhysXPbdHandle handle)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxQueryParticlesRadius(PhysXParticleIndexHandle index, V3f[] centers, float32[] radii, uint32 nbQueries, 
+        uint32 maxResults, uint32[] results, uint32[] counts)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxQueryParticlesBox(PhysXParticleIndexHandle index, V3f[] boxMin, V3f[] boxMax, uint32 nbQueries, 
+        uint32 maxResults, uint32[] results, uint32[] counts)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxQueryParticlesNearest(PhysXParticleIndexHandle index, V3f[] centers, uint32 nbQueries, uint32 k, float32 maxRadius, 
+        uint32[] results, float32[] distances, uint32[] counts)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXFluidSurfaceHandle pxCreateFluidSurface(PhysXFluidSurfaceDesc& desc)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyFluidSurface(PhysXFluidSurfaceHandle surface)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxUpdateFluidSurface(PhysXFluidSurfaceHandle surface, V4f[] positions, uint32 count)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxGetFluidSurfaceCounts(PhysXFluidSurfaceHandle surface, uint32& vertexCount, uint32& indexCount)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxGetFluidSurfaceMesh(PhysXFluidSurfaceHandle surface, V3f[] vertices, V3f[] normals, uint32[] indices)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxGetInstanceLayout(uint32& transformSize)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXInstanceExportHandle pxCreateInstanceExport()
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyInstanceExport(PhysXInstanceExportHandle exp)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxCreateInstanceGroup(PhysXInstanceExportHandle exp)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxAssignInstanceGroupOfActor(PhysXInstanceExportHandle exp, PhysxActorHandle actor, uint32 group)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxSetInstanceBuffer(PhysXInstanceExportHandle exp, uint32 group, nativeint buffer, uint32 capacity)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxUpdateInstances(PhysXInstanceExportHandle exp, PhysXSceneHandle scene)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxGetInstanceGroups(PhysXInstanceExportHandle exp, PhysXInstanceGroup[] groups, uint32 maxGroups)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXPoseStreamHandle pxCreatePoseStream(string name, uint32 slotCount, uint32 maxBodies)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyPoseStream(PhysXPoseStreamHandle stream)
+
+    [<DllImport("PhysXNative")>]
+    extern uint64 pxPublishPoseStream(PhysXPoseStreamHandle stream, PhysXBodyTableHandle table, float time)
+
+    [<DllImport("PhysXNative")>]
+    extern uint64 pxPublishPoses(PhysXPoseStreamHandle stream, uint32 count, Euclidean3d[] poses, PhysXBodyHandle[] ids, float time)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXReplayRecorderHandle pxCreateReplayRecorder(string path, uint32 keyframeInterval, uint32 positionBits, uint32 rotationBits)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyReplayRecorder(PhysXReplayRecorderHandle recorder)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxRecordReplayFrame(PhysXReplayRecorderHandle recorder, PhysXBodyTableHandle table, float time)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxRecordReplayPoses(PhysXReplayRecorderHandle recorder, uint32 count, Euclidean3d[] poses, PhysXBodyHandle[] ids, float time)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxFlushReplayRecorder(PhysXReplayRecorderHandle recorder)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXReplayReaderHandle pxOpenReplay(string path)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxCloseReplay(PhysXReplayReaderHandle reader)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxGetReplayInfo(PhysXReplayReaderHandle reader, uint64& frameCount, uint32& maxBodies)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDecodeReplayFrames(PhysXReplayReaderHandle reader, uint64 first, uint64 count, Euclidean3d[] poses, 
+        PhysXBodyHandle[] ids, uint32 stride, uint32[] counts, float[] times)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXServerHandle pxCreateServer(PhysXSceneHandle scene, PhysXBodyTableHandle table, PhysXServerDesc& desc)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyServer(PhysXServerHandle server)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxSetServerOutputs(PhysXServerHandle server, PhysXPoseStreamHandle stream, PhysXReplayRecorderHandle recorder)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxStartServer(PhysXServerHandle server)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxStopServer(PhysXServerHandle server)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxEnqueueServerCommands(PhysXServerHandle server, uint32 count, PhysXServerCommand[] commands)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxLockServer(PhysXServerHandle server)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxUnlockServer(PhysXServerHandle server)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxGetServerStats(PhysXServerHandle server, PhysXServerStats& stats)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxGetServerSnapshot(PhysXServerHandle server, uint64& tick, Euclidean3d[] poses, PhysXBodyHandle[] ids, uint32 maxBodies)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXSnapshotEncoderHandle pxCreateSnapshotEncoder(PhysXSnapshotDesc& desc)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroySnapshotEncoder(PhysXSnapshotEncoderHandle encoder)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxAddSnapshotClient(PhysXSnapshotEncoderHandle encoder)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxRemoveSnapshotClient(PhysXSnapshotEncoderHandle encoder, uint32 client)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxCaptureSnapshot(PhysXSnapshotEncoderHandle encoder, PhysXBodyTableHandle table)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxEncodeSnapshot(PhysXSnapshotEncoderHandle encoder, uint32 client, byte[] buffer, uint32 budget)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxAckSnapshot(PhysXSnapshotEncoderHandle encoder, uint32 client, uint32 seq, uint32[] skipped, uint32 skippedCount)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXSnapshotDecoderHandle pxCreateSnapshotDecoder(PhysXSnapshotDesc& desc)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroySnapshotDecoder(PhysXSnapshotDecoderHandle decoder)
+
+    [<DllImport("PhysXNative")>]
+    extern int pxDecodeSnapshot(PhysXSnapshotDecoderHandle decoder, byte[] data, uint32 size, uint32& seq)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxGetSnapshotUpdates(PhysXSnapshotDecoderHandle decoder, PhysXBodyHandle[] ids, Euclidean3d[] poses, int[] removed)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxGetSnapshotSkipped(PhysXSnapshotDecoderHandle decoder, uint32[] slots)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxGetSnapshotBodies(PhysXSnapshotDecoderHandle decoder, PhysXBodyHandle[] ids, Euclidean3d[] poses, uint32 maxBodies)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXInterestManagerHandle pxCreateInterestManager(float32 cellSize)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyInterestManager(PhysXInterestManagerHandle manager)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxAddObserver(PhysXInterestManagerHandle manager, PhysXObserverDesc& desc)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxRemoveObserver(PhysXInterestManagerHandle manager, uint32 observer)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxSetObserver(PhysXInterestManagerHandle manager, uint32 observer, PhysXObserverDesc& desc)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxUpdateInterest(PhysXInterestManagerHandle manager, PhysXBodyTableHandle table)
+
+    [<DllImport("PhysXNative")>]
+    extern int pxGetInterestCounts(PhysXInterestManagerHandle manager, uint32 observer, uint32& enter, uint32& stay, uint32& leave)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxGetInterestSets(PhysXInterestManagerHandle manager, uint32 observer, PhysXBodyHandle[] enter, PhysXBodyHandle[] stay, PhysXBodyHandle[] leave)
+
+    [<DllImport("PhysXNative")>]
+    extern uint64 pxSerializeScene(PhysXSceneHandle scene, byte[] data, uint64 capacity)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXSceneBatchHandle pxCreateSceneBatch(PhysXHandle handle, PhysXSceneHandle source, byte[] data, uint64 size, uint32 count, V3d gravity)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroySceneBatch(PhysXSceneBatchHandle batch)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxGetSceneBatchInfo(PhysXSceneBatchHandle batch, uint32& copies, uint32& bodies)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxStepSceneBatch(PhysXSceneBatchHandle batch, float32 dt, uint32 substeps, float32[] actions, uint32 mode, float32[] observations)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxObserveSceneBatch(PhysXSceneBatchHandle batch, float32[] observations)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxResetSceneBatch(PhysXSceneBatchHandle batch, uint32[] copies, uint32 count)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXWorldHandle pxCreateWorld(PhysXHandle handle, PhysXWorldDesc& desc)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyWorld(PhysXWorldHandle world)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXBodyHandle pxWorldAddBody(PhysXWorldHandle world, PhysxActorHandle actor, uint64 userData)
+
+    [<DllImport("PhysXNative")>]
+    extern int pxWorldRemoveBody(PhysXWorldHandle world, PhysXBodyHandle handle)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxWorldAddStatic(PhysXWorldHandle world, PhysxActorHandle actor)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxWorldStep(PhysXWorldHandle world, float32 dt)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXBodyTableHandle pxWorldGetBodyTable(PhysXWorldHandle world)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxWorldGetBodyCell(PhysXWorldHandle world, PhysXBodyHandle handle)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxWorldGetCellCounts(PhysXWorldHandle world, uint32[] counts)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxWorldGetStats(PhysXWorldHandle world, PhysXWorldStats& stats)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxWorldApplyCollisionLayers(PhysXWorldHandle world, PhysXCollisionLayersHandle layers, int refilter)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXCollisionLayersHandle pxCreateCollisionLayers(uint32 groupCount)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyCollisionLayers(PhysXCollisionLayersHandle layers)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxSetLayerCollision(PhysXCollisionLayersHandle layers, uint32 a, uint32 b, int collide)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxSetLayerNotify(PhysXCollisionLayersHandle layers, uint32 a, uint32 b, int notify)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxSetGroupIgnore(PhysXCollisionLayersHandle layers, uint32 g0, uint32 g1, int ignore)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxApplyCollisionLayers(PhysXCollisionLayersHandle layers, PhysXSceneHandle scene, int refilter)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxSetActorLayers(uint32 count, PhysxActorHandle[] actors, uint32[] layers, uint32[] groups)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXTriggerManagerHandle pxCreateTriggerManager()
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyTriggerManager(PhysXTriggerManagerHandle manager)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxAddTriggers(PhysXTriggerManagerHandle manager, uint32 count, PhysXTriggerDesc[] descs, uint32[] ids)
+
+    [<DllImport("PhysXNative")>]
+    extern int pxRemoveTrigger(PhysXTriggerManagerHandle manager, uint32 id)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxUpdateTriggers(PhysXTriggerManagerHandle manager, PhysXBodyTableHandle table, PhysXSceneHandle scene)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxUpdateWorldTriggers(PhysXTriggerManagerHandle manager, PhysXWorldHandle world)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxGetTriggerEvents(PhysXTriggerManagerHandle manager, PhysXTriggerEvent[] events, uint32 maxEvents)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXProjectileManagerHandle pxCreateProjectileManager(V3d gravity, float32 impulseScale)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyProjectileManager(PhysXProjectileManagerHandle manager)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxSpawnProjectiles(PhysXProjectileManagerHandle manager, uint32 count, PhysXProjectileDesc[] descs, uint32[] ids)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxStepProjectiles(PhysXProjectileManagerHandle manager, PhysXSceneHandle scene, float32 dt)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxGetProjectileImpacts(PhysXProjectileManagerHandle manager, PhysXProjectileImpact[] impacts, uint32 maxImpacts)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxGetProjectileCount(PhysXProjectileManagerHandle manager)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxGetProjectiles(PhysXProjectileManagerHandle manager, V3d[] positions, V3d[] velocities, uint32[] ids, uint32 maxProjectiles)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxSetCcdModes(PhysXSceneHandle scene, uint32 count, PhysxActorHandle[] actors, uint32[] modes)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxSetCcdAuto(PhysXSceneHandle scene, float32 factor, int dynamicDynamic)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxGetCcdEnabledCount(PhysXSceneHandle scene)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXCharacterManagerHandle pxCreateCharacterManager(PhysXSceneHandle scene, int overlapRecovery, int interactions)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyCharacterManager(PhysXCharacterManagerHandle manager)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxCreateCapsuleControllers(PhysXCharacterManagerHandle manager, uint32 count, PhysXCharacterDesc[] descs, uint32[] ids)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxReleaseControllers(PhysXCharacterManagerHandle manager, uint32 count, uint32[] ids)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxMoveControllers(PhysXCharacterManagerHandle manager, uint32 count, uint32[] ids, V3d[] displacements,
+        float32 minDistance, float32 dt, uint32[] flags, V3d[] positions)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxSetControllerPositions(PhysXCharacterManagerHandle manager, uint32 count, uint32[] ids, V3d[] positions)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxAddCharacterObstacles(PhysXCharacterManagerHandle manager, uint32 count, PhysXCharacterObstacle[] obstacles, uint32[] handles)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxUpdateCharacterObstacles(PhysXCharacterManagerHandle manager, uint32 count, uint32[] handles, PhysXCharacterObstacle[] obstacles)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxRemoveCharacterObstacles(PhysXCharacterManagerHandle manager, uint32 count, uint32[] handles)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXVehicleFleetHandle pxCreateVehicleFleet(PhysXSceneHandle scene)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyVehicleFleet(PhysXVehicleFleetHandle fleet)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxCreateVehicles(PhysXVehicleFleetHandle fleet, uint32 count, PhysXVehicleDesc[] descs, PhysXVehicleWheelDesc[] wheels, uint32[] ids)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxReleaseVehicles(PhysXVehicleFleetHandle fleet, uint32 count, uint32[] ids)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxStepVehicles(PhysXVehicleFleetHandle fleet, float32 dt, uint32 count, uint32[] ids, PhysXVehicleCommand[] commands)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxGetVehicleStatus(PhysXVehicleFleetHandle fleet, uint32 count, uint32[] ids, PhysXVehicleStatus[] status)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxGetVehicleWheelPoses(PhysXVehicleFleetHandle fleet, uint32 count, uint32[] ids, Euclidean3d[] poses, uint32 maxPoses)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysxActorHandle pxGetVehicleActor(PhysXVehicleFleetHandle fleet, uint32 id)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXArticulationManagerHandle pxCreateArticulationManager(PhysXSceneHandle scene)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyArticulationManager(PhysXArticulationManagerHandle manager)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxCreateArticulations(PhysXArticulationManagerHandle manager, uint32 count, PhysXArticulationDesc[] descs, PhysXArticulationLinkDesc[] links, uint32[] ids)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxReleaseArticulations(PhysXArticulationManagerHandle manager, uint32 count, uint32[] ids)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxGetArticulationLayout(PhysXArticulationManagerHandle manager, PhysXArticulationRange[] ranges, uint32 maxRanges, uint32& linkCount)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxExportArticulations(PhysXArticulationManagerHandle manager, PhysXArticulationLinkState[] states, uint32 maxStates)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxSetArticulationStates(PhysXArticulationManagerHandle manager, uint32 count, uint32[] ids, PhysXArticulationLinkState[] states)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxSetArticulationDriveTargets(PhysXArticulationManagerHandle manager, uint32 count, uint32[] ids, float32[] targets)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysxActorHandle pxGetArticulationLink(PhysXArticulationManagerHandle manager, uint32 id, uint32 link)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXJointManagerHandle pxCreateJointManager(PhysXSceneHandle scene)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyJointManager(PhysXJointManagerHandle manager)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxCreateJointsBatch(PhysXJointManagerHandle manager, uint32 count, PhysXJointDesc[] descs, uint32[] ids)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxReleaseJoints(PhysXJointManagerHandle manager, uint32 count, uint32[] ids)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxGetBrokenJoints(PhysXJointManagerHandle manager, PhysXBrokenJoint[] joints, uint32 maxJoints)
+
+    [<DllImport("PhysXNative")>]
+    extern nativeint pxGetJoint(PhysXJointManagerHandle manager, uint32 id)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXDestructibleAssetHandle pxCreateDestructibleAsset(PhysXHandle handle, uint32 chunkCount, PhysXDestructibleChunkDesc[] chunks, V3f[] vertices, uint32 bondCount, PhysXDestructibleBond[] bonds)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyDestructibleAsset(PhysXDestructibleAssetHandle asset)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXDestructibleManagerHandle pxCreateDestructibleManager(PhysXSceneHandle scene)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyDestructibleManager(PhysXDestructibleManagerHandle manager)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxCreateDestructibles(PhysXDestructibleManagerHandle manager, uint32 count, PhysXDestructibleDesc[] descs, uint32[] ids)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxReleaseDestructibles(PhysXDestructibleManagerHandle manager, uint32 count, uint32[] ids)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxUpdateDestructibles(PhysXDestructibleManagerHandle manager)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxGetNewDestructiblePieces(PhysXDestructibleManagerHandle manager, PhysXDestructiblePiece[] pieces, uint32 maxPieces)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxGetDestructibleChunkPoses(PhysXDestructibleManagerHandle manager, uint32 count, uint32[] ids, Euclidean3d[] poses)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXFractureServiceHandle pxCreateFractureService(PhysXSceneHandle scene, uint32 maxCached)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyFractureService(PhysXFractureServiceHandle service)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxRequestFractures(PhysXFractureServiceHandle service, uint32 count, PhysXFractureRequest[] requests, uint32[] tickets)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxApplyFractures(PhysXFractureServiceHandle service)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxGetAppliedFractures(PhysXFractureServiceHandle service, PhysXFractureResult[] results, uint32 maxResults)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxGetFracturePieces(PhysXFractureServiceHandle service, PhysxActorHandle[] pieces, uint32 maxPieces)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxGetPendingFractureCount(PhysXFractureServiceHandle service)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxUpdateMassAndInertia(PhysXSceneHandle scene, uint32 count, PhysxActorHandle[] bodies, float32[] densities)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxAddActors(PhysXSceneHandle scene, uint32 count, PhysxActorHandle[] actors)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxClearMassCache()
+
+    [<DllImport("PhysXNative")>]
+    extern void pxSetMassCacheLimits(uint32 maxShapes, uint32 maxBodies)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXBodyTableHandle pxCreateBodyTable(uint32 capacity)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxDestroyBodyTable(PhysXBodyTableHandle table)
+
+    [<DllImport("PhysXNative")>]
+    extern PhysXBodyHandle pxBodyTableAdd(PhysXBodyTableHandle table, PhysxActorHandle actor, uint64 userData)
+
+    [<DllImport("PhysXNative")>]
+    extern int pxBodyTableRemove(PhysXBodyTableHandle table, PhysXBodyHandle handle, PhysXBodyRemap& remap)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxBodyTableRemoveMany(PhysXBodyTableHandle table, uint32 count, PhysXBodyHandle[] handles, PhysXBodyRemap[] remaps)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxBodyTableCount(PhysXBodyTableHandle table)
+
+    [<DllImport("PhysXNative")>]
+    extern int pxBodyTableIsValid(PhysXBodyTableHandle table, PhysXBodyHandle handle)
+
+    [<DllImport("PhysXNative")>]
+    extern uint32 pxBodyTableGetDenseIndex(PhysXBodyTableHandle table, PhysXBodyHandle handle)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxBodyTableSync(PhysXBodyTableHandle table, PhysXSceneHandle scene)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxBodyTableGetPoses(PhysXBodyTableHandle table, uint32 start, uint32 count, Euclidean3d[] poses)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxBodyTableGetVelocities(PhysXBodyTableHandle table, uint32 start, uint32 count, V3d[] linear, V3d[] angular)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxBodyTableSetLinearVelocities(PhysXBodyTableHandle table, uint32 count, uint32[] dense, V3d[] velocities)
+
+    [<DllImport("PhysXNative")>]
+    extern void pxBodyTableSetAngularVelocities(PhysXBodyTableHandle table, uint32 count, uint32[] dense, V3d[] velocities)
     
 type Material =
     {
@@ -174,6 +1197,8 @@ type PhysXScene(gravity : V3d) =
     let particleSpawnSize = 1.0f
     let particleSpacing = particleSpawnSize / single(numParticlesDim)
     let pbdHandle = PhysX.pxCreatePBD(sceneHandle, maxParticles, 0.0f, 0.0f, 1.0f, numParticlesDim, particleSpacing, 1000.0f)
+    // positions, velocities and phases without packing
+    let particleReadback = PhysX.pxCreateParticleReadback(pbdHandle, 7u, 0u)
     let matCache = Dict<Material, PhysXMaterialHandle>()
     let actors = System.Collections.Generic.HashSet<PhysXActor>()
     
@@ -252,15 +1277,18 @@ type PhysXScene(gravity : V3d) =
         )
 
     member x.ReadParticleProperties() =
-        positionsBuffer.SetValue(V4f(42.0f, 43.0f, 44.0f, 45.0f), 0)
-        velsBuffer.SetValue(V4f(22.0f, 43.0f, 44.0f, 45.0f), 0)
-        phasesBuffer.SetValue(uint32(48), 1)
-        use positionsBufferFixed = fixed positionsBuffer
-        use velsBufferFixed = fixed velsBuffer
-        PhysX.pxGetParticleProperties(pbdHandle, positionsBufferFixed, velsBufferFixed, phasesBuffer)
+        PhysX.pxUpdateParticleReadback(particleReadback) |> ignore
+        let mutable frame = PhysXParticleReadbackFrame()
+        if PhysX.pxAcquireParticleReadback(particleReadback, &frame) <> 0 then
+            let n = int frame.Count
+            System.Span<V4f>(frame.PositionInvMass.ToPointer(), n).CopyTo(System.Span<V4f>(positionsBuffer))
+            System.Span<V4f>(frame.Velocity.ToPointer(), n).CopyTo(System.Span<V4f>(velsBuffer))
+            System.Span<uint32>(frame.Phase.ToPointer(), n).CopyTo(System.Span<uint32>(phasesBuffer))
 
     member x.Dispose() =
         lock actors (fun () ->
+            PhysX.pxDestroyParticleReadback(particleReadback)
+            PhysX.pxDestroyPBD(pbdHandle)
             PhysX.pxDestroyScene(sceneHandle)
         )
 
@@ -270,6 +1298,7 @@ type PhysXScene(gravity : V3d) =
 and PhysXActor(parent : PhysXScene, isDynamic : bool, geometryDesc : Geometry, handle : PhysxActorHandle, geometry : PhysXGeometryHandle) =
     let mutable isDisposed = 0
     
+    member x.Handle = handle
     member x.Geometry = geometryDesc
 
 
@@ -7,6 +7,42 @@ open Aardvark.Rendering
 
 open Aardvark.PhysX
 
+// Transforms of one instance group, written by pxUpdateInstances straight into a pinned array.
+type InstanceBuffer(exp : PhysXInstanceExportHandle, group : uint32) =
+    let mutable data : M34f[] = Array.zeroCreate 256
+    let mutable pin = GCHandle.Alloc(data, GCHandleType.Pinned)
+    do PhysX.pxSetInstanceBuffer(exp, group, pin.AddrOfPinnedObject(), uint32 data.Length)
+
+    member x.Group = group
+
+    // returns false if the buffer had to grow and the group must be written again
+    member x.Fits(count : uint32) =
+        if int count <= data.Length then 
+            true
+        else
+            pin.Free()
+            data <- Array.zeroCreate (max (int count) (2 * data.Length))
+            pin <- GCHandle.Alloc(data, GCHandleType.Pinned)
+            PhysX.pxSetInstanceBuffer(exp, group, pin.AddrOfPinnedObject(), uint32 data.Length)
+            false
+
+    member x.Trafos(count : uint32) =
+        Array.init (int count) (fun i ->
+            let m = data.[i]
+            let f = 
+                M44d(
+                    float m.M00, float m.M01, float m.M02, float m.M03,
+                    float m.M10, float m.M11, float m.M12, float m.M13,
+                    float m.M20, float m.M21, float m.M22, float m.M23,
+                    0.0, 0.0, 0.0, 1.0
+                )
+            Trafo3d(f, f.Inverse)
+        )
+
+    member x.Dispose() =
+        PhysX.pxSetInstanceBuffer(exp, group, 0n, 0u)
+        pin.Free()
+
 [<EntryPoint>]
 let main args =
     Aardvark.Init()
@@ -45,6 +81,16 @@ let main args =
 
     let boxes = cset []
     let spheres = cmap<PhysXActor, float>()
+
+    // boxes and bullets are drawn from the native instance export, one group each
+    let instances = PhysX.pxCreateInstanceExport()
+    let boxInstances = new InstanceBuffer(instances, PhysX.pxCreateInstanceGroup(instances))
+    let sphereInstances = new InstanceBuffer(instances, PhysX.pxCreateInstanceGroup(instances))
+
+    let addDynamic (buffer : InstanceBuffer) (desc : PhysXDynamicActorDescription) =
+        let actor = scene.AddDynamic desc
+        PhysX.pxAssignInstanceGroupOfActor(instances, actor.Handle, buffer.Group)
+        actor
     
 
     
@@ -54,7 +100,7 @@ let main args =
                 let p = V3d(float x, float y, float z + 0.5) * 0.5
 
                 let box = 
-                    scene.AddDynamic  {
+                    addDynamic boxInstances {
                         Geometry = Box V3d.Half
                         Pose = Euclidean3d.Translation(p)
                         Density = 1.0
@@ -128,7 +174,7 @@ let main args =
                     let a = rand.UniformDouble() * Constant.PiTimesTwo
                     
                     let box = 
-                        scene.AddDynamic {
+                        addDynamic boxInstances {
                             Geometry = Box V3d.Half
                             Pose = Euclidean3d.Translation(p) * Euclidean3d.Rotation(r, a)
                             Density = 1.0
@@ -140,7 +186,7 @@ let main args =
 
         | Keys.Escape-> 
             for a in boxes do a.Dispose()
-            let newBox = scene.AddDynamic (randomBox())
+            let newBox = addDynamic boxInstances (randomBox())
             transact (fun () ->
                 lock boxes (fun () -> boxes.Value <- HashSet.single newBox)
             )
@@ -160,7 +206,7 @@ let main args =
                         let origin = origin + dir * 3.0
 
                         let bullet =
-                            scene.AddDynamic {
+                            addDynamic sphereInstances {
                                 Geometry = Sphere 0.05
                                 Density = 1000.0
                                 Velocity = dir * 10.0
@@ -199,22 +245,27 @@ let main args =
         | _ -> ()
     )
 
-    let boxTrafos = 
-        let actors = ASet.toAVal boxes
-        AVal.custom (fun t ->
-            let sim = sim.GetValue t 
-            let a = actors.GetValue t
-            a |> HashSet.toArray |> Array.map (fun m -> m.Pose |> Euclidean3d.op_Explicit : Trafo3d)
-        
+    let instanceTrafos =
+        let groups : PhysXInstanceGroup[] = Array.zeroCreate 16
+        let count (buffer : InstanceBuffer) n =
+            groups |> Array.truncate n |> Array.tryFind (fun g -> g.Id = buffer.Group) |> Option.map (fun g -> g.Count) |> Option.defaultValue 0u
+
+        sim |> AVal.map (fun scene ->
+            lock scene.ActorSet (fun () ->
+                let mutable n = int (PhysX.pxUpdateInstances(instances, scene.Handle))
+                PhysX.pxGetInstanceGroups(instances, groups, uint32 groups.Length) |> ignore
+                let fitBoxes = boxInstances.Fits(count boxInstances n)
+                let fitSpheres = sphereInstances.Fits(count sphereInstances n)
+                if not (fitBoxes && fitSpheres) then
+                    n <- int (PhysX.pxUpdateInstances(instances, scene.Handle))
+                    PhysX.pxGetInstanceGroups(instances, groups, uint32 groups.Length) |> ignore
+
+                boxInstances.Trafos(count boxInstances n), sphereInstances.Trafos(count sphereInstances n)
+            )
         )
 
-    let sphereTrafos = 
-        let actors = AMap.toAVal spheres
-        AVal.custom (fun t ->
-            let sim = sim.GetValue t 
-            let a = actors.GetValue t
-            a |> HashMap.toKeyArray |> Array.map (fun m -> m.Pose |> Euclidean3d.op_Explicit : Trafo3d)
-        )
+    let boxTrafos = instanceTrafos |> AVal.map fst
+    let sphereTrafos = instanceTrafos |> AVal.map snd
 
     let particleTrafos = 
         AVal.custom (fun t ->
@@ -263,6 +314,9 @@ let main args =
 
     //plane.Dispose()
 
+    boxInstances.Dispose()
+    sphereInstances.Dispose()
+    PhysX.pxDestroyInstanceExport(instances)
     scene.Dispose()
     0
     
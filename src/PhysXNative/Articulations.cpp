@@ -0,0 +1,313 @@
+#include "Articulations.h"
+#include "MassCache.h"
+#include "Parallel.h"
+
+using namespace physx;
+
+static const PxU32 ExportGrain = 4;
+
+static const PxArticulationCacheFlags StateFlags =
+    PxArticulationCacheFlag::ePOSITION | PxArticulationCacheFlag::eVELOCITY | PxArticulationCacheFlag::eLINK_VELOCITY;
+
+static PxU32 jointAxes(PxU32 kind, PxArticulationAxis::Enum* axes) {
+    switch(kind) {
+        case PxArticulationJointRevolute:
+            axes[0] = PxArticulationAxis::eTWIST;
+            return 1;
+        case PxArticulationJointPrismatic:
+            axes[0] = PxArticulationAxis::eX;
+            return 1;
+        case PxArticulationJointSpherical:
+            axes[0] = PxArticulationAxis::eTWIST;
+            axes[1] = PxArticulationAxis::eSWING1;
+            axes[2] = PxArticulationAxis::eSWING2;
+            return 3;
+        default:
+            return 0;
+    }
+}
+
+// the unlocked axes of the inbound joint, in the order of its dofs in the cache
+static PxU32 jointAxes(PxArticulationLink* link, PxArticulationAxis::Enum* axes) {
+    auto joint = link->getInboundJoint();
+    if(!joint) return 0;
+    PxU32 n = 0;
+    for(PxU32 a = 0; a < PxArticulationAxis::eCOUNT && n < 3; a++) {
+        auto axis = (PxArticulationAxis::Enum)a;
+        if(joint->getMotion(axis) != PxArticulationMotion::eLOCKED) axes[n++] = axis;
+    }
+    return n;
+}
+
+static void configureJoint(PxArticulationJointReducedCoordinate* joint, const PxArticulationLinkDesc& d) {
+    joint->setParentPose(toPxTransform(d.ParentFrame));
+    joint->setChildPose(toPxTransform(d.ChildFrame));
+    if(d.Friction > 0.0f) joint->setFrictionCoefficient(d.Friction);
+    if(d.MaxJointVelocity > 0.0f) joint->setMaxJointVelocity(d.MaxJointVelocity);
+
+    switch(d.Joint) {
+        case PxArticulationJointRevolute: joint->setJointType(PxArticulationJointType::eREVOLUTE); break;
+        case PxArticulationJointPrismatic: joint->setJointType(PxArticulationJointType::ePRISMATIC); break;
+        case PxArticulationJointSpherical: joint->setJointType(PxArticulationJointType::eSPHERICAL); break;
+        default: joint->setJointType(PxArticulationJointType::eFIX); break;
+    }
+
+    PxArticulationAxis::Enum axes[3];
+    auto n = jointAxes(d.Joint, axes);
+    auto maxForce = d.MaxForce > 0.0f ? d.MaxForce : PX_MAX_F32;
+    for(PxU32 k = 0; k < n; k++) {
+        auto axis = axes[k];
+        auto swing = axis == PxArticulationAxis::eSWING1 || axis == PxArticulationAxis::eSWING2;
+        if(swing && d.SwingLimit > 0.0f) {
+            joint->setMotion(axis, PxArticulationMotion::eLIMITED);
+            joint->setLimitParams(axis, PxArticulationLimit(-d.SwingLimit, d.SwingLimit));
+        }
+        else if(!swing && d.Lower < d.Upper) {
+            joint->setMotion(axis, PxArticulationMotion::eLIMITED);
+            joint->setLimitParams(axis, PxArticulationLimit(d.Lower, d.Upper));
+        }
+        else joint->setMotion(axis, PxArticulationMotion::eFREE);
+
+        if(d.Stiffness > 0.0f || d.Damping > 0.0f) {
+            joint->setDriveParams(axis, PxArticulationDrive(d.Stiffness, d.Damping, maxForce, PxArticulationDriveType::eFORCE));
+        }
+    }
+}
+
+static bool attachShape(PxArticulationLink* link, const PxArticulationLinkDesc& d, PxMaterial* material) {
+    PxShape* shape;
+    switch(d.Shape) {
+        case PxArticulationShapeSphere:
+            shape = PxRigidActorExt::createExclusiveShape(*link, PxSphereGeometry((float)d.HalfExtents.X), *material);
+            break;
+        case PxArticulationShapeCapsule:
+            shape = PxRigidActorExt::createExclusiveShape(*link, PxCapsuleGeometry((float)d.HalfExtents.X, (float)d.HalfExtents.Y), *material);
+            break;
+        default:
+            shape = PxRigidActorExt::createExclusiveShape(*link, PxBoxGeometry(toPxVec3(d.HalfExtents)), *material);
+            break;
+    }
+    return shape != nullptr;
+}
+
+ArticulationManager::~ArticulationManager() {
+    for(PxU32 id = 0; id < (PxU32)Articulations.size(); id++) release(id);
+}
+
+PxU32 ArticulationManager::create(const PxArticulationDesc& desc, const PxArticulationLinkDesc* links) {
+    auto n = desc.LinkCount;
+    if(n == 0 || !desc.Material || links[0].Parent != 0xFFFFFFFF) return 0xFFFFFFFF;
+    for(PxU32 i = 1; i < n; i++) {
+        if(links[i].Parent >= i) return 0xFFFFFFFF;
+    }
+
+    auto articulation = Scene->Physics->createArticulationReducedCoordinate();
+    if(!articulation) return 0xFFFFFFFF;
+    articulation->setArticulationFlag(PxArticulationFlag::eFIX_BASE, desc.FixedBase != 0);
+    articulation->setArticulationFlag(PxArticulationFlag::eDISABLE_SELF_COLLISION, desc.SelfCollision == 0);
+    if(desc.PositionIterations > 0) {
+        articulation->setSolverIterationCounts(desc.PositionIterations, desc.VelocityIterations > 0 ? desc.VelocityIterations : 1);
+    }
+
+    auto entry = new ArticulationEntry();
+    entry->Articulation = articulation;
+    entry->Cache = nullptr;
+    entry->UserData = desc.UserData;
+    entry->Links.resize(n);
+    for(PxU32 i = 0; i < n; i++) {
+        auto& d = links[i];
+        auto parent = i == 0 ? nullptr : entry->Links[d.Parent];
+        auto link = articulation->createLink(parent, toPxTransform(d.Pose));
+        if(!link || !attachShape(link, d, desc.Material)) {
+            articulation->release();
+            delete entry;
+            return 0xFFFFFFFF;
+        }
+        massCache().updateMassAndInertia(*link, d.Density > 0.0f ? d.Density : 1.0f);
+        if(parent) configureJoint(link->getInboundJoint(), d);
+        entry->Links[i] = link;
+    }
+    articulation->userData = (void*)(size_t)desc.UserData;
+
+    // the cache and the low-level link indices only exist once the articulation is in a scene
+    if(!Scene->Scene->addArticulation(*articulation)) {
+        articulation->release();
+        delete entry;
+        return 0xFFFFFFFF;
+    }
+    entry->Cache = articulation->createCache();
+
+    // dofs are stored by low-level link index, see PxArticulationCache::jointPosition
+    std::vector<PxU32> starts(n, 0);
+    entry->LinkIndex.resize(n);
+    entry->DofCount.resize(n);
+    entry->DofStart.resize(n);
+    for(PxU32 i = 0; i < n; i++) {
+        entry->LinkIndex[i] = entry->Links[i]->getLinkIndex();
+        entry->DofCount[i] = entry->Links[i]->getInboundJointDof();
+        starts[entry->LinkIndex[i]] = entry->DofCount[i];
+    }
+    PxU32 dofs = 0;
+    for(PxU32 i = 0; i < n; i++) {
+        auto c = starts[i];
+        starts[i] = dofs;
+        dofs += c;
+    }
+    for(PxU32 i = 0; i < n; i++) entry->DofStart[i] = starts[entry->LinkIndex[i]];
+
+    PxU32 id;
+    if(FreeIds.empty()) {
+        id = (PxU32)Articulations.size();
+        Articulations.push_back(entry);
+    }
+    else {
+        id = FreeIds.back();
+        FreeIds.pop_back();
+        Articulations[id] = entry;
+    }
+    return id;
+}
+
+void ArticulationManager::release(PxU32 id) {
+    auto entry = get(id);
+    if(!entry) return;
+    if(entry->Cache) entry->Cache->release();
+    // removes the articulation from its scene and releases its links
+    entry->Articulation->release();
+    delete entry;
+    Articulations[id] = nullptr;
+    FreeIds.push_back(id);
+}
+
+PxU32 ArticulationManager::layout(PxArticulationRange* ranges, PxU32 maxRanges, PxU32* linkCount) const {
+    PxU32 count = 0;
+    PxU32 links = 0;
+    for(PxU32 id = 0; id < (PxU32)Articulations.size(); id++) {
+        auto entry = Articulations[id];
+        if(!entry) continue;
+        auto n = (PxU32)entry->Links.size();
+        if(ranges && count < maxRanges) {
+            ranges[count] = { id, links, n, entry->Articulation->isSleeping() ? 1u : 0u };
+        }
+        count++;
+        links += n;
+    }
+    if(linkCount) *linkCount = links;
+    return count;
+}
+
+static void readStates(ArticulationEntry* entry, PxArticulationLinkState* states) {
+    auto cache = entry->Cache;
+    entry->Articulation->copyInternalStateToCache(*cache, StateFlags);
+    for(PxU32 i = 0; i < (PxU32)entry->Links.size(); i++) {
+        auto& s = states[i];
+        // the cache holds no link poses, reading them from the links does not write the scene
+        s.Pose = toEuclidean3d(entry->Links[i]->getGlobalPose());
+        auto& v = cache->linkVelocity[entry->LinkIndex[i]];
+        s.LinearVelocity = toV3d(v.linear);
+        s.AngularVelocity = toV3d(v.angular);
+        auto start = entry->DofStart[i];
+        auto count = entry->DofCount[i];
+        for(PxU32 k = 0; k < 3; k++) {
+            s.JointPosition[k] = k < count ? cache->jointPosition[start + k] : 0.0f;
+            s.JointVelocity[k] = k < count ? cache->jointVelocity[start + k] : 0.0f;
+        }
+    }
+}
+
+PxU32 ArticulationManager::exportStates(PxArticulationLinkState* states, PxU32 maxStates, PxCpuDispatcher* dispatcher) {
+    Live.clear();
+    Offsets.clear();
+    PxU32 total = 0;
+    for(auto entry : Articulations) {
+        if(!entry) continue;
+        auto n = (PxU32)entry->Links.size();
+        if(total + n > maxStates) break;
+        Live.push_back(entry);
+        Offsets.push_back(total);
+        total += n;
+    }
+
+    // each articulation only writes its own cache
+    parallelFor(dispatcher, (PxU32)Live.size(), ExportGrain, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 i = begin; i < end; i++) readStates(Live[i], states + Offsets[i]);
+    });
+    return total;
+}
+
+void ArticulationManager::apply(ArticulationEntry* entry, const PxArticulationLinkState* states) {
+    auto cache = entry->Cache;
+    auto root = cache->rootLinkData;
+    root->transform = toPxTransform(states[0].Pose);
+    root->worldLinVel = toPxVec3(states[0].LinearVelocity);
+    root->worldAngVel = toPxVec3(states[0].AngularVelocity);
+    for(PxU32 i = 0; i < (PxU32)entry->Links.size(); i++) {
+        auto start = entry->DofStart[i];
+        auto count = entry->DofCount[i];
+        for(PxU32 k = 0; k < count && k < 3; k++) {
+            cache->jointPosition[start + k] = states[i].JointPosition[k];
+            cache->jointVelocity[start + k] = states[i].JointVelocity[k];
+        }
+    }
+    // applying positions and the root transform updates the link poses as well
+    entry->Articulation->applyCache(*cache, PxArticulationCacheFlag::ePOSITION | PxArticulationCacheFlag::eVELOCITY |
+        PxArticulationCacheFlag::eROOT_TRANSFORM | PxArticulationCacheFlag::eROOT_VELOCITIES);
+}
+
+
+DllExport(ArticulationManager*) pxCreateArticulationManager(PxSceneHandle* scene) {
+    return new ArticulationManager(scene);
+}
+
+DllExport(void) pxDestroyArticulationManager(ArticulationManager* manager) {
+    delete manager;
+}
+
+DllExport(void) pxCreateArticulations(ArticulationManager* manager, PxU32 count, const PxArticulationDesc* descs,
+        const PxArticulationLinkDesc* links, PxU32* ids) {
+    for(PxU32 i = 0; i < count; i++) {
+        auto id = manager->create(descs[i], links);
+        links += descs[i].LinkCount;
+        if(ids) ids[i] = id;
+    }
+}
+
+DllExport(void) pxReleaseArticulations(ArticulationManager* manager, PxU32 count, const PxU32* ids) {
+    for(PxU32 i = 0; i < count; i++) manager->release(ids[i]);
+}
+
+DllExport(PxU32) pxGetArticulationLayout(ArticulationManager* manager, PxArticulationRange* ranges, PxU32 maxRanges, PxU32* linkCount) {
+    return manager->layout(ranges, maxRanges, linkCount);
+}
+
+DllExport(PxU32) pxExportArticulations(ArticulationManager* manager, PxArticulationLinkState* states, PxU32 maxStates) {
+    return manager->exportStates(states, maxStates, sharedDispatcher());
+}
+
+DllExport(void) pxSetArticulationStates(ArticulationManager* manager, PxU32 count, const PxU32* ids, const PxArticulationLinkState* states) {
+    // released ids take no states
+    for(PxU32 i = 0; i < count; i++) {
+        auto entry = manager->get(ids[i]);
+        if(!entry) continue;
+        manager->apply(entry, states);
+        states += entry->Links.size();
+    }
+}
+
+DllExport(void) pxSetArticulationDriveTargets(ArticulationManager* manager, PxU32 count, const PxU32* ids, const float* targets) {
+    for(PxU32 i = 0; i < count; i++) {
+        auto entry = manager->get(ids[i]);
+        if(!entry) continue;
+        for(auto link : entry->Links) {
+            PxArticulationAxis::Enum axes[3];
+            auto n = jointAxes(link, axes);
+            for(PxU32 k = 0; k < n; k++) link->getInboundJoint()->setDriveTarget(axes[k], targets[k]);
+            targets += 3;
+        }
+    }
+}
+
+DllExport(PxArticulationLink*) pxGetArticulationLink(ArticulationManager* manager, PxU32 id, PxU32 link) {
+    auto entry = manager->get(id);
+    return entry && link < entry->Links.size() ? entry->Links[link] : nullptr;
+}
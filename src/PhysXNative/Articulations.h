@@ -0,0 +1,121 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include <vector>
+
+enum PxArticulationShapeType {
+    PxArticulationShapeBox = 0,         // HalfExtents
+    PxArticulationShapeSphere = 1,      // radius in HalfExtents.X
+    PxArticulationShapeCapsule = 2      // along X, radius in HalfExtents.X, half height in HalfExtents.Y
+};
+
+enum PxArticulationJointKind {
+    PxArticulationJointFixed = 0,
+    PxArticulationJointRevolute = 1,    // about X of the joint frames, one dof
+    PxArticulationJointPrismatic = 2,   // along X of the joint frames, one dof
+    PxArticulationJointSpherical = 3    // twist about X, swing about Y and Z, three dofs
+};
+
+typedef struct {
+    physx::PxU32 Parent;        // index of the parent in the link array of the articulation, 0xFFFFFFFF for the root
+    physx::PxU32 Shape;
+    Euclidean3d Pose;           // world pose at creation
+    V3d HalfExtents;
+    float Density;
+    physx::PxU32 Joint;         // inbound joint kind, ignored for the root
+    Euclidean3d ParentFrame;    // joint frame relative to the parent link
+    Euclidean3d ChildFrame;     // joint frame relative to this link
+    float Lower;                // revolute, prismatic and twist limit, Lower >= Upper leaves the axis free
+    float Upper;
+    float SwingLimit;           // symmetric limit of both swing axes, 0 leaves them free
+    float Stiffness;            // drive on every joint axis, 0 disables the drive
+    float Damping;
+    float MaxForce;
+    float Friction;             // joint friction coefficient
+    float MaxJointVelocity;     // 0 keeps the default
+} PxArticulationLinkDesc;
+
+typedef struct {
+    physx::PxU32 LinkCount;     // number of PxArticulationLinkDesc, parents must come before their children
+    physx::PxU32 FixedBase;
+    physx::PxU32 SelfCollision;
+    physx::PxU32 PositionIterations;    // 0 keeps the default
+    physx::PxU32 VelocityIterations;
+    physx::PxU32 Reserved;
+    physx::PxMaterial* Material;
+    physx::PxU64 UserData;
+} PxArticulationDesc;
+
+// One link of the exported state, links keep the order of their description.
+typedef struct {
+    Euclidean3d Pose;
+    V3d LinearVelocity;         // world frame, at the center of mass
+    V3d AngularVelocity;
+    float JointPosition[3];     // inbound joint dofs in PxArticulationAxis order, unused entries are 0
+    float JointVelocity[3];
+} PxArticulationLinkState;
+
+typedef struct {
+    physx::PxU32 Id;
+    physx::PxU32 FirstLink;     // into the exported link states
+    physx::PxU32 LinkCount;
+    physx::PxU32 Sleeping;
+} PxArticulationRange;
+
+struct ArticulationEntry {
+    physx::PxArticulationReducedCoordinate* Articulation;
+    physx::PxArticulationCache* Cache;
+    // in description order
+    std::vector<physx::PxArticulationLink*> Links;
+    std::vector<physx::PxU32> LinkIndex;    // low-level index, into the link data of the cache
+    std::vector<physx::PxU32> DofStart;     // of each link's inbound joint in the cache
+    std::vector<physx::PxU32> DofCount;
+    physx::PxU64 UserData;
+};
+
+// Reduced coordinate articulations (e.g. ragdolls) of one scene. Each
+// articulation owns one PxArticulationCache, all state reads and writes go
+// through it instead of the per link and per joint getters. exportStates
+// writes the state of every live articulation into one contiguous array of
+// link states, laid out by the ranges of layout, so a frame's ragdolls are
+// copied in a single call.
+class ArticulationManager {
+public:
+    ArticulationManager(PxSceneHandle* scene) : Scene(scene) {}
+    ~ArticulationManager();
+
+    PxSceneHandle* Scene;
+
+    // indexed by articulation id, NULL for released ones
+    std::vector<ArticulationEntry*> Articulations;
+    std::vector<physx::PxU32> FreeIds;
+
+    physx::PxU32 create(const PxArticulationDesc& desc, const PxArticulationLinkDesc* links);
+    void release(physx::PxU32 id);
+    ArticulationEntry* get(physx::PxU32 id) const { return id < Articulations.size() ? Articulations[id] : nullptr; }
+
+    // returns the number of live articulations, ranges may be NULL
+    physx::PxU32 layout(PxArticulationRange* ranges, physx::PxU32 maxRanges, physx::PxU32* linkCount) const;
+    // states receives the links of all live articulations in id order, returns the number of links written
+    physx::PxU32 exportStates(PxArticulationLinkState* states, physx::PxU32 maxStates, physx::PxCpuDispatcher* dispatcher);
+    // states holds the links of one articulation, only the root pose and velocities and joint dofs are applied
+    void apply(ArticulationEntry* entry, const PxArticulationLinkState* states);
+
+private:
+    std::vector<ArticulationEntry*> Live;
+    std::vector<physx::PxU32> Offsets;
+};
+
+DllExport(ArticulationManager*) pxCreateArticulationManager(PxSceneHandle* scene);
+DllExport(void) pxDestroyArticulationManager(ArticulationManager* manager);
+// links holds the PxArticulationLinkDesc of all descs back to back
+DllExport(void) pxCreateArticulations(ArticulationManager* manager, physx::PxU32 count, const PxArticulationDesc* descs,
+    const PxArticulationLinkDesc* links, physx::PxU32* ids);
+DllExport(void) pxReleaseArticulations(ArticulationManager* manager, physx::PxU32 count, const physx::PxU32* ids);
+DllExport(physx::PxU32) pxGetArticulationLayout(ArticulationManager* manager, PxArticulationRange* ranges, physx::PxU32 maxRanges, physx::PxU32* linkCount);
+DllExport(physx::PxU32) pxExportArticulations(ArticulationManager* manager, PxArticulationLinkState* states, physx::PxU32 maxStates);
+// states holds the links of all ids back to back
+DllExport(void) pxSetArticulationStates(ArticulationManager* manager, physx::PxU32 count, const physx::PxU32* ids, const PxArticulationLinkState* states);
+// targets holds three values per link of all ids back to back, in the layout of PxArticulationLinkState::JointPosition
+DllExport(void) pxSetArticulationDriveTargets(ArticulationManager* manager, physx::PxU32 count, const physx::PxU32* ids, const float* targets);
+DllExport(physx::PxArticulationLink*) pxGetArticulationLink(ArticulationManager* manager, physx::PxU32 id, physx::PxU32 link);
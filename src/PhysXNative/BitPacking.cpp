@@ -0,0 +1,56 @@
+#include "BitPacking.h"
+
+using namespace physx;
+
+// components other than the largest lie in [-1/sqrt(2), 1/sqrt(2)]
+static const float QuatRange = 0.70710678f;
+
+PositionQuantizer::PositionQuantizer(const PxBounds3& bounds, PxU32 bits) : Min(bounds.minimum), Bits(bits) {
+    auto steps = (float)BitWriter::maskOf(bits);
+    for(PxU32 a = 0; a < 3; a++) {
+        auto extent = PxMax(bounds.maximum[a] - bounds.minimum[a], 1e-6f);
+        Scale[a] = steps / extent;
+        InvScale[a] = extent / steps;
+    }
+}
+
+void PositionQuantizer::quantize(const PxVec3& p, PxU32* q) const {
+    auto maxValue = (float)BitWriter::maskOf(Bits);
+    for(PxU32 a = 0; a < 3; a++) {
+        auto v = PxClamp((p[a] - Min[a]) * Scale[a] + 0.5f, 0.0f, maxValue);
+        q[a] = (PxU32)v;
+    }
+}
+
+PxVec3 PositionQuantizer::dequantize(const PxU32* q) const {
+    return PxVec3(Min.x + q[0] * InvScale.x, Min.y + q[1] * InvScale.y, Min.z + q[2] * InvScale.z);
+}
+
+PxU32 quantizeQuat(const PxQuat& q, PxU32 bits, PxU32* components) {
+    float v[4] = { q.x, q.y, q.z, q.w };
+    PxU32 largest = 0;
+    for(PxU32 i = 1; i < 4; i++) if(PxAbs(v[i]) > PxAbs(v[largest])) largest = i;
+    auto sign = v[largest] < 0.0f ? -1.0f : 1.0f;
+
+    auto maxValue = (float)BitWriter::maskOf(bits);
+    auto scale = maxValue / (2.0f * QuatRange);
+    for(PxU32 i = 0, c = 0; i < 4; i++) {
+        if(i == largest) continue;
+        auto x = PxClamp((v[i] * sign + QuatRange) * scale + 0.5f, 0.0f, maxValue);
+        components[c++] = (PxU32)x;
+    }
+    return largest;
+}
+
+PxQuat dequantizeQuat(PxU32 largest, const PxU32* components, PxU32 bits) {
+    auto inv = 2.0f * QuatRange / (float)BitWriter::maskOf(bits);
+    float v[4];
+    float sum = 0.0f;
+    for(PxU32 i = 0, c = 0; i < 4; i++) {
+        if(i == largest) continue;
+        v[i] = components[c++] * inv - QuatRange;
+        sum += v[i] * v[i];
+    }
+    v[largest] = PxSqrt(PxMax(0.0f, 1.0f - sum));
+    return PxQuat(v[0], v[1], v[2], v[3]).getNormalized();
+}
@@ -0,0 +1,105 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include <vector>
+
+// Appends values of up to 32 bits LSB first into a byte vector.
+class BitWriter {
+public:
+    explicit BitWriter(std::vector<physx::PxU8>& bytes) : Bytes(bytes), Acc(0), Bits(0) {}
+
+    void write(physx::PxU32 value, physx::PxU32 bits) {
+        if(bits == 0) return;
+        Acc |= (physx::PxU64)(value & maskOf(bits)) << Bits;
+        Bits += bits;
+        while(Bits >= 8) {
+            Bytes.push_back((physx::PxU8)Acc);
+            Acc >>= 8;
+            Bits -= 8;
+        }
+    }
+
+    // pads to the next byte
+    void flush() {
+        if(Bits > 0) Bytes.push_back((physx::PxU8)Acc);
+        Acc = 0;
+        Bits = 0;
+    }
+
+    size_t bitCount() const { return Bytes.size() * 8 + Bits; }
+
+    static physx::PxU32 maskOf(physx::PxU32 bits) { return bits >= 32 ? 0xFFFFFFFFu : (1u << bits) - 1; }
+
+private:
+    std::vector<physx::PxU8>& Bytes;
+    physx::PxU64 Acc;
+    physx::PxU32 Bits;
+};
+
+// Reads what BitWriter wrote, reads past the end return zeros and set Overrun.
+class BitReader {
+public:
+    BitReader(const physx::PxU8* data, size_t size) : Data(data), Size(size), Pos(0), Acc(0), Bits(0), Overrun(false) {}
+
+    physx::PxU32 read(physx::PxU32 bits) {
+        if(bits == 0) return 0;
+        while(Bits < bits) {
+            physx::PxU64 b = 0;
+            if(Pos < Size) b = Data[Pos];
+            else Overrun = true;
+            Pos++;
+            Acc |= b << Bits;
+            Bits += 8;
+        }
+        auto v = (physx::PxU32)(Acc & BitWriter::maskOf(bits));
+        Acc >>= bits;
+        Bits -= bits;
+        return v;
+    }
+
+    // skips to the next byte
+    void align() {
+        Acc = 0;
+        Bits = 0;
+    }
+
+    size_t bytePosition() const { return Pos; }
+    bool overrun() const { return Overrun; }
+
+private:
+    const physx::PxU8* Data;
+    size_t Size;
+    size_t Pos;
+    physx::PxU64 Acc;
+    physx::PxU32 Bits;
+    bool Overrun;
+};
+
+inline physx::PxU32 zigZag(physx::PxI32 v) { return ((physx::PxU32)v << 1) ^ (physx::PxU32)(v >> 31); }
+inline physx::PxI32 unZigZag(physx::PxU32 v) { return (physx::PxI32)(v >> 1) ^ -(physx::PxI32)(v & 1); }
+
+// number of bits needed to store v
+inline physx::PxU32 bitWidth(physx::PxU32 v) {
+    physx::PxU32 n = 0;
+    while(v) { n++; v >>= 1; }
+    return n;
+}
+
+// Positions quantized to bits per axis inside a box.
+struct PositionQuantizer {
+    physx::PxVec3 Min;
+    physx::PxVec3 Scale;      // steps per unit
+    physx::PxVec3 InvScale;
+    physx::PxU32 Bits;
+
+    PositionQuantizer() : Min(0.0f), Scale(0.0f), InvScale(0.0f), Bits(0) {}
+    PositionQuantizer(const physx::PxBounds3& bounds, physx::PxU32 bits);
+
+    void quantize(const physx::PxVec3& p, physx::PxU32* q) const;
+    physx::PxVec3 dequantize(const physx::PxU32* q) const;
+};
+
+// Smallest-three quaternion: index of the largest component in 2 bits, the
+// other three in bits each. The sign is chosen so the dropped one is positive.
+physx::PxU32 quantizeQuat(const physx::PxQuat& q, physx::PxU32 bits, physx::PxU32* components);
+physx::PxQuat dequantizeQuat(physx::PxU32 largest, const physx::PxU32* components, physx::PxU32 bits);
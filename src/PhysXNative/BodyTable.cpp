@@ -0,0 +1,227 @@
+#include "BodyTable.h"
+
+using namespace physx;
+
+PxBodyHandle BodyTable::add(PxRigidActor* actor, PxU64 userData) {
+    PxU32 slot;
+    if(FreeSlots.empty()) {
+        slot = (PxU32)Generations.size();
+        Generations.push_back(1);
+        SlotToDense.push_back(PxInvalidBodyIndex);
+    }
+    else {
+        slot = FreeSlots.back();
+        FreeSlots.pop_back();
+    }
+
+    auto dense = size();
+    SlotToDense[slot] = dense;
+    DenseToSlot.push_back(slot);
+    Actors.push_back(actor);
+    Poses.push_back(PxTransform(PxIdentity));
+    LinearVelocities.push_back(PxVec3(0.0f));
+    AngularVelocities.push_back(PxVec3(0.0f));
+    UserData.push_back(userData);
+
+    if(actor) {
+        ActorSlots[actor] = slot;
+        readBody(dense);
+    }
+    return { slot, Generations[slot] };
+}
+
+bool BodyTable::remove(PxBodyHandle handle, PxBodyRemap& remap) {
+    auto dense = denseIndex(handle);
+    if(dense == PxInvalidBodyIndex) return false;
+
+    auto last = size() - 1;
+    if(Actors[dense]) ActorSlots.erase(Actors[dense]);
+
+    if(dense != last) {
+        Actors[dense] = Actors[last];
+        Poses[dense] = Poses[last];
+        LinearVelocities[dense] = LinearVelocities[last];
+        AngularVelocities[dense] = AngularVelocities[last];
+        UserData[dense] = UserData[last];
+        DenseToSlot[dense] = DenseToSlot[last];
+        SlotToDense[DenseToSlot[dense]] = dense;
+    }
+
+    Actors.pop_back();
+    Poses.pop_back();
+    LinearVelocities.pop_back();
+    AngularVelocities.pop_back();
+    UserData.pop_back();
+    DenseToSlot.pop_back();
+
+    // generation 0 is reserved so that a zeroed handle is never valid
+    auto gen = Generations[handle.Index] + 1;
+    Generations[handle.Index] = gen == 0 ? 1 : gen;
+    SlotToDense[handle.Index] = PxInvalidBodyIndex;
+    FreeSlots.push_back(handle.Index);
+
+    remap.From = last;
+    remap.To = dense;
+    return true;
+}
+
+PxU32 BodyTable::denseIndexOf(const PxActor* actor) const {
+    auto it = ActorSlots.find(actor);
+    if(it == ActorSlots.end()) return PxInvalidBodyIndex;
+    return SlotToDense[it->second];
+}
+
+void BodyTable::readBody(PxU32 dense) {
+    auto actor = Actors[dense];
+    if(!actor) return;
+    Poses[dense] = actor->getGlobalPose();
+    if(auto body = actor->is<PxRigidBody>()) {
+        LinearVelocities[dense] = body->getLinearVelocity();
+        AngularVelocities[dense] = body->getAngularVelocity();
+    }
+}
+
+void BodyTable::sync(PxScene* scene) {
+    if(scene && (scene->getFlags() & PxSceneFlag::eENABLE_ACTIVE_ACTORS)) {
+        // only bodies that moved during the last step need a refresh
+        PxU32 count = 0;
+        auto active = scene->getActiveActors(count);
+        for(PxU32 i = 0; i < count; i++) {
+            auto dense = denseIndexOf(active[i]);
+            if(dense != PxInvalidBodyIndex) readBody(dense);
+        }
+    }
+    else {
+        for(PxU32 i = 0; i < size(); i++) readBody(i);
+    }
+}
+
+
+DllExport(BodyTable*) pxCreateBodyTable(PxU32 capacity) {
+    auto table = new BodyTable();
+    table->Actors.reserve(capacity);
+    table->Poses.reserve(capacity);
+    table->LinearVelocities.reserve(capacity);
+    table->AngularVelocities.reserve(capacity);
+    table->UserData.reserve(capacity);
+    table->DenseToSlot.reserve(capacity);
+    table->SlotToDense.reserve(capacity);
+    table->Generations.reserve(capacity);
+    table->ActorSlots.reserve(capacity);
+    return table;
+}
+
+DllExport(void) pxDestroyBodyTable(BodyTable* table) {
+    delete table;
+}
+
+DllExport(PxBodyHandle) pxBodyTableAdd(BodyTable* table, PxRigidActor* actor, PxU64 userData) {
+    return table->add(actor, userData);
+}
+
+DllExport(int) pxBodyTableRemove(BodyTable* table, PxBodyHandle handle, PxBodyRemap* remap) {
+    PxBodyRemap r;
+    if(!table->remove(handle, r)) return 0;
+    if(remap) *remap = r;
+    return 1;
+}
+
+DllExport(PxU32) pxBodyTableRemoveMany(BodyTable* table, PxU32 count, const PxBodyHandle* handles, PxBodyRemap* remaps) {
+    // remaps are reported in removal order, replaying them in order on a
+    // caller-side array keeps it in sync with the dense storage
+    PxU32 removed = 0;
+    for(PxU32 i = 0; i < count; i++) {
+        PxBodyRemap r;
+        if(table->remove(handles[i], r)) {
+            if(remaps) remaps[removed] = r;
+            removed++;
+        }
+    }
+    return removed;
+}
+
+DllExport(PxU32) pxBodyTableCount(BodyTable* table) {
+    return table->size();
+}
+
+DllExport(int) pxBodyTableIsValid(BodyTable* table, PxBodyHandle handle) {
+    return table->denseIndex(handle) != PxInvalidBodyIndex ? 1 : 0;
+}
+
+DllExport(PxU32) pxBodyTableGetDenseIndex(BodyTable* table, PxBodyHandle handle) {
+    return table->denseIndex(handle);
+}
+
+DllExport(PxBodyHandle) pxBodyTableGetHandle(BodyTable* table, PxU32 dense) {
+    if(dense >= table->size()) return { PxInvalidBodyIndex, 0 };
+    return table->handleOf(dense);
+}
+
+DllExport(PxRigidActor*) pxBodyTableGetActor(BodyTable* table, PxBodyHandle handle) {
+    auto dense = table->denseIndex(handle);
+    if(dense == PxInvalidBodyIndex) return nullptr;
+    return table->Actors[dense];
+}
+
+DllExport(void) pxBodyTableSync(BodyTable* table, PxSceneHandle* scene) {
+    table->sync(scene ? scene->Scene : nullptr);
+}
+
+DllExport(void) pxBodyTableGetPoses(BodyTable* table, PxU32 start, PxU32 count, Euclidean3d* poses) {
+    auto end = PxMin(start + count, table->size());
+    for(PxU32 i = start; i < end; i++) {
+        poses[i - start] = toEuclidean3d(table->Poses[i]);
+    }
+}
+
+DllExport(void) pxBodyTableGetVelocities(BodyTable* table, PxU32 start, PxU32 count, V3d* linear, V3d* angular) {
+    auto end = PxMin(start + count, table->size());
+    for(PxU32 i = start; i < end; i++) {
+        if(linear) linear[i - start] = toV3d(table->LinearVelocities[i]);
+        if(angular) angular[i - start] = toV3d(table->AngularVelocities[i]);
+    }
+}
+
+DllExport(void) pxBodyTableGetUserData(BodyTable* table, PxU32 start, PxU32 count, PxU64* userData) {
+    auto end = PxMin(start + count, table->size());
+    for(PxU32 i = start; i < end; i++) {
+        userData[i - start] = table->UserData[i];
+    }
+}
+
+DllExport(void) pxBodyTableSetUserData(BodyTable* table, PxU32 count, const PxU32* dense, const PxU64* userData) {
+    for(PxU32 i = 0; i < count; i++) {
+        if(dense[i] >= table->size()) continue;
+        table->UserData[dense[i]] = userData[i];
+    }
+}
+
+DllExport(void) pxBodyTableSetLinearVelocities(BodyTable* table, PxU32 count, const PxU32* dense, const V3d* velocities) {
+    for(PxU32 i = 0; i < count; i++) {
+        auto d = dense[i];
+        if(d >= table->size()) continue;
+        auto v = toPxVec3(velocities[i]);
+        table->LinearVelocities[d] = v;
+        if(auto body = table->Actors[d] ? table->Actors[d]->is<PxRigidDynamic>() : nullptr) body->setLinearVelocity(v);
+    }
+}
+
+DllExport(void) pxBodyTableSetAngularVelocities(BodyTable* table, PxU32 count, const PxU32* dense, const V3d* velocities) {
+    for(PxU32 i = 0; i < count; i++) {
+        auto d = dense[i];
+        if(d >= table->size()) continue;
+        auto v = toPxVec3(velocities[i]);
+        table->AngularVelocities[d] = v;
+        if(auto body = table->Actors[d] ? table->Actors[d]->is<PxRigidDynamic>() : nullptr) body->setAngularVelocity(v);
+    }
+}
+
+DllExport(void) pxBodyTableSetPoses(BodyTable* table, PxU32 count, const PxU32* dense, const Euclidean3d* poses) {
+    for(PxU32 i = 0; i < count; i++) {
+        auto d = dense[i];
+        if(d >= table->size()) continue;
+        auto pose = toPxTransform(poses[i]);
+        table->Poses[d] = pose;
+        if(table->Actors[d]) table->Actors[d]->setGlobalPose(pose);
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include <vector>
+#include <unordered_map>
+
+// A body handle is a slot index plus the generation of that slot at the time the
+// handle was issued. Removing a body bumps the generation, so stale handles are
+// rejected by a single compare instead of dereferencing a released actor.
+typedef struct {
+    physx::PxU32 Index;
+    physx::PxU32 Generation;
+} PxBodyHandle;
+
+// Reported whenever a removal moves the last dense entry into the freed place.
+// From == To means the removed body was the last one and nothing moved.
+typedef struct {
+    physx::PxU32 From;
+    physx::PxU32 To;
+} PxBodyRemap;
+
+static const physx::PxU32 PxInvalidBodyIndex = 0xFFFFFFFF;
+
+class BodyTable {
+public:
+    // dense storage, indexed by dense index and kept compact on removal
+    std::vector<physx::PxRigidActor*> Actors;
+    std::vector<physx::PxTransform> Poses;
+    std::vector<physx::PxVec3> LinearVelocities;
+    std::vector<physx::PxVec3> AngularVelocities;
+    std::vector<physx::PxU64> UserData;
+    std::vector<physx::PxU32> DenseToSlot;
+
+    // sparse slots, indexed by PxBodyHandle::Index
+    std::vector<physx::PxU32> SlotToDense;
+    std::vector<physx::PxU32> Generations;
+    std::vector<physx::PxU32> FreeSlots;
+
+    // actor -> slot, kept beside the actors so that their userData stays with the caller
+    std::unordered_map<const physx::PxActor*, physx::PxU32> ActorSlots;
+
+    physx::PxU32 size() const { return (physx::PxU32)Actors.size(); }
+
+    PxBodyHandle add(physx::PxRigidActor* actor, physx::PxU64 userData);
+    bool remove(PxBodyHandle handle, PxBodyRemap& remap);
+
+    physx::PxU32 denseIndex(PxBodyHandle handle) const {
+        if(handle.Index >= Generations.size() || Generations[handle.Index] != handle.Generation) return PxInvalidBodyIndex;
+        return SlotToDense[handle.Index];
+    }
+
+    PxBodyHandle handleOf(physx::PxU32 dense) const {
+        auto slot = DenseToSlot[dense];
+        return { slot, Generations[slot] };
+    }
+
+    // resolves an actor back to its dense index through ActorSlots and returns
+    // PxInvalidBodyIndex for actors not owned by this table
+    physx::PxU32 denseIndexOf(const physx::PxActor* actor) const;
+
+    void readBody(physx::PxU32 dense);
+    void sync(physx::PxScene* scene);
+};
+
+DllExport(BodyTable*) pxCreateBodyTable(physx::PxU32 capacity);
+DllExport(void) pxDestroyBodyTable(BodyTable* table);
+
+DllExport(PxBodyHandle) pxBodyTableAdd(BodyTable* table, physx::PxRigidActor* actor, physx::PxU64 userData);
+DllExport(int) pxBodyTableRemove(BodyTable* table, PxBodyHandle handle, PxBodyRemap* remap);
+DllExport(physx::PxU32) pxBodyTableRemoveMany(BodyTable* table, physx::PxU32 count, const PxBodyHandle* handles, PxBodyRemap* remaps);
+
+DllExport(physx::PxU32) pxBodyTableCount(BodyTable* table);
+DllExport(int) pxBodyTableIsValid(BodyTable* table, PxBodyHandle handle);
+DllExport(physx::PxU32) pxBodyTableGetDenseIndex(BodyTable* table, PxBodyHandle handle);
+DllExport(PxBodyHandle) pxBodyTableGetHandle(BodyTable* table, physx::PxU32 dense);
+DllExport(physx::PxRigidActor*) pxBodyTableGetActor(BodyTable* table, PxBodyHandle handle);
+
+DllExport(void) pxBodyTableSync(BodyTable* table, PxSceneHandle* scene);
+DllExport(void) pxBodyTableGetPoses(BodyTable* table, physx::PxU32 start, physx::PxU32 count, Euclidean3d* poses);
+DllExport(void) pxBodyTableGetVelocities(BodyTable* table, physx::PxU32 start, physx::PxU32 count, V3d* linear, V3d* angular);
+DllExport(void) pxBodyTableGetUserData(BodyTable* table, physx::PxU32 start, physx::PxU32 count, physx::PxU64* userData);
+DllExport(void) pxBodyTableSetUserData(BodyTable* table, physx::PxU32 count, const physx::PxU32* dense, const physx::PxU64* userData);
+DllExport(void) pxBodyTableSetLinearVelocities(BodyTable* table, physx::PxU32 count, const physx::PxU32* dense, const V3d* velocities);
+DllExport(void) pxBodyTableSetAngularVelocities(BodyTable* table, physx::PxU32 count, const physx::PxU32* dense, const V3d* velocities);
+DllExport(void) pxBodyTableSetPoses(BodyTable* table, physx::PxU32 count, const physx::PxU32* dense, const Euclidean3d* poses);
@@ -0,0 +1,144 @@
+#include "CcdManager.h"
+#include "Parallel.h"
+
+using namespace physx;
+
+static const PxU32 CcdGrain = 1024;
+
+CcdManager::CcdManager(PxScene* scene) : Scene(scene), AutoFactor(0.5f), DynamicDynamic(false), Raycast(nullptr), RaycastCount(0) {
+    Scene->getPhysics().registerDeletionListener(*this, PxDeletionEventFlag::eUSER_RELEASE, true);
+}
+
+CcdManager::~CcdManager() {
+    Scene->getPhysics().unregisterDeletionListener(*this);
+    delete Raycast;
+}
+
+static PxShape* singleShape(PxRigidDynamic* actor) {
+    PxShape* shape = nullptr;
+    if(actor->getNbShapes() != 1) return nullptr;
+    actor->getShapes(&shape, 1);
+    return shape;
+}
+
+void CcdManager::enable(CcdBody& body, bool enabled) {
+    if(body.Enabled == enabled) return;
+    body.Enabled = enabled;
+    auto actor = body.Actor;
+
+    // swept CCD is not supported for kinematics, PhysX would reject the flag
+    auto kinematic = actor->getRigidBodyFlags().isSet(PxRigidBodyFlag::eKINEMATIC);
+    if(body.Mode & PxCcdSpeculative) actor->setRigidBodyFlag(PxRigidBodyFlag::eENABLE_SPECULATIVE_CCD, enabled);
+    if((body.Mode & PxCcdSwept) && !kinematic) actor->setRigidBodyFlag(PxRigidBodyFlag::eENABLE_CCD, enabled);
+
+    if(body.Mode & PxCcdRaycast) {
+        if(enabled) {
+            auto shape = singleShape(actor);
+            if(!shape) return;
+            if(!Raycast) Raycast = new RaycastCCDManager(Scene);
+            if(Raycast->registerRaycastCCDObject(actor, shape)) {
+                body.RaycastShape = shape;
+                RaycastCount++;
+            }
+        }
+        else if(body.RaycastShape) {
+            if(Raycast->unregisterRaycastCCDObject(actor, body.RaycastShape)) RaycastCount--;
+            body.RaycastShape = nullptr;
+        }
+    }
+}
+
+void CcdManager::remove(PxU32 i) {
+    Index.erase(Bodies[i].Actor);
+    if(i != Bodies.size() - 1) {
+        Bodies[i] = Bodies.back();
+        Index[Bodies[i].Actor] = i;
+    }
+    Bodies.pop_back();
+}
+
+void CcdManager::onRelease(const PxBase* observed, void*, PxDeletionEventFlag::Enum) {
+    auto it = Index.find((PxRigidDynamic*)observed->is<PxRigidDynamic>());
+    if(it == Index.end()) return;
+    // the actor goes away with its flags, only our own references are dropped
+    auto& body = Bodies[it->second];
+    if(body.RaycastShape && Raycast->unregisterRaycastCCDObject(body.Actor, body.RaycastShape)) RaycastCount--;
+    remove(it->second);
+}
+
+void CcdManager::set(PxRigidDynamic* actor, PxU32 mode) {
+    auto it = Index.find(actor);
+    if(it != Index.end()) {
+        // drop the old mode first, the new one starts from a clean state
+        auto i = it->second;
+        enable(Bodies[i], false);
+        if(mode == PxCcdNone) {
+            const PxBase* observed = actor;
+            Scene->getPhysics().unregisterDeletionListenerObjects(*this, &observed, 1);
+            remove(i);
+            return;
+        }
+        Bodies[i].Mode = mode;
+        enable(Bodies[i], !(mode & PxCcdAuto));
+        return;
+    }
+    if(mode == PxCcdNone) return;
+
+    auto extents = actor->getWorldBounds().getDimensions();
+    CcdBody body = { actor, mode, PxMin(extents.x, PxMin(extents.y, extents.z)), false, nullptr };
+    const PxBase* observed = actor;
+    Scene->getPhysics().registerDeletionListenerObjects(*this, &observed, 1);
+    Index[actor] = (PxU32)Bodies.size();
+    Bodies.push_back(body);
+    enable(Bodies.back(), !(mode & PxCcdAuto));
+}
+
+PxU32 CcdManager::enabledCount() const {
+    PxU32 count = 0;
+    for(auto& body : Bodies) if(body.Enabled) count++;
+    return count;
+}
+
+void CcdManager::beforeStep(float dt, PxCpuDispatcher* dispatcher) {
+    auto n = (PxU32)Bodies.size();
+    Wanted.resize(n);
+    // velocities are only read here, flags are written serially below
+    parallelFor(dispatcher, n, CcdGrain, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 i = begin; i < end; i++) {
+            auto& body = Bodies[i];
+            if(!(body.Mode & PxCcdAuto)) {
+                Wanted[i] = 1;
+                continue;
+            }
+            auto travel = body.Actor->getLinearVelocity().magnitude() * dt;
+            Wanted[i] = travel > AutoFactor * body.Size ? 1 : 0;
+        }
+    });
+
+    for(PxU32 i = 0; i < n; i++) enable(Bodies[i], Wanted[i] != 0);
+}
+
+void CcdManager::afterStep() {
+    if(Raycast && RaycastCount > 0) Raycast->doRaycastCCD(DynamicDynamic);
+}
+
+static CcdManager* ccdOf(PxSceneHandle* scene) {
+    if(!scene->Ccd) scene->Ccd = new CcdManager(scene->Scene);
+    return scene->Ccd;
+}
+
+
+DllExport(void) pxSetCcdModes(PxSceneHandle* scene, PxU32 count, PxRigidDynamic** actors, const PxU32* modes) {
+    auto ccd = ccdOf(scene);
+    for(PxU32 i = 0; i < count; i++) ccd->set(actors[i], modes[i]);
+}
+
+DllExport(void) pxSetCcdAuto(PxSceneHandle* scene, float factor, int dynamicDynamic) {
+    auto ccd = ccdOf(scene);
+    ccd->AutoFactor = factor;
+    ccd->DynamicDynamic = dynamicDynamic != 0;
+}
+
+DllExport(PxU32) pxGetCcdEnabledCount(PxSceneHandle* scene) {
+    return scene->Ccd ? scene->Ccd->enabledCount() : 0;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include <extensions/PxRaycastCCD.h>
+#include <unordered_map>
+#include <vector>
+
+// per body CCD modes, may be combined
+enum PxCcdMode {
+    PxCcdNone = 0,
+    PxCcdSpeculative = 1,   // PxRigidBodyFlag::eENABLE_SPECULATIVE_CCD, cheap, handles rotation
+    PxCcdSwept = 2,         // PxRigidBodyFlag::eENABLE_CCD, extra sweep pass after the solver
+    PxCcdRaycast = 4,       // RaycastCCDManager after each step, single shape bodies only
+    PxCcdAuto = 8           // the other modes only apply while the body is fast for its size
+};
+
+struct CcdBody {
+    physx::PxRigidDynamic* Actor;
+    physx::PxU32 Mode;
+    float Size;         // smallest extent of the body bounds when the mode was set
+    bool Enabled;
+    physx::PxShape* RaycastShape;   // registered with the RaycastCCDManager while enabled
+};
+
+// Keeps the CCD flags of registered bodies in one scene. Bodies with PxCcdAuto
+// only pay for CCD while they move farther than AutoFactor times their size in
+// one step. Registered actors are watched through a deletion listener, so a
+// body released by any path (pxDestroyActor, destructibles, fracture) drops
+// out of the manager.
+class CcdManager : public physx::PxDeletionListener {
+public:
+    explicit CcdManager(physx::PxScene* scene);
+    ~CcdManager();
+
+    physx::PxScene* Scene;
+    float AutoFactor;
+    bool DynamicDynamic;    // raycast CCD against other dynamics as well
+    std::vector<CcdBody> Bodies;
+
+    void set(physx::PxRigidDynamic* actor, physx::PxU32 mode);
+    physx::PxU32 enabledCount() const;
+
+    // around simulate and fetchResults
+    void beforeStep(float dt, physx::PxCpuDispatcher* dispatcher);
+    void afterStep();
+
+    void onRelease(const physx::PxBase* observed, void* userData, physx::PxDeletionEventFlag::Enum deletionEvent) override;
+
+private:
+    void enable(CcdBody& body, bool enabled);
+    void remove(physx::PxU32 i);
+
+    physx::RaycastCCDManager* Raycast;
+    physx::PxU32 RaycastCount;
+    std::unordered_map<physx::PxRigidDynamic*, physx::PxU32> Index;
+    std::vector<physx::PxU8> Wanted;
+};
+
+DllExport(void) pxSetCcdModes(PxSceneHandle* scene, physx::PxU32 count, physx::PxRigidDynamic** actors, const physx::PxU32* modes);
+DllExport(void) pxSetCcdAuto(PxSceneHandle* scene, float factor, int dynamicDynamic);
+DllExport(physx::PxU32) pxGetCcdEnabledCount(PxSceneHandle* scene);
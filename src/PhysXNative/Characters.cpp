@@ -0,0 +1,146 @@
+#include "Characters.h"
+
+using namespace physx;
+
+static PxExtendedVec3 toExtended(const V3d& v) {
+    return PxExtendedVec3(v.X, v.Y, v.Z);
+}
+
+CharacterManager::CharacterManager(PxScene* scene, bool overlapRecovery, bool interactions) : Interactions(interactions) {
+    Manager = PxCreateControllerManager(*scene);
+    Manager->setOverlapRecoveryModule(overlapRecovery);
+    Obstacles = Manager->createObstacleContext();
+}
+
+CharacterManager::~CharacterManager() {
+    // releases controllers and obstacle contexts as well
+    Manager->release();
+}
+
+PxU32 CharacterManager::create(const PxCharacterDesc& desc) {
+    PxCapsuleControllerDesc cct;
+    cct.position = toExtended(desc.Position);
+    cct.radius = desc.Radius;
+    cct.height = desc.Height;
+    cct.stepOffset = desc.StepOffset;
+    cct.slopeLimit = desc.SlopeLimit;
+    if(desc.ContactOffset > 0.0f) cct.contactOffset = desc.ContactOffset;
+    if(desc.Density > 0.0f) cct.density = desc.Density;
+    cct.material = desc.Material;
+    cct.userData = (void*)(size_t)desc.UserData;
+
+    auto controller = cct.isValid() ? Manager->createController(cct) : nullptr;
+    if(!controller) return 0xFFFFFFFF;
+
+    PxU32 id;
+    if(FreeIds.empty()) {
+        id = (PxU32)Controllers.size();
+        Controllers.push_back(controller);
+    }
+    else {
+        id = FreeIds.back();
+        FreeIds.pop_back();
+        Controllers[id] = controller;
+    }
+    return id;
+}
+
+void CharacterManager::release(PxU32 id) {
+    auto controller = get(id);
+    if(!controller) return;
+    controller->release();
+    Controllers[id] = nullptr;
+    FreeIds.push_back(id);
+}
+
+void CharacterManager::move(PxU32 count, const PxU32* ids, const V3d* displacements, float minDistance, float dt,
+        PxU32* collisionFlags, V3d* positions) {
+    if(Interactions) Manager->computeInteractions(dt);
+
+    // a move updates the kinematic proxy actor in the scene and reads the other
+    // characters of the manager, so moves cannot overlap; the batch only saves
+    // the per character transitions into native code
+    PxControllerFilters filters;
+    for(PxU32 i = 0; i < count; i++) {
+        auto controller = get(ids[i]);
+        if(!controller) {
+            if(collisionFlags) collisionFlags[i] = 0;
+            continue;
+        }
+        auto flags = controller->move(toPxVec3(displacements[i]), minDistance, dt, filters, Obstacles);
+        if(collisionFlags) collisionFlags[i] = (PxU32)flags;
+        if(positions) {
+            auto p = controller->getPosition();
+            positions[i] = { p.x, p.y, p.z };
+        }
+    }
+}
+
+static PxObstacleHandle storeObstacle(PxObstacleContext* context, const PxCharacterObstacle& desc, PxObstacleHandle handle) {
+    // a handle other than PX_INVALID_OBSTACLE_HANDLE updates that obstacle
+    if(desc.Type == PxCharacterObstacleCapsule) {
+        PxCapsuleObstacle obstacle;
+        obstacle.mPos = toExtended(desc.Pose.Trans);
+        obstacle.mRot = toPxTransform(desc.Pose).q;
+        obstacle.mRadius = (float)desc.HalfExtents.X;
+        obstacle.mHalfHeight = (float)desc.HalfExtents.Y;
+        if(handle == PX_INVALID_OBSTACLE_HANDLE) return context->addObstacle(obstacle);
+        context->updateObstacle(handle, obstacle);
+        return handle;
+    }
+
+    PxBoxObstacle obstacle;
+    obstacle.mPos = toExtended(desc.Pose.Trans);
+    obstacle.mRot = toPxTransform(desc.Pose).q;
+    obstacle.mHalfExtents = toPxVec3(desc.HalfExtents);
+    if(handle == PX_INVALID_OBSTACLE_HANDLE) return context->addObstacle(obstacle);
+    context->updateObstacle(handle, obstacle);
+    return handle;
+}
+
+
+DllExport(CharacterManager*) pxCreateCharacterManager(PxSceneHandle* scene, int overlapRecovery, int interactions) {
+    return new CharacterManager(scene->Scene, overlapRecovery != 0, interactions != 0);
+}
+
+DllExport(void) pxDestroyCharacterManager(CharacterManager* manager) {
+    delete manager;
+}
+
+DllExport(void) pxCreateCapsuleControllers(CharacterManager* manager, PxU32 count, const PxCharacterDesc* descs, PxU32* ids) {
+    for(PxU32 i = 0; i < count; i++) {
+        auto id = manager->create(descs[i]);
+        if(ids) ids[i] = id;
+    }
+}
+
+DllExport(void) pxReleaseControllers(CharacterManager* manager, PxU32 count, const PxU32* ids) {
+    for(PxU32 i = 0; i < count; i++) manager->release(ids[i]);
+}
+
+DllExport(void) pxMoveControllers(CharacterManager* manager, PxU32 count, const PxU32* ids, const V3d* displacements,
+        float minDistance, float dt, PxU32* flags, V3d* positions) {
+    manager->move(count, ids, displacements, minDistance, dt, flags, positions);
+}
+
+DllExport(void) pxSetControllerPositions(CharacterManager* manager, PxU32 count, const PxU32* ids, const V3d* positions) {
+    for(PxU32 i = 0; i < count; i++) {
+        auto controller = manager->get(ids[i]);
+        if(controller) controller->setPosition(toExtended(positions[i]));
+    }
+}
+
+DllExport(void) pxAddCharacterObstacles(CharacterManager* manager, PxU32 count, const PxCharacterObstacle* obstacles, PxU32* handles) {
+    for(PxU32 i = 0; i < count; i++) {
+        auto handle = storeObstacle(manager->Obstacles, obstacles[i], PX_INVALID_OBSTACLE_HANDLE);
+        if(handles) handles[i] = handle;
+    }
+}
+
+DllExport(void) pxUpdateCharacterObstacles(CharacterManager* manager, PxU32 count, const PxU32* handles, const PxCharacterObstacle* obstacles) {
+    for(PxU32 i = 0; i < count; i++) storeObstacle(manager->Obstacles, obstacles[i], handles[i]);
+}
+
+DllExport(void) pxRemoveCharacterObstacles(CharacterManager* manager, PxU32 count, const PxU32* handles) {
+    for(PxU32 i = 0; i < count; i++) manager->Obstacles->removeObstacle(handles[i]);
+}
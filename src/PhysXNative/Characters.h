@@ -0,0 +1,70 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include <characterkinematic/PxControllerManager.h>
+#include <characterkinematic/PxCapsuleController.h>
+#include <characterkinematic/PxControllerObstacles.h>
+#include <vector>
+
+typedef struct {
+    V3d Position;           // capsule center
+    float Radius;
+    float Height;           // distance between the sphere centers
+    float StepOffset;
+    float SlopeLimit;       // cosine of the steepest walkable slope, 0 disables the limit
+    float ContactOffset;
+    float Density;          // of the kinematic proxy actor, used when it pushes dynamics
+    physx::PxMaterial* Material;
+    physx::PxU64 UserData;
+} PxCharacterDesc;
+
+enum PxCharacterObstacleType {
+    PxCharacterObstacleBox = 0,         // HalfExtents
+    PxCharacterObstacleCapsule = 1      // radius in HalfExtents.X, half height in HalfExtents.Y
+};
+
+typedef struct {
+    physx::PxU32 Type;
+    physx::PxU32 Reserved;
+    Euclidean3d Pose;
+    V3d HalfExtents;
+} PxCharacterObstacle;
+
+// Capsule character controllers of one scene behind a batched API. Moves go
+// through one PxObstacleContext, so moving platforms or doors that are not
+// scene actors can be updated in bulk and still block characters. With
+// Interactions set, overlapping characters are pushed apart by the manager's
+// character-character pass before the moves. All moves of a batch run in one
+// native call but one after another, see CharacterManager::move.
+class CharacterManager {
+public:
+    CharacterManager(physx::PxScene* scene, bool overlapRecovery, bool interactions);
+    ~CharacterManager();
+
+    physx::PxControllerManager* Manager;
+    physx::PxObstacleContext* Obstacles;
+    bool Interactions;
+
+    // indexed by character id, NULL for released ones
+    std::vector<physx::PxController*> Controllers;
+    std::vector<physx::PxU32> FreeIds;
+
+    physx::PxU32 create(const PxCharacterDesc& desc);
+    void release(physx::PxU32 id);
+    physx::PxController* get(physx::PxU32 id) const { return id < Controllers.size() ? Controllers[id] : nullptr; }
+
+    void move(physx::PxU32 count, const physx::PxU32* ids, const V3d* displacements, float minDistance, float dt,
+        physx::PxU32* collisionFlags, V3d* positions);
+};
+
+DllExport(CharacterManager*) pxCreateCharacterManager(PxSceneHandle* scene, int overlapRecovery, int interactions);
+DllExport(void) pxDestroyCharacterManager(CharacterManager* manager);
+DllExport(void) pxCreateCapsuleControllers(CharacterManager* manager, physx::PxU32 count, const PxCharacterDesc* descs, physx::PxU32* ids);
+DllExport(void) pxReleaseControllers(CharacterManager* manager, physx::PxU32 count, const physx::PxU32* ids);
+// flags receive PxControllerCollisionFlag bits, flags and positions may be NULL
+DllExport(void) pxMoveControllers(CharacterManager* manager, physx::PxU32 count, const physx::PxU32* ids, const V3d* displacements,
+    float minDistance, float dt, physx::PxU32* flags, V3d* positions);
+DllExport(void) pxSetControllerPositions(CharacterManager* manager, physx::PxU32 count, const physx::PxU32* ids, const V3d* positions);
+DllExport(void) pxAddCharacterObstacles(CharacterManager* manager, physx::PxU32 count, const PxCharacterObstacle* obstacles, physx::PxU32* handles);
+DllExport(void) pxUpdateCharacterObstacles(CharacterManager* manager, physx::PxU32 count, const physx::PxU32* handles, const PxCharacterObstacle* obstacles);
+DllExport(void) pxRemoveCharacterObstacles(CharacterManager* manager, physx::PxU32 count, const physx::PxU32* handles);
@@ -0,0 +1,138 @@
+#include "CollisionLayers.h"
+#include <vector>
+
+using namespace physx;
+
+static const PxU32 HeaderWords = sizeof(PxLayerTable) / sizeof(PxU64);
+
+CollisionLayers::CollisionLayers(PxU32 groupCount) {
+    auto words = (groupCount + 63) / 64;
+    Data.assign(HeaderWords + (size_t)groupCount * words, 0);
+    auto t = table();
+    for(PxU32 i = 0; i < PxLayerCount; i++) t->Collide[i] = ~(PxU64)0;
+    t->GroupCount = groupCount;
+    t->GroupWords = words;
+}
+
+static PX_FORCE_INLINE void setBit(PxU64* rows, PxU32 a, PxU32 b, bool value) {
+    if(value) rows[a] |= (PxU64)1 << b;
+    else rows[a] &= ~((PxU64)1 << b);
+}
+
+void CollisionLayers::setCollide(PxU32 a, PxU32 b, bool collide) {
+    if(a >= PxLayerCount || b >= PxLayerCount) return;
+    setBit(table()->Collide, a, b, collide);
+    setBit(table()->Collide, b, a, collide);
+}
+
+void CollisionLayers::setNotify(PxU32 a, PxU32 b, bool notify) {
+    if(a >= PxLayerCount || b >= PxLayerCount) return;
+    setBit(table()->Notify, a, b, notify);
+    setBit(table()->Notify, b, a, notify);
+}
+
+void CollisionLayers::setIgnore(PxU32 g0, PxU32 g1, bool ignore) {
+    auto t = table();
+    if(g0 >= t->GroupCount || g1 >= t->GroupCount) return;
+    auto bits = Data.data() + HeaderWords;
+    setBit(bits + (size_t)g0 * t->GroupWords, g1 / 64, g1 % 64, ignore);
+    setBit(bits + (size_t)g1 * t->GroupWords, g0 / 64, g0 % 64, ignore);
+}
+
+void CollisionLayers::apply(PxScene* scene, bool refilter) const {
+    scene->setFilterShaderData(data(), size());
+    if(!refilter) return;
+
+    auto types = PxActorTypeFlag::eRIGID_STATIC | PxActorTypeFlag::eRIGID_DYNAMIC;
+    std::vector<PxActor*> actors(scene->getNbActors(types));
+    scene->getActors(types, actors.data(), (PxU32)actors.size());
+    for(auto actor : actors) scene->resetFiltering(*actor);
+}
+
+PxFilterFlags layerFilterShader(PxFilterObjectAttributes attributes0, PxFilterData filterData0,
+    PxFilterObjectAttributes attributes1, PxFilterData filterData1,
+    PxPairFlags& pairFlags, const void* constantBlock, PxU32 constantBlockSize) {
+    auto l0 = filterData0.word0 % PxLayerCount;
+    auto l1 = filterData1.word0 % PxLayerCount;
+
+    bool notify = false;
+    if(constantBlock && constantBlockSize >= sizeof(PxLayerTable)) {
+        auto t = (const PxLayerTable*)constantBlock;
+        if(!((t->Collide[l0] >> l1) & 1)) return PxFilterFlag::eKILL;
+
+        auto g0 = filterData0.word1;
+        auto g1 = filterData1.word1;
+        if(g0 && g1 && g0 < t->GroupCount && g1 < t->GroupCount) {
+            auto row = (const PxU64*)(t + 1) + (size_t)g0 * t->GroupWords;
+            if((row[g1 / 64] >> (g1 % 64)) & 1) return PxFilterFlag::eKILL;
+        }
+        notify = ((t->Notify[l0] >> l1) & 1) != 0;
+    }
+
+    if(PxFilterObjectIsTrigger(attributes0) || PxFilterObjectIsTrigger(attributes1)) {
+        pairFlags = PxPairFlag::eTRIGGER_DEFAULT;
+        return PxFilterFlag::eDEFAULT;
+    }
+
+    // swept CCD only runs for pairs with a CCD body, the flag costs nothing otherwise
+    pairFlags = PxPairFlag::eCONTACT_DEFAULT | PxPairFlag::eDETECT_CCD_CONTACT;
+    if(notify) pairFlags |= PxPairFlag::eNOTIFY_TOUCH_FOUND | PxPairFlag::eNOTIFY_TOUCH_LOST | PxPairFlag::eNOTIFY_CONTACT_POINTS;
+    return PxFilterFlag::eDEFAULT;
+}
+
+const CollisionLayers& defaultCollisionLayers() {
+    static const CollisionLayers layers(0);
+    return layers;
+}
+
+
+DllExport(CollisionLayers*) pxCreateCollisionLayers(PxU32 groupCount) {
+    return new CollisionLayers(groupCount);
+}
+
+DllExport(void) pxDestroyCollisionLayers(CollisionLayers* layers) {
+    delete layers;
+}
+
+DllExport(void) pxSetLayerCollision(CollisionLayers* layers, PxU32 a, PxU32 b, int collide) {
+    layers->setCollide(a, b, collide != 0);
+}
+
+DllExport(void) pxSetLayerNotify(CollisionLayers* layers, PxU32 a, PxU32 b, int notify) {
+    layers->setNotify(a, b, notify != 0);
+}
+
+DllExport(void) pxSetGroupIgnore(CollisionLayers* layers, PxU32 g0, PxU32 g1, int ignore) {
+    layers->setIgnore(g0, g1, ignore != 0);
+}
+
+DllExport(void) pxApplyCollisionLayers(CollisionLayers* layers, PxSceneHandle* scene, int refilter) {
+    layers->apply(scene->Scene, refilter != 0);
+}
+
+DllExport(PxU32) pxSetActorLayers(PxU32 count, PxRigidActor** actors, const PxU32* layers, const PxU32* groups) {
+    // shape writes are not thread safe within a scene, so this runs serially but in one call
+    PxShape* shapes[16];
+    PxU32 skipped = 0;
+    for(PxU32 i = 0; i < count; i++) {
+        auto actor = actors[i];
+        auto n = actor->getNbShapes();
+        for(PxU32 start = 0; start < n; start += 16) {
+            auto got = actor->getShapes(shapes, 16, start);
+            for(PxU32 s = 0; s < got; s++) {
+                // a shared shape cannot be written while attached, and swapping it for
+                // an exclusive copy would break owners that track it by pointer
+                if(!shapes[s]->isExclusive()) {
+                    skipped++;
+                    continue;
+                }
+                auto data = shapes[s]->getSimulationFilterData();
+                data.word0 = layers[i];
+                if(groups) data.word1 = groups[i];
+                // also refilters existing pairs of the shape
+                shapes[s]->setSimulationFilterData(data);
+            }
+        }
+    }
+    return skipped;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include <vector>
+
+static const physx::PxU32 PxLayerCount = 64;
+
+// Constant table handed to the filter shader through PxSceneDesc::filterShaderData.
+// Shapes carry their layer in PxFilterData::word0 and their group in word1, group
+// 0 means none. Ignored group pairs follow the header as a GroupCount x GroupCount
+// bit matrix with rows padded to 64 bit words.
+typedef struct {
+    physx::PxU64 Collide[PxLayerCount];     // bit b of row a is set if layer a collides with layer b
+    physx::PxU64 Notify[PxLayerCount];      // colliding layer pairs that report touches and contact points
+    physx::PxU32 GroupCount;
+    physx::PxU32 GroupWords;                // words per row of the ignore matrix
+} PxLayerTable;
+
+// Builds the table for layerFilterShader. Both matrices are kept symmetric,
+// a new table lets every layer collide with every other and ignores nothing.
+class CollisionLayers {
+public:
+    explicit CollisionLayers(physx::PxU32 groupCount);
+
+    void setCollide(physx::PxU32 a, physx::PxU32 b, bool collide);
+    void setNotify(physx::PxU32 a, physx::PxU32 b, bool notify);
+    void setIgnore(physx::PxU32 g0, physx::PxU32 g1, bool ignore);
+
+    const void* data() const { return Data.data(); }
+    physx::PxU32 size() const { return (physx::PxU32)(Data.size() * sizeof(physx::PxU64)); }
+
+    // existing pairs keep their old filter result unless refilter is set
+    void apply(physx::PxScene* scene, bool refilter) const;
+
+private:
+    PxLayerTable* table() { return (PxLayerTable*)Data.data(); }
+    std::vector<physx::PxU64> Data;
+};
+
+// Pairs excluded by the layer matrix or by an ignored group pair are killed
+// when the broadphase reports them, before any narrowphase work. Triggers get
+// trigger flags, everything else contact flags plus notifications if the layer
+// pair asks for them.
+physx::PxFilterFlags layerFilterShader(physx::PxFilterObjectAttributes attributes0, physx::PxFilterData filterData0,
+    physx::PxFilterObjectAttributes attributes1, physx::PxFilterData filterData1,
+    physx::PxPairFlags& pairFlags, const void* constantBlock, physx::PxU32 constantBlockSize);
+
+// all layers collide, no groups, used for scenes created without a table
+const CollisionLayers& defaultCollisionLayers();
+
+DllExport(CollisionLayers*) pxCreateCollisionLayers(physx::PxU32 groupCount);
+DllExport(void) pxDestroyCollisionLayers(CollisionLayers* layers);
+DllExport(void) pxSetLayerCollision(CollisionLayers* layers, physx::PxU32 a, physx::PxU32 b, int collide);
+DllExport(void) pxSetLayerNotify(CollisionLayers* layers, physx::PxU32 a, physx::PxU32 b, int notify);
+DllExport(void) pxSetGroupIgnore(CollisionLayers* layers, physx::PxU32 g0, physx::PxU32 g1, int ignore);
+DllExport(void) pxApplyCollisionLayers(CollisionLayers* layers, PxSceneHandle* scene, int refilter);
+// assigns a layer and optionally a group (groups may be NULL) to all exclusive shapes of
+// each actor. Shared shapes (pxCreateDynamicCompositeBatch, destructible chunks) are left
+// alone and counted in the result, since writing one would change every actor using it.
+// Their filter data must be set before they are attached (PxDestructibleDesc.Layer).
+DllExport(physx::PxU32) pxSetActorLayers(physx::PxU32 count, physx::PxRigidActor** actors, const physx::PxU32* layers, const physx::PxU32* groups);
@@ -0,0 +1,421 @@
+#include "CpuParticleSystem.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <foundation/PxVecMath.h>
+#include <foundation/PxBitUtils.h>
+#include <extensions/PxShapeExt.h>
+
+using namespace physx;
+using namespace physx::aos;
+
+static const PxU32 ParticleGrain = 512;
+static const PxU32 MaxBinColliders = 256;
+static const PxU32 MaxBinsPerAxis = 16;
+
+static PX_FORCE_INLINE PxI32 cellCoord(float v, float invCellSize) {
+    return (PxI32)PxFloor(v * invCellSize);
+}
+
+static PX_FORCE_INLINE PxU32 cellHash(PxI32 x, PxI32 y, PxI32 z, PxU32 mask) {
+    return ((PxU32)x * 73856093u ^ (PxU32)y * 19349663u ^ (PxU32)z * 83492791u) & mask;
+}
+
+static PX_FORCE_INLINE PxU32 phaseGroup(PxU32 phase) {
+    return phase & PxParticlePhaseFlag::eParticlePhaseGroupMask;
+}
+
+static PX_FORCE_INLINE bool isFluid(PxU32 phase) {
+    return (phase & PxParticlePhaseFlag::eParticlePhaseFluid) != 0;
+}
+
+CpuParticleSystem::CpuParticleSystem(PxU32 maxParticles, float particleSpacing)
+    : RestOffset(0.5f * particleSpacing), ContactOffset(0.5f * particleSpacing), ParticleContactOffset(particleSpacing),
+      SolidRestOffset(0.5f * particleSpacing), FluidRestOffset(0.5f * particleSpacing), MaxVelocity(PX_MAX_F32),
+      SolverIterations(4), KernelRadius(2.0f * particleSpacing), RestDensity(1.0f), Relaxation(0.0f), ArtificialPressure(0.0f),
+      MaxParticles(maxParticles), NbActiveParticles(0), Next(nullptr), Count(0), CellMask(0), BinSize(1.0f) {
+
+    PositionInvMass.resize(maxParticles, PxVec4(0.0f));
+    Velocity.resize(maxParticles, PxVec4(0.0f));
+    Phase.resize(maxParticles, 0);
+    BinCount[0] = BinCount[1] = BinCount[2] = 0;
+
+    // rest density and constraint stiffness of a particle in the middle of a
+    // lattice with the creation spacing, particles have unit mass
+    auto n = (PxI32)PxCeil(KernelRadius / particleSpacing);
+    float rho = 0.0f;
+    for(PxI32 x = -n; x <= n; x++) {
+        for(PxI32 y = -n; y <= n; y++) {
+            for(PxI32 z = -n; z <= n; z++) {
+                rho += poly6(PxVec3((float)x, (float)y, (float)z).magnitudeSquared() * particleSpacing * particleSpacing);
+            }
+        }
+    }
+    RestDensity = rho;
+
+    float grad2 = 0.0f;
+    PxVec3 gradI(0.0f);
+    for(PxI32 x = -n; x <= n; x++) {
+        for(PxI32 y = -n; y <= n; y++) {
+            for(PxI32 z = -n; z <= n; z++) {
+                auto d = PxVec3((float)x, (float)y, (float)z) * particleSpacing;
+                auto r = d.magnitude();
+                if(r <= 0.0f || r >= KernelRadius) continue;
+                auto g = spikyGradient(d, r) / RestDensity;
+                gradI += g;
+                grad2 += g.magnitudeSquared();
+            }
+        }
+    }
+    // both are relative to the constraint gradient so they do not depend on the spacing
+    auto stiffness = grad2 + gradI.magnitudeSquared();
+    Relaxation = 0.01f * stiffness;
+    ArtificialPressure = 0.1f / stiffness;
+}
+
+float CpuParticleSystem::poly6(float r2) const {
+    auto h2 = KernelRadius * KernelRadius;
+    if(r2 >= h2) return 0.0f;
+    auto h9 = h2 * h2 * h2 * h2 * KernelRadius;
+    auto x = h2 - r2;
+    return 315.0f / (64.0f * PxPi * h9) * x * x * x;
+}
+
+PxVec3 CpuParticleSystem::spikyGradient(const PxVec3& d, float r) const {
+    if(r <= 0.0f || r >= KernelRadius) return PxVec3(0.0f);
+    auto h6 = KernelRadius * KernelRadius * KernelRadius;
+    h6 *= h6;
+    auto x = KernelRadius - r;
+    return d * (-45.0f / (PxPi * h6) * x * x / r);
+}
+
+PxU32 CpuParticleSystem::createPhase(const CpuPbdMaterial& material, PxParticlePhaseFlags flags) {
+    auto group = (PxU32)Materials.size();
+    Materials.push_back(material);
+    return group | (PxU32)flags;
+}
+
+void CpuParticleSystem::buildGrid(PxCpuDispatcher* dispatcher) {
+    // Delta holds the predicted positions in buffer order here
+    auto tableSize = PxNextPowerOfTwo(PxMax(Count * 2, 64u) - 1);
+    CellMask = tableSize - 1;
+    CellKeys.resize(Count);
+    CellStart.assign(tableSize + 1, 0);
+
+    auto inv = 1.0f / KernelRadius;
+    auto mask = CellMask;
+    parallelFor(dispatcher, Count, ParticleGrain * 4, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 i = begin; i < end; i++) {
+            auto& p = Delta[i];
+            CellKeys[i] = cellHash(cellCoord(p.x, inv), cellCoord(p.y, inv), cellCoord(p.z, inv), mask);
+        }
+    });
+
+    // counting sort by cell
+    for(PxU32 i = 0; i < Count; i++) CellStart[CellKeys[i] + 1]++;
+    for(PxU32 c = 0; c < tableSize; c++) CellStart[c + 1] += CellStart[c];
+    std::vector<PxU32> fill(CellStart.begin(), CellStart.end() - 1);
+    for(PxU32 i = 0; i < Count; i++) Sorted[fill[CellKeys[i]]++] = i;
+
+    parallelFor(dispatcher, Count, ParticleGrain, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 k = begin; k < end; k++) {
+            auto o = Sorted[k];
+            auto& p = Delta[o];
+            SX[k] = p.x; SY[k] = p.y; SZ[k] = p.z;
+            Old[k] = PositionInvMass[o].getXYZ();
+            InvMass[k] = PositionInvMass[o].w;
+            SPhase[k] = Phase[o];
+        }
+    });
+}
+
+void CpuParticleSystem::findNeighbors(PxCpuDispatcher* dispatcher) {
+    auto inv = 1.0f / KernelRadius;
+    auto h2 = KernelRadius * KernelRadius;
+    parallelFor(dispatcher, Count, ParticleGrain, [&](PxU32 begin, PxU32 end) {
+        PxU32 buckets[27];
+        auto h2v = V4Load(h2);
+        for(PxU32 k = begin; k < end; k++) {
+            auto cx = cellCoord(SX[k], inv);
+            auto cy = cellCoord(SY[k], inv);
+            auto cz = cellCoord(SZ[k], inv);
+
+            // neighboring cells may share a hash bucket, visit each bucket once
+            PxU32 nb = 0;
+            for(PxI32 dx = -1; dx <= 1; dx++)
+                for(PxI32 dy = -1; dy <= 1; dy++)
+                    for(PxI32 dz = -1; dz <= 1; dz++)
+                        buckets[nb++] = cellHash(cx + dx, cy + dy, cz + dz, CellMask);
+            std::sort(buckets, buckets + nb);
+            nb = (PxU32)(std::unique(buckets, buckets + nb) - buckets);
+
+            auto px = V4Load(SX[k]);
+            auto py = V4Load(SY[k]);
+            auto pz = V4Load(SZ[k]);
+            auto out = &Neighbors[k * CpuPbdMaxNeighbors];
+            PxU32 count = 0;
+
+            for(PxU32 b = 0; b < nb && count < CpuPbdMaxNeighbors; b++) {
+                auto j = CellStart[buckets[b]];
+                auto e = CellStart[buckets[b] + 1];
+                for(; j + 4 <= e; j += 4) {
+                    auto dx = V4Sub(V4LoadU(&SX[j]), px);
+                    auto dy = V4Sub(V4LoadU(&SY[j]), py);
+                    auto dz = V4Sub(V4LoadU(&SZ[j]), pz);
+                    auto d2 = V4MulAdd(dz, dz, V4MulAdd(dy, dy, V4Mul(dx, dx)));
+                    auto bits = BGetBitMask(V4IsGrtr(h2v, d2));
+                    while(bits && count < CpuPbdMaxNeighbors) {
+                        auto l = PxLowestSetBit(bits);
+                        bits &= bits - 1;
+                        if(j + l != k) out[count++] = j + l;
+                    }
+                }
+                for(; j < e && count < CpuPbdMaxNeighbors; j++) {
+                    auto dx = SX[j] - SX[k];
+                    auto dy = SY[j] - SY[k];
+                    auto dz = SZ[j] - SZ[k];
+                    if(j != k && dx * dx + dy * dy + dz * dz < h2) out[count++] = j;
+                }
+            }
+            NeighborCount[k] = count;
+        }
+    });
+}
+
+void CpuParticleSystem::gatherColliders(PxScene* scene, PxCpuDispatcher* dispatcher) {
+    Bounds = PxBounds3::empty();
+    for(PxU32 k = 0; k < Count; k++) Bounds.include(PxVec3(SX[k], SY[k], SZ[k]));
+
+    auto extent = Bounds.getDimensions();
+    BinSize = PxMax(4.0f * KernelRadius, extent.maxElement() / (float)MaxBinsPerAxis);
+    for(PxU32 a = 0; a < 3; a++) BinCount[a] = PxMin(MaxBinsPerAxis, (PxU32)(extent[a] / BinSize) + 1);
+    auto nbBins = BinCount[0] * BinCount[1] * BinCount[2];
+
+    ParticleBin.resize(Count);
+    for(auto& b : Bins) b.clear();
+    Bins.resize(nbBins);
+
+    std::vector<char> occupied(nbBins, 0);
+    auto inv = 1.0f / BinSize;
+    for(PxU32 k = 0; k < Count; k++) {
+        auto bx = PxMin(BinCount[0] - 1, (PxU32)((SX[k] - Bounds.minimum.x) * inv));
+        auto by = PxMin(BinCount[1] - 1, (PxU32)((SY[k] - Bounds.minimum.y) * inv));
+        auto bz = PxMin(BinCount[2] - 1, (PxU32)((SZ[k] - Bounds.minimum.z) * inv));
+        auto bin = (bz * BinCount[1] + by) * BinCount[0] + bx;
+        ParticleBin[k] = bin;
+        occupied[bin] = 1;
+    }
+
+    std::vector<PxU32> queries;
+    for(PxU32 b = 0; b < nbBins; b++) if(occupied[b]) queries.push_back(b);
+
+    // one overlap query per occupied bin, scene queries are safe to run concurrently
+    auto margin = RestOffset + ContactOffset;
+    parallelFor(dispatcher, (PxU32)queries.size(), 1, [&](PxU32 begin, PxU32 end) {
+        PxOverlapHit hits[MaxBinColliders];
+        for(PxU32 q = begin; q < end; q++) {
+            auto bin = queries[q];
+            auto bx = bin % BinCount[0];
+            auto by = (bin / BinCount[0]) % BinCount[1];
+            auto bz = bin / (BinCount[0] * BinCount[1]);
+            auto lo = Bounds.minimum + PxVec3((float)bx, (float)by, (float)bz) * BinSize;
+            auto half = PxVec3(0.5f * BinSize + margin);
+
+            PxOverlapBuffer buffer(hits, MaxBinColliders);
+            PxQueryFilterData filter(PxQueryFlag::eSTATIC | PxQueryFlag::eDYNAMIC | PxQueryFlag::eNO_BLOCK);
+            scene->overlap(PxBoxGeometry(half), PxTransform(lo + PxVec3(0.5f * BinSize)), buffer, filter);
+
+            auto& colliders = Bins[bin];
+            for(PxU32 h = 0; h < buffer.getNbTouches(); h++) {
+                auto& hit = buffer.getTouch(h);
+                if(!(hit.shape->getFlags() & PxShapeFlag::eSIMULATION_SHAPE)) continue;
+                CpuPbdCollider c;
+                c.Geometry = &hit.shape->getGeometry();
+                c.Pose = PxShapeExt::getGlobalPose(*hit.shape, *hit.actor);
+                c.Bounds = PxShapeExt::getWorldBounds(*hit.shape, *hit.actor);
+                colliders.push_back(c);
+            }
+        }
+    });
+}
+
+void CpuParticleSystem::solveDensity(PxCpuDispatcher* dispatcher) {
+    auto invRho = 1.0f / RestDensity;
+    auto dq = poly6(0.04f * KernelRadius * KernelRadius);
+    auto invDq = dq > 0.0f ? 1.0f / dq : 0.0f;
+    auto solidDistance = 2.0f * SolidRestOffset;
+
+    for(PxU32 it = 0; it < SolverIterations; it++) {
+        parallelFor(dispatcher, Count, ParticleGrain, [&](PxU32 begin, PxU32 end) {
+            for(PxU32 k = begin; k < end; k++) {
+                if(!isFluid(SPhase[k])) { Lambda[k] = 0.0f; continue; }
+                PxVec3 p(SX[k], SY[k], SZ[k]);
+                float rho = poly6(0.0f);
+                PxVec3 gradI(0.0f);
+                float grad2 = 0.0f;
+                auto nbs = &Neighbors[k * CpuPbdMaxNeighbors];
+                for(PxU32 n = 0; n < NeighborCount[k]; n++) {
+                    auto j = nbs[n];
+                    if(!isFluid(SPhase[j])) continue;
+                    auto d = p - PxVec3(SX[j], SY[j], SZ[j]);
+                    auto r2 = d.magnitudeSquared();
+                    rho += poly6(r2);
+                    auto g = spikyGradient(d, PxSqrt(r2)) * invRho;
+                    gradI += g;
+                    grad2 += g.magnitudeSquared();
+                }
+                // unilateral, particles at the free surface are not pulled together
+                auto c = PxMax(rho * invRho - 1.0f, 0.0f);
+                Lambda[k] = -c / (grad2 + gradI.magnitudeSquared() + Relaxation);
+            }
+        });
+
+        parallelFor(dispatcher, Count, ParticleGrain, [&](PxU32 begin, PxU32 end) {
+            for(PxU32 k = begin; k < end; k++) {
+                PxVec3 delta(0.0f);
+                if(InvMass[k] > 0.0f) {
+                    PxVec3 p(SX[k], SY[k], SZ[k]);
+                    auto pk = SPhase[k];
+                    auto nbs = &Neighbors[k * CpuPbdMaxNeighbors];
+                    for(PxU32 n = 0; n < NeighborCount[k]; n++) {
+                        auto j = nbs[n];
+                        auto pj = SPhase[j];
+                        auto d = p - PxVec3(SX[j], SY[j], SZ[j]);
+                        auto r = d.magnitude();
+                        if(isFluid(pk) && isFluid(pj)) {
+                            // artificial pressure against tensile instability
+                            auto w = poly6(r * r) * invDq;
+                            auto corr = -ArtificialPressure * w * w * w * w;
+                            delta += spikyGradient(d, r) * ((Lambda[k] + Lambda[j] + corr) * invRho);
+                        }
+                        else if(r > 0.0f && r < solidDistance) {
+                            auto collide = phaseGroup(pk) != phaseGroup(pj) ||
+                                ((pk & PxParticlePhaseFlag::eParticlePhaseSelfCollide) && (pj & PxParticlePhaseFlag::eParticlePhaseSelfCollide));
+                            if(collide) delta += d * (0.5f * (solidDistance - r) / r);
+                        }
+                    }
+                }
+                Delta[k] = delta;
+            }
+        });
+
+        parallelFor(dispatcher, Count, ParticleGrain * 4, [&](PxU32 begin, PxU32 end) {
+            for(PxU32 k = begin; k < end; k++) {
+                SX[k] += Delta[k].x;
+                SY[k] += Delta[k].y;
+                SZ[k] += Delta[k].z;
+            }
+        });
+    }
+}
+
+void CpuParticleSystem::collide(PxCpuDispatcher* dispatcher) {
+    auto radius = RestOffset;
+    PxSphereGeometry sphere(radius);
+    parallelFor(dispatcher, Count, ParticleGrain, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 k = begin; k < end; k++) {
+            auto& colliders = Bins[ParticleBin[k]];
+            if(colliders.empty() || InvMass[k] <= 0.0f) continue;
+
+            auto group = phaseGroup(SPhase[k]);
+            auto friction = group < Materials.size() ? PxMin(Materials[group].Friction, 1.0f) : 0.0f;
+
+            PxVec3 p(SX[k], SY[k], SZ[k]);
+            for(auto& c : colliders) {
+                PxBounds3 b(p - PxVec3(radius), p + PxVec3(radius));
+                if(!b.intersects(c.Bounds)) continue;
+
+                PxVec3 n;
+                PxF32 depth;
+                if(PxGeometryQuery::computePenetration(n, depth, sphere, PxTransform(p), *c.Geometry, c.Pose) && depth > 0.0f) {
+                    p += n * depth;
+                    // remove part of the tangential motion of this step
+                    auto move = p - Old[k];
+                    auto tangential = move - n * n.dot(move);
+                    p -= tangential * friction;
+                }
+            }
+            SX[k] = p.x; SY[k] = p.y; SZ[k] = p.z;
+        }
+    });
+}
+
+void CpuParticleSystem::updateVelocities(float dt, PxCpuDispatcher* dispatcher) {
+    auto invDt = 1.0f / dt;
+    parallelFor(dispatcher, Count, ParticleGrain * 4, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 k = begin; k < end; k++) {
+            Vel[k] = (PxVec3(SX[k], SY[k], SZ[k]) - Old[k]) * invDt;
+        }
+    });
+
+    // XSPH viscosity, written to Delta so every particle reads unsmoothed velocities
+    auto invRho = 1.0f / RestDensity;
+    parallelFor(dispatcher, Count, ParticleGrain, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 k = begin; k < end; k++) {
+            PxVec3 v = Vel[k];
+            auto group = phaseGroup(SPhase[k]);
+            if(isFluid(SPhase[k]) && group < Materials.size()) {
+                auto& m = Materials[group];
+                auto c = PxClamp(m.Viscosity * 0.01f, 0.0f, 0.5f);
+                PxVec3 p(SX[k], SY[k], SZ[k]);
+                PxVec3 sum(0.0f);
+                auto nbs = &Neighbors[k * CpuPbdMaxNeighbors];
+                for(PxU32 n = 0; n < NeighborCount[k]; n++) {
+                    auto j = nbs[n];
+                    if(!isFluid(SPhase[j])) continue;
+                    auto r2 = (p - PxVec3(SX[j], SY[j], SZ[j])).magnitudeSquared();
+                    sum += (Vel[j] - Vel[k]) * poly6(r2);
+                }
+                v += sum * (c * invRho);
+                v *= PxMax(0.0f, 1.0f - m.Damping * dt);
+            }
+            Delta[k] = v;
+        }
+    });
+
+    parallelFor(dispatcher, Count, ParticleGrain * 4, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 k = begin; k < end; k++) {
+            auto o = Sorted[k];
+            PositionInvMass[o] = PxVec4(SX[k], SY[k], SZ[k], InvMass[k]);
+            Velocity[o] = PxVec4(Delta[k], 0.0f);
+        }
+    });
+}
+
+void CpuParticleSystem::step(float dt, const PxVec3& gravity, PxScene* scene, PxCpuDispatcher* dispatcher) {
+    Count = PxMin(NbActiveParticles, MaxParticles);
+    if(Count == 0 || dt <= 0.0f) return;
+
+    Sorted.resize(Count);
+    SX.resize(Count + 4); SY.resize(Count + 4); SZ.resize(Count + 4);
+    Old.resize(Count);
+    Vel.resize(Count);
+    InvMass.resize(Count);
+    SPhase.resize(Count);
+    Delta.resize(Count);
+    Lambda.resize(Count);
+    Neighbors.resize(Count * CpuPbdMaxNeighbors);
+    NeighborCount.resize(Count);
+
+    // predict
+    auto maxVel2 = MaxVelocity * MaxVelocity;
+    parallelFor(dispatcher, Count, ParticleGrain * 4, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 i = begin; i < end; i++) {
+            auto& x = PositionInvMass[i];
+            auto v = Velocity[i].getXYZ();
+            if(x.w > 0.0f) v += gravity * dt;
+            else v = PxVec3(0.0f);
+            auto l2 = v.magnitudeSquared();
+            if(l2 > maxVel2) v *= MaxVelocity / PxSqrt(l2);
+            Delta[i] = x.getXYZ() + v * dt;
+        }
+    });
+
+    buildGrid(dispatcher);
+    findNeighbors(dispatcher);
+    if(scene) gatherColliders(scene, dispatcher);
+    else Bins.clear();
+
+    solveDensity(dispatcher);
+    if(!Bins.empty()) collide(dispatcher);
+    updateVelocities(dt, dispatcher);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include <vector>
+
+// Material parameters of a CPU phase, same meaning as the arguments of
+// PxPhysics::createPBDMaterial. Viscosity is mapped to an XSPH coefficient.
+typedef struct {
+    float Friction;
+    float Damping;
+    float Viscosity;
+    float Cohesion;
+} CpuPbdMaterial;
+
+// Rigid shape that particles of one collision bin may touch.
+struct CpuPbdCollider {
+    const physx::PxGeometry* Geometry;
+    physx::PxTransform Pose;
+    physx::PxBounds3 Bounds;
+};
+
+// Position based fluids (Macklin and Mueller 2013) on the CPU. Particle data
+// uses the same layout as a PxParticleBuffer (posInvMass, velocity, phase) so
+// PxPbdHandle consumers do not care which backend runs a system.
+class CpuParticleSystem {
+public:
+    CpuParticleSystem(physx::PxU32 maxParticles, float particleSpacing);
+
+    // PxPBDParticleSystem compatible parameters
+    float RestOffset;
+    float ContactOffset;
+    float ParticleContactOffset;
+    float SolidRestOffset;
+    float FluidRestOffset;
+    float MaxVelocity;
+    physx::PxU32 SolverIterations;
+
+    // PBF kernel radius and rest density of a particle lattice with the creation spacing
+    float KernelRadius;
+    float RestDensity;
+    float Relaxation;
+    float ArtificialPressure;
+
+    physx::PxU32 MaxParticles;
+    physx::PxU32 NbActiveParticles;
+    std::vector<physx::PxVec4> PositionInvMass;
+    std::vector<physx::PxVec4> Velocity;
+    std::vector<physx::PxU32> Phase;
+    std::vector<CpuPbdMaterial> Materials;
+
+    // systems of one scene are chained and stepped by pxSimulate
+    CpuParticleSystem* Next;
+
+    physx::PxU32 createPhase(const CpuPbdMaterial& material, physx::PxParticlePhaseFlags flags);
+    void step(float dt, const physx::PxVec3& gravity, physx::PxScene* scene, physx::PxCpuDispatcher* dispatcher);
+
+private:
+    void buildGrid(physx::PxCpuDispatcher* dispatcher);
+    void findNeighbors(physx::PxCpuDispatcher* dispatcher);
+    void gatherColliders(physx::PxScene* scene, physx::PxCpuDispatcher* dispatcher);
+    void solveDensity(physx::PxCpuDispatcher* dispatcher);
+    void collide(physx::PxCpuDispatcher* dispatcher);
+    void updateVelocities(float dt, physx::PxCpuDispatcher* dispatcher);
+
+    float poly6(float r2) const;
+    physx::PxVec3 spikyGradient(const physx::PxVec3& d, float r) const;
+
+    // working set in cell-sorted order, S* arrays are padded for 4-wide loads
+    physx::PxU32 Count;
+    std::vector<physx::PxU32> Sorted;
+    std::vector<float> SX, SY, SZ;
+    std::vector<physx::PxVec3> Old;
+    std::vector<physx::PxVec3> Vel;
+    std::vector<float> InvMass;
+    std::vector<physx::PxU32> SPhase;
+    std::vector<physx::PxVec3> Delta;
+    std::vector<float> Lambda;
+
+    std::vector<physx::PxU32> CellKeys;
+    std::vector<physx::PxU32> CellStart;
+    physx::PxU32 CellMask;
+
+    std::vector<physx::PxU32> Neighbors;
+    std::vector<physx::PxU32> NeighborCount;
+
+    physx::PxBounds3 Bounds;
+    physx::PxU32 BinCount[3];
+    float BinSize;
+    std::vector<physx::PxU32> ParticleBin;
+    std::vector<std::vector<CpuPbdCollider>> Bins;
+};
+
+static const physx::PxU32 CpuPbdMaxNeighbors = 64;
@@ -0,0 +1,302 @@
+#include "Destructibles.h"
+#include "MassCache.h"
+#include "Parallel.h"
+#include "SceneEvents.h"
+#include <algorithm>
+
+using namespace physx;
+
+static const PxU32 NoIsland = 0xFFFFFFFF;
+
+DestructibleAsset::~DestructibleAsset() {
+    for(auto mesh : Meshes) {
+        if(mesh) mesh->release();
+    }
+}
+
+bool DestructibleAsset::build(PxPhysics* physics, PxU32 chunkCount, const PxDestructibleChunkDesc* chunks, const V3f* vertices,
+        PxU32 bondCount, const PxDestructibleBond* bonds) {
+    PxCookingParams params(physics->getTolerancesScale());
+    Meshes.assign(chunkCount, nullptr);
+    Anchored.resize(chunkCount);
+    for(PxU32 c = 0; c < chunkCount; c++) {
+        PxConvexMeshDesc desc;
+        desc.points.count = chunks[c].VertexCount;
+        desc.points.stride = sizeof(V3f);
+        desc.points.data = vertices + chunks[c].FirstVertex;
+        desc.flags = PxConvexFlag::eCOMPUTE_CONVEX;
+        Meshes[c] = PxCreateConvexMesh(params, desc, physics->getPhysicsInsertionCallback());
+        if(!Meshes[c]) return false;
+        Anchored[c] = chunks[c].Anchored != 0;
+    }
+
+    // bonds per chunk, both ends list the bond
+    Bonds.clear();
+    BondStart.assign(chunkCount + 1, 0);
+    for(PxU32 b = 0; b < bondCount; b++) {
+        auto& bond = bonds[b];
+        if(bond.Chunk0 >= chunkCount || bond.Chunk1 >= chunkCount || bond.Chunk0 == bond.Chunk1) continue;
+        Bonds.push_back(bond);
+        BondStart[bond.Chunk0 + 1]++;
+        BondStart[bond.Chunk1 + 1]++;
+    }
+    for(PxU32 c = 0; c < chunkCount; c++) BondStart[c + 1] += BondStart[c];
+    BondList.resize(BondStart[chunkCount]);
+    std::vector<PxU32> next(BondStart.begin(), BondStart.end() - 1);
+    for(PxU32 b = 0; b < (PxU32)Bonds.size(); b++) {
+        BondList[next[Bonds[b].Chunk0]++] = b;
+        BondList[next[Bonds[b].Chunk1]++] = b;
+    }
+    return true;
+}
+
+DestructibleManager::DestructibleManager(PxSceneHandle* scene) : Scene(scene) {
+    // contacts of the step before the manager existed are never applied
+    LastStep = sceneEventsOf(scene)->Step;
+}
+
+DestructibleManager::~DestructibleManager() {
+    for(PxU32 id = 0; id < (PxU32)Destructibles.size(); id++) release(id);
+}
+
+PxU32 DestructibleManager::create(const PxDestructibleDesc& desc) {
+    auto asset = desc.Asset;
+    if(!asset || !desc.Material || asset->Meshes.empty()) return 0xFFFFFFFF;
+
+    auto n = (PxU32)asset->Meshes.size();
+    auto actor = Scene->Physics->createRigidDynamic(toPxTransform(desc.Pose));
+    if(!actor) return 0xFFFFFFFF;
+
+    auto d = new Destructible();
+    d->Asset = asset;
+    d->Density = desc.Density > 0.0f ? desc.Density : 1.0f;
+    d->UserData = desc.UserData;
+    d->Shapes.resize(n);
+    d->ChunkActors.assign(n, actor);
+    d->Broken.assign(asset->Bonds.size(), 0);
+    d->Pieces.push_back(actor);
+
+    PxFilterData filter;
+    filter.word0 = desc.Layer;
+    filter.word1 = desc.Group;
+    bool anchored = false;
+    for(PxU32 c = 0; c < n; c++) {
+        // not exclusive, detachShape keeps our reference and the shape can join another piece
+        auto shape = Scene->Physics->createShape(PxConvexMeshGeometry(asset->Meshes[c]), *desc.Material, false);
+        if(!shape) {
+            actor->release();
+            for(PxU32 k = 0; k < c; k++) d->Shapes[k]->release();
+            delete d;
+            return 0xFFFFFFFF;
+        }
+        shape->setSimulationFilterData(filter);
+        actor->attachShape(*shape);
+        d->Shapes[c] = shape;
+        anchored |= asset->Anchored[c] != 0;
+    }
+    if(anchored) actor->setRigidBodyFlag(PxRigidBodyFlag::eKINEMATIC, true);
+    massCache().updateMassAndInertia(*actor, d->Density);
+    Scene->Scene->addActor(*actor);
+
+    PxU32 id;
+    if(FreeIds.empty()) {
+        id = (PxU32)Destructibles.size();
+        Destructibles.push_back(d);
+    }
+    else {
+        id = FreeIds.back();
+        FreeIds.pop_back();
+        Destructibles[id] = d;
+    }
+    for(PxU32 c = 0; c < n; c++) ShapeIndex[d->Shapes[c]] = ((PxU64)id << 32) | c;
+    return id;
+}
+
+void DestructibleManager::release(PxU32 id) {
+    auto d = get(id);
+    if(!d) return;
+    for(auto shape : d->Shapes) ShapeIndex.erase(shape);
+    for(auto piece : d->Pieces) piece->release();
+    for(auto shape : d->Shapes) shape->release();
+    delete d;
+    Destructibles[id] = nullptr;
+    FreeIds.push_back(id);
+}
+
+void DestructibleManager::split(PxU32 id, Destructible* d, PxRigidDynamic* actor) {
+    auto asset = d->Asset;
+    auto n = (PxU32)d->Shapes.size();
+
+    // islands of the piece over its unbroken bonds
+    Labels.assign(n, NoIsland);
+    IslandSize.clear();
+    IslandAnchored.clear();
+    for(PxU32 c = 0; c < n; c++) {
+        if(d->ChunkActors[c] != actor || Labels[c] != NoIsland) continue;
+        auto island = (PxU32)IslandSize.size();
+        IslandSize.push_back(0);
+        IslandAnchored.push_back(0);
+        Labels[c] = island;
+        Stack.clear();
+        Stack.push_back(c);
+        while(!Stack.empty()) {
+            auto chunk = Stack.back();
+            Stack.pop_back();
+            IslandSize[island]++;
+            IslandAnchored[island] |= asset->Anchored[chunk];
+            for(PxU32 i = asset->BondStart[chunk]; i < asset->BondStart[chunk + 1]; i++) {
+                auto b = asset->BondList[i];
+                if(d->Broken[b]) continue;
+                auto& bond = asset->Bonds[b];
+                auto other = bond.Chunk0 == chunk ? bond.Chunk1 : bond.Chunk0;
+                if(Labels[other] != NoIsland || d->ChunkActors[other] != actor) continue;
+                Labels[other] = island;
+                Stack.push_back(other);
+            }
+        }
+    }
+    auto islands = (PxU32)IslandSize.size();
+    if(islands <= 1) return;
+
+    // the actor keeps an anchored island, otherwise the largest one
+    PxU32 keep = 0;
+    for(PxU32 i = 1; i < islands; i++) {
+        if(IslandAnchored[i] > IslandAnchored[keep] || (IslandAnchored[i] == IslandAnchored[keep] && IslandSize[i] > IslandSize[keep])) keep = i;
+    }
+
+    auto pose = actor->getGlobalPose();
+    auto kinematic = actor->getRigidBodyFlags().isSet(PxRigidBodyFlag::eKINEMATIC);
+    Spawn parent;
+    parent.LinearVelocity = kinematic ? PxVec3(0.0f) : actor->getLinearVelocity();
+    parent.AngularVelocity = kinematic ? PxVec3(0.0f) : actor->getAngularVelocity();
+    parent.Center = pose.transform(actor->getCMassLocalPose().p);
+
+    auto first = (PxU32)Spawns.size();
+    for(PxU32 i = 0; i < islands; i++) {
+        if(i == keep) continue;
+        // same frame as the parent, the chunk shapes keep their identity local pose
+        auto piece = Scene->Physics->createRigidDynamic(pose);
+        if(IslandAnchored[i]) piece->setRigidBodyFlag(PxRigidBodyFlag::eKINEMATIC, true);
+        parent.Actor = piece;
+        Spawns.push_back(parent);
+        d->Pieces.push_back(piece);
+        NewPieces.push_back({ id, IslandSize[i], piece });
+        MassBodies.push_back(piece);
+        MassDensities.push_back(d->Density);
+    }
+    for(PxU32 c = 0; c < n; c++) {
+        if(d->ChunkActors[c] != actor || Labels[c] == keep) continue;
+        auto slot = Labels[c] < keep ? Labels[c] : Labels[c] - 1;
+        auto piece = Spawns[first + slot].Actor;
+        actor->detachShape(*d->Shapes[c]);
+        piece->attachShape(*d->Shapes[c]);
+        d->ChunkActors[c] = piece;
+    }
+    if(kinematic && !IslandAnchored[keep]) actor->setRigidBodyFlag(PxRigidBodyFlag::eKINEMATIC, false);
+    MassBodies.push_back(actor);
+    MassDensities.push_back(d->Density);
+}
+
+PxU32 DestructibleManager::update(PxCpuDispatcher* dispatcher) {
+    NewPieces.clear();
+    auto events = Scene->Events;
+    // a second update without a step in between must not break bonds again
+    if(!events || events->Step == LastStep) return 0;
+    LastStep = events->Step;
+
+    // bonds of hit chunks that are weaker than the impulse break
+    Dirty.clear();
+    for(auto& contact : events->Contacts) {
+        auto it = ShapeIndex.find(contact.Shape);
+        if(it == ShapeIndex.end()) continue;
+        auto id = (PxU32)(it->second >> 32);
+        auto chunk = (PxU32)it->second;
+        auto d = Destructibles[id];
+        auto asset = d->Asset;
+        bool broke = false;
+        for(PxU32 i = asset->BondStart[chunk]; i < asset->BondStart[chunk + 1]; i++) {
+            auto b = asset->BondList[i];
+            if(d->Broken[b] || contact.Impulse <= asset->Bonds[b].Strength) continue;
+            d->Broken[b] = 1;
+            broke = true;
+        }
+        if(broke) Dirty.push_back({ id, d->ChunkActors[chunk] });
+    }
+    if(Dirty.empty()) return 0;
+    std::sort(Dirty.begin(), Dirty.end());
+    Dirty.erase(std::unique(Dirty.begin(), Dirty.end()), Dirty.end());
+
+    Spawns.clear();
+    MassBodies.clear();
+    MassDensities.clear();
+    for(auto& dirty : Dirty) split(dirty.first, Destructibles[dirty.first], dirty.second);
+    if(Spawns.empty()) return 0;
+
+    massCache().updateMassAndInertia(dispatcher, (PxU32)MassBodies.size(), MassBodies.data(), MassDensities.data());
+
+    // pieces move like the part of the parent they were, angular velocity included
+    std::vector<PxActor*> actors(Spawns.size());
+    for(PxU32 i = 0; i < (PxU32)Spawns.size(); i++) {
+        auto& s = Spawns[i];
+        actors[i] = s.Actor;
+        if(s.Actor->getRigidBodyFlags().isSet(PxRigidBodyFlag::eKINEMATIC)) continue;
+        auto center = s.Actor->getGlobalPose().transform(s.Actor->getCMassLocalPose().p);
+        s.Actor->setLinearVelocity(s.LinearVelocity + s.AngularVelocity.cross(center - s.Center));
+        s.Actor->setAngularVelocity(s.AngularVelocity);
+    }
+    Scene->Scene->addActors(actors.data(), (PxU32)actors.size());
+    return (PxU32)NewPieces.size();
+}
+
+
+DllExport(DestructibleAsset*) pxCreateDestructibleAsset(PxHandle* handle, PxU32 chunkCount, const PxDestructibleChunkDesc* chunks,
+        const V3f* vertices, PxU32 bondCount, const PxDestructibleBond* bonds) {
+    auto asset = new DestructibleAsset();
+    if(!asset->build(handle->Physics, chunkCount, chunks, vertices, bondCount, bonds)) {
+        delete asset;
+        return nullptr;
+    }
+    return asset;
+}
+
+DllExport(void) pxDestroyDestructibleAsset(DestructibleAsset* asset) {
+    delete asset;
+}
+
+DllExport(DestructibleManager*) pxCreateDestructibleManager(PxSceneHandle* scene) {
+    return new DestructibleManager(scene);
+}
+
+DllExport(void) pxDestroyDestructibleManager(DestructibleManager* manager) {
+    delete manager;
+}
+
+DllExport(void) pxCreateDestructibles(DestructibleManager* manager, PxU32 count, const PxDestructibleDesc* descs, PxU32* ids) {
+    for(PxU32 i = 0; i < count; i++) {
+        auto id = manager->create(descs[i]);
+        if(ids) ids[i] = id;
+    }
+}
+
+DllExport(void) pxReleaseDestructibles(DestructibleManager* manager, PxU32 count, const PxU32* ids) {
+    for(PxU32 i = 0; i < count; i++) manager->release(ids[i]);
+}
+
+DllExport(PxU32) pxUpdateDestructibles(DestructibleManager* manager) {
+    return manager->update(sharedDispatcher());
+}
+
+DllExport(PxU32) pxGetNewDestructiblePieces(DestructibleManager* manager, PxDestructiblePiece* pieces, PxU32 maxPieces) {
+    auto n = (PxU32)manager->NewPieces.size();
+    for(PxU32 i = 0; i < n && i < maxPieces; i++) pieces[i] = manager->NewPieces[i];
+    return n;
+}
+
+DllExport(void) pxGetDestructibleChunkPoses(DestructibleManager* manager, PxU32 count, const PxU32* ids, Euclidean3d* poses) {
+    for(PxU32 i = 0; i < count; i++) {
+        auto d = manager->get(ids[i]);
+        if(!d) continue;
+        // chunk shapes have identity local poses, a chunk moves with its piece
+        for(auto actor : d->ChunkActors) *poses++ = toEuclidean3d(actor->getGlobalPose());
+    }
+}
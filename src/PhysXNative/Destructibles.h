@@ -0,0 +1,130 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include <unordered_map>
+#include <vector>
+
+struct DestructibleAsset;
+
+typedef struct {
+    physx::PxU32 FirstVertex;   // into the vertex array of the asset, points in the asset frame
+    physx::PxU32 VertexCount;   // the chunk is the convex hull of its points
+    physx::PxU32 Anchored;      // pieces holding an anchored chunk stay kinematic
+    physx::PxU32 Reserved;
+} PxDestructibleChunkDesc;
+
+typedef struct {
+    physx::PxU32 Chunk0;
+    physx::PxU32 Chunk1;
+    float Strength;             // contact impulse on either chunk that breaks the bond
+} PxDestructibleBond;
+
+typedef struct {
+    DestructibleAsset* Asset;
+    Euclidean3d Pose;
+    float Density;
+    physx::PxU32 Layer;         // simulation filter words of the chunk shapes, see pxSetActorLayers
+    physx::PxU32 Group;
+    physx::PxU32 Reserved;
+    physx::PxMaterial* Material;
+    physx::PxU64 UserData;
+} PxDestructibleDesc;
+
+typedef struct {
+    physx::PxU32 Id;            // destructible the piece split off from
+    physx::PxU32 ChunkCount;
+    physx::PxRigidDynamic* Actor;
+} PxDestructiblePiece;
+
+// Precomputed convex chunks and the bonds between them, shared by all
+// destructibles made from it. Must outlive them.
+struct DestructibleAsset {
+    std::vector<physx::PxConvexMesh*> Meshes;
+    std::vector<physx::PxU8> Anchored;
+    std::vector<PxDestructibleBond> Bonds;
+    // bonds of chunk c are BondList[BondStart[c] .. BondStart[c + 1]]
+    std::vector<physx::PxU32> BondStart;
+    std::vector<physx::PxU32> BondList;
+
+    ~DestructibleAsset();
+    bool build(physx::PxPhysics* physics, physx::PxU32 chunkCount, const PxDestructibleChunkDesc* chunks, const V3f* vertices,
+        physx::PxU32 bondCount, const PxDestructibleBond* bonds);
+};
+
+struct Destructible {
+    DestructibleAsset* Asset;
+    float Density;
+    physx::PxU64 UserData;
+    // per chunk, the shapes are shared so that they can move between pieces
+    std::vector<physx::PxShape*> Shapes;
+    std::vector<physx::PxRigidDynamic*> ChunkActors;
+    std::vector<physx::PxU8> Broken;    // per bond
+    std::vector<physx::PxRigidDynamic*> Pieces;
+};
+
+// Pre-fractured objects of one scene. An intact object is a single
+// PxRigidDynamic with one convex shape per chunk. update reads the contact
+// impulses of the last step from the scene's SceneEvents, so the chunk layers
+// must notify (see pxSetLayerNotify), breaks every bond of a hit chunk weaker
+// than the impulse and splits pieces whose bond graph fell apart. All splits
+// of an update move shapes between actors, recompute masses in one batch and
+// add the new pieces with one addActors.
+class DestructibleManager {
+public:
+    DestructibleManager(PxSceneHandle* scene);
+    ~DestructibleManager();
+
+    PxSceneHandle* Scene;
+
+    // indexed by destructible id, NULL for released ones
+    std::vector<Destructible*> Destructibles;
+    std::vector<physx::PxU32> FreeIds;
+    // pieces split off by the last update
+    std::vector<PxDestructiblePiece> NewPieces;
+
+    physx::PxU32 create(const PxDestructibleDesc& desc);
+    void release(physx::PxU32 id);
+    Destructible* get(physx::PxU32 id) const { return id < Destructibles.size() ? Destructibles[id] : nullptr; }
+
+    // after the step, returns the number of new pieces. The contacts of a step
+    // are applied once, further calls before the next step do nothing.
+    physx::PxU32 update(physx::PxCpuDispatcher* dispatcher);
+
+private:
+    struct Spawn {
+        physx::PxRigidDynamic* Actor;
+        physx::PxVec3 LinearVelocity;   // of the parent piece
+        physx::PxVec3 AngularVelocity;
+        physx::PxVec3 Center;           // parent center of mass
+    };
+
+    void split(physx::PxU32 id, Destructible* d, physx::PxRigidDynamic* actor);
+
+    // SceneEvents::Step of the contacts the last update applied
+    physx::PxU32 LastStep;
+
+    // destructible id in the high, chunk in the low 32 bits
+    std::unordered_map<const physx::PxShape*, physx::PxU64> ShapeIndex;
+
+    std::vector<std::pair<physx::PxU32, physx::PxRigidDynamic*>> Dirty;
+    std::vector<physx::PxU32> Labels;
+    std::vector<physx::PxU32> Stack;
+    std::vector<physx::PxU32> IslandSize;
+    std::vector<physx::PxU8> IslandAnchored;
+    std::vector<Spawn> Spawns;
+    std::vector<physx::PxRigidBody*> MassBodies;
+    std::vector<float> MassDensities;
+};
+
+// vertices holds the points of all chunks, returns NULL if a chunk cannot be cooked
+DllExport(DestructibleAsset*) pxCreateDestructibleAsset(PxHandle* handle, physx::PxU32 chunkCount, const PxDestructibleChunkDesc* chunks,
+    const V3f* vertices, physx::PxU32 bondCount, const PxDestructibleBond* bonds);
+DllExport(void) pxDestroyDestructibleAsset(DestructibleAsset* asset);
+DllExport(DestructibleManager*) pxCreateDestructibleManager(PxSceneHandle* scene);
+DllExport(void) pxDestroyDestructibleManager(DestructibleManager* manager);
+DllExport(void) pxCreateDestructibles(DestructibleManager* manager, physx::PxU32 count, const PxDestructibleDesc* descs, physx::PxU32* ids);
+DllExport(void) pxReleaseDestructibles(DestructibleManager* manager, physx::PxU32 count, const physx::PxU32* ids);
+DllExport(physx::PxU32) pxUpdateDestructibles(DestructibleManager* manager);
+DllExport(physx::PxU32) pxGetNewDestructiblePieces(DestructibleManager* manager, PxDestructiblePiece* pieces, physx::PxU32 maxPieces);
+// poses holds one pose per chunk of all ids back to back, released ids take no poses
+DllExport(void) pxGetDestructibleChunkPoses(DestructibleManager* manager, physx::PxU32 count, const physx::PxU32* ids, Euclidean3d* poses);
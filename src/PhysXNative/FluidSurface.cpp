@@ -0,0 +1,469 @@
+#include "FluidSurface.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cstring>
+#include <foundation/PxBitUtils.h>
+#include <foundation/PxMathUtils.h>
+
+using namespace physx;
+
+static const PxU32 KernelGrain = 256;
+static const PxU32 PairGrain = 1024;
+static const PxI32 BlockBias = 1 << 20;
+static const PxU32 BlockNodeCount = FluidBlockNodes * FluidBlockNodes * FluidBlockNodes;
+static const PxU32 NoVertex = 0xFFFFFFFF;
+
+// Marching cubes cases derived from the cube topology. On every face the
+// surface separates each run of inside corners on its own, which is decided by
+// the face alone, so neighboring cells always agree and the surface is closed.
+struct MarchingCubes {
+    PxU8 EdgeCorners[12][2];
+    PxI8 Triangles[256][37];
+    MarchingCubes();
+};
+
+static PX_FORCE_INLINE PxVec3 cornerOffset(PxU32 c) {
+    return PxVec3((float)(c & 1), (float)((c >> 1) & 1), (float)((c >> 2) & 1));
+}
+
+MarchingCubes::MarchingCubes() {
+    PxI32 edgeOf[8][8];
+    PxU32 nbEdges = 0;
+    for(PxU32 a = 0; a < 8; a++) {
+        for(PxU32 axis = 0; axis < 3; axis++) {
+            if(a & (1u << axis)) continue;
+            auto b = a | (1u << axis);
+            EdgeCorners[nbEdges][0] = (PxU8)a;
+            EdgeCorners[nbEdges][1] = (PxU8)b;
+            edgeOf[a][b] = edgeOf[b][a] = (PxI32)nbEdges++;
+        }
+    }
+
+    // corner cycles counter-clockwise seen from outside, (u, v, axis) is right handed
+    PxU32 faces[6][4];
+    for(PxU32 axis = 0; axis < 3; axis++) {
+        for(PxU32 side = 0; side < 2; side++) {
+            auto u = 1u << ((axis + 1) % 3);
+            auto v = 1u << ((axis + 2) % 3);
+            auto base = side << axis;
+            auto& f = faces[2 * axis + side];
+            f[0] = base; f[1] = base | u; f[2] = base | u | v; f[3] = base | v;
+            if(!side) std::swap(f[1], f[3]);
+        }
+    }
+
+    for(PxU32 mask = 0; mask < 256; mask++) {
+        // each crossed edge continues to exactly one other edge of the polygon
+        PxI32 next[12];
+        for(auto& n : next) n = -1;
+        for(auto& f : faces) {
+            for(PxU32 k = 0; k < 4; k++) {
+                auto a = f[k], b = f[(k + 1) & 3];
+                if(((mask >> a) & 1) || !((mask >> b) & 1)) continue;
+                for(PxU32 m = 1; m < 4; m++) {
+                    auto c = f[(k + m) & 3], d = f[(k + m + 1) & 3];
+                    if(((mask >> c) & 1) && !((mask >> d) & 1)) {
+                        next[edgeOf[a][b]] = edgeOf[c][d];
+                        break;
+                    }
+                }
+            }
+        }
+
+        PxU32 n = 0;
+        bool visited[12] = {};
+        for(PxI32 e = 0; e < 12; e++) {
+            if(next[e] < 0 || visited[e]) continue;
+            PxI32 loop[12];
+            PxU32 len = 0;
+            for(auto x = e; !visited[x]; x = next[x]) {
+                visited[x] = true;
+                loop[len++] = x;
+            }
+            for(PxU32 i = 1; i + 1 < len; i++) {
+                Triangles[mask][n++] = (PxI8)loop[0];
+                Triangles[mask][n++] = (PxI8)loop[i];
+                Triangles[mask][n++] = (PxI8)loop[i + 1];
+            }
+        }
+        Triangles[mask][n] = -1;
+    }
+
+    // all cases share one winding, make it face away from the inside corners
+    auto mid = [this](PxI8 e) { return (cornerOffset(EdgeCorners[e][0]) + cornerOffset(EdgeCorners[e][1])) * 0.5f; };
+    auto t = Triangles[1];
+    auto normal = (mid(t[1]) - mid(t[0])).cross(mid(t[2]) - mid(t[0]));
+    if(normal.dot(mid(t[0]) - cornerOffset(0)) < 0.0f) {
+        for(auto& tris : Triangles)
+            for(PxU32 i = 0; tris[i] >= 0; i += 3) std::swap(tris[i + 1], tris[i + 2]);
+    }
+}
+
+static const MarchingCubes& marchingCubes() {
+    static MarchingCubes cases;
+    return cases;
+}
+
+static PX_FORCE_INLINE PxI32 cellCoord(float v, float invCellSize) {
+    return (PxI32)PxFloor(v * invCellSize);
+}
+
+static PX_FORCE_INLINE PxU64 blockKey(PxI32 x, PxI32 y, PxI32 z) {
+    return (PxU64)((PxU32)(x + BlockBias) & 0x1FFFFF) | ((PxU64)((PxU32)(y + BlockBias) & 0x1FFFFF) << 21) | ((PxU64)((PxU32)(z + BlockBias) & 0x1FFFFF) << 42);
+}
+
+static PX_FORCE_INLINE PxI32 blockCoord(PxU64 key, PxU32 axis) {
+    return (PxI32)((key >> (21 * axis)) & 0x1FFFFF) - BlockBias;
+}
+
+static PX_FORCE_INLINE PxU32 nodeIndex(PxU32 x, PxU32 y, PxU32 z) {
+    return x + FluidBlockNodes * (y + FluidBlockNodes * z);
+}
+
+static PX_FORCE_INLINE PxU64 hashFloats(PxU64 h, const float* values, PxU32 count) {
+    for(PxU32 i = 0; i < count; i++) {
+        PxU32 bits;
+        memcpy(&bits, &values[i], sizeof(PxU32));
+        h = (h ^ bits) * 1099511628211ull;
+    }
+    return h;
+}
+
+FluidSurface::FluidSurface(const PxFluidSurfaceDesc& desc)
+    : Desc(desc), VertexCount(0), IndexCount(0), Neighbors(2.0f * desc.ParticleRadius), Frame(0) {
+    marchingCubes();
+}
+
+void FluidSurface::computeKernels(const PxVec4* positions, PxU32 count, PxCpuDispatcher* dispatcher) {
+    auto radius = 2.0f * Desc.ParticleRadius;
+    auto r2 = radius * radius;
+    auto inv = 1.0f / radius;
+    auto maxAnisotropy = PxMax(1.0f, Desc.MaxAnisotropy);
+    auto smoothing = PxClamp(Desc.Smoothing, 0.0f, 1.0f);
+
+    parallelFor(dispatcher, count, KernelGrain, [&](PxU32 begin, PxU32 end) {
+        std::vector<PxU32> buckets;
+        for(PxU32 i = begin; i < end; i++) {
+            auto x = positions[i].getXYZ();
+
+            // weighted moments of the neighbor offsets, the particle itself has weight 1
+            float sumW = 1.0f;
+            PxVec3 m(0.0f);
+            PxMat33 c(PxZero);
+            PxU32 neighbors = 0;
+            Neighbors.forEachInRadius(x, radius, buckets, [&](PxU32 j, float d2) {
+                if(j == i || d2 >= r2) return;
+                auto d = positions[j].getXYZ() - x;
+                auto q = PxSqrt(d2) * inv;
+                auto w = 1.0f - q * q * q;
+                sumW += w;
+                m += d * w;
+                c += PxMat33::outer(d * w, d);
+                neighbors++;
+            });
+            m *= 1.0f / sumW;
+            Centers[i] = x + m * smoothing;
+
+            if(neighbors >= Desc.MinNeighbors && neighbors > 0 && maxAnisotropy > 1.0f) {
+                c = c * (1.0f / sumW) - PxMat33::outer(m, m);
+                PxQuat axes;
+                auto sigma = PxDiagonalize(c, axes);
+
+                // axis lengths from the standard deviations, clamped and volume preserving
+                PxVec3 s(PxSqrt(PxMax(sigma.x, 0.0f)), PxSqrt(PxMax(sigma.y, 0.0f)), PxSqrt(PxMax(sigma.z, 0.0f)));
+                auto smax = s.maxElement();
+                if(smax > 0.0f) {
+                    auto smin = smax / maxAnisotropy;
+                    s = PxVec3(PxMax(s.x, smin), PxMax(s.y, smin), PxMax(s.z, smin));
+                    s *= 1.0f / PxPow(s.x * s.y * s.z, 1.0f / 3.0f);
+
+                    PxMat33 rot(axes);
+                    Kernels[i] = rot * PxMat33::createDiagonal(PxVec3(inv / s.x, inv / s.y, inv / s.z)) * rot.getTranspose();
+                    for(PxU32 a = 0; a < 3; a++) {
+                        auto e = PxVec3(rot(a, 0) * s.x, rot(a, 1) * s.y, rot(a, 2) * s.z);
+                        Extents[i][a] = radius * e.magnitude();
+                    }
+                    continue;
+                }
+            }
+            Kernels[i] = PxMat33::createDiagonal(PxVec3(inv));
+            Extents[i] = PxVec3(radius);
+        }
+    });
+}
+
+void FluidSurface::assignBlocks(PxU32 count, PxCpuDispatcher* dispatcher) {
+    auto invBlock = 1.0f / (Desc.CellSize * (float)FluidBlockCells);
+
+    PairOffsets.resize(count + 1);
+    parallelFor(dispatcher, count, PairGrain, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 i = begin; i < end; i++) {
+            auto lo = Centers[i] - Extents[i];
+            auto hi = Centers[i] + Extents[i];
+            auto r = &BlockRange[6 * i];
+            PxU32 n = 1;
+            for(PxU32 a = 0; a < 3; a++) {
+                r[a] = cellCoord(lo[a], invBlock);
+                r[3 + a] = cellCoord(hi[a], invBlock);
+                n *= (PxU32)(r[3 + a] - r[a] + 1);
+            }
+            PairOffsets[i] = n;
+        }
+    });
+
+    PxU32 total = 0;
+    for(PxU32 i = 0; i < count; i++) {
+        auto n = PairOffsets[i];
+        PairOffsets[i] = total;
+        total += n;
+    }
+    PairOffsets[count] = total;
+
+    PairKeys.resize(total);
+    PairBlocks.resize(total);
+    parallelFor(dispatcher, count, PairGrain, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 i = begin; i < end; i++) {
+            auto r = &BlockRange[6 * i];
+            auto o = PairOffsets[i];
+            for(auto z = r[2]; z <= r[5]; z++)
+                for(auto y = r[1]; y <= r[4]; y++)
+                    for(auto x = r[0]; x <= r[3]; x++)
+                        PairKeys[o++] = blockKey(x, y, z);
+        }
+    });
+
+    // blocks survive between updates so unchanged ones keep their mesh
+    Frame++;
+    PxU64 lastKey = ~0ull;
+    PxU32 lastBlock = 0;
+    for(PxU32 p = 0; p < total; p++) {
+        auto key = PairKeys[p];
+        if(key != lastKey) {
+            auto it = BlockMap.find(key);
+            if(it == BlockMap.end()) {
+                lastBlock = (PxU32)Blocks.size();
+                BlockMap.emplace(key, lastBlock);
+                Blocks.push_back(FluidSurfaceBlock());
+                auto& b = Blocks.back();
+                b.Key = key;
+                b.Checksum = 0;
+                b.Valid = false;
+            }
+            else lastBlock = it->second;
+            Blocks[lastBlock].Frame = Frame;
+            lastKey = key;
+        }
+        PairBlocks[p] = lastBlock;
+    }
+
+    // drop blocks no particle touches anymore
+    std::vector<PxU32> remap(Blocks.size());
+    PxU32 live = 0;
+    for(PxU32 b = 0; b < Blocks.size(); b++) {
+        if(Blocks[b].Frame != Frame) {
+            BlockMap.erase(Blocks[b].Key);
+            continue;
+        }
+        if(live != b) {
+            Blocks[live] = std::move(Blocks[b]);
+            BlockMap[Blocks[live].Key] = live;
+        }
+        remap[b] = live++;
+    }
+    Blocks.erase(Blocks.begin() + live, Blocks.end());
+
+    // counting sort by block, particles stay in index order within a block
+    BlockStart.assign(live + 1, 0);
+    for(PxU32 p = 0; p < total; p++) {
+        PairBlocks[p] = remap[PairBlocks[p]];
+        BlockStart[PairBlocks[p] + 1]++;
+    }
+    for(PxU32 b = 0; b < live; b++) BlockStart[b + 1] += BlockStart[b];
+    std::vector<PxU32> fill(BlockStart.begin(), BlockStart.end() - 1);
+    BlockParticles.resize(total);
+    for(PxU32 i = 0; i < count; i++)
+        for(auto p = PairOffsets[i]; p < PairOffsets[i + 1]; p++)
+            BlockParticles[fill[PairBlocks[p]]++] = i;
+}
+
+void FluidSurface::polygonize(FluidSurfaceBlock& block, const PxU32* particles, PxU32 n, float* field, PxU32* edgeVertices) const {
+    auto& mc = marchingCubes();
+    auto cell = Desc.CellSize;
+    auto inv = 1.0f / cell;
+    auto iso = Desc.IsoLevel;
+    const PxI32 lastNode = (PxI32)FluidBlockCells;
+
+    // everything is evaluated at global node coordinates so nodes and vertices
+    // shared with neighboring blocks come out bit identical
+    PxI32 base[3];
+    for(PxU32 a = 0; a < 3; a++) base[a] = blockCoord(block.Key, a) * (PxI32)FluidBlockCells;
+    auto nodePosition = [&](PxU32 x, PxU32 y, PxU32 z) {
+        return PxVec3((float)(base[0] + (PxI32)x) * cell, (float)(base[1] + (PxI32)y) * cell, (float)(base[2] + (PxI32)z) * cell);
+    };
+
+    memset(field, 0, sizeof(float) * BlockNodeCount);
+    for(PxU32 k = 0; k < n; k++) {
+        auto p = particles[k];
+        auto& c = Centers[p];
+        auto& e = Extents[p];
+        auto& g = Kernels[p];
+
+        PxI32 lo[3], hi[3];
+        for(PxU32 a = 0; a < 3; a++) {
+            lo[a] = PxMax(0, (PxI32)PxCeil((c[a] - e[a]) * inv) - base[a]);
+            hi[a] = PxMin(lastNode, (PxI32)PxFloor((c[a] + e[a]) * inv) - base[a]);
+        }
+        for(auto z = lo[2]; z <= hi[2]; z++) {
+            for(auto y = lo[1]; y <= hi[1]; y++) {
+                auto f = field + nodeIndex((PxU32)lo[0], (PxU32)y, (PxU32)z);
+                for(auto x = lo[0]; x <= hi[0]; x++, f++) {
+                    auto q2 = (g * (nodePosition((PxU32)x, (PxU32)y, (PxU32)z) - c)).magnitudeSquared();
+                    if(q2 < 1.0f) {
+                        auto t = 1.0f - q2;
+                        *f += t * t * t;
+                    }
+                }
+            }
+        }
+    }
+
+    auto gradient = [&](PxU32 x, PxU32 y, PxU32 z) {
+        PxU32 c[3] = { x, y, z };
+        PxVec3 g;
+        for(PxU32 a = 0; a < 3; a++) {
+            PxU32 l[3] = { x, y, z }, h[3] = { x, y, z };
+            l[a] = c[a] > 0 ? c[a] - 1 : c[a];
+            h[a] = c[a] < FluidBlockCells ? c[a] + 1 : c[a];
+            g[a] = (field[nodeIndex(h[0], h[1], h[2])] - field[nodeIndex(l[0], l[1], l[2])]) / ((float)(h[a] - l[a]) * cell);
+        }
+        return g;
+    };
+
+    block.Vertices.clear();
+    block.Normals.clear();
+    block.Indices.clear();
+    for(PxU32 i = 0; i < 3 * BlockNodeCount; i++) edgeVertices[i] = NoVertex;
+
+    for(PxU32 z = 0; z < FluidBlockCells; z++) {
+        for(PxU32 y = 0; y < FluidBlockCells; y++) {
+            for(PxU32 x = 0; x < FluidBlockCells; x++) {
+                PxU32 mask = 0;
+                for(PxU32 c = 0; c < 8; c++) {
+                    if(field[nodeIndex(x + (c & 1), y + ((c >> 1) & 1), z + ((c >> 2) & 1))] >= iso) mask |= 1u << c;
+                }
+                if(mask == 0 || mask == 255) continue;
+
+                for(auto t = mc.Triangles[mask]; *t >= 0; t++) {
+                    auto a = mc.EdgeCorners[*t][0];
+                    auto b = mc.EdgeCorners[*t][1];
+                    auto axis = PxLowestSetBit((PxU32)(a ^ b));
+                    PxU32 ax = x + (a & 1), ay = y + ((a >> 1) & 1), az = z + ((a >> 2) & 1);
+                    PxU32 bx = x + (b & 1), by = y + ((b >> 1) & 1), bz = z + ((b >> 2) & 1);
+                    auto na = nodeIndex(ax, ay, az);
+                    auto& slot = edgeVertices[axis * BlockNodeCount + na];
+                    if(slot == NoVertex) {
+                        auto fa = field[na];
+                        auto fb = field[nodeIndex(bx, by, bz)];
+                        auto s = (iso - fa) / (fb - fa);
+                        auto pa = nodePosition(ax, ay, az);
+                        auto pb = nodePosition(bx, by, bz);
+                        auto g = gradient(ax, ay, az) * (1.0f - s) + gradient(bx, by, bz) * s;
+                        auto len = g.magnitude();
+                        slot = (PxU32)block.Vertices.size();
+                        block.Vertices.push_back(pa + (pb - pa) * s);
+                        block.Normals.push_back(len > 0.0f ? g * (-1.0f / len) : PxVec3(0.0f));
+                    }
+                    block.Indices.push_back(slot);
+                }
+            }
+        }
+    }
+}
+
+PxU32 FluidSurface::update(const PxVec4* positions, PxU32 count, PxCpuDispatcher* dispatcher) {
+    Centers.resize(count);
+    Kernels.resize(count);
+    Extents.resize(count);
+    BlockRange.resize(6 * count);
+
+    Neighbors.build(positions, count, dispatcher);
+    computeKernels(positions, count, dispatcher);
+    assignBlocks(count, dispatcher);
+
+    // a block is rebuilt only if the kernels overlapping it changed
+    auto nbBlocks = (PxU32)Blocks.size();
+    std::vector<PxU8> dirty(nbBlocks);
+    parallelFor(dispatcher, nbBlocks, 16, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 b = begin; b < end; b++) {
+            PxU64 h = 14695981039346656037ull;
+            for(auto k = BlockStart[b]; k < BlockStart[b + 1]; k++) {
+                auto p = BlockParticles[k];
+                h = hashFloats(h, &Centers[p].x, 3);
+                h = hashFloats(h, &Kernels[p].column0.x, 9);
+            }
+            auto& block = Blocks[b];
+            dirty[b] = !block.Valid || block.Checksum != h;
+            block.Checksum = h;
+        }
+    });
+
+    std::vector<PxU32> rebuild;
+    for(PxU32 b = 0; b < nbBlocks; b++) if(dirty[b]) rebuild.push_back(b);
+
+    parallelFor(dispatcher, (PxU32)rebuild.size(), 1, [&](PxU32 begin, PxU32 end) {
+        std::vector<float> field(BlockNodeCount);
+        std::vector<PxU32> edgeVertices(3 * BlockNodeCount);
+        for(PxU32 i = begin; i < end; i++) {
+            auto b = rebuild[i];
+            auto& block = Blocks[b];
+            polygonize(block, &BlockParticles[BlockStart[b]], BlockStart[b + 1] - BlockStart[b], field.data(), edgeVertices.data());
+            block.Valid = true;
+        }
+    });
+
+    VertexOffsets.resize(nbBlocks + 1);
+    IndexOffsets.resize(nbBlocks + 1);
+    VertexOffsets[0] = IndexOffsets[0] = 0;
+    for(PxU32 b = 0; b < nbBlocks; b++) {
+        VertexOffsets[b + 1] = VertexOffsets[b] + (PxU32)Blocks[b].Vertices.size();
+        IndexOffsets[b + 1] = IndexOffsets[b] + (PxU32)Blocks[b].Indices.size();
+    }
+    VertexCount = VertexOffsets[nbBlocks];
+    IndexCount = IndexOffsets[nbBlocks];
+    return (PxU32)rebuild.size();
+}
+
+void FluidSurface::copyMesh(PxVec3* vertices, PxVec3* normals, PxU32* indices, PxCpuDispatcher* dispatcher) const {
+    parallelFor(dispatcher, (PxU32)Blocks.size(), 16, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 b = begin; b < end; b++) {
+            auto& block = Blocks[b];
+            auto v = VertexOffsets[b];
+            std::copy(block.Vertices.begin(), block.Vertices.end(), vertices + v);
+            if(normals) std::copy(block.Normals.begin(), block.Normals.end(), normals + v);
+            auto out = indices + IndexOffsets[b];
+            for(auto i : block.Indices) *out++ = i + v;
+        }
+    });
+}
+
+
+DllExport(FluidSurface*) pxCreateFluidSurface(const PxFluidSurfaceDesc* desc) {
+    return new FluidSurface(*desc);
+}
+
+DllExport(void) pxDestroyFluidSurface(FluidSurface* surface) {
+    delete surface;
+}
+
+DllExport(PxU32) pxUpdateFluidSurface(FluidSurface* surface, const V4f* positions, PxU32 count) {
+    return surface->update((const PxVec4*)positions, count, sharedDispatcher());
+}
+
+DllExport(void) pxGetFluidSurfaceCounts(FluidSurface* surface, PxU32* vertexCount, PxU32* indexCount) {
+    *vertexCount = surface->VertexCount;
+    *indexCount = surface->IndexCount;
+}
+
+DllExport(void) pxGetFluidSurfaceMesh(FluidSurface* surface, V3f* vertices, V3f* normals, PxU32* indices) {
+    surface->copyMesh((PxVec3*)vertices, (PxVec3*)normals, indices, sharedDispatcher());
+}
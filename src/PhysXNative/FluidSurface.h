@@ -0,0 +1,82 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include "ParticleIndex.h"
+#include <unordered_map>
+#include <vector>
+
+typedef struct {
+    float ParticleRadius;       // kernels reach twice the radius
+    float CellSize;             // marching cubes resolution
+    float IsoLevel;             // 1 is the density at the center of an isolated particle
+    float Smoothing;            // blends kernel centers towards their neighborhood mean, 0..1
+    float MaxAnisotropy;        // largest ratio between kernel axes, 1 keeps kernels spherical
+    physx::PxU32 MinNeighbors;  // particles with fewer neighbors keep a spherical kernel
+} PxFluidSurfaceDesc;
+
+static const physx::PxU32 FluidBlockCells = 8;
+static const physx::PxU32 FluidBlockNodes = FluidBlockCells + 1;
+
+// Part of the surface produced by one block of the sparse grid. A block only
+// depends on the kernels overlapping it, so it keeps its mesh until one of
+// them changes.
+struct FluidSurfaceBlock {
+    physx::PxU64 Key;
+    physx::PxU64 Checksum;
+    physx::PxU32 Frame;
+    bool Valid;
+    std::vector<physx::PxVec3> Vertices;
+    std::vector<physx::PxVec3> Normals;
+    std::vector<physx::PxU32> Indices;
+};
+
+// Surface reconstruction from particle positions with anisotropic kernels (Yu
+// and Turk 2013). Kernels are splatted into a sparse grid of 8^3 cell blocks
+// that are polygonized by marching cubes in parallel. Works on any host-side
+// posInvMass array. Vertices on block faces are not shared between blocks.
+class FluidSurface {
+public:
+    explicit FluidSurface(const PxFluidSurfaceDesc& desc);
+
+    PxFluidSurfaceDesc Desc;
+    physx::PxU32 VertexCount;
+    physx::PxU32 IndexCount;
+
+    // returns the number of blocks that had to be rebuilt
+    physx::PxU32 update(const physx::PxVec4* positions, physx::PxU32 count, physx::PxCpuDispatcher* dispatcher);
+    // normals may be NULL, buffers must hold VertexCount and IndexCount elements
+    void copyMesh(physx::PxVec3* vertices, physx::PxVec3* normals, physx::PxU32* indices, physx::PxCpuDispatcher* dispatcher) const;
+
+private:
+    void computeKernels(const physx::PxVec4* positions, physx::PxU32 count, physx::PxCpuDispatcher* dispatcher);
+    void assignBlocks(physx::PxU32 count, physx::PxCpuDispatcher* dispatcher);
+    void polygonize(FluidSurfaceBlock& block, const physx::PxU32* particles, physx::PxU32 n, float* field, physx::PxU32* edgeVertices) const;
+
+    // per particle
+    std::vector<physx::PxVec3> Centers;
+    std::vector<physx::PxMat33> Kernels;    // maps offsets to the unit support sphere
+    std::vector<physx::PxVec3> Extents;
+    std::vector<physx::PxI32> BlockRange;   // min and max block coordinates
+
+    // neighbor grid with cell size 2 * ParticleRadius
+    ParticleIndex Neighbors;
+
+    // particles overlapping each block
+    std::vector<physx::PxU32> PairOffsets;
+    std::vector<physx::PxU64> PairKeys;
+    std::vector<physx::PxU32> PairBlocks;
+    std::vector<physx::PxU32> BlockStart;
+    std::vector<physx::PxU32> BlockParticles;
+
+    std::vector<FluidSurfaceBlock> Blocks;
+    std::unordered_map<physx::PxU64, physx::PxU32> BlockMap;
+    std::vector<physx::PxU32> VertexOffsets;
+    std::vector<physx::PxU32> IndexOffsets;
+    physx::PxU32 Frame;
+};
+
+DllExport(FluidSurface*) pxCreateFluidSurface(const PxFluidSurfaceDesc* desc);
+DllExport(void) pxDestroyFluidSurface(FluidSurface* surface);
+DllExport(physx::PxU32) pxUpdateFluidSurface(FluidSurface* surface, const V4f* positions, physx::PxU32 count);
+DllExport(void) pxGetFluidSurfaceCounts(FluidSurface* surface, physx::PxU32* vertexCount, physx::PxU32* indexCount);
+DllExport(void) pxGetFluidSurfaceMesh(FluidSurface* surface, V3f* vertices, V3f* normals, physx::PxU32* indices);
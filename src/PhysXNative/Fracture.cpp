@@ -0,0 +1,476 @@
+#include "Fracture.h"
+#include "MassCache.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace physx;
+
+typedef std::vector<std::vector<PxVec3>> FractureHull;
+
+static const PxU32 MaxCells = 64;
+static const float PlaneEpsilon = 1e-5f;
+
+bool FractureKey::operator==(const FractureKey& o) const {
+    return memcmp(this, &o, sizeof(FractureKey)) == 0;
+}
+
+size_t FractureKeyHash::operator()(const FractureKey& key) const {
+    // FNV-1a
+    auto bytes = (const unsigned char*)&key;
+    PxU64 h = 14695981039346656037ull;
+    for(size_t i = 0; i < sizeof(FractureKey); i++) {
+        h ^= bytes[i];
+        h *= 1099511628211ull;
+    }
+    return (size_t)h;
+}
+
+void FracturePieces::release() {
+    for(auto mesh : Meshes) mesh->release();
+    Meshes.clear();
+    Volumes.clear();
+}
+
+static void addFace(FractureHull& hull, const PxTransform& pose, const PxVec3* points, PxU32 count) {
+    std::vector<PxVec3> face(count);
+    for(PxU32 i = 0; i < count; i++) face[i] = pose.transform(points[i]);
+    hull.push_back(std::move(face));
+}
+
+// faces of the shape in its actor frame, false for other geometries
+static bool readHull(const PxShape* shape, FractureHull& hull, FractureKey& key) {
+    auto pose = shape->getLocalPose();
+    key.Geometry[0] = pose.p.x; key.Geometry[1] = pose.p.y; key.Geometry[2] = pose.p.z;
+    key.Geometry[3] = pose.q.x; key.Geometry[4] = pose.q.y; key.Geometry[5] = pose.q.z; key.Geometry[6] = pose.q.w;
+
+    auto& g = shape->getGeometry();
+    if(g.getType() == PxGeometryType::eBOX) {
+        auto e = static_cast<const PxBoxGeometry&>(g).halfExtents;
+        key.Geometry[7] = e.x; key.Geometry[8] = e.y; key.Geometry[9] = e.z;
+        for(PxU32 axis = 0; axis < 3; axis++) {
+            auto u = (axis + 1) % 3;
+            auto v = (axis + 2) % 3;
+            for(float side = -1.0f; side <= 1.0f; side += 2.0f) {
+                PxVec3 quad[4];
+                const float us[4] = { -1.0f, 1.0f, 1.0f, -1.0f };
+                const float vs[4] = { -1.0f, -1.0f, 1.0f, 1.0f };
+                for(PxU32 k = 0; k < 4; k++) {
+                    quad[k][axis] = side * e[axis];
+                    quad[k][u] = us[k] * e[u];
+                    quad[k][v] = vs[k] * e[v];
+                }
+                addFace(hull, pose, quad, 4);
+            }
+        }
+        return true;
+    }
+    if(g.getType() == PxGeometryType::eCONVEXMESH) {
+        auto& c = static_cast<const PxConvexMeshGeometry&>(g);
+        key.Mesh = (PxU64)(size_t)c.convexMesh;
+        key.Geometry[7] = c.scale.scale.x; key.Geometry[8] = c.scale.scale.y; key.Geometry[9] = c.scale.scale.z;
+        key.Geometry[10] = c.scale.rotation.x; key.Geometry[11] = c.scale.rotation.y;
+        key.Geometry[12] = c.scale.rotation.z; key.Geometry[13] = c.scale.rotation.w;
+
+        auto scale = c.scale.toMat33();
+        auto vertices = c.convexMesh->getVertices();
+        auto indices = c.convexMesh->getIndexBuffer();
+        std::vector<PxVec3> points;
+        for(PxU32 p = 0; p < c.convexMesh->getNbPolygons(); p++) {
+            PxHullPolygon polygon;
+            if(!c.convexMesh->getPolygonData(p, polygon)) continue;
+            points.resize(polygon.mNbVerts);
+            for(PxU32 k = 0; k < polygon.mNbVerts; k++) points[k] = scale * vertices[indices[polygon.mIndexBase + k]];
+            addFace(hull, pose, points.data(), polygon.mNbVerts);
+        }
+        return !hull.empty();
+    }
+    return false;
+}
+
+// keeps the part of the hull with n.x <= d for a unit n, the cut is closed with a cap face
+static void clipHull(const FractureHull& in, const PxVec3& n, float d, FractureHull& out, std::vector<PxVec3>& cap) {
+    out.clear();
+    cap.clear();
+    for(auto& face : in) {
+        std::vector<PxVec3> clipped;
+        auto m = face.size();
+        for(size_t i = 0; i < m; i++) {
+            auto& a = face[i];
+            auto& b = face[(i + 1) % m];
+            auto da = n.dot(a) - d;
+            auto db = n.dot(b) - d;
+            if(da <= PlaneEpsilon) clipped.push_back(a);
+            if(PxAbs(da) <= PlaneEpsilon) cap.push_back(a);
+            if((da < -PlaneEpsilon && db > PlaneEpsilon) || (da > PlaneEpsilon && db < -PlaneEpsilon)) {
+                auto p = a + (b - a) * (da / (da - db));
+                clipped.push_back(p);
+                cap.push_back(p);
+            }
+        }
+        if(clipped.size() >= 3) out.push_back(std::move(clipped));
+    }
+    if(cap.size() < 3) return;
+
+    // the cap points are convex, order them by angle around their center
+    PxVec3 center(0.0f);
+    for(auto& p : cap) center += p;
+    center *= 1.0f / (float)cap.size();
+    auto u = PxAbs(n.x) < 0.9f ? n.cross(PxVec3(1.0f, 0.0f, 0.0f)) : n.cross(PxVec3(0.0f, 1.0f, 0.0f));
+    u.normalize();
+    auto v = n.cross(u);
+    std::vector<std::pair<float, PxVec3>> sorted(cap.size());
+    for(size_t i = 0; i < cap.size(); i++) {
+        auto r = cap[i] - center;
+        sorted[i] = { atan2f(r.dot(v), r.dot(u)), cap[i] };
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const std::pair<float, PxVec3>& a, const std::pair<float, PxVec3>& b) { return a.first < b.first; });
+    std::vector<PxVec3> face(sorted.size());
+    for(size_t i = 0; i < sorted.size(); i++) face[i] = sorted[i].second;
+    out.push_back(std::move(face));
+}
+
+static float nextUnit(PxU32& state) {
+    // xorshift32
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return (float)(state & 0xFFFFFF) / 16777216.0f;
+}
+
+// seeds are scattered around the quantized impact, cells near it come out small
+static void makeSeeds(const FractureKey& key, std::vector<PxVec3>& seeds) {
+    auto step = key.Radius * 0.5f;
+    PxVec3 center((key.Cell[0] + 0.5f) * step, (key.Cell[1] + 0.5f) * step, (key.Cell[2] + 0.5f) * step);
+    PxU32 state = (key.Seed * 2654435761u) ^ 0x9E3779B9u;
+    if(state == 0) state = 1;
+    seeds.resize(key.CellCount);
+    for(auto& s : seeds) {
+        PxVec3 p;
+        do {
+            p = PxVec3(nextUnit(state), nextUnit(state), nextUnit(state)) * 2.0f - PxVec3(1.0f);
+        } while(p.magnitudeSquared() > 1.0f);
+        s = center + p * key.Radius;
+    }
+}
+
+static void cookCells(const PxTolerancesScale& scale, const FractureKey& key, const FractureHull& hull, FracturePieces& pieces) {
+    std::vector<PxVec3> seeds;
+    makeSeeds(key, seeds);
+
+    PxCookingParams params(scale);
+    FractureHull cell, next;
+    std::vector<PxVec3> cap, points;
+    for(PxU32 i = 0; i < (PxU32)seeds.size(); i++) {
+        // the Voronoi cell of seed i is the hull cut by the bisectors towards all other seeds
+        cell = hull;
+        for(PxU32 j = 0; j < (PxU32)seeds.size() && !cell.empty(); j++) {
+            auto n = seeds[j] - seeds[i];
+            if(i == j || n.normalize() < PlaneEpsilon) continue;
+            clipHull(cell, n, n.dot((seeds[i] + seeds[j]) * 0.5f), next, cap);
+            cell.swap(next);
+        }
+        if(cell.size() < 4) continue;
+
+        points.clear();
+        for(auto& face : cell) points.insert(points.end(), face.begin(), face.end());
+        PxConvexMeshDesc desc;
+        desc.points.count = (PxU32)points.size();
+        desc.points.stride = sizeof(PxVec3);
+        desc.points.data = points.data();
+        desc.flags = PxConvexFlag::eCOMPUTE_CONVEX;
+        auto mesh = PxCreateConvexMesh(params, desc);
+        if(!mesh) continue;
+
+        PxReal volume;
+        PxMat33 inertia;
+        PxVec3 com;
+        mesh->getMassInformation(volume, inertia, com);
+        if(volume <= 0.0f) {
+            mesh->release();
+            continue;
+        }
+        pieces.Meshes.push_back(mesh);
+        pieces.Volumes.push_back(volume);
+    }
+}
+
+FractureService::FractureService(PxSceneHandle* scene, PxU32 maxCached)
+    : Scene(scene), MaxCached(maxCached), Scale(scene->Physics->getTolerancesScale()), NextTicket(0), Running(0), Stop(false) {
+    Scene->Physics->registerDeletionListener(*this, PxDeletionEventFlag::eUSER_RELEASE, true);
+    Worker = std::thread([this]() { workerLoop(); });
+}
+
+// jobs and cache entries hold a reference to the mesh of their key, so its
+// address cannot be reused by another mesh while the key is around
+static void acquireSource(const FractureKey& key) {
+    if(key.Mesh) ((PxConvexMesh*)(size_t)key.Mesh)->acquireReference();
+}
+
+static void releaseSource(const FractureKey& key) {
+    if(key.Mesh) ((PxConvexMesh*)(size_t)key.Mesh)->release();
+}
+
+FractureService::~FractureService() {
+    Scene->Physics->unregisterDeletionListener(*this);
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Stop = true;
+    }
+    Wake.notify_all();
+    Worker.join();
+    for(auto& job : Jobs) releaseSource(job.Key);
+    for(auto& job : Finished) {
+        job.Pieces.release();
+        releaseSource(job.Key);
+    }
+    for(auto& job : Ready) {
+        job.Pieces.release();
+        releaseSource(job.Key);
+    }
+    for(auto& entry : Cache) {
+        entry.second.release();
+        releaseSource(entry.first);
+    }
+}
+
+void FractureService::watch(PxRigidDynamic* actor, PxU32 ticket) {
+    auto& tickets = Watched[actor];
+    if(tickets.empty()) {
+        const PxBase* observed = actor;
+        Scene->Physics->registerDeletionListenerObjects(*this, &observed, 1);
+    }
+    tickets.push_back(ticket);
+}
+
+void FractureService::unwatch(PxRigidDynamic* actor, PxU32 ticket) {
+    auto it = Watched.find(actor);
+    if(it == Watched.end()) return;
+    auto& tickets = it->second;
+    tickets.erase(std::remove(tickets.begin(), tickets.end(), ticket), tickets.end());
+    if(tickets.empty()) {
+        const PxBase* observed = actor;
+        Scene->Physics->unregisterDeletionListenerObjects(*this, &observed, 1);
+        Watched.erase(it);
+    }
+}
+
+// the jobs may be with the worker, they are recognized by ticket in apply
+void FractureService::onRelease(const PxBase* observed, void*, PxDeletionEventFlag::Enum) {
+    auto it = Watched.find(observed);
+    if(it == Watched.end()) return;
+    Orphaned.insert(it->second.begin(), it->second.end());
+    Watched.erase(it);
+}
+
+void FractureService::workerLoop() {
+    for(;;) {
+        FractureJob job;
+        {
+            std::unique_lock<std::mutex> lock(Mutex);
+            Wake.wait(lock, [this]() { return Stop || !Jobs.empty(); });
+            if(Stop) return;
+            job = std::move(Jobs.front());
+            Jobs.pop_front();
+            Running++;
+        }
+        cookCells(Scale, job.Key, job.Hull, job.Pieces);
+        job.Hull.clear();
+        {
+            std::lock_guard<std::mutex> lock(Mutex);
+            Finished.push_back(std::move(job));
+            Running--;
+        }
+    }
+}
+
+PxU32 FractureService::request(const PxFractureRequest& request) {
+    auto actor = request.Actor;
+    PxShape* shape;
+    if(!actor || actor->getNbShapes() != 1 || actor->getShapes(&shape, 1) != 1) return 0xFFFFFFFF;
+
+    FractureJob job;
+    memset(&job.Key, 0, sizeof(FractureKey));
+    if(!readHull(shape, job.Hull, job.Key)) return 0xFFFFFFFF;
+
+    PxBounds3 bounds = PxBounds3::empty();
+    for(auto& face : job.Hull) {
+        for(auto& p : face) bounds.include(p);
+    }
+    auto radius = request.Radius > 0.0f ? request.Radius : 0.5f * bounds.getDimensions().maxElement();
+    auto impact = actor->getGlobalPose().transformInv(toPxVec3(request.Point));
+    auto step = radius * 0.5f;
+    job.Key.Cell[0] = (PxI32)floorf(impact.x / step);
+    job.Key.Cell[1] = (PxI32)floorf(impact.y / step);
+    job.Key.Cell[2] = (PxI32)floorf(impact.z / step);
+    job.Key.CellCount = PxClamp(request.CellCount, 2u, MaxCells);
+    job.Key.Seed = request.Seed;
+    job.Key.Radius = radius;
+    job.Ticket = NextTicket++;
+    job.Actor = actor;
+    job.Cached = false;
+    acquireSource(job.Key);
+    watch(actor, job.Ticket);
+
+    auto cached = Cache.find(job.Key);
+    if(cached != Cache.end()) {
+        // the job keeps its own references, the entry may be dropped before apply
+        job.Cached = true;
+        job.Hull.clear();
+        job.Pieces = cached->second;
+        for(auto mesh : job.Pieces.Meshes) mesh->acquireReference();
+        Ready.push_back(std::move(job));
+        return Ready.back().Ticket;
+    }
+
+    auto ticket = job.Ticket;
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Jobs.push_back(std::move(job));
+    }
+    Wake.notify_one();
+    return ticket;
+}
+
+void FractureService::remember(const FractureKey& key, const FracturePieces& pieces) {
+    if(MaxCached == 0 || pieces.Meshes.empty() || Cache.count(key)) return;
+    while(Cache.size() >= MaxCached) {
+        auto oldest = CacheOrder.front();
+        Cache[oldest].release();
+        Cache.erase(oldest);
+        releaseSource(oldest);
+        CacheOrder.pop_front();
+    }
+    auto& entry = Cache[key];
+    entry = pieces;
+    for(auto mesh : entry.Meshes) mesh->acquireReference();
+    acquireSource(key);
+    CacheOrder.push_back(key);
+}
+
+PxU32 FractureService::apply(PxCpuDispatcher* dispatcher) {
+    Results.clear();
+    Pieces.clear();
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        for(auto& job : Finished) Ready.push_back(std::move(job));
+        Finished.clear();
+    }
+    if(Ready.empty()) return 0;
+
+    struct Parent {
+        PxVec3 LinearVelocity;
+        PxVec3 AngularVelocity;
+        PxVec3 Center;
+    };
+    std::vector<Parent> parents;
+    std::vector<PxU32> pieceParents;
+    std::vector<PxRigidBody*> bodies;
+    std::vector<float> densities;
+
+    for(auto& job : Ready) {
+        if(!job.Cached) remember(job.Key, job.Pieces);
+
+        PxFractureResult result = { job.Ticket, 0, (PxU32)Pieces.size(), job.Cached ? 1u : 0u, job.Actor };
+        auto actor = job.Actor;
+        if(Orphaned.erase(job.Ticket)) {
+            result.Original = actor = nullptr;
+        }
+        else unwatch(actor, job.Ticket);
+
+        PxShape* shape;
+        PxMaterial* material;
+        // a second request for the same body finds it already swapped
+        if(actor && actor->getScene() == Scene->Scene && actor->getShapes(&shape, 1) == 1 && shape->getMaterials(&material, 1) == 1) {
+            auto pose = actor->getGlobalPose();
+            auto filter = shape->getSimulationFilterData();
+            auto kinematic = actor->getRigidBodyFlags().isSet(PxRigidBodyFlag::eKINEMATIC);
+            Parent parent;
+            parent.LinearVelocity = kinematic ? PxVec3(0.0f) : actor->getLinearVelocity();
+            parent.AngularVelocity = kinematic ? PxVec3(0.0f) : actor->getAngularVelocity();
+            parent.Center = pose.transform(actor->getCMassLocalPose().p);
+
+            // a piece without its shape would have no mass, it is dropped
+            float volume = 0.0f;
+            for(PxU32 m = 0; m < job.Pieces.Meshes.size(); m++) {
+                auto piece = Scene->Physics->createRigidDynamic(pose);
+                if(!piece) continue;
+                auto pieceShape = PxRigidActorExt::createExclusiveShape(*piece, PxConvexMeshGeometry(job.Pieces.Meshes[m]), *material);
+                if(!pieceShape) {
+                    piece->release();
+                    continue;
+                }
+                pieceShape->setSimulationFilterData(filter);
+                Pieces.push_back(piece);
+                pieceParents.push_back((PxU32)parents.size());
+                bodies.push_back(piece);
+                volume += job.Pieces.Volumes[m];
+            }
+            result.PieceCount = (PxU32)Pieces.size() - result.FirstPiece;
+
+            // pieces share the body's mass by volume
+            auto density = volume > 0.0f ? actor->getMass() / volume : 1.0f;
+            densities.resize(bodies.size(), density);
+            parents.push_back(parent);
+            if(result.PieceCount) Scene->Scene->removeActor(*actor);
+        }
+        // the shapes hold their own references
+        job.Pieces.release();
+        releaseSource(job.Key);
+        Results.push_back(result);
+    }
+    Ready.clear();
+
+    massCache().updateMassAndInertia(dispatcher, (PxU32)bodies.size(), bodies.data(), densities.data());
+    for(PxU32 i = 0; i < (PxU32)Pieces.size(); i++) {
+        auto& parent = parents[pieceParents[i]];
+        auto piece = Pieces[i];
+        auto center = piece->getGlobalPose().transform(piece->getCMassLocalPose().p);
+        piece->setLinearVelocity(parent.LinearVelocity + parent.AngularVelocity.cross(center - parent.Center));
+        piece->setAngularVelocity(parent.AngularVelocity);
+    }
+    if(!Pieces.empty()) Scene->Scene->addActors((PxActor* const*)Pieces.data(), (PxU32)Pieces.size());
+    return (PxU32)Results.size();
+}
+
+PxU32 FractureService::pending() {
+    std::lock_guard<std::mutex> lock(Mutex);
+    return (PxU32)(Jobs.size() + Finished.size() + Running + Ready.size());
+}
+
+
+DllExport(FractureService*) pxCreateFractureService(PxSceneHandle* scene, PxU32 maxCached) {
+    return new FractureService(scene, maxCached);
+}
+
+DllExport(void) pxDestroyFractureService(FractureService* service) {
+    delete service;
+}
+
+DllExport(void) pxRequestFractures(FractureService* service, PxU32 count, const PxFractureRequest* requests, PxU32* tickets) {
+    for(PxU32 i = 0; i < count; i++) {
+        auto ticket = service->request(requests[i]);
+        if(tickets) tickets[i] = ticket;
+    }
+}
+
+DllExport(PxU32) pxApplyFractures(FractureService* service) {
+    return service->apply(sharedDispatcher());
+}
+
+DllExport(PxU32) pxGetAppliedFractures(FractureService* service, PxFractureResult* results, PxU32 maxResults) {
+    auto n = (PxU32)service->Results.size();
+    for(PxU32 i = 0; i < n && i < maxResults; i++) results[i] = service->Results[i];
+    return n;
+}
+
+DllExport(PxU32) pxGetFracturePieces(FractureService* service, PxRigidDynamic** pieces, PxU32 maxPieces) {
+    auto n = (PxU32)service->Pieces.size();
+    for(PxU32 i = 0; i < n && i < maxPieces; i++) pieces[i] = service->Pieces[i];
+    return n;
+}
+
+DllExport(PxU32) pxGetPendingFractureCount(FractureService* service) {
+    return service->pending();
+}
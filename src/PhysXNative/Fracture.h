@@ -0,0 +1,125 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+typedef struct {
+    physx::PxRigidDynamic* Actor;   // with a single box or convex mesh shape
+    V3d Point;                      // impact point in world space
+    float Radius;                   // spread of the cells around the impact, 0 uses half the hull size
+    physx::PxU32 CellCount;
+    physx::PxU32 Seed;
+    physx::PxU32 Reserved;
+} PxFractureRequest;
+
+typedef struct {
+    physx::PxU32 Ticket;
+    physx::PxU32 PieceCount;        // 0 if the actor was released or left the scene first, or no piece could be created
+    physx::PxU32 FirstPiece;        // into the pieces of pxGetFracturePieces
+    physx::PxU32 Cached;            // the pieces came from the cache
+    physx::PxRigidDynamic* Original;    // removed from the scene if it has pieces, not released, NULL if it was released
+} PxFractureResult;
+
+// Hull of the fractured shape in its actor frame and the quantized impact.
+// Requests with equal keys produce equal pieces.
+struct FractureKey {
+    physx::PxU64 Mesh;              // convex mesh, 0 for boxes, referenced while the key is held
+    float Geometry[14];             // shape local pose, mesh scale or box half extents
+    physx::PxI32 Cell[3];           // impact cell of size Radius / 2
+    physx::PxU32 CellCount;
+    physx::PxU32 Seed;
+    float Radius;
+
+    bool operator==(const FractureKey& o) const;
+};
+
+struct FractureKeyHash {
+    size_t operator()(const FractureKey& key) const;
+};
+
+// the service holds one reference to each mesh
+struct FracturePieces {
+    std::vector<physx::PxConvexMesh*> Meshes;
+    std::vector<float> Volumes;
+
+    void release();
+};
+
+struct FractureJob {
+    physx::PxU32 Ticket;
+    physx::PxRigidDynamic* Actor;
+    FractureKey Key;
+    bool Cached;
+    std::vector<std::vector<physx::PxVec3>> Hull;   // convex faces in the actor frame, cleared after cooking
+    FracturePieces Pieces;
+};
+
+// Fractures bodies at an impact point at runtime. Requests read the hull of
+// the body's shape, the Voronoi cells of seeds scattered around the impact are
+// clipped against it and cooked with PxCreateConvexMesh on a background
+// thread, so a fracture never stalls the step. apply swaps finished bodies
+// for their pieces between steps: pieces take the body's material, filter
+// data, velocity field and share its mass by volume. Cooked pieces are cached
+// by hull and quantized impact, an equal request later is served without
+// cooking. Releasing a body with a pending request drops the request, apply
+// reports its ticket without pieces.
+class FractureService : public physx::PxDeletionListener {
+public:
+    FractureService(PxSceneHandle* scene, physx::PxU32 maxCached);
+    ~FractureService();
+
+    PxSceneHandle* Scene;
+    physx::PxU32 MaxCached;
+
+    // results of the last apply
+    std::vector<PxFractureResult> Results;
+    std::vector<physx::PxRigidDynamic*> Pieces;
+
+    // returns the ticket, 0xFFFFFFFF for bodies without a single box or convex shape
+    physx::PxU32 request(const PxFractureRequest& request);
+    // between steps, returns the number of results
+    physx::PxU32 apply(physx::PxCpuDispatcher* dispatcher);
+    physx::PxU32 pending();
+
+    void onRelease(const physx::PxBase* observed, void* userData, physx::PxDeletionEventFlag::Enum deletionEvent) override;
+
+private:
+    void workerLoop();
+    void remember(const FractureKey& key, const FracturePieces& pieces);
+    void watch(physx::PxRigidDynamic* actor, physx::PxU32 ticket);
+    void unwatch(physx::PxRigidDynamic* actor, physx::PxU32 ticket);
+
+    physx::PxTolerancesScale Scale;
+    physx::PxU32 NextTicket;
+
+    // caller thread only
+    std::unordered_map<FractureKey, FracturePieces, FractureKeyHash> Cache;
+    std::deque<FractureKey> CacheOrder;
+    std::vector<FractureJob> Ready;
+    // tickets of pending requests by body, and tickets whose body was released
+    std::unordered_map<const physx::PxBase*, std::vector<physx::PxU32>> Watched;
+    std::unordered_set<physx::PxU32> Orphaned;
+
+    std::deque<FractureJob> Jobs;
+    std::vector<FractureJob> Finished;
+    physx::PxU32 Running;
+    std::mutex Mutex;
+    std::condition_variable Wake;
+    std::thread Worker;
+    bool Stop;
+};
+
+// maxCached hulls keep their pieces, the oldest is dropped first
+DllExport(FractureService*) pxCreateFractureService(PxSceneHandle* scene, physx::PxU32 maxCached);
+DllExport(void) pxDestroyFractureService(FractureService* service);
+DllExport(void) pxRequestFractures(FractureService* service, physx::PxU32 count, const PxFractureRequest* requests, physx::PxU32* tickets);
+DllExport(physx::PxU32) pxApplyFractures(FractureService* service);
+DllExport(physx::PxU32) pxGetAppliedFractures(FractureService* service, PxFractureResult* results, physx::PxU32 maxResults);
+DllExport(physx::PxU32) pxGetFracturePieces(FractureService* service, physx::PxRigidDynamic** pieces, physx::PxU32 maxPieces);
+DllExport(physx::PxU32) pxGetPendingFractureCount(FractureService* service);
@@ -0,0 +1,320 @@
+#include "InstanceExport.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace physx;
+
+static const PxU32 WriteGrain = 1024;
+static const PxU32 NoGroup = 0xFFFFFFFF;
+
+bool InstanceGeometryKey::operator==(const InstanceGeometryKey& o) const {
+    return memcmp(this, &o, sizeof(InstanceGeometryKey)) == 0;
+}
+
+size_t InstanceGeometryKeyHash::operator()(const InstanceGeometryKey& key) const {
+    // FNV-1a
+    auto bytes = (const unsigned char*)&key;
+    PxU64 h = 14695981039346656037ull;
+    for(size_t i = 0; i < sizeof(InstanceGeometryKey); i++) {
+        h ^= bytes[i];
+        h *= 1099511628211ull;
+    }
+    return (size_t)h;
+}
+
+static void writeScale(float* data, const PxMeshScale& s) {
+    data[0] = s.scale.x; data[1] = s.scale.y; data[2] = s.scale.z;
+    data[3] = s.rotation.x; data[4] = s.rotation.y; data[5] = s.rotation.z; data[6] = s.rotation.w;
+}
+
+static void makeKey(const PxGeometry& g, InstanceGeometryKey& key) {
+    memset(&key, 0, sizeof(InstanceGeometryKey));
+    key.Type = (PxU32)g.getType();
+    switch(g.getType()) {
+        case PxGeometryType::eSPHERE:
+            key.Data[0] = static_cast<const PxSphereGeometry&>(g).radius;
+            break;
+        case PxGeometryType::eBOX: {
+            auto& e = static_cast<const PxBoxGeometry&>(g).halfExtents;
+            key.Data[0] = e.x; key.Data[1] = e.y; key.Data[2] = e.z;
+            break;
+        }
+        case PxGeometryType::eCAPSULE: {
+            auto& c = static_cast<const PxCapsuleGeometry&>(g);
+            key.Data[0] = c.radius; key.Data[1] = c.halfHeight;
+            break;
+        }
+        case PxGeometryType::eCONVEXMESH: {
+            auto& c = static_cast<const PxConvexMeshGeometry&>(g);
+            key.Mesh = (PxU64)(size_t)c.convexMesh;
+            writeScale(key.Data, c.scale);
+            break;
+        }
+        case PxGeometryType::eTRIANGLEMESH: {
+            auto& t = static_cast<const PxTriangleMeshGeometry&>(g);
+            key.Mesh = (PxU64)(size_t)t.triangleMesh;
+            writeScale(key.Data, t.scale);
+            break;
+        }
+        case PxGeometryType::eHEIGHTFIELD: {
+            auto& h = static_cast<const PxHeightFieldGeometry&>(g);
+            key.Mesh = (PxU64)(size_t)h.heightField;
+            key.Data[0] = h.rowScale; key.Data[1] = h.heightScale; key.Data[2] = h.columnScale;
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static PxInstanceGroup makeGroupInfo(PxU32 id, const InstanceGeometryKey& key) {
+    PxInstanceGroup info;
+    memset(&info, 0, sizeof(PxInstanceGroup));
+    info.Id = id;
+    info.GeometryType = key.Type;
+    switch((PxGeometryType::Enum)key.Type) {
+        case PxGeometryType::eSPHERE:
+            info.Size = { key.Data[0], key.Data[0], key.Data[0] };
+            break;
+        case PxGeometryType::eCAPSULE:
+            info.Size = { key.Data[0], key.Data[1], 0.0 };
+            break;
+        default:
+            info.Size = { key.Data[0], key.Data[1], key.Data[2] };
+            break;
+    }
+    info.Mesh = (void*)(size_t)key.Mesh;
+    return info;
+}
+
+static PX_FORCE_INLINE void writeInstance(PxInstanceTransform& out, const PxTransform& pose) {
+#if PX_INSTANCE_LAYOUT == PX_INSTANCE_MAT3X4
+    PxMat33 r(pose.q);
+    for(PxU32 i = 0; i < 3; i++) {
+        out.M[i * 4 + 0] = r.column0[i];
+        out.M[i * 4 + 1] = r.column1[i];
+        out.M[i * 4 + 2] = r.column2[i];
+        out.M[i * 4 + 3] = pose.p[i];
+    }
+#elif PX_INSTANCE_LAYOUT == PX_INSTANCE_QUAT_TRANS
+    out.Rot[0] = pose.q.x; out.Rot[1] = pose.q.y; out.Rot[2] = pose.q.z; out.Rot[3] = pose.q.w;
+    out.Trans[0] = pose.p.x; out.Trans[1] = pose.p.y; out.Trans[2] = pose.p.z;
+    out.Pad = 0.0f;
+#else
+    out = toEuclidean3d(pose);
+#endif
+}
+
+InstanceExport::InstanceExport() : Physics(nullptr) {
+}
+
+InstanceExport::~InstanceExport() {
+    if(Physics) Physics->unregisterDeletionListener(*this);
+}
+
+void InstanceExport::track(const PxShape* shape, PxU32 group) {
+    auto inserted = ShapeMap.insert({ shape, group });
+    if(!inserted.second) {
+        inserted.first->second = group;
+        return;
+    }
+    if(!Physics) {
+        Physics = &PxGetPhysics();
+        Physics->registerDeletionListener(*this, PxDeletionEventFlag::eMEMORY_RELEASE, true);
+    }
+    const PxBase* observed = shape;
+    Physics->registerDeletionListenerObjects(*this, &observed, 1);
+}
+
+void InstanceExport::onRelease(const PxBase* observed, void*, PxDeletionEventFlag::Enum) {
+    auto it = ShapeMap.find(static_cast<const PxShape*>(observed));
+    if(it == ShapeMap.end()) return;
+    // a new shape at the same address must not pass for an unchanged member
+    if(it->second < Groups.size()) Groups[it->second].Members.clear();
+    ShapeMap.erase(it);
+}
+
+PxU32 InstanceExport::createGroup() {
+    InstanceGroupState g;
+    memset(&g.Info, 0, sizeof(PxInstanceGroup));
+    g.Info.Id = (PxU32)Groups.size();
+    g.Info.GeometryType = PxInstanceUserGroup;
+    g.Buffer = NULL;
+    g.Capacity = 0;
+    Groups.push_back(g);
+    return g.Info.Id;
+}
+
+void InstanceExport::assign(const PxShape* shape, PxU32 group) {
+    if(group >= Groups.size()) return;
+    track(shape, group);
+}
+
+void InstanceExport::forget(const PxShape* shape) {
+    if(!ShapeMap.erase(shape)) return;
+    const PxBase* observed = shape;
+    Physics->unregisterDeletionListenerObjects(*this, &observed, 1);
+}
+
+PxU32 InstanceExport::groupOf(const PxShape* shape) {
+    auto s = ShapeMap.find(shape);
+    if(s != ShapeMap.end()) return s->second;
+
+    InstanceGeometryKey key;
+    makeKey(shape->getGeometry(), key);
+    auto it = GeometryGroups.find(key);
+    PxU32 group;
+    if(it != GeometryGroups.end()) {
+        group = it->second;
+    } else {
+        group = (PxU32)Groups.size();
+        InstanceGroupState g;
+        g.Info = makeGroupInfo(group, key);
+        g.Buffer = NULL;
+        g.Capacity = 0;
+        Groups.push_back(g);
+        GeometryGroups[key] = group;
+    }
+    track(shape, group);
+    return group;
+}
+
+PxU32 InstanceExport::update(PxScene* scene, PxCpuDispatcher* dispatcher) {
+    auto nbActors = scene->getNbActors(PxActorTypeFlag::eRIGID_DYNAMIC);
+    Actors.resize(nbActors);
+    if(nbActors > 0) scene->getActors(PxActorTypeFlag::eRIGID_DYNAMIC, Actors.data(), nbActors);
+
+    ActorOffsets.resize(nbActors + 1);
+    ActorOffsets[0] = 0;
+    for(PxU32 a = 0; a < nbActors; a++) ActorOffsets[a + 1] = ActorOffsets[a] + static_cast<PxRigidActor*>(Actors[a])->getNbShapes();
+    auto nbShapes = ActorOffsets[nbActors];
+
+    Shapes.resize(nbShapes);
+    ShapeActors.resize(nbShapes);
+    parallelFor(dispatcher, nbActors, WriteGrain, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 a = begin; a < end; a++) {
+            auto actor = static_cast<PxRigidActor*>(Actors[a]);
+            auto o = ActorOffsets[a];
+            actor->getShapes(&Shapes[o], ActorOffsets[a + 1] - o);
+            for(auto i = o; i < ActorOffsets[a + 1]; i++) ShapeActors[i] = a;
+        }
+    });
+
+    // group lookup may create groups, so it stays serial; shapes hidden from
+    // visualization are not exported
+    ShapeGroups.resize(nbShapes);
+    for(PxU32 i = 0; i < nbShapes; i++) {
+        ShapeGroups[i] = (Shapes[i]->getFlags() & PxShapeFlag::eVISUALIZATION) ? groupOf(Shapes[i]) : NoGroup;
+    }
+
+    // counting sort of the instances by group
+    auto nbGroups = (PxU32)Groups.size();
+    GroupStart.assign(nbGroups + 1, 0);
+    GroupAwake.assign(nbGroups, 0);
+    for(PxU32 i = 0; i < nbShapes; i++) {
+        auto g = ShapeGroups[i];
+        if(g == NoGroup) continue;
+        GroupStart[g + 1]++;
+        auto body = static_cast<PxRigidDynamic*>(Actors[ShapeActors[i]]);
+        if(!body->isSleeping()) GroupAwake[g] = 1;
+    }
+    for(PxU32 g = 0; g < nbGroups; g++) GroupStart[g + 1] += GroupStart[g];
+    auto nbInstances = GroupStart[nbGroups];
+
+    SortedShapes.resize(nbInstances);
+    SortedActors.resize(nbInstances);
+    SortedGroups.resize(nbInstances);
+    std::vector<PxU32> cursor(GroupStart.begin(), GroupStart.end() - 1);
+    for(PxU32 i = 0; i < nbShapes; i++) {
+        auto g = ShapeGroups[i];
+        if(g == NoGroup) continue;
+        auto o = cursor[g]++;
+        SortedShapes[o] = Shapes[i];
+        SortedActors[o] = static_cast<PxRigidActor*>(Actors[ShapeActors[i]]);
+        SortedGroups[o] = g;
+    }
+
+    GroupWrite.assign(nbGroups, 0);
+    for(PxU32 g = 0; g < nbGroups; g++) {
+        auto& group = Groups[g];
+        auto begin = SortedShapes.begin() + GroupStart[g];
+        auto end = SortedShapes.begin() + GroupStart[g + 1];
+        group.Info.Count = GroupStart[g + 1] - GroupStart[g];
+        group.Info.Written = 0;
+        if(!group.Buffer || group.Capacity < group.Info.Count) {
+            group.Members.clear();
+            continue;
+        }
+
+        auto same = group.Members.size() == group.Info.Count && std::equal(begin, end, group.Members.begin());
+        if(same && !GroupAwake[g]) continue;
+        if(!same) group.Members.assign(begin, end);
+        group.Info.Written = 1;
+        GroupWrite[g] = 1;
+    }
+
+    parallelFor(dispatcher, nbInstances, WriteGrain, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 k = begin; k < end; k++) {
+            auto g = SortedGroups[k];
+            if(!GroupWrite[g]) continue;
+            auto& group = Groups[g];
+            auto pose = SortedActors[k]->getGlobalPose() * SortedShapes[k]->getLocalPose();
+            writeInstance(group.Buffer[k - GroupStart[g]], pose);
+        }
+    });
+
+    return nbGroups;
+}
+
+
+DllExport(PxU32) pxGetInstanceLayout(PxU32* transformSize) {
+    if(transformSize) *transformSize = (PxU32)sizeof(PxInstanceTransform);
+    return PX_INSTANCE_LAYOUT;
+}
+
+DllExport(InstanceExport*) pxCreateInstanceExport() {
+    return new InstanceExport();
+}
+
+DllExport(void) pxDestroyInstanceExport(InstanceExport* exp) {
+    delete exp;
+}
+
+DllExport(PxU32) pxCreateInstanceGroup(InstanceExport* exp) {
+    return exp->createGroup();
+}
+
+DllExport(void) pxAssignInstanceGroup(InstanceExport* exp, PxShape* shape, PxU32 group) {
+    exp->assign(shape, group);
+}
+
+DllExport(void) pxAssignInstanceGroupOfActor(InstanceExport* exp, PxRigidActor* actor, PxU32 group) {
+    auto n = actor->getNbShapes();
+    std::vector<PxShape*> shapes(n);
+    actor->getShapes(shapes.data(), n);
+    for(auto s : shapes) exp->assign(s, group);
+}
+
+DllExport(void) pxForgetInstanceShape(InstanceExport* exp, PxShape* shape) {
+    exp->forget(shape);
+}
+
+DllExport(void) pxSetInstanceBuffer(InstanceExport* exp, PxU32 group, PxInstanceTransform* buffer, PxU32 capacity) {
+    if(group >= exp->Groups.size()) return;
+    auto& g = exp->Groups[group];
+    g.Buffer = buffer;
+    g.Capacity = capacity;
+    // a new buffer has never seen the current transforms
+    g.Members.clear();
+}
+
+DllExport(PxU32) pxUpdateInstances(InstanceExport* exp, PxSceneHandle* scene) {
+    return exp->update(scene->Scene, sharedDispatcher());
+}
+
+DllExport(PxU32) pxGetInstanceGroups(InstanceExport* exp, PxInstanceGroup* groups, PxU32 maxGroups) {
+    auto n = PxMin(maxGroups, (PxU32)exp->Groups.size());
+    for(PxU32 g = 0; g < n; g++) groups[g] = exp->Groups[g].Info;
+    return (PxU32)exp->Groups.size();
+}
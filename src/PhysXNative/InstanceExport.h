@@ -0,0 +1,122 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include <unordered_map>
+#include <vector>
+
+// Layout of exported instance transforms, selected at compile time (cmake -DPX_INSTANCE_LAYOUT=..).
+#define PX_INSTANCE_MAT3X4 1        // float 3x4 row-major matrix (rotation | translation)
+#define PX_INSTANCE_QUAT_TRANS 2    // float quaternion (xyzw) and translation, padded to 32 bytes
+#define PX_INSTANCE_EUCLIDEAN3D 3   // Euclidean3d with doubles
+
+#ifndef PX_INSTANCE_LAYOUT
+#define PX_INSTANCE_LAYOUT PX_INSTANCE_MAT3X4
+#endif
+
+#if PX_INSTANCE_LAYOUT == PX_INSTANCE_MAT3X4
+typedef struct {
+    float M[12];
+} PxInstanceTransform;
+#elif PX_INSTANCE_LAYOUT == PX_INSTANCE_QUAT_TRANS
+typedef struct {
+    float Rot[4];
+    float Trans[3];
+    float Pad;
+} PxInstanceTransform;
+#elif PX_INSTANCE_LAYOUT == PX_INSTANCE_EUCLIDEAN3D
+typedef Euclidean3d PxInstanceTransform;
+#else
+#error "unknown PX_INSTANCE_LAYOUT"
+#endif
+
+typedef struct {
+    physx::PxU32 Id;
+    physx::PxU32 GeometryType;  // PxGeometryType, 0xFFFFFFFF for user defined groups
+    V3d Size;                   // box half extents, sphere radius, capsule radius and half height, mesh scale
+    void* Mesh;                 // convex or triangle mesh of the group, NULL for primitives
+    physx::PxU32 Count;
+    physx::PxU32 Written;       // 0 if the group was asleep and unchanged, or its buffer was too small
+} PxInstanceGroup;
+
+static const physx::PxU32 PxInstanceUserGroup = 0xFFFFFFFF;
+
+// Geometry of one instance group, local shape poses are part of the transforms.
+struct InstanceGeometryKey {
+    physx::PxU64 Mesh;
+    physx::PxU32 Type;
+    float Data[7];
+
+    bool operator==(const InstanceGeometryKey& o) const;
+};
+
+struct InstanceGeometryKeyHash {
+    size_t operator()(const InstanceGeometryKey& key) const;
+};
+
+struct InstanceGroupState {
+    PxInstanceGroup Info;
+    PxInstanceTransform* Buffer;
+    physx::PxU32 Capacity;
+    // members of the last written update, an unchanged sleeping group is not written again
+    std::vector<const physx::PxShape*> Members;
+};
+
+// Exports one transform per shape of every dynamic body, grouped so that each
+// group can be drawn with a single instanced call. Groups are identified by
+// geometry, or by a user group assigned to a shape. Shapes are cached by
+// pointer and dropped from the cache when their memory is released, so a
+// reused address starts over. Transforms go straight into caller buffers (e.g.
+// mapped upload buffers), a group whose bodies all sleep is not written again
+// while its members and its buffer stay the same.
+class InstanceExport : public physx::PxDeletionListener {
+public:
+    std::vector<InstanceGroupState> Groups;
+
+    InstanceExport();
+    ~InstanceExport();
+
+    physx::PxU32 createGroup();
+    void assign(const physx::PxShape* shape, physx::PxU32 group);
+    void forget(const physx::PxShape* shape);
+
+    // returns the number of groups
+    physx::PxU32 update(physx::PxScene* scene, physx::PxCpuDispatcher* dispatcher);
+
+    void onRelease(const physx::PxBase* observed, void* userData, physx::PxDeletionEventFlag::Enum deletionEvent) override;
+
+private:
+    physx::PxU32 groupOf(const physx::PxShape* shape);
+    void track(const physx::PxShape* shape, physx::PxU32 group);
+
+    // bound on the first tracked shape, the export is created without a scene;
+    // it has to be destroyed before this PxPhysics is released
+    physx::PxPhysics* Physics;
+
+    std::unordered_map<InstanceGeometryKey, physx::PxU32, InstanceGeometryKeyHash> GeometryGroups;
+    std::unordered_map<const physx::PxShape*, physx::PxU32> ShapeMap;
+
+    std::vector<physx::PxActor*> Actors;
+    std::vector<physx::PxU32> ActorOffsets;
+    std::vector<physx::PxShape*> Shapes;
+    std::vector<physx::PxU32> ShapeActors;
+    std::vector<physx::PxU32> ShapeGroups;
+    std::vector<physx::PxU32> GroupStart;
+    std::vector<physx::PxU8> GroupAwake;
+    std::vector<physx::PxU8> GroupWrite;
+
+    // instances sorted by group
+    std::vector<const physx::PxShape*> SortedShapes;
+    std::vector<const physx::PxRigidActor*> SortedActors;
+    std::vector<physx::PxU32> SortedGroups;
+};
+
+DllExport(physx::PxU32) pxGetInstanceLayout(physx::PxU32* transformSize);
+DllExport(InstanceExport*) pxCreateInstanceExport();
+DllExport(void) pxDestroyInstanceExport(InstanceExport* exp);
+DllExport(physx::PxU32) pxCreateInstanceGroup(InstanceExport* exp);
+DllExport(void) pxAssignInstanceGroup(InstanceExport* exp, physx::PxShape* shape, physx::PxU32 group);
+DllExport(void) pxAssignInstanceGroupOfActor(InstanceExport* exp, physx::PxRigidActor* actor, physx::PxU32 group);
+DllExport(void) pxForgetInstanceShape(InstanceExport* exp, physx::PxShape* shape);
+DllExport(void) pxSetInstanceBuffer(InstanceExport* exp, physx::PxU32 group, PxInstanceTransform* buffer, physx::PxU32 capacity);
+DllExport(physx::PxU32) pxUpdateInstances(InstanceExport* exp, PxSceneHandle* scene);
+DllExport(physx::PxU32) pxGetInstanceGroups(InstanceExport* exp, PxInstanceGroup* groups, physx::PxU32 maxGroups);
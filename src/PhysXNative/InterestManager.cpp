@@ -0,0 +1,148 @@
+#include "InterestManager.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace physx;
+
+static const PxU32 GatherGrain = 4096;
+
+static bool handleLess(const PxBodyHandle& a, const PxBodyHandle& b) {
+    return a.Index < b.Index || (a.Index == b.Index && a.Generation < b.Generation);
+}
+
+InterestManager::InterestManager(float cellSize) : Pass(0), Index(cellSize) {}
+
+PxU32 InterestManager::addObserver(const PxObserverDesc& desc) {
+    PxU32 id;
+    if(!FreeObservers.empty()) {
+        id = FreeObservers.back();
+        FreeObservers.pop_back();
+    }
+    else {
+        id = (PxU32)Observers.size();
+        Observers.emplace_back();
+    }
+    auto& o = Observers[id];
+    o.Desc = desc;
+    o.Active = true;
+    o.Updated = false;
+    // spread observers with the same interval over the passes
+    o.Phase = id;
+    o.Relevant.clear();
+    o.Previous.clear();
+    o.Enter.clear();
+    o.Stay.clear();
+    o.Leave.clear();
+    return id;
+}
+
+void InterestManager::removeObserver(PxU32 observer) {
+    if(observer >= Observers.size() || !Observers[observer].Active) return;
+    Observers[observer].Active = false;
+    FreeObservers.push_back(observer);
+}
+
+void InterestManager::setObserver(PxU32 observer, const PxObserverDesc& desc) {
+    if(observer >= Observers.size() || !Observers[observer].Active) return;
+    Observers[observer].Desc = desc;
+}
+
+void InterestManager::update(const BodyTable& table, PxCpuDispatcher* dispatcher) {
+    auto pass = Pass++;
+    auto n = table.size();
+    Positions.resize(n);
+    parallelFor(dispatcher, n, GatherGrain, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 i = begin; i < end; i++) Positions[i] = PxVec4(table.Poses[i].p, 0.0f);
+    });
+    Index.build(Positions.data(), n, dispatcher);
+
+    parallelFor(dispatcher, (PxU32)Observers.size(), 1, [&](PxU32 begin, PxU32 end) {
+        std::vector<PxU32> buckets;
+        for(auto id = begin; id < end; id++) {
+            auto& o = Observers[id];
+            auto interval = PxMax(o.Desc.UpdateInterval, 1u);
+            o.Updated = o.Active && (pass + o.Phase) % interval == 0;
+            if(!o.Updated) continue;
+
+            PxVec4 planes[6];
+            auto frustum = o.Desc.Type == PxObserverFrustum;
+            if(frustum) {
+                for(PxU32 p = 0; p < 6; p++) {
+                    auto& v = o.Desc.Planes[p];
+                    planes[p] = PxVec4((float)v.X, (float)v.Y, (float)v.Z, (float)v.W);
+                }
+            }
+
+            o.Previous.swap(o.Relevant);
+            o.Relevant.clear();
+            Index.forEachInRadius(toPxVec3(o.Desc.Position), (float)o.Desc.Radius, buckets, [&](PxU32 i, float) {
+                if(frustum) {
+                    auto& p = Positions[i];
+                    for(PxU32 k = 0; k < 6; k++) {
+                        if(planes[k].x * p.x + planes[k].y * p.y + planes[k].z * p.z + planes[k].w < 0.0f) return;
+                    }
+                }
+                o.Relevant.push_back(table.handleOf(i));
+            });
+            std::sort(o.Relevant.begin(), o.Relevant.end(), handleLess);
+
+            // both sets are sorted, one merge yields all three lists
+            o.Enter.clear();
+            o.Stay.clear();
+            o.Leave.clear();
+            size_t a = 0, b = 0;
+            while(a < o.Relevant.size() || b < o.Previous.size()) {
+                if(b == o.Previous.size() || (a < o.Relevant.size() && handleLess(o.Relevant[a], o.Previous[b]))) o.Enter.push_back(o.Relevant[a++]);
+                else if(a == o.Relevant.size() || handleLess(o.Previous[b], o.Relevant[a])) o.Leave.push_back(o.Previous[b++]);
+                else {
+                    o.Stay.push_back(o.Relevant[a]);
+                    a++;
+                    b++;
+                }
+            }
+        }
+    });
+}
+
+
+DllExport(InterestManager*) pxCreateInterestManager(float cellSize) {
+    return new InterestManager(cellSize);
+}
+
+DllExport(void) pxDestroyInterestManager(InterestManager* manager) {
+    delete manager;
+}
+
+DllExport(PxU32) pxAddObserver(InterestManager* manager, const PxObserverDesc* desc) {
+    return manager->addObserver(*desc);
+}
+
+DllExport(void) pxRemoveObserver(InterestManager* manager, PxU32 observer) {
+    manager->removeObserver(observer);
+}
+
+DllExport(void) pxSetObserver(InterestManager* manager, PxU32 observer, const PxObserverDesc* desc) {
+    manager->setObserver(observer, *desc);
+}
+
+DllExport(void) pxUpdateInterest(InterestManager* manager, BodyTable* table) {
+    manager->update(*table, sharedDispatcher());
+}
+
+DllExport(int) pxGetInterestCounts(InterestManager* manager, PxU32 observer, PxU32* enter, PxU32* stay, PxU32* leave) {
+    if(observer >= manager->Observers.size()) return 0;
+    auto& o = manager->Observers[observer];
+    if(enter) *enter = (PxU32)o.Enter.size();
+    if(stay) *stay = (PxU32)o.Stay.size();
+    if(leave) *leave = (PxU32)o.Leave.size();
+    return o.Updated ? 1 : 0;
+}
+
+DllExport(void) pxGetInterestSets(InterestManager* manager, PxU32 observer, PxBodyHandle* enter, PxBodyHandle* stay, PxBodyHandle* leave) {
+    if(observer >= manager->Observers.size()) return;
+    auto& o = manager->Observers[observer];
+    if(enter && !o.Enter.empty()) memcpy(enter, o.Enter.data(), o.Enter.size() * sizeof(PxBodyHandle));
+    if(stay && !o.Stay.empty()) memcpy(stay, o.Stay.data(), o.Stay.size() * sizeof(PxBodyHandle));
+    if(leave && !o.Leave.empty()) memcpy(leave, o.Leave.data(), o.Leave.size() * sizeof(PxBodyHandle));
+}
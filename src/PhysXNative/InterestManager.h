@@ -0,0 +1,65 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include "BodyTable.h"
+#include "ParticleIndex.h"
+#include <vector>
+
+enum PxObserverType {
+    PxObserverSphere = 0,
+    PxObserverFrustum = 1   // sphere of Radius clipped by the frustum planes
+};
+
+typedef struct {
+    physx::PxU32 Type;
+    physx::PxU32 UpdateInterval;    // passes between updates, 0 and 1 update every pass
+    V3d Position;
+    double Radius;
+    V4d Planes[6];                  // frustum planes (normal, distance), inside where dot(n, p) + d >= 0
+} PxObserverDesc;
+
+struct InterestObserver {
+    PxObserverDesc Desc;
+    bool Active;
+    bool Updated;   // sets are from the last pass
+    physx::PxU32 Phase;
+    std::vector<PxBodyHandle> Relevant;    // sorted by slot
+    std::vector<PxBodyHandle> Previous;
+    std::vector<PxBodyHandle> Enter;
+    std::vector<PxBodyHandle> Stay;
+    std::vector<PxBodyHandle> Leave;
+};
+
+// Relevancy sets for many observers. A pass indexes all bodies of a table
+// once and then queries every observer that is due in parallel, each one
+// diffing its new relevant set against the previous one into enter, stay and
+// leave lists. Bodies are relevant when their center is inside the observer
+// volume.
+class InterestManager {
+public:
+    explicit InterestManager(float cellSize);
+
+    std::vector<InterestObserver> Observers;
+    physx::PxU64 Pass;
+
+    physx::PxU32 addObserver(const PxObserverDesc& desc);
+    void removeObserver(physx::PxU32 observer);
+    void setObserver(physx::PxU32 observer, const PxObserverDesc& desc);
+
+    void update(const BodyTable& table, physx::PxCpuDispatcher* dispatcher);
+
+private:
+    ParticleIndex Index;
+    std::vector<physx::PxVec4> Positions;
+    std::vector<physx::PxU32> FreeObservers;
+};
+
+DllExport(InterestManager*) pxCreateInterestManager(float cellSize);
+DllExport(void) pxDestroyInterestManager(InterestManager* manager);
+DllExport(physx::PxU32) pxAddObserver(InterestManager* manager, const PxObserverDesc* desc);
+DllExport(void) pxRemoveObserver(InterestManager* manager, physx::PxU32 observer);
+DllExport(void) pxSetObserver(InterestManager* manager, physx::PxU32 observer, const PxObserverDesc* desc);
+DllExport(void) pxUpdateInterest(InterestManager* manager, BodyTable* table);
+// returns 0 if the observer was not updated by the last pass
+DllExport(int) pxGetInterestCounts(InterestManager* manager, physx::PxU32 observer, physx::PxU32* enter, physx::PxU32* stay, physx::PxU32* leave);
+DllExport(void) pxGetInterestSets(InterestManager* manager, physx::PxU32 observer, PxBodyHandle* enter, PxBodyHandle* stay, PxBodyHandle* leave);
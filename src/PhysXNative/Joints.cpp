@@ -0,0 +1,159 @@
+#include "Joints.h"
+#include "SceneEvents.h"
+
+using namespace physx;
+
+static PxJoint* createFixed(PxPhysics& physics, const PxJointDesc& d) {
+    return PxFixedJointCreate(physics, d.Actor0, toPxTransform(d.Frame0), d.Actor1, toPxTransform(d.Frame1));
+}
+
+static PxJoint* createRevolute(PxPhysics& physics, const PxJointDesc& d) {
+    auto joint = PxRevoluteJointCreate(physics, d.Actor0, toPxTransform(d.Frame0), d.Actor1, toPxTransform(d.Frame1));
+    if(!joint) return nullptr;
+    if(d.Lower < d.Upper) {
+        joint->setLimit(PxJointAngularLimitPair(d.Lower, d.Upper, PxSpring(d.LimitStiffness, d.LimitDamping)));
+        joint->setRevoluteJointFlag(PxRevoluteJointFlag::eLIMIT_ENABLED, true);
+    }
+    if(d.DriveForceLimit > 0.0f) {
+        joint->setDriveVelocity(d.DriveVelocity);
+        joint->setDriveForceLimit(d.DriveForceLimit);
+        joint->setRevoluteJointFlag(PxRevoluteJointFlag::eDRIVE_ENABLED, true);
+    }
+    return joint;
+}
+
+static PxJoint* createSpherical(PxPhysics& physics, const PxJointDesc& d) {
+    auto joint = PxSphericalJointCreate(physics, d.Actor0, toPxTransform(d.Frame0), d.Actor1, toPxTransform(d.Frame1));
+    if(!joint) return nullptr;
+    if(d.Swing1 > 0.0f && d.Swing2 > 0.0f) {
+        joint->setLimitCone(PxJointLimitCone(d.Swing1, d.Swing2, PxSpring(d.LimitStiffness, d.LimitDamping)));
+        joint->setSphericalJointFlag(PxSphericalJointFlag::eLIMIT_ENABLED, true);
+    }
+    return joint;
+}
+
+static PxJoint* createDistance(PxPhysics& physics, const PxJointDesc& d) {
+    auto joint = PxDistanceJointCreate(physics, d.Actor0, toPxTransform(d.Frame0), d.Actor1, toPxTransform(d.Frame1));
+    if(!joint) return nullptr;
+    joint->setMinDistance(PxMax(d.Lower, 0.0f));
+    joint->setDistanceJointFlag(PxDistanceJointFlag::eMIN_DISTANCE_ENABLED, d.Lower > 0.0f);
+    if(d.Upper > 0.0f) {
+        joint->setMaxDistance(d.Upper);
+        joint->setDistanceJointFlag(PxDistanceJointFlag::eMAX_DISTANCE_ENABLED, true);
+    }
+    if(d.DriveStiffness > 0.0f) {
+        joint->setStiffness(d.DriveStiffness);
+        joint->setDamping(d.DriveDamping);
+        joint->setDistanceJointFlag(PxDistanceJointFlag::eSPRING_ENABLED, true);
+    }
+    return joint;
+}
+
+static PxJoint* createD6(PxPhysics& physics, const PxJointDesc& d) {
+    auto joint = PxD6JointCreate(physics, d.Actor0, toPxTransform(d.Frame0), d.Actor1, toPxTransform(d.Frame1));
+    if(!joint) return nullptr;
+    for(PxU32 a = 0; a < PxD6Axis::eCOUNT; a++) {
+        auto motion = (d.D6Motion >> (2 * a)) & 3;
+        joint->setMotion((PxD6Axis::Enum)a, (PxD6Motion::Enum)PxMin(motion, (PxU32)PxD6Motion::eFREE));
+    }
+    PxSpring spring(d.LimitStiffness, d.LimitDamping);
+    if(d.LinearLimit > 0.0f) joint->setDistanceLimit(PxJointLinearLimit(d.LinearLimit, spring));
+    if(d.Lower < d.Upper) joint->setTwistLimit(PxJointAngularLimitPair(d.Lower, d.Upper, spring));
+    if(d.Swing1 > 0.0f && d.Swing2 > 0.0f) joint->setSwingLimit(PxJointLimitCone(d.Swing1, d.Swing2, spring));
+    if(d.DriveStiffness > 0.0f || d.DriveDamping > 0.0f) {
+        auto forceLimit = d.DriveForceLimit > 0.0f ? d.DriveForceLimit : PX_MAX_F32;
+        joint->setDrive(PxD6Drive::eSLERP, PxD6JointDrive(d.DriveStiffness, d.DriveDamping, forceLimit));
+    }
+    return joint;
+}
+
+JointManager::JointManager(PxSceneHandle* scene) : Scene(scene) {
+    sceneEventsOf(scene);
+}
+
+JointManager::~JointManager() {
+    for(PxU32 id = 0; id < (PxU32)Joints.size(); id++) release(id);
+}
+
+PxU32 JointManager::create(const PxJointDesc& desc) {
+    auto& physics = *Scene->Physics;
+    PxJoint* joint;
+    switch(desc.Type) {
+        case PxJointFixed: joint = createFixed(physics, desc); break;
+        case PxJointD6: joint = createD6(physics, desc); break;
+        case PxJointRevolute: joint = createRevolute(physics, desc); break;
+        case PxJointDistance: joint = createDistance(physics, desc); break;
+        case PxJointSpherical: joint = createSpherical(physics, desc); break;
+        default: joint = nullptr; break;
+    }
+    if(!joint) return 0xFFFFFFFF;
+
+    joint->setBreakForce(desc.BreakForce > 0.0f ? desc.BreakForce : PX_MAX_F32, desc.BreakTorque > 0.0f ? desc.BreakTorque : PX_MAX_F32);
+    joint->setConstraintFlag(PxConstraintFlag::eCOLLISION_ENABLED, desc.CollideConnected != 0);
+
+    PxU32 id;
+    if(FreeIds.empty()) {
+        id = (PxU32)Joints.size();
+        Joints.push_back(joint);
+        Types.push_back(desc.Type);
+        UserData.push_back(desc.UserData);
+    }
+    else {
+        id = FreeIds.back();
+        FreeIds.pop_back();
+        Joints[id] = joint;
+        Types[id] = desc.Type;
+        UserData[id] = desc.UserData;
+    }
+    Index[joint] = id;
+    return id;
+}
+
+void JointManager::release(PxU32 id) {
+    auto joint = get(id);
+    if(!joint) return;
+    Index.erase(joint);
+    joint->release();
+    Joints[id] = nullptr;
+    FreeIds.push_back(id);
+}
+
+PxU32 JointManager::broken(PxBrokenJoint* joints, PxU32 maxJoints) const {
+    if(!Scene->Events) return 0;
+    PxU32 count = 0;
+    for(auto joint : Scene->Events->BrokenJoints) {
+        auto it = Index.find(joint);
+        if(it == Index.end()) continue;
+        if(joints && count < maxJoints) joints[count] = { it->second, Types[it->second], UserData[it->second] };
+        count++;
+    }
+    return count;
+}
+
+
+DllExport(JointManager*) pxCreateJointManager(PxSceneHandle* scene) {
+    return new JointManager(scene);
+}
+
+DllExport(void) pxDestroyJointManager(JointManager* manager) {
+    delete manager;
+}
+
+DllExport(void) pxCreateJointsBatch(JointManager* manager, PxU32 count, const PxJointDesc* descs, PxU32* ids) {
+    for(PxU32 i = 0; i < count; i++) {
+        auto id = manager->create(descs[i]);
+        if(ids) ids[i] = id;
+    }
+}
+
+DllExport(void) pxReleaseJoints(JointManager* manager, PxU32 count, const PxU32* ids) {
+    for(PxU32 i = 0; i < count; i++) manager->release(ids[i]);
+}
+
+DllExport(PxU32) pxGetBrokenJoints(JointManager* manager, PxBrokenJoint* joints, PxU32 maxJoints) {
+    return manager->broken(joints, maxJoints);
+}
+
+DllExport(PxJoint*) pxGetJoint(JointManager* manager, PxU32 id) {
+    return manager->get(id);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include <unordered_map>
+#include <vector>
+
+enum PxJointKind {
+    PxJointFixed = 0,
+    PxJointD6 = 1,
+    PxJointRevolute = 2,    // about X of the joint frames
+    PxJointDistance = 3,
+    PxJointSpherical = 4
+};
+
+typedef struct {
+    physx::PxU32 Type;
+    physx::PxU32 CollideConnected;  // the two actors keep colliding with each other
+    physx::PxRigidActor* Actor0;    // NULL attaches to the world
+    physx::PxRigidActor* Actor1;
+    Euclidean3d Frame0;             // joint frame relative to Actor0, or in world space
+    Euclidean3d Frame1;
+    float Lower;                    // revolute and D6 twist limit if Lower < Upper, distance joint min distance if > 0
+    float Upper;                    // distance joint max distance if > 0
+    float Swing1;                   // spherical and D6 swing cone, used if both angles are > 0
+    float Swing2;
+    float LinearLimit;              // D6 distance limit of the limited linear axes
+    float LimitStiffness;           // 0 makes the limits hard
+    float LimitDamping;
+    float DriveStiffness;           // D6 slerp drive towards the joint frames, distance joint spring
+    float DriveDamping;
+    float DriveForceLimit;          // revolute velocity drive if > 0, 0 means unlimited for the others
+    float DriveVelocity;
+    float BreakForce;               // 0 never breaks
+    float BreakTorque;
+    physx::PxU32 D6Motion;          // 2 bits of PxD6Motion per PxD6Axis, X in the lowest bits
+    physx::PxU64 UserData;
+} PxJointDesc;
+
+typedef struct {
+    physx::PxU32 Id;
+    physx::PxU32 Type;
+    physx::PxU64 UserData;
+} PxBrokenJoint;
+
+// Joints from PhysXExtensions, created and released in batches. Broken joints
+// are not released, they are reported after the step that broke them by
+// broken, which reads the constraint breaks collected by the scene's
+// SceneEvents.
+class JointManager {
+public:
+    JointManager(PxSceneHandle* scene);
+    ~JointManager();
+
+    PxSceneHandle* Scene;
+
+    // indexed by joint id, NULL for released ones
+    std::vector<physx::PxJoint*> Joints;
+    std::vector<physx::PxU32> Types;
+    std::vector<physx::PxU64> UserData;
+    std::vector<physx::PxU32> FreeIds;
+
+    physx::PxU32 create(const PxJointDesc& desc);
+    void release(physx::PxU32 id);
+    physx::PxJoint* get(physx::PxU32 id) const { return id < Joints.size() ? Joints[id] : nullptr; }
+
+    // joints of this manager broken in the last step, returns the total count
+    physx::PxU32 broken(PxBrokenJoint* joints, physx::PxU32 maxJoints) const;
+
+private:
+    // broken joints are looked up by address, released joints must not be dereferenced
+    std::unordered_map<const physx::PxJoint*, physx::PxU32> Index;
+};
+
+DllExport(JointManager*) pxCreateJointManager(PxSceneHandle* scene);
+DllExport(void) pxDestroyJointManager(JointManager* manager);
+// ids receive 0xFFFFFFFF for descriptions PhysX rejects, ids may be NULL
+DllExport(void) pxCreateJointsBatch(JointManager* manager, physx::PxU32 count, const PxJointDesc* descs, physx::PxU32* ids);
+DllExport(void) pxReleaseJoints(JointManager* manager, physx::PxU32 count, const physx::PxU32* ids);
+DllExport(physx::PxU32) pxGetBrokenJoints(JointManager* manager, PxBrokenJoint* joints, physx::PxU32 maxJoints);
+DllExport(physx::PxJoint*) pxGetJoint(JointManager* manager, physx::PxU32 id);
@@ -0,0 +1,268 @@
+#include "MassCache.h"
+#include "Parallel.h"
+#include <cstring>
+#include <extensions/PxRigidBodyExt.h>
+#include <extensions/PxMassProperties.h>
+
+using namespace physx;
+
+static const PxU32 MassMiss = 0xFFFFFFFF;
+static const PxU32 MassUnsupported = 0xFFFFFFFE;
+static const PxU32 MassSkipped = 0xFFFFFFFD;
+
+static size_t hashBytes(const void* data, size_t size) {
+    // FNV-1a
+    auto bytes = (const unsigned char*)data;
+    PxU64 h = 14695981039346656037ull;
+    for(size_t i = 0; i < size; i++) {
+        h ^= bytes[i];
+        h *= 1099511628211ull;
+    }
+    return (size_t)h;
+}
+
+bool MassShapeKey::operator==(const MassShapeKey& o) const {
+    return memcmp(this, &o, sizeof(MassShapeKey)) == 0;
+}
+
+size_t MassShapeKeyHash::operator()(const MassShapeKey& key) const {
+    return hashBytes(&key, sizeof(MassShapeKey));
+}
+
+size_t MassBodyKeyHash::operator()(const std::vector<PxU32>& key) const {
+    return hashBytes(key.data(), key.size() * sizeof(PxU32));
+}
+
+static void writeScale(float* data, const PxMeshScale& s) {
+    data[0] = s.scale.x; data[1] = s.scale.y; data[2] = s.scale.z;
+    data[3] = s.rotation.x; data[4] = s.rotation.y; data[5] = s.rotation.z; data[6] = s.rotation.w;
+}
+
+// returns false for geometries PxMassProperties cannot integrate for a dynamic body,
+// those fall back to PxRigidBodyExt
+static bool makeKey(const PxShape& shape, MassShapeKey& key) {
+    memset(&key, 0, sizeof(MassShapeKey));
+    const PxGeometry& g = shape.getGeometry();
+    key.Type = (PxU32)g.getType();
+    switch(g.getType()) {
+        case PxGeometryType::eSPHERE:
+            key.Data[0] = static_cast<const PxSphereGeometry&>(g).radius;
+            break;
+        case PxGeometryType::eBOX: {
+            auto& e = static_cast<const PxBoxGeometry&>(g).halfExtents;
+            key.Data[0] = e.x; key.Data[1] = e.y; key.Data[2] = e.z;
+            break;
+        }
+        case PxGeometryType::eCAPSULE: {
+            auto& c = static_cast<const PxCapsuleGeometry&>(g);
+            key.Data[0] = c.radius; key.Data[1] = c.halfHeight;
+            break;
+        }
+        case PxGeometryType::eCONVEXMESH: {
+            auto& c = static_cast<const PxConvexMeshGeometry&>(g);
+            key.Mesh = (PxU64)(size_t)c.convexMesh;
+            writeScale(key.Data, c.scale);
+            break;
+        }
+        default:
+            return false;
+    }
+
+    auto pose = shape.getLocalPose();
+    key.Data[10] = pose.p.x; key.Data[11] = pose.p.y; key.Data[12] = pose.p.z;
+    key.Data[13] = pose.q.x; key.Data[14] = pose.q.y; key.Data[15] = pose.q.z; key.Data[16] = pose.q.w;
+    return true;
+}
+
+MassCache::MassCache() : MaxShapes(1 << 16), MaxBodies(1 << 16) {
+}
+
+void MassCache::updateMassAndInertia(PxCpuDispatcher* dispatcher, PxU32 count, PxRigidBody* const* bodies, const float* densities) {
+    std::lock_guard<std::mutex> lock(Mutex);
+
+    // flat per-shape storage, offsets[i] .. offsets[i+1] belong to bodies[i]
+    std::vector<PxU32> offsets(count + 1);
+    offsets[0] = 0;
+    for(PxU32 i = 0; i < count; i++) offsets[i + 1] = offsets[i] + bodies[i]->getNbShapes();
+
+    // worst case every shape and body of the batch is new
+    if(Shapes.size() + offsets[count] > MaxShapes || Bodies.size() + count > MaxBodies) {
+        ShapeIds.clear();
+        Shapes.clear();
+        BodyIds.clear();
+        Bodies.clear();
+    }
+
+    std::vector<PxShape*> shapes(offsets[count]);
+    std::vector<MassShapeKey> keys(offsets[count]);
+    std::vector<PxU32> shapeIds(offsets[count]);
+
+    // resolve shapes against the (read-only) cache
+    parallelFor(dispatcher, count, 64, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 i = begin; i < end; i++) {
+            auto o = offsets[i];
+            auto n = offsets[i + 1] - o;
+            bodies[i]->getShapes(&shapes[o], n);
+            for(PxU32 s = 0; s < n; s++) {
+                auto shape = shapes[o + s];
+                if(!(shape->getFlags() & PxShapeFlag::eSIMULATION_SHAPE)) {
+                    shapeIds[o + s] = MassSkipped;
+                }
+                else if(!makeKey(*shape, keys[o + s])) {
+                    shapeIds[o + s] = MassUnsupported;
+                }
+                else {
+                    auto it = ShapeIds.find(keys[o + s]);
+                    shapeIds[o + s] = it == ShapeIds.end() ? MassMiss : it->second;
+                }
+            }
+        }
+    });
+
+    // insert misses, identical shapes within the batch share one entry
+    std::vector<PxU32> newShapes;
+    for(PxU32 j = 0; j < offsets[count]; j++) {
+        if(shapeIds[j] != MassMiss) continue;
+        auto res = ShapeIds.insert(std::make_pair(keys[j], (PxU32)Shapes.size()));
+        if(res.second) {
+            Shapes.push_back(PxMassProperties());
+            newShapes.push_back(j);
+        }
+        shapeIds[j] = res.first->second;
+    }
+
+    parallelFor(dispatcher, (PxU32)newShapes.size(), 16, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 k = begin; k < end; k++) {
+            auto shape = shapes[newShapes[k]];
+            PxMassProperties props(shape->getGeometry());
+            auto pose = shape->getLocalPose();
+            Shapes[shapeIds[newShapes[k]]] = PxMassProperties::sum(&props, &pose, 1);
+        }
+    });
+
+    // bodies with identical shape sets share one diagonalized entry
+    std::vector<PxU32> bodyIds(count);
+    std::vector<PxU32> newBodies;
+    std::vector<std::vector<PxU32>> newBodyKeys;
+    std::vector<PxU32> bodyKey;
+    for(PxU32 i = 0; i < count; i++) {
+        bodyKey.clear();
+        bool supported = true;
+        for(PxU32 j = offsets[i]; j < offsets[i + 1]; j++) {
+            if(shapeIds[j] == MassUnsupported) { supported = false; break; }
+            if(shapeIds[j] != MassSkipped) bodyKey.push_back(shapeIds[j]);
+        }
+        if(!supported || bodyKey.empty()) {
+            bodyIds[i] = MassUnsupported;
+            continue;
+        }
+
+        auto res = BodyIds.insert(std::make_pair(bodyKey, (PxU32)Bodies.size()));
+        if(res.second) {
+            Bodies.push_back(MassBody());
+            newBodies.push_back(res.first->second);
+            newBodyKeys.push_back(bodyKey);
+        }
+        bodyIds[i] = res.first->second;
+    }
+
+    parallelFor(dispatcher, (PxU32)newBodies.size(), 16, [&](PxU32 begin, PxU32 end) {
+        std::vector<PxMassProperties> props;
+        std::vector<PxTransform> identity;
+        for(PxU32 k = begin; k < end; k++) {
+            auto& key = newBodyKeys[k];
+            props.clear();
+            for(auto id : key) props.push_back(Shapes[id]);
+            identity.assign(key.size(), PxTransform(PxIdentity));
+
+            auto sum = PxMassProperties::sum(props.data(), identity.data(), (PxU32)props.size());
+            PxQuat frame;
+            auto inertia = PxMassProperties::getMassSpaceInertia(sum.inertiaTensor, frame);
+
+            auto& b = Bodies[newBodies[k]];
+            b.Mass = sum.mass;
+            b.MassFrame = PxTransform(sum.centerOfMass, frame);
+            b.Inertia = inertia;
+        }
+    });
+
+    // PhysX setters are not safe to call concurrently, apply them in one pass
+    for(PxU32 i = 0; i < count; i++) {
+        auto body = bodies[i];
+        auto density = densities ? densities[i] : 1.0f;
+        if(bodyIds[i] == MassUnsupported) {
+            PxRigidBodyExt::updateMassAndInertia(*body, density);
+            continue;
+        }
+        auto& b = Bodies[bodyIds[i]];
+        body->setMass(b.Mass * density);
+        body->setCMassLocalPose(b.MassFrame);
+        body->setMassSpaceInertiaTensor(b.Inertia * density);
+    }
+}
+
+void MassCache::updateMassAndInertia(PxRigidBody& body, float density) {
+    PxRigidBody* bodies[] = { &body };
+    updateMassAndInertia(nullptr, 1, bodies, &density);
+}
+
+void MassCache::clear() {
+    std::lock_guard<std::mutex> lock(Mutex);
+    ShapeIds.clear();
+    Shapes.clear();
+    BodyIds.clear();
+    Bodies.clear();
+}
+
+void MassCache::setLimits(PxU32 maxShapes, PxU32 maxBodies) {
+    std::lock_guard<std::mutex> lock(Mutex);
+    ShapeIds.clear();
+    Shapes.clear();
+    BodyIds.clear();
+    Bodies.clear();
+    MaxShapes = maxShapes;
+    MaxBodies = maxBodies;
+}
+
+MassCache& massCache() {
+    static MassCache cache;
+    return cache;
+}
+
+
+DllExport(void) pxUpdateMassAndInertia(PxSceneHandle* scene, PxU32 count, PxRigidDynamic** bodies, const float* densities) {
+    massCache().updateMassAndInertia(scene->Scene->getCpuDispatcher(), count, (PxRigidBody* const*)bodies, densities);
+}
+
+DllExport(void) pxCreateDynamicCompositeBatch(PxSceneHandle* scene, float density, PxU32 count, const Euclidean3d* trafos, int shapeCount, PxShapeDescription* shapes, PxRigidDynamic** actors) {
+    // all bodies share the same (non-exclusive) shapes
+    std::vector<PxShape*> shared(shapeCount);
+    for(int i = 0; i < shapeCount; i++) {
+        auto d = &shapes[i];
+        shared[i] = scene->Physics->createShape(*d->Geometry, *d->Material, false);
+        shared[i]->setLocalPose(toPxTransform(d->Pose));
+    }
+
+    for(PxU32 i = 0; i < count; i++) {
+        auto thing = scene->Physics->createRigidDynamic(toPxTransform(trafos[i]));
+        for(auto s : shared) thing->attachShape(*s);
+        actors[i] = thing;
+    }
+
+    for(auto s : shared) s->release();
+
+    std::vector<float> densities(count, density);
+    massCache().updateMassAndInertia(scene->Scene->getCpuDispatcher(), count, (PxRigidBody* const*)actors, densities.data());
+}
+
+DllExport(void) pxAddActors(PxSceneHandle* scene, PxU32 count, PxActor** actors) {
+    scene->Scene->addActors(actors, count);
+}
+
+DllExport(void) pxClearMassCache() {
+    massCache().clear();
+}
+
+DllExport(void) pxSetMassCacheLimits(PxU32 maxShapes, PxU32 maxBodies) {
+    massCache().setLimits(maxShapes, maxBodies);
+}
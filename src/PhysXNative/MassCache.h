@@ -0,0 +1,68 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Unit-density mass properties of a single shape, identified by its geometry
+// and its pose relative to the actor (never the body pose, density scales the
+// result). Meshes are identified by pointer, so the cache must be cleared
+// (pxClearMassCache) before a released mesh address can be reused by a
+// different mesh.
+struct MassShapeKey {
+    physx::PxU64 Mesh;
+    physx::PxU32 Type;
+    float Data[17];
+
+    bool operator==(const MassShapeKey& o) const;
+};
+
+struct MassShapeKeyHash {
+    size_t operator()(const MassShapeKey& key) const;
+};
+
+struct MassBodyKeyHash {
+    size_t operator()(const std::vector<physx::PxU32>& key) const;
+};
+
+// Unit-density mass of a whole body, already diagonalized.
+struct MassBody {
+    physx::PxReal Mass;
+    physx::PxTransform MassFrame;
+    physx::PxVec3 Inertia;
+};
+
+class MassCache {
+public:
+    MassCache();
+
+    // a batch that would grow either level past its limit clears the cache first,
+    // so shapes of many distinct sizes cannot grow it without bound
+    physx::PxU32 MaxShapes;
+    physx::PxU32 MaxBodies;
+
+    // Equivalent to PxRigidBodyExt::updateMassAndInertia for every body. Identical
+    // shapes and identical shape sets are integrated and diagonalized once, the
+    // per-body work runs on the dispatcher's workers (serially if NULL).
+    void updateMassAndInertia(physx::PxCpuDispatcher* dispatcher, physx::PxU32 count, physx::PxRigidBody* const* bodies, const float* densities);
+    void updateMassAndInertia(physx::PxRigidBody& body, float density);
+    void clear();
+    // clears the cache
+    void setLimits(physx::PxU32 maxShapes, physx::PxU32 maxBodies);
+
+private:
+    std::mutex Mutex;
+    std::unordered_map<MassShapeKey, physx::PxU32, MassShapeKeyHash> ShapeIds;
+    std::vector<physx::PxMassProperties> Shapes;
+    std::unordered_map<std::vector<physx::PxU32>, physx::PxU32, MassBodyKeyHash> BodyIds;
+    std::vector<MassBody> Bodies;
+};
+
+MassCache& massCache();
+
+DllExport(void) pxUpdateMassAndInertia(PxSceneHandle* scene, physx::PxU32 count, physx::PxRigidDynamic** bodies, const float* densities);
+DllExport(void) pxCreateDynamicCompositeBatch(PxSceneHandle* scene, float density, physx::PxU32 count, const Euclidean3d* trafos, int shapeCount, PxShapeDescription* shapes, physx::PxRigidDynamic** actors);
+DllExport(void) pxAddActors(PxSceneHandle* scene, physx::PxU32 count, physx::PxActor** actors);
+DllExport(void) pxClearMassCache();
+DllExport(void) pxSetMassCacheLimits(physx::PxU32 maxShapes, physx::PxU32 maxBodies);
@@ -0,0 +1,15 @@
+#include "Parallel.h"
+#include <extensions/PxDefaultCpuDispatcher.h>
+#include <thread>
+
+using namespace physx;
+
+PxU32 defaultWorkerCount() {
+    auto n = std::thread::hardware_concurrency();
+    return n > 1 ? n - 1 : 1;
+}
+
+PxCpuDispatcher* sharedDispatcher() {
+    static PxDefaultCpuDispatcher* dispatcher = PxDefaultCpuDispatcherCreate(defaultWorkerCount());
+    return dispatcher;
+}
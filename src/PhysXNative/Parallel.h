@@ -0,0 +1,81 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+
+// Runs fn(begin, end) over [0, count) in chunks of grain on the worker threads
+// of a PhysX CpuDispatcher. The calling thread takes chunks as well, so this also
+// makes progress when all workers are busy or the dispatcher is NULL.
+// Must not be called while the dispatcher is running PxScene::simulate.
+template<typename F>
+class ParallelForJob {
+public:
+    class Task : public physx::PxLightCpuTask {
+    public:
+        ParallelForJob* Job;
+        virtual void run() override { Job->work(); }
+        // the dispatcher calls release after run, the task must stay alive until then
+        virtual void release() override { Job->done(); }
+        virtual const char* getName() const override { return "ParallelFor"; }
+    };
+
+    const F& Fn;
+    physx::PxU32 Count;
+    physx::PxU32 Grain;
+    std::atomic<physx::PxU32> Next;
+    physx::PxU32 Pending;
+    std::mutex Mutex;
+    std::condition_variable Finished;
+
+    ParallelForJob(const F& fn, physx::PxU32 count, physx::PxU32 grain)
+        : Fn(fn), Count(count), Grain(grain), Next(0), Pending(0) {}
+
+    void work() {
+        for(;;) {
+            auto begin = Next.fetch_add(Grain);
+            if(begin >= Count) break;
+            Fn(begin, physx::PxMin(begin + Grain, Count));
+        }
+    }
+
+    void done() {
+        std::lock_guard<std::mutex> lock(Mutex);
+        if(--Pending == 0) Finished.notify_all();
+    }
+};
+
+template<typename F>
+void parallelFor(physx::PxCpuDispatcher* dispatcher, physx::PxU32 count, physx::PxU32 grain, const F& fn) {
+    if(count == 0) return;
+    if(grain == 0) grain = 1;
+
+    auto chunks = (count + grain - 1) / grain;
+    physx::PxU32 nbTasks = dispatcher ? physx::PxMin(dispatcher->getWorkerCount(), chunks - 1) : 0;
+    if(nbTasks == 0) {
+        fn(0, count);
+        return;
+    }
+
+    ParallelForJob<F> job(fn, count, grain);
+    job.Pending = nbTasks;
+    std::vector<typename ParallelForJob<F>::Task> tasks(nbTasks);
+    for(auto& t : tasks) {
+        t.Job = &job;
+        dispatcher->submitTask(t);
+    }
+
+    job.work();
+
+    std::unique_lock<std::mutex> lock(job.Mutex);
+    job.Finished.wait(lock, [&job]() { return job.Pending == 0; });
+}
+
+// Number of worker threads used for scenes and the shared worker dispatcher.
+physx::PxU32 defaultWorkerCount();
+
+// Dispatcher for native passes that are not tied to a scene (particle queries,
+// surface reconstruction, ...). Created on first use, requires pxInit.
+physx::PxCpuDispatcher* sharedDispatcher();
@@ -0,0 +1,423 @@
+#include "ParticleEmitter.h"
+#include "CpuParticleSystem.h"
+#include "Parallel.h"
+#include <atomic>
+#include <cstring>
+#include <cudamanager/PxCudaContext.h>
+#include <cudamanager/PxCudaContextManager.h>
+
+using namespace physx;
+
+static const PxU32 AgeGrain = 4096;
+static const PxU32 CullGrain = 1024;
+
+ParticleSlots::ParticleSlots(PxU32 capacity)
+    : Capacity(capacity), Count(0), DeadCount(0),
+      DenseToId(capacity), Remaining(capacity), Dead(capacity, 0), IdToDense(capacity, PxInvalidParticle) {
+    // lowest ids are handed out first
+    FreeIds.reserve(capacity);
+    for(PxU32 i = capacity; i > 0; i--) FreeIds.push_back(i - 1);
+}
+
+PxU32 ParticleSlots::allocate(float lifetime) {
+    if(FreeIds.empty()) return PxInvalidParticle;
+    auto id = FreeIds.back();
+    FreeIds.pop_back();
+
+    auto dense = Count++;
+    DenseToId[dense] = id;
+    IdToDense[id] = dense;
+    Remaining[dense] = lifetime > 0.0f ? lifetime : PX_MAX_F32;
+    Dead[dense] = 0;
+    return dense;
+}
+
+void ParticleSlots::kill(PxU32 dense) {
+    if(dense >= Count || Dead[dense]) return;
+    Dead[dense] = 1;
+    DeadCount++;
+}
+
+PxU32 ParticleSlots::compact(PxVec4* positionInvMass, PxVec4* velocity, PxU32* phase) {
+    auto first = Count;
+    if(DeadCount == 0) return first;
+
+    // walking down keeps the swapped in particle alive, everything above was handled already
+    for(PxU32 i = Count; i > 0; i--) {
+        auto dense = i - 1;
+        if(!Dead[dense]) continue;
+
+        auto id = DenseToId[dense];
+        IdToDense[id] = PxInvalidParticle;
+        FreeIds.push_back(id);
+
+        auto last = --Count;
+        if(dense != last) {
+            positionInvMass[dense] = positionInvMass[last];
+            velocity[dense] = velocity[last];
+            phase[dense] = phase[last];
+            DenseToId[dense] = DenseToId[last];
+            IdToDense[DenseToId[dense]] = dense;
+            Remaining[dense] = Remaining[last];
+        }
+        Dead[dense] = 0;
+        first = dense;
+    }
+    DeadCount = 0;
+    return first;
+}
+
+
+static PxU32 nextRandom(PxU32& state) {
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static float randomFloat(PxU32& state) {
+    return (float)(nextRandom(state) >> 8) * (1.0f / 16777216.0f);
+}
+
+static PxVec3 randomInSphere(PxU32& state) {
+    for(;;) {
+        PxVec3 p(2.0f * randomFloat(state) - 1.0f, 2.0f * randomFloat(state) - 1.0f, 2.0f * randomFloat(state) - 1.0f);
+        if(p.magnitudeSquared() <= 1.0f) return p;
+    }
+}
+
+ParticleEmitterSystem::ParticleEmitterSystem(PxU32 capacity, PxU32 nbActive, PxU32 defaultPhase, float defaultInvMass)
+    : Slots(capacity), DefaultPhase(defaultPhase), DefaultInvMass(defaultInvMass),
+      CudaManager(nullptr), HostPositionInvMass(nullptr), HostVelocity(nullptr), HostPhase(nullptr) {
+    // particles that exist already live until they are killed
+    for(PxU32 i = 0; i < nbActive && i < capacity; i++) Slots.allocate(0.0f);
+}
+
+ParticleEmitterSystem::~ParticleEmitterSystem() {
+    if(CudaManager) {
+        CudaManager->freePinnedHostBuffer(HostPositionInvMass);
+        CudaManager->freePinnedHostBuffer(HostVelocity);
+        CudaManager->freePinnedHostBuffer(HostPhase);
+    }
+}
+
+PxU32 ParticleEmitterSystem::addEmitter(const PxParticleEmitterDesc& desc) {
+    PxU32 index = 0;
+    while(index < Emitters.size() && Emitters[index].Alive) index++;
+    if(index == Emitters.size()) Emitters.push_back(ParticleEmitter());
+
+    auto& e = Emitters[index];
+    e.Desc = desc;
+    e.Alive = true;
+    e.Accumulator = 0.0f;
+    e.Random = 0x9E3779B9u ^ (index * 0x85EBCA6Bu);
+    e.Samples.clear();
+    e.Normals.clear();
+    return index;
+}
+
+PxU32 ParticleEmitterSystem::addKillVolume(const PxParticleKillVolume& volume) {
+    PxU32 index = 0;
+    while(index < KillVolumes.size() && KillVolumeAlive[index]) index++;
+    if(index == KillVolumes.size()) {
+        KillVolumes.push_back(volume);
+        KillVolumeAlive.push_back(true);
+    }
+    else {
+        KillVolumes[index] = volume;
+        KillVolumeAlive[index] = true;
+    }
+    return index;
+}
+
+bool ParticleEmitterSystem::hasKillVolumes() const {
+    for(auto alive : KillVolumeAlive) if(alive) return true;
+    return false;
+}
+
+void ParticleEmitterSystem::age(float dt, PxCpuDispatcher* dispatcher) {
+    std::atomic<PxU32> died(0);
+    parallelFor(dispatcher, Slots.Count, AgeGrain, [&](PxU32 begin, PxU32 end) {
+        PxU32 n = 0;
+        for(PxU32 i = begin; i < end; i++) {
+            auto& r = Slots.Remaining[i];
+            if(r == PX_MAX_F32 || Slots.Dead[i]) continue;
+            r -= dt;
+            if(r <= 0.0f) {
+                Slots.Dead[i] = 1;
+                n++;
+            }
+        }
+        if(n) died.fetch_add(n);
+    });
+    Slots.DeadCount += died.load();
+}
+
+void ParticleEmitterSystem::cull(const PxVec4* positionInvMass, PxCpuDispatcher* dispatcher) {
+    std::vector<PxTransform> poses;
+    std::vector<const PxParticleKillVolume*> volumes;
+    for(size_t i = 0; i < KillVolumes.size(); i++) {
+        if(!KillVolumeAlive[i]) continue;
+        poses.push_back(toPxTransform(KillVolumes[i].Pose));
+        volumes.push_back(&KillVolumes[i]);
+    }
+    if(volumes.empty()) return;
+
+    std::atomic<PxU32> died(0);
+    parallelFor(dispatcher, Slots.Count, CullGrain, [&](PxU32 begin, PxU32 end) {
+        PxU32 n = 0;
+        for(PxU32 i = begin; i < end; i++) {
+            if(Slots.Dead[i]) continue;
+            auto p = positionInvMass[i].getXYZ();
+            for(size_t v = 0; v < volumes.size(); v++) {
+                auto& vol = *volumes[v];
+                auto l = poses[v].transformInv(p);
+                bool inside;
+                if(vol.Type == PxParticleKillSphere) {
+                    auto r = (float)vol.Extents.X;
+                    inside = l.magnitudeSquared() <= r * r;
+                }
+                else {
+                    inside = PxAbs(l.x) <= (float)vol.Extents.X && PxAbs(l.y) <= (float)vol.Extents.Y && PxAbs(l.z) <= (float)vol.Extents.Z;
+                }
+                if(inside != (vol.Invert != 0)) {
+                    Slots.Dead[i] = 1;
+                    n++;
+                    break;
+                }
+            }
+        }
+        if(n) died.fetch_add(n);
+    });
+    Slots.DeadCount += died.load();
+}
+
+void ParticleEmitterSystem::emit(float dt, PxVec4* positionInvMass, PxVec4* velocity, PxU32* phase) {
+    for(auto& b : Bursts) {
+        auto dense = Slots.allocate(b.Lifetime);
+        if(dense == PxInvalidParticle) break;
+        positionInvMass[dense] = b.PositionInvMass;
+        velocity[dense] = b.Velocity;
+        phase[dense] = b.Phase ? b.Phase : DefaultPhase;
+    }
+    Bursts.clear();
+
+    for(auto& e : Emitters) {
+        if(!e.Alive || e.Desc.Rate <= 0.0f) continue;
+        if(e.Desc.Type == PxParticleEmitterMesh && e.Samples.empty()) continue;
+
+        e.Accumulator += e.Desc.Rate * dt;
+        auto n = (PxU32)e.Accumulator;
+        e.Accumulator -= (float)n;
+
+        auto& d = e.Desc;
+        auto pose = toPxTransform(d.Pose);
+        auto baseVelocity = pose.q.rotate(toPxVec3(d.Velocity));
+        auto invMass = d.InvMass > 0.0f ? d.InvMass : DefaultInvMass;
+        auto ph = d.Phase ? d.Phase : DefaultPhase;
+
+        for(PxU32 k = 0; k < n; k++) {
+            auto dense = Slots.allocate(d.Lifetime);
+            if(dense == PxInvalidParticle) {
+                // full, emission resumes once particles die
+                e.Accumulator = 0.0f;
+                break;
+            }
+
+            PxVec3 p, v = baseVelocity;
+            switch(d.Type) {
+                case PxParticleEmitterBox: {
+                    PxVec3 ext((float)d.Extents.X, (float)d.Extents.Y, (float)d.Extents.Z);
+                    PxVec3 u(randomFloat(e.Random), randomFloat(e.Random), randomFloat(e.Random));
+                    p = (u * 2.0f - PxVec3(1.0f)).multiply(ext);
+                    break;
+                }
+                case PxParticleEmitterMesh: {
+                    auto s = nextRandom(e.Random) % (PxU32)e.Samples.size();
+                    p = e.Samples[s];
+                    v += pose.q.rotate(e.Normals[s]) * d.Speed;
+                    break;
+                }
+                default:
+                    p = randomInSphere(e.Random) * (float)d.Extents.X;
+                    break;
+            }
+            if(d.Jitter > 0.0f) v += randomInSphere(e.Random) * d.Jitter;
+
+            positionInvMass[dense] = PxVec4(pose.transform(p), invMass);
+            velocity[dense] = PxVec4(v, 0.0f);
+            phase[dense] = ph;
+        }
+    }
+}
+
+PxU32 ParticleEmitterSystem::update(float dt, PxVec4* positionInvMass, PxVec4* velocity, PxU32* phase, PxCpuDispatcher* dispatcher) {
+    age(dt, dispatcher);
+    cull(positionInvMass, dispatcher);
+    auto first = Slots.compact(positionInvMass, velocity, phase);
+    emit(dt, positionInvMass, velocity, phase);
+    return first;
+}
+
+
+static ParticleEmitterSystem* emittersOf(PxPbdHandle* handle) {
+    if(handle->Emitters) return handle->Emitters;
+
+    if(auto cpu = handle->CpuParticles) {
+        handle->Emitters = new ParticleEmitterSystem(cpu->MaxParticles, cpu->NbActiveParticles, handle->DefaultPhase, handle->DefaultInvMass);
+    }
+    else {
+        auto buffer = handle->ParticleBuffer;
+        auto capacity = buffer->getMaxParticles();
+        auto system = new ParticleEmitterSystem(capacity, buffer->getNbActiveParticles(), handle->DefaultPhase, handle->DefaultInvMass);
+        auto cm = handle->CudaManager;
+        system->CudaManager = cm;
+        system->HostPositionInvMass = cm->allocPinnedHostBuffer<PxVec4>(capacity);
+        system->HostVelocity = cm->allocPinnedHostBuffer<PxVec4>(capacity);
+        system->HostPhase = cm->allocPinnedHostBuffer<PxU32>(capacity);
+        handle->Emitters = system;
+    }
+    return handle->Emitters;
+}
+
+DllExport(PxU32) pxAddParticleEmitter(PxPbdHandle* handle, const PxParticleEmitterDesc* desc) {
+    if(desc->Type == PxParticleEmitterMesh) return PxInvalidParticle;
+    return emittersOf(handle)->addEmitter(*desc);
+}
+
+DllExport(PxU32) pxAddParticleMeshEmitter(PxPbdHandle* handle, const PxParticleEmitterDesc* desc,
+        const V3f* vertices, PxU32 vertexCount, const PxU32* indices, PxU32 triangleCount, float sampleDistance) {
+
+    PxSimpleTriangleMesh mesh;
+    mesh.points.count = vertexCount;
+    mesh.points.stride = sizeof(V3f);
+    mesh.points.data = vertices;
+    mesh.triangles.count = triangleCount;
+    mesh.triangles.stride = 3 * sizeof(PxU32);
+    mesh.triangles.data = indices;
+
+    PxArray<PxVec3> samples;
+    PxArray<PxI32> triangleIds;
+    PxSamplingExt::poissonSample(mesh, sampleDistance, samples, 0.0f, &triangleIds);
+    if(samples.empty()) return PxInvalidParticle;
+
+    auto system = emittersOf(handle);
+    auto d = *desc;
+    d.Type = PxParticleEmitterMesh;
+    auto index = system->addEmitter(d);
+    auto& e = system->Emitters[index];
+
+    auto v = (const PxVec3*)vertices;
+    e.Samples.assign(samples.begin(), samples.end());
+    e.Normals.resize(samples.size());
+    for(PxU32 i = 0; i < samples.size(); i++) {
+        auto t = indices + 3 * triangleIds[i];
+        e.Normals[i] = (v[t[1]] - v[t[0]]).cross(v[t[2]] - v[t[0]]).getNormalized();
+    }
+    return index;
+}
+
+DllExport(void) pxDestroyParticleEmitters(PxPbdHandle* handle) {
+    delete handle->Emitters;
+    handle->Emitters = nullptr;
+}
+
+DllExport(void) pxRemoveParticleEmitter(PxPbdHandle* handle, PxU32 emitter) {
+    auto system = handle->Emitters;
+    if(!system || emitter >= system->Emitters.size()) return;
+    auto& e = system->Emitters[emitter];
+    e.Alive = false;
+    e.Samples.clear();
+    e.Normals.clear();
+}
+
+DllExport(void) pxSetParticleEmitterPose(PxPbdHandle* handle, PxU32 emitter, Euclidean3d pose) {
+    auto system = handle->Emitters;
+    if(!system || emitter >= system->Emitters.size()) return;
+    system->Emitters[emitter].Desc.Pose = pose;
+}
+
+DllExport(void) pxSetParticleEmitterRate(PxPbdHandle* handle, PxU32 emitter, float rate) {
+    auto system = handle->Emitters;
+    if(!system || emitter >= system->Emitters.size()) return;
+    system->Emitters[emitter].Desc.Rate = rate;
+}
+
+DllExport(PxU32) pxAddParticleKillVolume(PxPbdHandle* handle, const PxParticleKillVolume* volume) {
+    return emittersOf(handle)->addKillVolume(*volume);
+}
+
+DllExport(void) pxRemoveParticleKillVolume(PxPbdHandle* handle, PxU32 volume) {
+    auto system = handle->Emitters;
+    if(!system || volume >= system->KillVolumes.size()) return;
+    system->KillVolumeAlive[volume] = false;
+}
+
+DllExport(void) pxEmitParticles(PxPbdHandle* handle, PxU32 count, const V4f* positionInvMass, const V4f* velocity, const PxU32* phase, float lifetime) {
+    auto system = emittersOf(handle);
+    for(PxU32 i = 0; i < count; i++) {
+        ParticleBurst b;
+        auto& p = positionInvMass[i];
+        b.PositionInvMass = PxVec4(p.X, p.Y, p.Z, p.W > 0.0f ? p.W : system->DefaultInvMass);
+        b.Velocity = velocity ? PxVec4(velocity[i].X, velocity[i].Y, velocity[i].Z, 0.0f) : PxVec4(0.0f);
+        b.Phase = phase ? phase[i] : 0;
+        b.Lifetime = lifetime;
+        system->Bursts.push_back(b);
+    }
+}
+
+DllExport(PxU32) pxUpdateParticleEmitters(PxPbdHandle* handle, float dt) {
+    auto system = emittersOf(handle);
+    auto& slots = system->Slots;
+    auto dispatcher = handle->Scene->getCpuDispatcher();
+
+    if(auto cpu = handle->CpuParticles) {
+        system->update(dt, cpu->PositionInvMass.data(), cpu->Velocity.data(), cpu->Phase.data(), dispatcher);
+        cpu->NbActiveParticles = slots.Count;
+        return slots.Count;
+    }
+
+    auto buffer = handle->ParticleBuffer;
+    auto cm = handle->CudaManager;
+    auto pos = system->HostPositionInvMass;
+    auto vel = system->HostVelocity;
+    auto phase = system->HostPhase;
+
+    // the mirror is only refreshed when particles have to be tested or moved,
+    // pure emission just uploads the appended range
+    system->age(dt, dispatcher);
+    bool cull = system->hasKillVolumes();
+    auto count = slots.Count;
+
+    cm->acquireContext();
+    auto ctx = cm->getCudaContext();
+    if((cull || slots.DeadCount > 0) && count > 0) {
+        ctx->memcpyDtoH(pos, CUdeviceptr(buffer->getPositionInvMasses()), sizeof(PxVec4) * count);
+        ctx->memcpyDtoH(vel, CUdeviceptr(buffer->getVelocities()), sizeof(PxVec4) * count);
+        ctx->memcpyDtoH(phase, CUdeviceptr(buffer->getPhases()), sizeof(PxU32) * count);
+    }
+    if(cull) system->cull(pos, dispatcher);
+    auto first = slots.compact(pos, vel, phase);
+    system->emit(dt, pos, vel, phase);
+
+    if(slots.Count > first) {
+        auto n = slots.Count - first;
+        ctx->memcpyHtoD(CUdeviceptr(buffer->getPositionInvMasses() + first), pos + first, sizeof(PxVec4) * n);
+        ctx->memcpyHtoD(CUdeviceptr(buffer->getVelocities() + first), vel + first, sizeof(PxVec4) * n);
+        ctx->memcpyHtoD(CUdeviceptr(buffer->getPhases() + first), phase + first, sizeof(PxU32) * n);
+        buffer->raiseFlags(PxParticleBufferFlag::eUPDATE_POSITION);
+        buffer->raiseFlags(PxParticleBufferFlag::eUPDATE_VELOCITY);
+        buffer->raiseFlags(PxParticleBufferFlag::eUPDATE_PHASE);
+    }
+    cm->releaseContext();
+
+    buffer->setNbActiveParticles(slots.Count);
+    return slots.Count;
+}
+
+DllExport(PxU32) pxGetParticleIds(PxPbdHandle* handle, PxU32* ids) {
+    auto system = emittersOf(handle);
+    auto& slots = system->Slots;
+    memcpy(ids, slots.DenseToId.data(), sizeof(PxU32) * slots.Count);
+    return slots.Count;
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include <vector>
+
+enum PxParticleEmitterType {
+    PxParticleEmitterPoint = 0,
+    PxParticleEmitterBox = 1,
+    PxParticleEmitterMesh = 2
+};
+
+enum PxParticleKillVolumeType {
+    PxParticleKillBox = 0,
+    PxParticleKillSphere = 1
+};
+
+typedef struct {
+    physx::PxU32 Type;
+    Euclidean3d Pose;
+    V3d Extents;            // box half extents, X is the spawn radius of point emitters
+    V3d Velocity;           // initial velocity in emitter space
+    float Speed;            // initial speed along the surface normal of mesh emitters
+    float Jitter;           // magnitude of a random velocity added to every particle
+    float Rate;             // particles per second
+    float Lifetime;         // seconds, <= 0 keeps particles until they are killed
+    physx::PxU32 Phase;     // 0 uses the default phase of the particle system
+    float InvMass;          // 0 uses the default inverse mass of the particle system
+} PxParticleEmitterDesc;
+
+typedef struct {
+    physx::PxU32 Type;
+    physx::PxU32 Invert;    // kills everything outside of the volume instead
+    Euclidean3d Pose;
+    V3d Extents;            // box half extents, X is the sphere radius
+} PxParticleKillVolume;
+
+static const physx::PxU32 PxInvalidParticle = 0xFFFFFFFF;
+
+// Slot management over compacted particle arrays. Live particles always occupy
+// [0, Count) so the count can be handed to setNbActiveParticles directly, stable
+// particle ids are recycled through a free-list. Only touches the host arrays it
+// is given, GPU buffers are mirrored by the caller.
+class ParticleSlots {
+public:
+    explicit ParticleSlots(physx::PxU32 capacity);
+
+    physx::PxU32 Capacity;
+    physx::PxU32 Count;
+    physx::PxU32 DeadCount;
+
+    // per live particle
+    std::vector<physx::PxU32> DenseToId;
+    std::vector<float> Remaining;
+    std::vector<physx::PxU8> Dead;
+
+    // per id
+    std::vector<physx::PxU32> IdToDense;
+    std::vector<physx::PxU32> FreeIds;
+
+    // returns the dense index of the new particle, PxInvalidParticle when full
+    physx::PxU32 allocate(float lifetime);
+    void kill(physx::PxU32 dense);
+
+    // swap-removes all dead particles and moves the particle data along,
+    // returns the lowest dense index that changed (Count if none did)
+    physx::PxU32 compact(physx::PxVec4* positionInvMass, physx::PxVec4* velocity, physx::PxU32* phase);
+};
+
+struct ParticleEmitter {
+    PxParticleEmitterDesc Desc;
+    bool Alive;
+    float Accumulator;
+    physx::PxU32 Random;
+    // surface samples of mesh emitters in emitter space
+    std::vector<physx::PxVec3> Samples;
+    std::vector<physx::PxVec3> Normals;
+};
+
+struct ParticleBurst {
+    physx::PxVec4 PositionInvMass;
+    physx::PxVec4 Velocity;
+    physx::PxU32 Phase;
+    float Lifetime;
+};
+
+class ParticleEmitterSystem {
+public:
+    ParticleEmitterSystem(physx::PxU32 capacity, physx::PxU32 nbActive, physx::PxU32 defaultPhase, float defaultInvMass);
+    ~ParticleEmitterSystem();
+
+    ParticleSlots Slots;
+    physx::PxU32 DefaultPhase;
+    float DefaultInvMass;
+    std::vector<ParticleEmitter> Emitters;
+    std::vector<PxParticleKillVolume> KillVolumes;
+    std::vector<bool> KillVolumeAlive;
+    std::vector<ParticleBurst> Bursts;
+
+    physx::PxU32 addEmitter(const PxParticleEmitterDesc& desc);
+    physx::PxU32 addKillVolume(const PxParticleKillVolume& volume);
+    bool hasKillVolumes() const;
+
+    // update stages, split so a GPU backend only downloads particles when needed
+    void age(float dt, physx::PxCpuDispatcher* dispatcher);
+    void cull(const physx::PxVec4* positionInvMass, physx::PxCpuDispatcher* dispatcher);
+    void emit(float dt, physx::PxVec4* positionInvMass, physx::PxVec4* velocity, physx::PxU32* phase);
+
+    // all stages on host arrays, returns the lowest dense index that changed
+    physx::PxU32 update(float dt, physx::PxVec4* positionInvMass, physx::PxVec4* velocity, physx::PxU32* phase, physx::PxCpuDispatcher* dispatcher);
+
+    // pinned host mirror of a GPU particle buffer
+    physx::PxCudaContextManager* CudaManager;
+    physx::PxVec4* HostPositionInvMass;
+    physx::PxVec4* HostVelocity;
+    physx::PxU32* HostPhase;
+};
+
+DllExport(physx::PxU32) pxAddParticleEmitter(PxPbdHandle* handle, const PxParticleEmitterDesc* desc);
+DllExport(physx::PxU32) pxAddParticleMeshEmitter(PxPbdHandle* handle, const PxParticleEmitterDesc* desc,
+    const V3f* vertices, physx::PxU32 vertexCount, const physx::PxU32* indices, physx::PxU32 triangleCount, float sampleDistance);
+// drops all emitters, kill volumes and lifetimes of the handle, the particles stay
+DllExport(void) pxDestroyParticleEmitters(PxPbdHandle* handle);
+DllExport(void) pxRemoveParticleEmitter(PxPbdHandle* handle, physx::PxU32 emitter);
+DllExport(void) pxSetParticleEmitterPose(PxPbdHandle* handle, physx::PxU32 emitter, Euclidean3d pose);
+DllExport(void) pxSetParticleEmitterRate(PxPbdHandle* handle, physx::PxU32 emitter, float rate);
+DllExport(physx::PxU32) pxAddParticleKillVolume(PxPbdHandle* handle, const PxParticleKillVolume* volume);
+DllExport(void) pxRemoveParticleKillVolume(PxPbdHandle* handle, physx::PxU32 volume);
+DllExport(void) pxEmitParticles(PxPbdHandle* handle, physx::PxU32 count, const V4f* positionInvMass, const V4f* velocity, const physx::PxU32* phase, float lifetime);
+DllExport(physx::PxU32) pxUpdateParticleEmitters(PxPbdHandle* handle, float dt);
+DllExport(physx::PxU32) pxGetParticleIds(PxPbdHandle* handle, physx::PxU32* ids);
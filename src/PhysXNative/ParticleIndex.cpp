@@ -0,0 +1,241 @@
+#include "ParticleIndex.h"
+#include "CpuParticleSystem.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <foundation/PxBitUtils.h>
+#include <cudamanager/PxCudaContext.h>
+#include <cudamanager/PxCudaContextManager.h>
+
+using namespace physx;
+
+static const PxU32 BuildGrain = 4096;
+static const PxU32 SortChunk = 16384;
+static const PxU32 QueryGrain = 64;
+
+static PX_FORCE_INLINE PxI32 cellCoord(float v, float invCellSize) {
+    return (PxI32)PxFloor(v * invCellSize);
+}
+
+static PX_FORCE_INLINE PxU32 cellHash(PxI32 x, PxI32 y, PxI32 z, PxU32 mask) {
+    return ((PxU32)x * 73856093u ^ (PxU32)y * 19349663u ^ (PxU32)z * 83492791u) & mask;
+}
+
+ParticleIndex::ParticleIndex(float cellSize)
+    : CellSize(cellSize), Count(0), CellMask(0), KeyBits(0) {}
+
+void ParticleIndex::build(const PxVec4* positions, PxU32 count, PxCpuDispatcher* dispatcher) {
+    Count = count;
+    auto tableSize = PxNextPowerOfTwo(PxMax(count * 2, 64u) - 1);
+    CellMask = tableSize - 1;
+    KeyBits = 0;
+    while((1u << KeyBits) < tableSize) KeyBits++;
+
+    Keys.resize(count);
+    SortedIndices.resize(count);
+    TempKeys.resize(count);
+    TempIndices.resize(count);
+    SortedPositions.resize(count);
+
+    auto inv = 1.0f / CellSize;
+    auto mask = CellMask;
+    parallelFor(dispatcher, count, BuildGrain, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 i = begin; i < end; i++) {
+            auto& p = positions[i];
+            Keys[i] = cellHash(cellCoord(p.x, inv), cellCoord(p.y, inv), cellCoord(p.z, inv), mask);
+            SortedIndices[i] = i;
+        }
+    });
+
+    // LSD radix sort over the used key bits, each chunk histograms and scatters
+    // its own range so the sort stays stable
+    auto nbChunks = (count + SortChunk - 1) / SortChunk;
+    Histograms.resize(nbChunks * 256);
+    for(PxU32 shift = 0; shift < KeyBits; shift += 8) {
+        std::fill(Histograms.begin(), Histograms.end(), 0u);
+        parallelFor(dispatcher, nbChunks, 1, [&](PxU32 begin, PxU32 end) {
+            for(PxU32 c = begin; c < end; c++) {
+                auto h = &Histograms[c * 256];
+                for(PxU32 i = c * SortChunk, e = PxMin(count, (c + 1) * SortChunk); i < e; i++) h[(Keys[i] >> shift) & 0xFF]++;
+            }
+        });
+
+        PxU32 offset = 0;
+        for(PxU32 d = 0; d < 256; d++) {
+            for(PxU32 c = 0; c < nbChunks; c++) {
+                auto n = Histograms[c * 256 + d];
+                Histograms[c * 256 + d] = offset;
+                offset += n;
+            }
+        }
+
+        parallelFor(dispatcher, nbChunks, 1, [&](PxU32 begin, PxU32 end) {
+            for(PxU32 c = begin; c < end; c++) {
+                auto h = &Histograms[c * 256];
+                for(PxU32 i = c * SortChunk, e = PxMin(count, (c + 1) * SortChunk); i < e; i++) {
+                    auto o = h[(Keys[i] >> shift) & 0xFF]++;
+                    TempKeys[o] = Keys[i];
+                    TempIndices[o] = SortedIndices[i];
+                }
+            }
+        });
+        Keys.swap(TempKeys);
+        SortedIndices.swap(TempIndices);
+    }
+
+    CellStart.assign(tableSize, 0);
+    CellEnd.assign(tableSize, 0);
+    parallelFor(dispatcher, count, BuildGrain, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 k = begin; k < end; k++) {
+            SortedPositions[k] = positions[SortedIndices[k]];
+            auto key = Keys[k];
+            if(k == 0 || Keys[k - 1] != key) CellStart[key] = k;
+            if(k + 1 == count || Keys[k + 1] != key) CellEnd[key] = k + 1;
+        }
+    });
+}
+
+void ParticleIndex::build(PxPbdHandle* handle, PxCpuDispatcher* dispatcher) {
+    if(auto cpu = handle->CpuParticles) {
+        build(cpu->PositionInvMass.data(), cpu->NbActiveParticles, dispatcher);
+        return;
+    }
+
+    auto buffer = handle->ParticleBuffer;
+    auto n = buffer->getNbActiveParticles();
+    Staging.resize(n);
+    auto cm = handle->CudaManager;
+    cm->acquireContext();
+    cm->getCudaContext()->memcpyDtoH(Staging.data(), CUdeviceptr(buffer->getPositionInvMasses()), sizeof(PxVec4) * n);
+    cm->releaseContext();
+    build(Staging.data(), n, dispatcher);
+}
+
+void ParticleIndex::collectBuckets(const PxBounds3& box, std::vector<PxU32>& buckets) const {
+    buckets.clear();
+    if(Count == 0) return;
+
+    auto inv = 1.0f / CellSize;
+    PxI32 lo[3], hi[3];
+    double cells = 1.0;
+    for(PxU32 a = 0; a < 3; a++) {
+        lo[a] = cellCoord(box.minimum[a], inv);
+        hi[a] = cellCoord(box.maximum[a], inv);
+        cells *= (double)hi[a] - (double)lo[a] + 1.0;
+    }
+
+    // boxes with more cells than buckets visit every occupied bucket once
+    if(cells >= (double)(CellMask + 1)) {
+        for(PxU32 b = 0; b <= CellMask; b++) if(CellEnd[b] > CellStart[b]) buckets.push_back(b);
+        return;
+    }
+
+    for(auto z = lo[2]; z <= hi[2]; z++)
+        for(auto y = lo[1]; y <= hi[1]; y++)
+            for(auto x = lo[0]; x <= hi[0]; x++)
+                buckets.push_back(cellHash(x, y, z, CellMask));
+    std::sort(buckets.begin(), buckets.end());
+    buckets.erase(std::unique(buckets.begin(), buckets.end()), buckets.end());
+}
+
+void ParticleIndex::queryRadius(const PxVec3* centers, const float* radii, PxU32 nbQueries, PxU32 maxResults,
+        PxU32* results, PxU32* counts, PxCpuDispatcher* dispatcher) const {
+    parallelFor(dispatcher, nbQueries, QueryGrain, [&](PxU32 begin, PxU32 end) {
+        std::vector<PxU32> buckets;
+        for(PxU32 q = begin; q < end; q++) {
+            auto out = results + (size_t)q * maxResults;
+            PxU32 n = 0;
+            forEachInRadius(centers[q], radii[q], buckets, [&](PxU32 i, float) {
+                if(n < maxResults) out[n] = i;
+                n++;
+            });
+            counts[q] = n;
+        }
+    });
+}
+
+void ParticleIndex::queryBox(const PxBounds3* boxes, PxU32 nbQueries, PxU32 maxResults,
+        PxU32* results, PxU32* counts, PxCpuDispatcher* dispatcher) const {
+    parallelFor(dispatcher, nbQueries, QueryGrain, [&](PxU32 begin, PxU32 end) {
+        std::vector<PxU32> buckets;
+        for(PxU32 q = begin; q < end; q++) {
+            auto& box = boxes[q];
+            auto out = results + (size_t)q * maxResults;
+            PxU32 n = 0;
+            collectBuckets(box, buckets);
+            for(auto b : buckets) {
+                for(auto k = CellStart[b]; k < CellEnd[b]; k++) {
+                    if(!box.contains(SortedPositions[k].getXYZ())) continue;
+                    if(n < maxResults) out[n] = SortedIndices[k];
+                    n++;
+                }
+            }
+            counts[q] = n;
+        }
+    });
+}
+
+void ParticleIndex::queryNearest(const PxVec3* centers, PxU32 nbQueries, PxU32 k, float maxRadius,
+        PxU32* results, float* distances, PxU32* counts, PxCpuDispatcher* dispatcher) const {
+    if(maxRadius <= 0.0f) maxRadius = PX_MAX_F32;
+    auto wanted = PxMin(k, Count);
+
+    parallelFor(dispatcher, nbQueries, QueryGrain, [&](PxU32 begin, PxU32 end) {
+        std::vector<PxU32> buckets;
+        std::vector<std::pair<float, PxU32>> hits;
+        for(PxU32 q = begin; q < end; q++) {
+            // grow the radius until it holds k particles, everything closer is then inside
+            auto r = PxMin(CellSize, maxRadius);
+            for(;;) {
+                hits.clear();
+                forEachInRadius(centers[q], r, buckets, [&](PxU32 i, float d2) { hits.push_back(std::make_pair(d2, i)); });
+                if(hits.size() >= wanted || r >= maxRadius) break;
+                r = PxMin(r * 2.0f, maxRadius);
+            }
+
+            auto n = PxMin(k, (PxU32)hits.size());
+            std::partial_sort(hits.begin(), hits.begin() + n, hits.end());
+            auto out = results + (size_t)q * k;
+            for(PxU32 i = 0; i < n; i++) {
+                out[i] = hits[i].second;
+                if(distances) distances[(size_t)q * k + i] = PxSqrt(hits[i].first);
+            }
+            counts[q] = n;
+        }
+    });
+}
+
+
+DllExport(ParticleIndex*) pxCreateParticleIndex(float cellSize) {
+    return new ParticleIndex(cellSize);
+}
+
+DllExport(void) pxDestroyParticleIndex(ParticleIndex* index) {
+    delete index;
+}
+
+DllExport(void) pxBuildParticleIndex(ParticleIndex* index, const V4f* positions, PxU32 count) {
+    index->build((const PxVec4*)positions, count, sharedDispatcher());
+}
+
+DllExport(void) pxBuildParticleIndexFromPBD(ParticleIndex* index, PxPbdHandle* handle) {
+    index->build(handle, sharedDispatcher());
+}
+
+DllExport(void) pxQueryParticlesRadius(ParticleIndex* index, const V3f* centers, const float* radii, PxU32 nbQueries,
+        PxU32 maxResults, PxU32* results, PxU32* counts) {
+    index->queryRadius((const PxVec3*)centers, radii, nbQueries, maxResults, results, counts, sharedDispatcher());
+}
+
+DllExport(void) pxQueryParticlesBox(ParticleIndex* index, const V3f* boxMin, const V3f* boxMax, PxU32 nbQueries,
+        PxU32 maxResults, PxU32* results, PxU32* counts) {
+    std::vector<PxBounds3> boxes(nbQueries);
+    for(PxU32 q = 0; q < nbQueries; q++) {
+        boxes[q] = PxBounds3(PxVec3(boxMin[q].X, boxMin[q].Y, boxMin[q].Z), PxVec3(boxMax[q].X, boxMax[q].Y, boxMax[q].Z));
+    }
+    index->queryBox(boxes.data(), nbQueries, maxResults, results, counts, sharedDispatcher());
+}
+
+DllExport(void) pxQueryParticlesNearest(ParticleIndex* index, const V3f* centers, PxU32 nbQueries, PxU32 k, float maxRadius,
+        PxU32* results, float* distances, PxU32* counts) {
+    index->queryNearest((const PxVec3*)centers, nbQueries, k, maxRadius, results, distances, counts, sharedDispatcher());
+}
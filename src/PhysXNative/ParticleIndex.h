@@ -0,0 +1,74 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include <vector>
+
+// Cell-sorted hashed grid over particle positions. Particles are sorted by the
+// hash of their cell with a parallel radix sort so every bucket is a contiguous
+// range of the sorted arrays. Rebuilt from any host-side posInvMass array.
+class ParticleIndex {
+public:
+    explicit ParticleIndex(float cellSize);
+
+    float CellSize;
+    physx::PxU32 Count;
+
+    void build(const physx::PxVec4* positions, physx::PxU32 count, physx::PxCpuDispatcher* dispatcher);
+    // indexes the active particles of a particle system, GPU buffers are copied first
+    void build(PxPbdHandle* handle, physx::PxCpuDispatcher* dispatcher);
+
+    // Batched queries return indices into the array the index was built from.
+    // Every query owns maxResults slots of results, counts receives the full
+    // number of hits even if it did not fit.
+    void queryRadius(const physx::PxVec3* centers, const float* radii, physx::PxU32 nbQueries, physx::PxU32 maxResults,
+        physx::PxU32* results, physx::PxU32* counts, physx::PxCpuDispatcher* dispatcher) const;
+    void queryBox(const physx::PxBounds3* boxes, physx::PxU32 nbQueries, physx::PxU32 maxResults,
+        physx::PxU32* results, physx::PxU32* counts, physx::PxCpuDispatcher* dispatcher) const;
+    // k nearest particles within maxRadius sorted by distance, distances may be NULL
+    void queryNearest(const physx::PxVec3* centers, physx::PxU32 nbQueries, physx::PxU32 k, float maxRadius,
+        physx::PxU32* results, float* distances, physx::PxU32* counts, physx::PxCpuDispatcher* dispatcher) const;
+
+    // fills buckets with the distinct buckets of all cells overlapping box
+    void collectBuckets(const physx::PxBounds3& box, std::vector<physx::PxU32>& buckets) const;
+
+    // calls fn(index, squaredDistance) for every particle within radius of center
+    template<typename F>
+    void forEachInRadius(const physx::PxVec3& center, float radius, std::vector<physx::PxU32>& buckets, const F& fn) const {
+        collectBuckets(physx::PxBounds3(center - physx::PxVec3(radius), center + physx::PxVec3(radius)), buckets);
+        auto r2 = radius * radius;
+        for(auto b : buckets) {
+            for(auto k = CellStart[b]; k < CellEnd[b]; k++) {
+                auto d2 = (SortedPositions[k].getXYZ() - center).magnitudeSquared();
+                if(d2 <= r2) fn(SortedIndices[k], d2);
+            }
+        }
+    }
+
+private:
+    physx::PxU32 CellMask;
+    physx::PxU32 KeyBits;
+    std::vector<physx::PxU32> Keys;
+    std::vector<physx::PxU32> SortedIndices;
+    std::vector<physx::PxVec4> SortedPositions;
+    std::vector<physx::PxU32> CellStart;
+    std::vector<physx::PxU32> CellEnd;
+
+    // radix sort scratch
+    std::vector<physx::PxU32> TempKeys;
+    std::vector<physx::PxU32> TempIndices;
+    std::vector<physx::PxU32> Histograms;
+
+    // host copy of GPU particle positions
+    std::vector<physx::PxVec4> Staging;
+};
+
+DllExport(ParticleIndex*) pxCreateParticleIndex(float cellSize);
+DllExport(void) pxDestroyParticleIndex(ParticleIndex* index);
+DllExport(void) pxBuildParticleIndex(ParticleIndex* index, const V4f* positions, physx::PxU32 count);
+DllExport(void) pxBuildParticleIndexFromPBD(ParticleIndex* index, PxPbdHandle* handle);
+DllExport(void) pxQueryParticlesRadius(ParticleIndex* index, const V3f* centers, const float* radii, physx::PxU32 nbQueries,
+    physx::PxU32 maxResults, physx::PxU32* results, physx::PxU32* counts);
+DllExport(void) pxQueryParticlesBox(ParticleIndex* index, const V3f* boxMin, const V3f* boxMax, physx::PxU32 nbQueries,
+    physx::PxU32 maxResults, physx::PxU32* results, physx::PxU32* counts);
+DllExport(void) pxQueryParticlesNearest(ParticleIndex* index, const V3f* centers, physx::PxU32 nbQueries, physx::PxU32 k, float maxRadius,
+    physx::PxU32* results, float* distances, physx::PxU32* counts);
@@ -0,0 +1,326 @@
+#include "ParticleReadback.h"
+#include "CpuParticleSystem.h"
+#include "Parallel.h"
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <cudamanager/PxCudaContext.h>
+#include <cudamanager/PxCudaContextManager.h>
+
+using namespace physx;
+
+static const PxCUresult CudaSuccess = 0;
+static const unsigned int CudaEventDisableTiming = 2;
+static const PxU32 MiddleDirty = 4;
+static const PxU32 PackGrain = 4096;
+
+PxU16 floatToHalf(float f) {
+    PxU32 x;
+    memcpy(&x, &f, sizeof(float));
+    PxU32 sign = (x >> 16) & 0x8000;
+    PxU32 exp = (x >> 23) & 0xff;
+    PxU32 mant = x & 0x7fffff;
+
+    if(exp == 0xff) return (PxU16)(sign | 0x7c00 | (mant ? 0x200 : 0));
+
+    PxI32 e = (PxI32)exp - 127 + 15;
+    if(e >= 0x1f) return (PxU16)(sign | 0x7c00);
+    if(e <= 0) {
+        // subnormal half, round to nearest even
+        if(e < -10) return (PxU16)sign;
+        mant |= 0x800000;
+        PxU32 shift = (PxU32)(14 - e);
+        PxU32 h = mant >> shift;
+        PxU32 rem = mant & ((1u << shift) - 1);
+        PxU32 halfway = 1u << (shift - 1);
+        if(rem > halfway || (rem == halfway && (h & 1))) h++;
+        return (PxU16)(sign | h);
+    }
+
+    // a carry out of the mantissa correctly bumps the exponent (up to infinity)
+    PxU32 h = ((PxU32)e << 10) | (mant >> 13);
+    PxU32 rem = mant & 0x1fff;
+    if(rem > 0x1000 || (rem == 0x1000 && (h & 1))) h++;
+    return (PxU16)(sign | h);
+}
+
+float halfToFloat(PxU16 h) {
+    PxU32 sign = ((PxU32)h & 0x8000) << 16;
+    PxU32 exp = (h >> 10) & 0x1f;
+    PxU32 mant = h & 0x3ff;
+
+    PxU32 x;
+    if(exp == 0) {
+        float f = (float)mant * 5.9604644775390625e-8f;
+        return sign ? -f : f;
+    }
+    else if(exp == 0x1f) x = sign | 0x7f800000 | (mant << 13);
+    else x = sign | ((exp + 112) << 23) | (mant << 13);
+
+    float f;
+    memcpy(&f, &x, sizeof(float));
+    return f;
+}
+
+PxBounds3 computeParticleBounds(const PxVec4* positions, PxU32 count) {
+    auto b = PxBounds3::empty();
+    for(PxU32 i = 0; i < count; i++) b.include(positions[i].getXYZ());
+    return b;
+}
+
+void packFloat3(const PxVec4* positions, PxU32 count, float* out) {
+    for(PxU32 i = 0; i < count; i++) {
+        out[3 * i + 0] = positions[i].x;
+        out[3 * i + 1] = positions[i].y;
+        out[3 * i + 2] = positions[i].z;
+    }
+}
+
+void packHalf3(const PxVec4* positions, PxU32 count, PxU16* out) {
+    for(PxU32 i = 0; i < count; i++) {
+        out[3 * i + 0] = floatToHalf(positions[i].x);
+        out[3 * i + 1] = floatToHalf(positions[i].y);
+        out[3 * i + 2] = floatToHalf(positions[i].z);
+    }
+}
+
+void packQuantized16(const PxVec4* positions, PxU32 count, const PxBounds3& bounds, PxU16* out) {
+    auto size = bounds.getDimensions();
+    PxVec3 scale(
+        size.x > 0.0f ? 65535.0f / size.x : 0.0f,
+        size.y > 0.0f ? 65535.0f / size.y : 0.0f,
+        size.z > 0.0f ? 65535.0f / size.z : 0.0f
+    );
+    for(PxU32 i = 0; i < count; i++) {
+        auto p = (positions[i].getXYZ() - bounds.minimum).multiply(scale);
+        out[3 * i + 0] = (PxU16)PxClamp(p.x + 0.5f, 0.0f, 65535.0f);
+        out[3 * i + 1] = (PxU16)PxClamp(p.y + 0.5f, 0.0f, 65535.0f);
+        out[3 * i + 2] = (PxU16)PxClamp(p.z + 0.5f, 0.0f, 65535.0f);
+    }
+}
+
+PxU32 packedParticleSize(PxU32 format) {
+    switch(format) {
+        case PxParticleFormatFloat3: return 3 * sizeof(float);
+        case PxParticleFormatHalf3: return 3 * sizeof(PxU16);
+        case PxParticleFormatQuantized16: return 3 * sizeof(PxU16);
+        default: return 0;
+    }
+}
+
+
+ParticleRing::ParticleRing(PxU32 capacity, PxU32 channels, PxU32 format, ParticleAllocFn alloc, ParticleFreeFn free, void* user)
+    : Capacity(capacity), Channels(channels), Format(format), Back(0), Front(2), Middle(1), HasFront(false), Alloc(alloc), Free(free), User(user) {
+
+    if(Format != PxParticleFormatNone) Channels |= PxParticleReadbackPosition;
+    for(auto& s : Slots) {
+        s.PositionInvMass = (Channels & PxParticleReadbackPosition) ? (PxVec4*)Alloc(User, sizeof(PxVec4) * capacity) : nullptr;
+        s.Velocity = (Channels & PxParticleReadbackVelocity) ? (PxVec4*)Alloc(User, sizeof(PxVec4) * capacity) : nullptr;
+        s.Phase = (Channels & PxParticleReadbackPhase) ? (PxU32*)Alloc(User, sizeof(PxU32) * capacity) : nullptr;
+        s.Packed = Format != PxParticleFormatNone ? Alloc(User, packedParticleSize(Format) * capacity) : nullptr;
+        s.Count = 0;
+        s.Frame = 0;
+        s.Bounds = PxBounds3::empty();
+    }
+}
+
+ParticleRing::~ParticleRing() {
+    for(auto& s : Slots) {
+        if(s.PositionInvMass) Free(User, s.PositionInvMass);
+        if(s.Velocity) Free(User, s.Velocity);
+        if(s.Phase) Free(User, s.Phase);
+        if(s.Packed) Free(User, s.Packed);
+    }
+}
+
+void ParticleRing::publish() {
+    auto old = Middle.exchange(Back | MiddleDirty);
+    Back = old & 3;
+}
+
+const ParticleReadbackSlot* ParticleRing::acquire(bool& isNew) {
+    isNew = false;
+    if(Middle.load() & MiddleDirty) {
+        auto old = Middle.exchange(Front);
+        Front = old & 3;
+        HasFront = true;
+        isNew = true;
+    }
+    return HasFront ? &Slots[Front] : nullptr;
+}
+
+void ParticleRing::pack(PxCpuDispatcher* dispatcher) {
+    auto& s = Slots[Back];
+    if(!s.PositionInvMass) return;
+
+    // bounds are reported with every frame, quantization depends on them
+    auto chunks = (s.Count + PackGrain - 1) / PackGrain;
+    std::vector<PxBounds3> partial(chunks);
+    parallelFor(dispatcher, s.Count, PackGrain, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 c = begin / PackGrain; c * PackGrain < end; c++) {
+            auto b = c * PackGrain;
+            partial[c] = computeParticleBounds(s.PositionInvMass + b, PxMin(PackGrain, s.Count - b));
+        }
+    });
+    s.Bounds = PxBounds3::empty();
+    for(auto& b : partial) s.Bounds.include(b);
+
+    if(Format == PxParticleFormatNone) return;
+    parallelFor(dispatcher, s.Count, PackGrain, [&](PxU32 begin, PxU32 end) {
+        auto src = s.PositionInvMass + begin;
+        auto n = end - begin;
+        switch(Format) {
+            case PxParticleFormatFloat3: packFloat3(src, n, (float*)s.Packed + 3 * begin); break;
+            case PxParticleFormatHalf3: packHalf3(src, n, (PxU16*)s.Packed + 3 * begin); break;
+            case PxParticleFormatQuantized16: packQuantized16(src, n, s.Bounds, (PxU16*)s.Packed + 3 * begin); break;
+            default: break;
+        }
+    });
+}
+
+
+static void* hostAlloc(void*, size_t bytes) {
+    return malloc(bytes);
+}
+
+static void hostFree(void*, void* ptr) {
+    free(ptr);
+}
+
+static void* pinnedAlloc(void* user, size_t bytes) {
+    return ((PxCudaContextManager*)user)->allocPinnedHostBuffer<PxU8>((PxU32)bytes);
+}
+
+static void pinnedFree(void* user, void* ptr) {
+    auto p = (PxU8*)ptr;
+    ((PxCudaContextManager*)user)->freePinnedHostBuffer(p);
+}
+
+ParticleReadback::ParticleReadback(PxPbdHandle* handle, PxU32 channels, PxU32 format)
+    : Handle(handle), Ring(nullptr), Frame(0), Stream(nullptr), Snapshot(nullptr), Done(nullptr), InFlight(false) {
+    Staging[0] = Staging[1] = Staging[2] = 0;
+
+    if(auto cpu = handle->CpuParticles) {
+        Ring = new ParticleRing(cpu->MaxParticles, channels, format, hostAlloc, hostFree, nullptr);
+        return;
+    }
+
+    auto cm = handle->CudaManager;
+    auto capacity = handle->ParticleBuffer->getMaxParticles();
+    Ring = new ParticleRing(capacity, channels, format, pinnedAlloc, pinnedFree, cm);
+    auto ch = Ring->Channels;
+
+    cm->acquireContext();
+    auto ctx = cm->getCudaContext();
+    ctx->streamCreate(&Stream, 0);
+    ctx->eventCreate(&Snapshot, CudaEventDisableTiming);
+    ctx->eventCreate(&Done, CudaEventDisableTiming);
+    if(ch & PxParticleReadbackPosition) ctx->memAlloc(&Staging[0], sizeof(PxVec4) * capacity);
+    if(ch & PxParticleReadbackVelocity) ctx->memAlloc(&Staging[1], sizeof(PxVec4) * capacity);
+    if(ch & PxParticleReadbackPhase) ctx->memAlloc(&Staging[2], sizeof(PxU32) * capacity);
+    cm->releaseContext();
+}
+
+ParticleReadback::~ParticleReadback() {
+    if(auto cm = Handle->CudaManager) {
+        cm->acquireContext();
+        auto ctx = cm->getCudaContext();
+        ctx->streamSynchronize(Stream);
+        for(auto s : Staging) if(s) ctx->memFree(s);
+        ctx->eventDestroy(Snapshot);
+        ctx->eventDestroy(Done);
+        ctx->streamDestroy(Stream);
+        cm->releaseContext();
+    }
+    delete Ring;
+}
+
+bool ParticleReadback::update() {
+    if(auto cpu = Handle->CpuParticles) {
+        auto& slot = Ring->back();
+        auto n = PxMin(cpu->NbActiveParticles, Ring->Capacity);
+        if(slot.PositionInvMass) memcpy((void*)slot.PositionInvMass, cpu->PositionInvMass.data(), sizeof(PxVec4) * n);
+        if(slot.Velocity) memcpy((void*)slot.Velocity, cpu->Velocity.data(), sizeof(PxVec4) * n);
+        if(slot.Phase) memcpy(slot.Phase, cpu->Phase.data(), sizeof(PxU32) * n);
+        slot.Count = n;
+        slot.Frame = ++Frame;
+        Ring->pack(sharedDispatcher());
+        Ring->publish();
+        return true;
+    }
+
+    auto cm = Handle->CudaManager;
+    cm->acquireContext();
+    auto ctx = cm->getCudaContext();
+
+    bool published = false;
+    if(InFlight) {
+        if(ctx->eventQuery(Done) != CudaSuccess) {
+            // the previous transfer is still running, skip this frame
+            cm->releaseContext();
+            return false;
+        }
+        InFlight = false;
+        Ring->pack(sharedDispatcher());
+        Ring->publish();
+        published = true;
+    }
+
+    auto buffer = Handle->ParticleBuffer;
+    auto n = PxMin(buffer->getNbActiveParticles(), Ring->Capacity);
+    auto& slot = Ring->back();
+    slot.Count = n;
+    slot.Frame = ++Frame;
+
+    // device-side snapshot of the active range first, the next simulate may
+    // overwrite the particle buffer as soon as this returns
+    if(n > 0) {
+        if(Staging[0]) ctx->memcpyDtoDAsync(Staging[0], CUdeviceptr(buffer->getPositionInvMasses()), sizeof(PxVec4) * n, Stream);
+        if(Staging[1]) ctx->memcpyDtoDAsync(Staging[1], CUdeviceptr(buffer->getVelocities()), sizeof(PxVec4) * n, Stream);
+        if(Staging[2]) ctx->memcpyDtoDAsync(Staging[2], CUdeviceptr(buffer->getPhases()), sizeof(PxU32) * n, Stream);
+    }
+    ctx->eventRecord(Snapshot, Stream);
+    if(n > 0) {
+        if(Staging[0]) ctx->memcpyDtoHAsync(slot.PositionInvMass, Staging[0], sizeof(PxVec4) * n, Stream);
+        if(Staging[1]) ctx->memcpyDtoHAsync(slot.Velocity, Staging[1], sizeof(PxVec4) * n, Stream);
+        if(Staging[2]) ctx->memcpyDtoHAsync(slot.Phase, Staging[2], sizeof(PxU32) * n, Stream);
+    }
+    ctx->eventRecord(Done, Stream);
+    ctx->eventSynchronize(Snapshot);
+    InFlight = true;
+
+    cm->releaseContext();
+    return published;
+}
+
+
+DllExport(ParticleReadback*) pxCreateParticleReadback(PxPbdHandle* handle, PxU32 channels, PxU32 format) {
+    return new ParticleReadback(handle, channels, format);
+}
+
+DllExport(void) pxDestroyParticleReadback(ParticleReadback* readback) {
+    delete readback;
+}
+
+DllExport(int) pxUpdateParticleReadback(ParticleReadback* readback) {
+    return readback->update() ? 1 : 0;
+}
+
+DllExport(int) pxAcquireParticleReadback(ParticleReadback* readback, PxParticleReadbackFrame* frame) {
+    bool isNew = false;
+    auto s = readback->ring().acquire(isNew);
+    if(!s) {
+        memset(frame, 0, sizeof(PxParticleReadbackFrame));
+        return 0;
+    }
+    frame->Frame = s->Frame;
+    frame->Count = s->Count;
+    frame->Format = readback->ring().Format;
+    frame->PositionInvMass = (const V4f*)s->PositionInvMass;
+    frame->Velocity = (const V4f*)s->Velocity;
+    frame->Phase = s->Phase;
+    frame->Packed = s->Packed;
+    frame->BoundsMin = { s->Bounds.minimum.x, s->Bounds.minimum.y, s->Bounds.minimum.z };
+    frame->BoundsMax = { s->Bounds.maximum.x, s->Bounds.maximum.y, s->Bounds.maximum.z };
+    return isNew ? 1 : 0;
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include <atomic>
+
+// Which buffers a readback fetches, positions are always fetched when a packed
+// format is requested.
+enum PxParticleReadbackChannel {
+    PxParticleReadbackPosition = 1,
+    PxParticleReadbackVelocity = 2,
+    PxParticleReadbackPhase = 4
+};
+
+// Packed position formats, PxParticleFormatNone only provides the raw posInvMass.
+enum PxParticleFormat {
+    PxParticleFormatNone = 0,
+    PxParticleFormatFloat3 = 1,     // 3 x float
+    PxParticleFormatHalf3 = 2,      // 3 x IEEE half
+    PxParticleFormatQuantized16 = 3 // 3 x uint16 relative to the frame bounds
+};
+
+typedef struct {
+    physx::PxU64 Frame;
+    physx::PxU32 Count;
+    physx::PxU32 Format;
+    const V4f* PositionInvMass;
+    const V4f* Velocity;
+    const physx::PxU32* Phase;
+    const void* Packed;
+    V3f BoundsMin;
+    V3f BoundsMax;
+} PxParticleReadbackFrame;
+
+// Host-side packing, independent of the particle backend.
+physx::PxU16 floatToHalf(float f);
+float halfToFloat(physx::PxU16 h);
+physx::PxBounds3 computeParticleBounds(const physx::PxVec4* positions, physx::PxU32 count);
+void packFloat3(const physx::PxVec4* positions, physx::PxU32 count, float* out);
+void packHalf3(const physx::PxVec4* positions, physx::PxU32 count, physx::PxU16* out);
+void packQuantized16(const physx::PxVec4* positions, physx::PxU32 count, const physx::PxBounds3& bounds, physx::PxU16* out);
+physx::PxU32 packedParticleSize(physx::PxU32 format);
+
+typedef void* (*ParticleAllocFn)(void* user, size_t bytes);
+typedef void (*ParticleFreeFn)(void* user, void* ptr);
+
+struct ParticleReadbackSlot {
+    physx::PxVec4* PositionInvMass;
+    physx::PxVec4* Velocity;
+    physx::PxU32* Phase;
+    void* Packed;
+    physx::PxU32 Count;
+    physx::PxU64 Frame;
+    physx::PxBounds3 Bounds;
+};
+
+// Triple buffer of readback slots. The producer fills back() and publishes it,
+// the consumer swaps in the newest published slot on acquire(). Neither side
+// ever waits for the other, handing over a frame is an index exchange.
+class ParticleRing {
+public:
+    ParticleRing(physx::PxU32 capacity, physx::PxU32 channels, physx::PxU32 format, ParticleAllocFn alloc, ParticleFreeFn free, void* user);
+    ~ParticleRing();
+
+    physx::PxU32 Capacity;
+    physx::PxU32 Channels;
+    physx::PxU32 Format;
+
+    ParticleReadbackSlot& back() { return Slots[Back]; }
+    void publish();
+    // returns nullptr until the first frame was published, isNew tells whether
+    // the slot changed since the last acquire
+    const ParticleReadbackSlot* acquire(bool& isNew);
+
+    // computes the bounds of back() and packs it according to Format
+    void pack(physx::PxCpuDispatcher* dispatcher);
+
+private:
+    ParticleReadbackSlot Slots[3];
+    physx::PxU32 Back;
+    physx::PxU32 Front;
+    std::atomic<physx::PxU32> Middle;
+    bool HasFront;
+    ParticleAllocFn Alloc;
+    ParticleFreeFn Free;
+    void* User;
+};
+
+class ParticleReadback {
+public:
+    ParticleReadback(PxPbdHandle* handle, physx::PxU32 channels, physx::PxU32 format);
+    ~ParticleReadback();
+
+    // publishes a finished copy and starts the next one, never waits for the bus
+    bool update();
+
+    ParticleRing& ring() { return *Ring; }
+
+private:
+    PxPbdHandle* Handle;
+    ParticleRing* Ring;
+    physx::PxU64 Frame;
+
+    // GPU path: active ranges are snapshotted into device staging buffers and
+    // then copied to the pinned ring slot asynchronously
+    CUstream Stream;
+    CUevent Snapshot;
+    CUevent Done;
+    CUdeviceptr Staging[3];
+    bool InFlight;
+};
+
+DllExport(ParticleReadback*) pxCreateParticleReadback(PxPbdHandle* handle, physx::PxU32 channels, physx::PxU32 format);
+DllExport(void) pxDestroyParticleReadback(ParticleReadback* readback);
+DllExport(int) pxUpdateParticleReadback(ParticleReadback* readback);
+DllExport(int) pxAcquireParticleReadback(ParticleReadback* readback, PxParticleReadbackFrame* frame);
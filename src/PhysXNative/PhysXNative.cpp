@@ -2,7 +2,15 @@
 //
 
 #include "PhysXNative.h"
+#include "MassCache.h"
+#include "Parallel.h"
+#include "CpuParticleSystem.h"
+#include "CollisionLayers.h"
+#include "CcdManager.h"
+#include "SceneEvents.h"
+#include "ParticleEmitter.h"
 #include <string>
+#include <cstring>
 #include <iostream>
 
 #include <PxPhysicsAPI.h>
@@ -24,7 +32,7 @@ using namespace ExtGpu;
 
 static PxDefaultErrorCallback gDefaultErrorCallback;
 static PxDefaultAllocator gDefaultAllocatorCallback;
-static PxSimulationFilterShader gDefaultFilterShader = PxDefaultSimulationFilterShader;
+static PxSimulationFilterShader gDefaultFilterShader = layerFilterShader;
 static PxParticleInfo gParticleInfo = PxParticleInfo();
 static physx::PxU32 gMaxParticles = 0;
 
@@ -116,13 +124,25 @@ DllExport(PxRigidDynamic*) pxCreateDynamicComposite(PxSceneHandle* scene, float
         thing->attachShape(*shape);
     
     }
-    PxRigidBodyExt::updateMassAndInertia(*thing, density);
+    massCache().updateMassAndInertia(*thing, density);
     return thing;
 }
 
 DllExport(PxRigidDynamic*) pxCreateDynamic(PxSceneHandle* scene, PxMaterial* mat, float density, Euclidean3d trafo, PxGeometry* geometry) {
     PxTransform pose(PxVec3((float)trafo.Trans.X, (float)trafo.Trans.Y, (float)trafo.Trans.Z), PxQuat((float)trafo.Rot.X, (float)trafo.Rot.Y, (float)trafo.Rot.Z, (float)trafo.Rot.W));
-    return PxCreateDynamic(*scene->Physics, pose, *geometry, *mat, density);
+    // the checks of PxCreateDynamic, which this replaces to go through the mass cache
+    if(!pose.isValid() || !(density > 0.0f) || !PxGeometryQuery::isValid(*geometry)) return nullptr;
+    auto type = geometry->getType();
+    if(type == PxGeometryType::ePLANE || type == PxGeometryType::eTRIANGLEMESH || type == PxGeometryType::eHEIGHTFIELD) return nullptr;
+
+    auto thing = scene->Physics->createRigidDynamic(pose);
+    if(!thing) return nullptr;
+    if(!PxRigidActorExt::createExclusiveShape(*thing, *geometry, *mat)) {
+        thing->release();
+        return nullptr;
+    }
+    massCache().updateMassAndInertia(*thing, density);
+    return thing;
 }
 
 DllExport(void) pxSetLinearVelocity(PxRigidDynamic* actor, V3d vel) {
@@ -134,7 +154,7 @@ DllExport(void) pxSetAngularVelocity(PxRigidDynamic* actor, V3d vel) {
 }
 
 DllExport(void) pxSetDensity(PxRigidDynamic* actor, float density) {
-    PxRigidBodyExt::updateMassAndInertia(*actor, density);
+    massCache().updateMassAndInertia(*actor, density);
 }
 
 
@@ -181,14 +201,27 @@ DllExport(void*) pxAddStaticPlane(PxSceneHandle* scene, V4d coeff, PxMaterial* m
 } 
 
 
-DllExport(void) pxSimulate(PxSceneHandle* scene, float dt) {
+void stepScene(PxSceneHandle* scene, float dt) {
     if(dt > 0.0) {
+        if(scene->Ccd) scene->Ccd->beforeStep(dt, sharedDispatcher());
+        if(scene->Events) scene->Events->clear();
         scene->Scene->simulate(dt);
         scene->Scene->fetchResults(true);
-        scene->Scene->fetchResultsParticleSystem();
+        if(scene->CudaManager) scene->Scene->fetchResultsParticleSystem();
+        if(scene->Ccd) scene->Ccd->afterStep();
+
+        auto gravity = scene->Scene->getGravity();
+        auto dispatcher = scene->Scene->getCpuDispatcher();
+        for(auto s = scene->CpuParticleSystems; s; s = s->Next) {
+            s->step(dt, gravity, scene->Scene, dispatcher);
+        }
     }
 }
 
+DllExport(void) pxSimulate(PxSceneHandle* scene, float dt) {
+    stepScene(scene, dt);
+}
+
 DllExport(void) pxGetPose(PxRigidActor* actor, Euclidean3d& trafo) {
     auto pose = actor->getGlobalPose();
     trafo.Trans.X = pose.p.x;
@@ -206,18 +239,32 @@ DllExport(PxSceneHandle*) pxCreateScene(PxHandle* handle, V3d gravity) {
 
     PxCudaContextManagerDesc cudaContextManagerDesc;
     auto cudaContextManager = PxCreateCudaContextManager(*handle->Foundation, cudaContextManagerDesc, PxGetProfilerCallback());
-    sceneDesc.cudaContextManager = cudaContextManager;
+    if(cudaContextManager && !cudaContextManager->contextIsValid()) {
+        // no usable GPU, rigid bodies and particles run on the CPU
+        cudaContextManager->release();
+        cudaContextManager = nullptr;
+    }
 
-    sceneDesc.flags |= PxSceneFlag::eENABLE_GPU_DYNAMICS;
-    sceneDesc.broadPhaseType = PxBroadPhaseType::eGPU;
+    if(cudaContextManager) {
+        sceneDesc.cudaContextManager = cudaContextManager;
+        sceneDesc.flags |= PxSceneFlag::eENABLE_GPU_DYNAMICS;
+        sceneDesc.broadPhaseType = PxBroadPhaseType::eGPU;
+    }
+    sceneDesc.flags |= PxSceneFlag::eENABLE_ACTIVE_ACTORS;
+    // only bodies with a CCD flag pay for it, see pxSetCcdModes
+    sceneDesc.flags |= PxSceneFlag::eENABLE_CCD;
 
     if(!sceneDesc.cpuDispatcher) {
-        PxDefaultCpuDispatcher* mCpuDispatcher = PxDefaultCpuDispatcherCreate(1);
+        PxDefaultCpuDispatcher* mCpuDispatcher = PxDefaultCpuDispatcherCreate(defaultWorkerCount());
         if(!mCpuDispatcher) return nullptr;
         sceneDesc.cpuDispatcher = mCpuDispatcher;
     }
-    if(!sceneDesc.filterShader)
+    if(!sceneDesc.filterShader) {
+        // every layer collides until a table is applied with pxApplyCollisionLayers
         sceneDesc.filterShader = gDefaultFilterShader;
+        sceneDesc.filterShaderData = defaultCollisionLayers().data();
+        sceneDesc.filterShaderDataSize = defaultCollisionLayers().size();
+    }
 
     auto scene = handle->Physics->createScene(sceneDesc);
 
@@ -233,18 +280,124 @@ DllExport(PxSceneHandle*) pxCreateScene(PxHandle* handle, V3d gravity) {
     return sceneHandle;
 }
 
-DllExport(void) pxDestroyScene(PxPbdHandle* handle) {
+DllExport(void) pxDestroyScene(PxSceneHandle* handle) {
     //delete handle->ParticleInfo.posInvMass;
     //delete handle->ParticleInfo.velocity;
     //delete handle->ParticleInfo.phase;
+    // the scene owns the CPU particle systems of its pbd handles
+    for(auto s = handle->CpuParticleSystems; s; ) {
+        auto next = s->Next;
+        delete s;
+        s = next;
+    }
+    handle->CpuParticleSystems = nullptr;
+    delete handle->Ccd;
+    if(handle->Events) {
+        handle->Scene->setSimulationEventCallback(nullptr);
+        delete handle->Events;
+    }
     handle->Scene->release();
     delete handle;
 }
 
+static PxReal particleMassOf(PxReal particleSpacing, PxReal fluidDensity) {
+    return fluidDensity * 1.333f * 3.14159f * particleSpacing * particleSpacing * particleSpacing;
+}
+
+// Fills a numParticlesDim^3 block of particles, the material index changes along x.
+static void fillParticleBlock(
+        PxVec4* positionInvMass, PxVec4* velocity, PxU32* phase, const PxU32* phases, PxU32 maxMaterials,
+        float centerX, float centerY, float centerZ, PxU32 numParticlesDim, PxReal particleSpacing, PxReal fluidDensity) {
+    PxU32 numX = numParticlesDim;
+    PxU32 numY = numParticlesDim;
+    PxU32 numZ = numParticlesDim;
+    PxReal x = centerX;
+    PxReal y = centerY;
+    PxReal z = centerZ;
+    const PxReal particleMass = particleMassOf(particleSpacing, fluidDensity);
+    for (PxU32 i = 0; i < numX; ++i)
+    {
+        for (PxU32 j = 0; j < numY; ++j)
+        {
+            for (PxU32 k = 0; k < numZ; ++k)
+            {
+                const PxU32 index = i * (numY * numZ) + j * numZ + k;
+                const PxU16 matIndex = (PxU16)(i * maxMaterials / numX);
+                const PxVec4 pos(x, y, z, 1.0f / particleMass);
+                phase[index] = phases[matIndex];
+                positionInvMass[index] = pos;
+                velocity[index] = PxVec4(0.0f);
+
+                z += particleSpacing;
+            }
+            z = centerZ;
+            y += particleSpacing;
+        }
+        y = centerY;
+        x += particleSpacing;
+    }
+}
+
+static PxPbdHandle* createCpuPBD(
+        PxSceneHandle* sceneHandle, PxU32 maxParticles, 
+        float centerX, float centerY, float centerZ, PxU32 numParticlesDim,
+        PxReal particleSpacing, PxReal fluidDensity) {
+
+    auto particleSystem = new CpuParticleSystem(maxParticles, particleSpacing);
+
+    const PxReal restOffset = 0.5f * particleSpacing / 0.6f;
+    const PxReal solidRestOffset = restOffset;
+    const PxReal fluidRestOffset = restOffset * 0.6f;
+    particleSystem->RestOffset = restOffset;
+    particleSystem->ContactOffset = restOffset + 0.01f;
+    particleSystem->ParticleContactOffset = fluidRestOffset / 0.6f;
+    particleSystem->SolidRestOffset = solidRestOffset;
+    particleSystem->FluidRestOffset = fluidRestOffset;
+    particleSystem->MaxVelocity = solidRestOffset * 100.f;
+
+    // same materials as the GPU path
+    const PxU32 maxMaterials = 3;
+    PxU32 phases[maxMaterials];
+    for (PxU32 i = 0; i < maxMaterials; ++i)
+    {
+        CpuPbdMaterial mat = { 0.05f, i / (maxMaterials - 1.0f), 10.002f * (i + 1), 0.01f };
+        phases[i] = particleSystem->createPhase(mat, PxParticlePhaseFlags(PxParticlePhaseFlag::eParticlePhaseFluid | PxParticlePhaseFlag::eParticlePhaseSelfCollide));
+    }
+
+    const PxU32 numParticles = numParticlesDim * numParticlesDim * numParticlesDim;
+    if(numParticles > maxParticles) {
+        delete particleSystem;
+        return nullptr;
+    }
+    fillParticleBlock(
+        particleSystem->PositionInvMass.data(), particleSystem->Velocity.data(), particleSystem->Phase.data(), phases, maxMaterials,
+        centerX, centerY, centerZ, numParticlesDim, particleSpacing, fluidDensity
+    );
+    particleSystem->NbActiveParticles = numParticles;
+
+    particleSystem->Next = sceneHandle->CpuParticleSystems;
+    sceneHandle->CpuParticleSystems = particleSystem;
+
+    auto pbdHandle = new PxPbdHandle();
+    pbdHandle->Foundation = sceneHandle->Foundation;
+    pbdHandle->Physics = sceneHandle->Physics;
+    pbdHandle->Scene = sceneHandle->Scene;
+    pbdHandle->Cooking = sceneHandle->Cooking;
+    pbdHandle->CpuParticles = particleSystem;
+    pbdHandle->Owner = sceneHandle;
+    pbdHandle->DefaultPhase = phases[0];
+    pbdHandle->DefaultInvMass = 1.0f / particleMassOf(particleSpacing, fluidDensity);
+    return pbdHandle;
+}
+
 DllExport(PxPbdHandle*) pxCreatePBD(
         PxSceneHandle* sceneHandle, PxU32 maxParticles, 
         float centerX, float centerY, float centerZ, PxU32 numParticlesDim,
-        PxReal particleSpacing = 0.2f, PxReal fluidDensity = 1000.f) {
+        PxReal particleSpacing, PxReal fluidDensity) {
+
+    if(!sceneHandle->CudaManager) {
+        return createCpuPBD(sceneHandle, maxParticles, centerX, centerY, centerZ, numParticlesDim, particleSpacing, fluidDensity);
+    }
 
     PxPBDParticleSystem* particleSystem = sceneHandle->Physics->createPBDParticleSystem(*sceneHandle->CudaManager, 96);
 
@@ -266,6 +419,7 @@ DllExport(PxPbdHandle*) pxCreatePBD(
     pbdHandle->Cooking = sceneHandle->Cooking;
     pbdHandle->CudaManager = sceneHandle->CudaManager;
     pbdHandle->Pbd = particleSystem;
+    pbdHandle->Owner = sceneHandle;
 
     gMaxParticles = maxParticles;
     gParticleInfo.posInvMass = new PxArray<PxVec4>(maxParticles);
@@ -288,38 +442,14 @@ DllExport(PxPbdHandle*) pxCreatePBD(
         phases[i] = pbdHandle->Pbd->createPhase(mat, PxParticlePhaseFlags(PxParticlePhaseFlag::eParticlePhaseFluid | PxParticlePhaseFlag::eParticlePhaseSelfCollide));
     }
 
-    PxU32 numX = numParticlesDim;
-    PxU32 numY = numParticlesDim;
-    PxU32 numZ = numParticlesDim;
-    PxReal x = centerX;
-    PxReal y = centerY;
-    PxReal z = centerZ;
-    const PxReal particleMass = fluidDensity * 1.333f * 3.14159f * particleSpacing * particleSpacing * particleSpacing;
-    for (PxU32 i = 0; i < numX; ++i)
-    {
-        for (PxU32 j = 0; j < numY; ++j)
-        {
-            for (PxU32 k = 0; k < numZ; ++k)
-            {
-                const PxU32 index = i * (numY * numZ) + j * numZ + k;
-                const PxU16 matIndex = (PxU16)(i * maxMaterials / numX);
-                const PxVec4 pos(x, y, z, 1.0f / particleMass);
-                phase[index] = phases[matIndex];
-                positionInvMass[index] = pos;
-                velocity[index] = PxVec4(0.0f);
-
-                z += particleSpacing;
-            }
-            z = centerZ;
-            y += particleSpacing;
-        }
-        y = centerY;
-        x += particleSpacing;
-    }
+    fillParticleBlock(positionInvMass, velocity, phase, phases, maxMaterials, centerX, centerY, centerZ, numParticlesDim, particleSpacing, fluidDensity);
+    pbdHandle->DefaultPhase = phases[0];
+    pbdHandle->DefaultInvMass = 1.0f / particleMassOf(particleSpacing, fluidDensity);
 
+    // only the filled block is live, the rest of the buffer is left to emitters
     ExtGpu::PxParticleBufferDesc bufferDesc;
     bufferDesc.maxParticles = gMaxParticles;
-    bufferDesc.numActiveParticles = gMaxParticles;
+    bufferDesc.numActiveParticles = PxMin(numParticlesDim * numParticlesDim * numParticlesDim, gMaxParticles);
 
     bufferDesc.positions = positionInvMass;
     bufferDesc.velocities = velocity;
@@ -336,71 +466,49 @@ DllExport(PxPbdHandle*) pxCreatePBD(
     return pbdHandle;
 }
 
+// readbacks and indices built from the handle must be destroyed first, the
+// scene releases everything left over when it is destroyed
+DllExport(void) pxDestroyPBD(PxPbdHandle* handle) {
+    delete handle->Emitters;
+    if(auto cpu = handle->CpuParticles) {
+        auto link = &handle->Owner->CpuParticleSystems;
+        while(*link && *link != cpu) link = &(*link)->Next;
+        if(*link) *link = cpu->Next;
+        delete cpu;
+    }
+    if(handle->Pbd) {
+        handle->Pbd->removeParticleBuffer(handle->ParticleBuffer);
+        handle->ParticleBuffer->release();
+        handle->Pbd->release();
+    }
+    delete handle;
+}
+
 DllExport(void) pxGetParticleProperties(PxPbdHandle* handle, V4f* positionsHost, V4f* velsHost, PxU32* phasesHost){
 //DllExport(void) pxGetParticleProperties(PxPbdHandle* handle, float* positionsHost, float* velsHost, PxU32* phasesHost){
 
+    if(auto cpu = handle->CpuParticles) {
+        auto n = cpu->NbActiveParticles;
+        memcpy(positionsHost, cpu->PositionInvMass.data(), sizeof(PxVec4) * n);
+        memcpy(velsHost, cpu->Velocity.data(), sizeof(PxVec4) * n);
+        memcpy(phasesHost, cpu->Phase.data(), sizeof(PxU32) * n);
+        return;
+    }
+
     PxVec4* positions = handle->ParticleBuffer->getPositionInvMasses();
     PxVec4* vels = handle->ParticleBuffer->getVelocities();
     PxU32* phases = handle->ParticleBuffer->getPhases();
 
     const PxU32 numParticles = handle->ParticleBuffer->getNbActiveParticles();
 
-    PxScene* scene;
-    PxGetPhysics().getScenes(&scene, 1);
-    PxCudaContextManager* cudaContexManager = scene->getCudaContextManager();
-    
-    cudaContexManager->acquireContext();
-
-    PxCudaContext* cudaContext = cudaContexManager->getCudaContext();
-    //cudaContext->memcpyDtoH(gParticleInfo.posInvMass->begin(), CUdeviceptr(positions), sizeof(PxVec4) * numParticles);
-    //cudaContext->memcpyDtoH(gParticleInfo.velocity->begin(), CUdeviceptr(vels), sizeof(PxVec4) * numParticles);
-    //cudaContext->memcpyDtoH(gParticleInfo.phase->begin(), CUdeviceptr(phases), sizeof(PxU32) * numParticles);
+    // blocking copy of the active range, see pxUpdateParticleReadback for the asynchronous path
+    auto cudaContextManager = handle->CudaManager;
+    cudaContextManager->acquireContext();
+    PxCudaContext* cudaContext = cudaContextManager->getCudaContext();
     cudaContext->memcpyDtoH(positionsHost, CUdeviceptr(positions), sizeof(PxVec4) * numParticles);
     cudaContext->memcpyDtoH(velsHost, CUdeviceptr(vels), sizeof(PxVec4) * numParticles);
     cudaContext->memcpyDtoH(phasesHost, CUdeviceptr(phases), sizeof(PxU32) * numParticles);
-    cudaContexManager->releaseContext();
-
-    //int i = 0;
-    //for (auto it = gParticleInfo.posInvMass->begin(); it != gParticleInfo.posInvMass->end(); ++it)
-    //{   
-    //    //positionsHost[i].X = it->x;
-    //    //positionsHost[i].Y = it->y;
-    //    //positionsHost[i].Z = it->z;
-    //    //positionsHost[i].W = it->w;
-    //    //++i;
-
-    //    positionsHost[i++] = it->x;
-    //    positionsHost[i++] = it->y;
-    //    positionsHost[i++] = it->z;
-    //    positionsHost[i++] = it->w;
-    //}
-    //i = 0;
-    //for (auto it = gParticleInfo.velocity->begin(); it != gParticleInfo.velocity->end(); ++it)
-    //{
-    //    //velsHost[i].X = it->x;
-    //    //velsHost[i].Y = it->y;
-    //    //velsHost[i].Z = it->z;
-    //    //velsHost[i].W = it->w;
-    //    //++i;
-
-    //    velsHost[i++] = it->x;
-    //    velsHost[i++] = it->y;
-    //    velsHost[i++] = it->z;
-    //    velsHost[i++] = it->w;
-    //}
-    //i = 0;
-    //for (auto it = gParticleInfo.phase->begin(); it != gParticleInfo.phase->end(); ++it)
-    //{
-    //    phasesHost[i] = *it;
-    //    ++i;
-    //}
-
-    positionsHost[0].X = 1.1f; 
-    positionsHost[0].Y = 0.2f;
-    positionsHost[1].Z = 0.3f;
-    positionsHost[1].W = 9.4f;
-    velsHost[0].X = 0.6f;
-    phasesHost[0] = PxU32(42);
+    cudaContextManager->releaseContext();
 }
  
 //DllExport(void) pxSetParticleProperties(PxPbdHandle* handle, int maxParticles, 
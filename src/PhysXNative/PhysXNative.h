@@ -10,6 +10,12 @@
 #endif
 
 #include <PxPhysicsAPI.h>
+
+class CpuParticleSystem;
+class CcdManager;
+class SceneEvents;
+class ParticleEmitterSystem;
+
 typedef struct {
     float X;
     float Y;
@@ -60,6 +66,9 @@ typedef struct {
     physx::PxCooking* Cooking;
     physx::PxScene* Scene;
     physx::PxCudaContextManager* CudaManager;
+    CpuParticleSystem* CpuParticleSystems;
+    CcdManager* Ccd;    // created by the first pxSetCcdModes
+    SceneEvents* Events;    // created by the first subsystem reading simulation events
 } PxSceneHandle;
 
 typedef struct {
@@ -76,6 +85,12 @@ typedef struct {
     physx::PxCudaContextManager* CudaManager;
     physx::PxPBDParticleSystem* Pbd;
     physx::PxParticleBuffer* ParticleBuffer;
+    CpuParticleSystem* CpuParticles;
+    // used for emitted particles that do not specify their own
+    physx::PxU32 DefaultPhase;
+    float DefaultInvMass;
+    ParticleEmitterSystem* Emitters;
+    PxSceneHandle* Owner;   // its CpuParticleSystems chain holds CpuParticles
 } PxPbdHandle;
 
 typedef struct {
@@ -84,11 +99,48 @@ typedef struct {
     Euclidean3d Pose;
 } PxShapeDescription;
 
+inline physx::PxTransform toPxTransform(const Euclidean3d& trafo) {
+    return physx::PxTransform(
+        physx::PxVec3((float)trafo.Trans.X, (float)trafo.Trans.Y, (float)trafo.Trans.Z), 
+        physx::PxQuat((float)trafo.Rot.X, (float)trafo.Rot.Y, (float)trafo.Rot.Z, (float)trafo.Rot.W)
+    );
+}
+
+inline Euclidean3d toEuclidean3d(const physx::PxTransform& pose) {
+    Euclidean3d trafo;
+    trafo.Trans.X = pose.p.x;
+    trafo.Trans.Y = pose.p.y;
+    trafo.Trans.Z = pose.p.z;
+    trafo.Rot.X = pose.q.x;
+    trafo.Rot.Y = pose.q.y;
+    trafo.Rot.Z = pose.q.z;
+    trafo.Rot.W = pose.q.w;
+    return trafo;
+}
+
+inline physx::PxVec3 toPxVec3(const V3d& v) {
+    return physx::PxVec3((float)v.X, (float)v.Y, (float)v.Z);
+}
+
+inline V3d toV3d(const physx::PxVec3& v) {
+    return { v.x, v.y, v.z };
+}
+
+
 
+// steps the scene and its CPU particle systems, shared by pxSimulate and the server loop
+void stepScene(PxSceneHandle* scene, float dt);
 
 DllExport(PxHandle*) pxInit();
 DllExport(void) pxDestroy(PxHandle* handle);
 
 DllExport(PxSceneHandle*) pxCreateScene(PxHandle* handle, V3d gravity);
-DllExport(void) pxDestroyScene(PxPbdHandle* handle);
-DllExport(void) pxSimulate(PxSceneHandle* scene, float dt);
\ No newline at end of file
+DllExport(void) pxDestroyScene(PxSceneHandle* handle);
+DllExport(void) pxSimulate(PxSceneHandle* scene, float dt);
+
+// particles run on the CPU when the scene has no CUDA context
+DllExport(PxPbdHandle*) pxCreatePBD(PxSceneHandle* sceneHandle, physx::PxU32 maxParticles,
+    float centerX, float centerY, float centerZ, physx::PxU32 numParticlesDim,
+    physx::PxReal particleSpacing = 0.2f, physx::PxReal fluidDensity = 1000.f);
+DllExport(void) pxDestroyPBD(PxPbdHandle* handle);
+DllExport(void) pxGetParticleProperties(PxPbdHandle* handle, V4f* positionsHost, V4f* velsHost, physx::PxU32* phasesHost);
\ No newline at end of file
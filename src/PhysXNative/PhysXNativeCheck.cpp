@@ -0,0 +1,777 @@
+// Host checks of the CPU paths of PhysXNative, run without a GPU and without a
+// scene. Every check goes through the exported API only and prints one line,
+// the exit code is the number of failed checks.
+#include "PhysXNative.h"
+#include "BodyTable.h"
+#include "FluidSurface.h"
+#include "InterestManager.h"
+#include "ParticleEmitter.h"
+#include "ParticleIndex.h"
+#include "ParticleReadback.h"
+#include "SnapshotCodec.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <iterator>
+#include <random>
+#include <vector>
+
+using namespace physx;
+
+static float angleBetween(const PxQuat& a, const PxQuat& b) {
+    auto d = PxAbs(a.dot(b));
+    return 2.0f * std::acos(PxMin(d, 1.0f));
+}
+
+// IEEE half to float, independent of the library's own conversion
+static float fromHalf(PxU16 h) {
+    auto exp = (h >> 10) & 0x1f;
+    auto mant = (float)(h & 0x3ff);
+    float f;
+    if(exp == 0) f = mant * std::ldexp(1.0f, -24);
+    else if(exp == 0x1f) f = mant ? NAN : INFINITY;
+    else f = (1.0f + mant / 1024.0f) * std::ldexp(1.0f, exp - 15);
+    return (h & 0x8000) ? -f : f;
+}
+
+// Particle readback on a scene without CUDA runs the host ring. Every format
+// has to reproduce the positions pxGetParticleProperties reports, within the
+// precision of the format, and a frame is only new once per update.
+static bool checkParticleReadback(PxHandle* handle) {
+    const PxU32 maxParticles = 4096;
+    const PxU32 dim = 12;
+
+    auto scene = pxCreateScene(handle, { 0.0, 0.0, -9.81 });
+    auto pbd = pxCreatePBD(scene, maxParticles, -1.0f, 2.0f, 0.5f, dim, 0.2f, 1000.0f);
+    auto ok = pbd != NULL;
+    PxU32 count = dim * dim * dim;
+    std::vector<V4f> positions(maxParticles);
+    std::vector<V4f> velocities(maxParticles);
+    std::vector<PxU32> phases(maxParticles);
+    if(pbd) pxGetParticleProperties(pbd, positions.data(), velocities.data(), phases.data());
+
+    float maxError[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    for(PxU32 format = PxParticleFormatNone; format <= PxParticleFormatQuantized16 && ok; format++) {
+        auto readback = pxCreateParticleReadback(pbd, PxParticleReadbackPosition | PxParticleReadbackPhase, format);
+
+        // the GPU path publishes a copy one update later
+        PxParticleReadbackFrame frame;
+        auto isNew = 0;
+        for(PxU32 i = 0; i < 100 && !isNew; i++) {
+            pxUpdateParticleReadback(readback);
+            isNew = pxAcquireParticleReadback(readback, &frame);
+        }
+        PxParticleReadbackFrame again;
+        ok = ok && isNew && frame.Count == count && frame.Format == format && pxAcquireParticleReadback(readback, &again) == 0 &&
+            again.Frame == frame.Frame && again.PositionInvMass == frame.PositionInvMass;
+
+        for(PxU32 i = 0; i < frame.Count && ok; i++) {
+            auto& p = positions[i];
+            float q[3];
+            auto& e = maxError[format];
+            switch(format) {
+                case PxParticleFormatNone: {
+                    auto& r = frame.PositionInvMass[i];
+                    q[0] = r.X; q[1] = r.Y; q[2] = r.Z;
+                    if(r.W != p.W || frame.Phase[i] != phases[i]) ok = false;
+                    break;
+                }
+                case PxParticleFormatFloat3:
+                    for(PxU32 a = 0; a < 3; a++) q[a] = ((const float*)frame.Packed)[3 * i + a];
+                    break;
+                case PxParticleFormatHalf3:
+                    for(PxU32 a = 0; a < 3; a++) q[a] = fromHalf(((const PxU16*)frame.Packed)[3 * i + a]);
+                    break;
+                default: {
+                    auto packed = (const PxU16*)frame.Packed + 3 * i;
+                    q[0] = frame.BoundsMin.X + packed[0] * (frame.BoundsMax.X - frame.BoundsMin.X) / 65535.0f;
+                    q[1] = frame.BoundsMin.Y + packed[1] * (frame.BoundsMax.Y - frame.BoundsMin.Y) / 65535.0f;
+                    q[2] = frame.BoundsMin.Z + packed[2] * (frame.BoundsMax.Z - frame.BoundsMin.Z) / 65535.0f;
+                    break;
+                }
+            }
+            e = PxMax(e, PxMax(PxAbs(q[0] - p.X), PxMax(PxAbs(q[1] - p.Y), PxAbs(q[2] - p.Z))));
+        }
+        pxDestroyParticleReadback(readback);
+    }
+
+    // exact for raw and float copies, half rounds to 2^-8 steps below 8 where
+    // the block lies, 16 bit steps over its 2.2 extent are 3.4e-5
+    ok = ok && maxError[0] == 0.0f && maxError[1] == 0.0f && maxError[2] <= 4.0f / 2048.0f && maxError[3] <= 2.0e-5f;
+    printf("particle readback: %u particles, max error raw %g, float3 %g, half3 %g, quantized16 %g: %s\n",
+        count, maxError[0], maxError[1], maxError[2], maxError[3], ok ? "ok" : "FAILED");
+
+    if(pbd) pxDestroyPBD(pbd);
+    pxDestroyScene(scene);
+    return ok;
+}
+
+// Emitters, lifetimes and kill volumes on a CPU particle system, without
+// simulating so particles stay where they were put. A 4^3 block loses the 8
+// particles inside a kill sphere, a burst dies after its lifetime and a point
+// emitter settles at rate * lifetime particles. Every update has to report
+// unique ids for exactly the live particles, and once the emitter is gone
+// the compacted arrays have to hold the surviving block particles.
+static bool checkParticleEmitters(PxHandle* handle) {
+    const PxU32 maxParticles = 1024;
+    const float dt = 1.0f / 60.0f;
+
+    auto scene = pxCreateScene(handle, { 0.0, 0.0, -9.81 });
+    auto pbd = pxCreatePBD(scene, maxParticles, -0.3f, -0.3f, -0.3f, 4, 0.2f, 1000.0f);
+    if(!pbd) {
+        printf("particle emitters: no particle system: FAILED\n");
+        pxDestroyScene(scene);
+        return false;
+    }
+
+    std::vector<V4f> positions(maxParticles);
+    std::vector<V4f> velocities(maxParticles);
+    std::vector<PxU32> phases(maxParticles);
+    pxGetParticleProperties(pbd, positions.data(), velocities.data(), phases.data());
+    std::vector<PxVec3> survivors;
+    for(PxU32 i = 0; i < 64; i++) {
+        PxVec3 p(positions[i].X, positions[i].Y, positions[i].Z);
+        if(p.magnitude() > 0.25f) survivors.push_back(p);
+    }
+
+    PxParticleKillVolume kill;
+    memset(&kill, 0, sizeof(PxParticleKillVolume));
+    kill.Type = PxParticleKillSphere;
+    kill.Pose = toEuclidean3d(PxTransform(PxIdentity));
+    kill.Extents = { 0.25, 0.0, 0.0 };
+    pxAddParticleKillVolume(pbd, &kill);
+
+    std::vector<V4f> burst(100);
+    for(PxU32 i = 0; i < burst.size(); i++) burst[i] = { 5.0f, 0.0f, 0.01f * (float)i, 0.0f };
+    pxEmitParticles(pbd, (PxU32)burst.size(), burst.data(), NULL, NULL, 0.5f);
+
+    PxParticleEmitterDesc desc;
+    memset(&desc, 0, sizeof(PxParticleEmitterDesc));
+    desc.Type = PxParticleEmitterPoint;
+    desc.Pose = toEuclidean3d(PxTransform(PxVec3(10.0f, 0.0f, 0.0f)));
+    desc.Extents = { 0.5, 0.0, 0.0 };
+    desc.Rate = 120.0f;
+    desc.Lifetime = 1.0f;
+    auto emitter = pxAddParticleEmitter(pbd, &desc);
+
+    auto ok = true;
+    std::vector<PxU32> ids(maxParticles);
+    std::vector<PxU8> seen(maxParticles);
+    PxU32 count = 0;
+    auto update = [&](PxU32 steps) {
+        for(PxU32 step = 0; step < steps && ok; step++) {
+            count = pxUpdateParticleEmitters(pbd, dt);
+            if(pxGetParticleIds(pbd, ids.data()) != count) ok = false;
+            std::fill(seen.begin(), seen.end(), 0);
+            for(PxU32 i = 0; i < count && ok; i++) {
+                if(ids[i] >= maxParticles || seen[ids[i]]) ok = false;
+                else seen[ids[i]] = 1;
+            }
+        }
+    };
+
+    update(150);
+    PxU32 near[3] = { 0, 0, 0 };
+    if(ok) {
+        pxGetParticleProperties(pbd, positions.data(), velocities.data(), phases.data());
+        for(PxU32 i = 0; i < count; i++) {
+            PxVec3 p(positions[i].X, positions[i].Y, positions[i].Z);
+            if(p.magnitude() <= 0.25f) near[0]++;
+            if((p - PxVec3(5.0f, 0.0f, 0.5f)).magnitude() <= 1.0f) near[1]++;
+            if((p - PxVec3(10.0f, 0.0f, 0.0f)).magnitude() <= 0.5f) near[2]++;
+        }
+    }
+    auto emitted = count - (PxU32)survivors.size();
+    ok = ok && near[0] == 0 && near[1] == 0 && near[2] == emitted && emitted >= 118 && emitted <= 124;
+
+    // without the emitter its particles run out and only the block is left
+    pxRemoveParticleEmitter(pbd, emitter);
+    update(62);
+    auto remaining = count;
+    if(ok) {
+        pxGetParticleProperties(pbd, positions.data(), velocities.data(), phases.data());
+        std::vector<PxVec3> left;
+        for(PxU32 i = 0; i < count; i++) left.push_back(PxVec3(positions[i].X, positions[i].Y, positions[i].Z));
+        auto less = [](const PxVec3& a, const PxVec3& b) {
+            return a.x < b.x || (a.x == b.x && (a.y < b.y || (a.y == b.y && a.z < b.z)));
+        };
+        std::sort(left.begin(), left.end(), less);
+        std::sort(survivors.begin(), survivors.end(), less);
+        ok = left == survivors;
+    }
+
+    printf("particle emitters: %u emitter particles at rate * lifetime 120, %u left after removal of %u expected: %s\n",
+        emitted, remaining, (PxU32)survivors.size(), ok ? "ok" : "FAILED");
+
+    pxDestroyPBD(pbd);
+    pxDestroyScene(scene);
+    return ok;
+}
+
+// Radius, box and nearest queries of the particle index against brute force on
+// a uniform cloud with a dense cluster, including queries outside the cloud and
+// queries with more hits than result slots.
+static bool checkParticleIndex() {
+    const PxU32 count = 20000;
+    const PxU32 nbQueries = 200;
+    const PxU32 maxResults = 1024;
+    const PxU32 k = 8;
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> uniform(-5.0f, 5.0f);
+    std::normal_distribution<float> cluster(0.0f, 0.2f);
+    std::vector<V4f> particles(count);
+    for(PxU32 i = 0; i < count; i++) {
+        if(i % 4 == 0) particles[i] = { 2.0f + cluster(rng), cluster(rng), cluster(rng), 1.0f };
+        else particles[i] = { uniform(rng), uniform(rng), uniform(rng), 1.0f };
+    }
+    auto position = [&](PxU32 i) { return PxVec3(particles[i].X, particles[i].Y, particles[i].Z); };
+
+    std::vector<V3f> centers(nbQueries), boxMin(nbQueries), boxMax(nbQueries);
+    std::vector<float> radii(nbQueries);
+    std::uniform_real_distribution<float> wide(-7.0f, 7.0f);
+    std::uniform_real_distribution<float> size(0.05f, 0.8f);
+    for(PxU32 q = 0; q < nbQueries; q++) {
+        auto c = q % 3 == 0 ? PxVec3(2.0f + cluster(rng), cluster(rng), cluster(rng)) : PxVec3(wide(rng), wide(rng), wide(rng));
+        centers[q] = { c.x, c.y, c.z };
+        radii[q] = size(rng);
+        boxMin[q] = { c.x - size(rng), c.y - size(rng), c.z - size(rng) };
+        boxMax[q] = { c.x + size(rng), c.y + size(rng), c.z + size(rng) };
+    }
+
+    auto index = pxCreateParticleIndex(0.25f);
+    pxBuildParticleIndex(index, particles.data(), count);
+
+    std::vector<PxU32> results(nbQueries * maxResults), counts(nbQueries);
+    std::vector<PxU32> truncated(nbQueries * 4), truncatedCounts(nbQueries);
+    auto ok = true;
+
+    // hits that fit are compared as sorted sets, the rest must be a subset
+    auto subset = [](const PxU32* hits, PxU32 n, const std::vector<PxU32>& expected) {
+        std::vector<PxU32> sorted(hits, hits + n);
+        std::sort(sorted.begin(), sorted.end());
+        return std::unique(sorted.begin(), sorted.end()) == sorted.end() && std::includes(expected.begin(), expected.end(), sorted.begin(), sorted.end());
+    };
+    auto compare = [&](PxU32 q, const std::vector<PxU32>& expected) {
+        auto n = counts[q];
+        if(n != expected.size() || truncatedCounts[q] != n) return false;
+        return subset(&results[q * maxResults], PxMin(n, maxResults), expected) && subset(&truncated[q * 4], PxMin(n, 4u), expected);
+    };
+
+    pxQueryParticlesRadius(index, centers.data(), radii.data(), nbQueries, maxResults, results.data(), counts.data());
+    pxQueryParticlesRadius(index, centers.data(), radii.data(), nbQueries, 4, truncated.data(), truncatedCounts.data());
+    PxU32 radiusHits = 0, overflows = 0;
+    for(PxU32 q = 0; q < nbQueries && ok; q++) {
+        PxVec3 c(centers[q].X, centers[q].Y, centers[q].Z);
+        std::vector<PxU32> expected;
+        for(PxU32 i = 0; i < count; i++) {
+            if((position(i) - c).magnitudeSquared() <= radii[q] * radii[q]) expected.push_back(i);
+        }
+        radiusHits += (PxU32)expected.size();
+        if(expected.size() > maxResults) overflows++;
+        ok = compare(q, expected);
+    }
+
+    pxQueryParticlesBox(index, boxMin.data(), boxMax.data(), nbQueries, maxResults, results.data(), counts.data());
+    pxQueryParticlesBox(index, boxMin.data(), boxMax.data(), nbQueries, 4, truncated.data(), truncatedCounts.data());
+    PxU32 boxHits = 0;
+    for(PxU32 q = 0; q < nbQueries && ok; q++) {
+        PxBounds3 box(PxVec3(boxMin[q].X, boxMin[q].Y, boxMin[q].Z), PxVec3(boxMax[q].X, boxMax[q].Y, boxMax[q].Z));
+        std::vector<PxU32> expected;
+        for(PxU32 i = 0; i < count; i++) {
+            if(box.contains(position(i))) expected.push_back(i);
+        }
+        boxHits += (PxU32)expected.size();
+        if(expected.size() > maxResults) overflows++;
+        ok = compare(q, expected);
+    }
+
+    // nearest with and without a radius limit, distances are compared since ties may swap ids
+    std::vector<float> distances(nbQueries * k);
+    for(auto maxRadius : { 0.0f, 0.3f }) {
+        pxQueryParticlesNearest(index, centers.data(), nbQueries, k, maxRadius, results.data(), distances.data(), counts.data());
+        for(PxU32 q = 0; q < nbQueries && ok; q++) {
+            PxVec3 c(centers[q].X, centers[q].Y, centers[q].Z);
+            std::vector<float> expected;
+            for(PxU32 i = 0; i < count; i++) {
+                auto d2 = (position(i) - c).magnitudeSquared();
+                if(maxRadius <= 0.0f || d2 <= maxRadius * maxRadius) expected.push_back(PxSqrt(d2));
+            }
+            std::sort(expected.begin(), expected.end());
+            auto n = PxMin(k, (PxU32)expected.size());
+            ok = counts[q] == n;
+            for(PxU32 i = 0; i < n && ok; i++) {
+                auto id = results[q * k + i];
+                ok = id < count && distances[q * k + i] == expected[i] && PxSqrt((position(id) - c).magnitudeSquared()) == expected[i];
+            }
+        }
+    }
+
+    printf("particle index: %u particles, %u queries, %u radius hits, %u box hits, %u queries over %u results: %s\n",
+        count, nbQueries, radiusHits, boxHits, overflows, maxResults, ok ? "ok" : "FAILED");
+
+    pxDestroyParticleIndex(index);
+    return ok;
+}
+
+struct FluidMesh {
+    std::vector<V3f> Vertices;
+    std::vector<V3f> Normals;
+    std::vector<PxU32> Indices;
+};
+
+static FluidMesh fluidMesh(FluidSurface* surface) {
+    FluidMesh mesh;
+    PxU32 vertexCount = 0, indexCount = 0;
+    pxGetFluidSurfaceCounts(surface, &vertexCount, &indexCount);
+    mesh.Vertices.resize(vertexCount);
+    mesh.Normals.resize(vertexCount);
+    mesh.Indices.resize(indexCount);
+    pxGetFluidSurfaceMesh(surface, mesh.Vertices.data(), mesh.Normals.data(), mesh.Indices.data());
+    return mesh;
+}
+
+static PxU64 vertexBits(const V3f& v) {
+    PxU32 bits[3];
+    memcpy(bits, &v, sizeof(bits));
+    return ((PxU64)bits[0] * 1099511628211ull ^ bits[1]) * 1099511628211ull ^ bits[2];
+}
+
+// Every directed edge needs its reverse. Vertices on block faces are not
+// shared but bit identical, so edges are compared by position.
+static bool closedSurface(const FluidMesh& mesh) {
+    std::vector<std::pair<PxU64, PxU64>> edges, reversed;
+    for(size_t t = 0; t + 2 < mesh.Indices.size(); t += 3) {
+        for(PxU32 k = 0; k < 3; k++) {
+            auto a = vertexBits(mesh.Vertices[mesh.Indices[t + k]]);
+            auto b = vertexBits(mesh.Vertices[mesh.Indices[t + (k + 1) % 3]]);
+            edges.push_back({ a, b });
+            reversed.push_back({ b, a });
+        }
+    }
+    std::sort(edges.begin(), edges.end());
+    std::sort(reversed.begin(), reversed.end());
+    return edges == reversed;
+}
+
+static std::vector<PxU64> sortedVertices(const FluidMesh& mesh) {
+    std::vector<PxU64> keys;
+    for(auto& v : mesh.Vertices) keys.push_back(vertexBits(v));
+    std::sort(keys.begin(), keys.end());
+    return keys;
+}
+
+// Surface of a lattice ball: it has to be closed, stay close to the ball and
+// face outwards. After moving a cap of the ball the incremental update has to
+// rebuild only some blocks and still produce the mesh of a fresh surface.
+static bool checkFluidSurface() {
+    const float spacing = 0.1f;
+    const float ballRadius = 1.0f;
+
+    std::vector<V4f> particles;
+    for(int z = -10; z <= 10; z++)
+        for(int y = -10; y <= 10; y++)
+            for(int x = -10; x <= 10; x++) {
+                PxVec3 p((float)x * spacing, (float)y * spacing, (float)z * spacing);
+                if(p.magnitude() <= ballRadius) particles.push_back({ p.x, p.y, p.z, 1.0f });
+            }
+    auto count = (PxU32)particles.size();
+
+    PxFluidSurfaceDesc desc;
+    desc.ParticleRadius = spacing;
+    desc.CellSize = 0.5f * spacing;
+    desc.IsoLevel = 0.5f;
+    desc.Smoothing = 0.5f;
+    desc.MaxAnisotropy = 4.0f;
+    desc.MinNeighbors = 8;
+
+    auto surface = pxCreateFluidSurface(&desc);
+    auto built = pxUpdateFluidSurface(surface, particles.data(), count);
+    auto mesh = fluidMesh(surface);
+
+    auto ok = !mesh.Indices.empty() && mesh.Indices.size() % 3 == 0;
+    for(auto i : mesh.Indices) ok = ok && i < mesh.Vertices.size();
+
+    float minRadius = 1e30f, maxRadius = 0.0f;
+    PxU32 outward = 0;
+    for(size_t i = 0; i < mesh.Vertices.size(); i++) {
+        PxVec3 p(mesh.Vertices[i].X, mesh.Vertices[i].Y, mesh.Vertices[i].Z);
+        PxVec3 n(mesh.Normals[i].X, mesh.Normals[i].Y, mesh.Normals[i].Z);
+        auto r = p.magnitude();
+        minRadius = PxMin(minRadius, r);
+        maxRadius = PxMax(maxRadius, r);
+        if(n.dot(p) > 0.5f * r) outward++;
+    }
+    ok = ok && minRadius >= ballRadius - 2.0f * spacing && maxRadius <= ballRadius + 2.0f * spacing;
+    ok = ok && outward >= mesh.Vertices.size() * 95 / 100;
+    ok = ok && closedSurface(mesh);
+
+    // the same particles again rebuild nothing
+    ok = ok && pxUpdateFluidSurface(surface, particles.data(), count) == 0;
+
+    for(auto& p : particles) {
+        if(p.X > 0.7f) p.X += 0.5f * spacing;
+    }
+    auto rebuilt = pxUpdateFluidSurface(surface, particles.data(), count);
+    auto moved = fluidMesh(surface);
+
+    auto fresh = pxCreateFluidSurface(&desc);
+    pxUpdateFluidSurface(fresh, particles.data(), count);
+    auto reference = fluidMesh(fresh);
+
+    ok = ok && rebuilt > 0 && rebuilt < built;
+    ok = ok && moved.Indices.size() == reference.Indices.size() && sortedVertices(moved) == sortedVertices(reference);
+    ok = ok && closedSurface(moved);
+
+    printf("fluid surface: %u particles, %u triangles, radius %g..%g, %u of %u blocks rebuilt after moving a cap: %s\n",
+        count, (PxU32)mesh.Indices.size() / 3, minRadius, maxRadius, rebuilt, built, ok ? "ok" : "FAILED");
+
+    pxDestroyFluidSurface(fresh);
+    pxDestroyFluidSurface(surface);
+    return ok;
+}
+
+static PxSnapshotDesc snapshotDesc() {
+    PxSnapshotDesc desc;
+    desc.BoundsMin = { -100.0, -100.0, -10.0 };
+    desc.BoundsMax = { 100.0, 100.0, 90.0 };
+    desc.PositionBits = 18;
+    desc.RotationBits = 12;
+    desc.DeltaBits = 8;
+    desc.MaxBodies = 0;
+    return desc;
+}
+
+static void setTablePoses(BodyTable* table, const std::vector<PxBodyHandle>& handles, const std::vector<PxTransform>& poses) {
+    std::vector<PxU32> dense(handles.size());
+    std::vector<Euclidean3d> e(handles.size());
+    for(PxU32 i = 0; i < handles.size(); i++) {
+        dense[i] = pxBodyTableGetDenseIndex(table, handles[i]);
+        e[i] = toEuclidean3d(poses[i]);
+    }
+    pxBodyTableSetPoses(table, (PxU32)handles.size(), dense.data(), e.data());
+}
+
+// Decodes a packet and acks it with the slots the decoder had to skip.
+static bool receive(SnapshotEncoder* encoder, PxU32 client, SnapshotDecoder* decoder, const std::vector<PxU8>& packet, PxU32 size, PxU32* skippedTotal) {
+    PxU32 seq = 0;
+    if(pxDecodeSnapshot(decoder, packet.data(), size, &seq) < 0) return false;
+    std::vector<PxU32> skipped(pxGetSnapshotSkipped(decoder, NULL));
+    pxGetSnapshotSkipped(decoder, skipped.data());
+    if(skippedTotal) *skippedTotal += (PxU32)skipped.size();
+    pxAckSnapshot(encoder, client, seq, skipped.data(), (PxU32)skipped.size());
+    return true;
+}
+
+// Largest position and rotation error of the bodies a decoder holds against
+// the table, false if it holds other bodies than the live ones.
+static bool compareBodies(SnapshotDecoder* decoder, const std::vector<PxBodyHandle>& handles, const std::vector<PxTransform>& poses,
+        float& maxPosition, float& maxAngle) {
+    auto n = pxGetSnapshotBodies(decoder, NULL, NULL, 0);
+    if(n != handles.size()) return false;
+    std::vector<PxBodyHandle> ids(n);
+    std::vector<Euclidean3d> decoded(n);
+    pxGetSnapshotBodies(decoder, ids.data(), decoded.data(), n);
+    for(PxU32 k = 0; k < n; k++) {
+        PxU32 i = 0;
+        while(i < handles.size() && (handles[i].Index != ids[k].Index || handles[i].Generation != ids[k].Generation)) i++;
+        if(i == handles.size()) return false;
+        auto pose = toPxTransform(decoded[k]);
+        maxPosition = PxMax(maxPosition, (pose.p - poses[i].p).magnitude());
+        maxAngle = PxMax(maxAngle, angleBetween(pose.q, poses[i].q));
+    }
+    return true;
+}
+
+// one position step per axis and a few rotation steps
+static bool withinQuantization(const PxSnapshotDesc& desc, float maxPosition, float maxAngle) {
+    auto step = (float)(desc.BoundsMax.X - desc.BoundsMin.X) / (float)((1u << desc.PositionBits) - 1);
+    return maxPosition <= step * 1.8f && maxAngle <= 8.0f / (float)(1u << desc.RotationBits);
+}
+
+// Server and clients in one process: capture, encode per client, decode, ack.
+// Client 0 receives everything, client 1 loses every third packet and client 2
+// acks three ticks late. Bodies move and get replaced for a while, then come
+// to rest, after which every client has to hold exactly the live bodies within
+// the quantization error. Reports the bytes per client and tick while moving.
+static bool checkSnapshotLoopback() {
+    const PxU32 nbBodies = 2000;
+    const PxU32 nbClients = 3;
+    const PxU32 budget = 1200;
+    const PxU32 movingTicks = 120;
+    const PxU32 restTicks = 200;
+
+    auto desc = snapshotDesc();
+    auto table = pxCreateBodyTable(nbBodies);
+    auto encoder = pxCreateSnapshotEncoder(&desc);
+    std::vector<SnapshotDecoder*> decoders(nbClients);
+    std::vector<PxU32> clients(nbClients);
+    for(PxU32 c = 0; c < nbClients; c++) {
+        clients[c] = pxAddSnapshotClient(encoder);
+        decoders[c] = pxCreateSnapshotDecoder(&desc);
+    }
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    std::vector<PxBodyHandle> handles;
+    std::vector<PxTransform> poses;
+    std::vector<PxVec3> velocities;
+    for(PxU32 i = 0; i < nbBodies; i++) {
+        handles.push_back(pxBodyTableAdd(table, NULL, i));
+        // inside the snapshot bounds for the whole run
+        poses.push_back(PxTransform(PxVec3(uniform(rng) * 60.0f, uniform(rng) * 60.0f, 40.0f + uniform(rng) * 20.0f),
+            PxQuat(uniform(rng) * PxPi, PxVec3(uniform(rng), uniform(rng), 1.0f).getNormalized())));
+        velocities.push_back(PxVec3(uniform(rng), uniform(rng), uniform(rng)) * 0.2f);
+    }
+
+    std::vector<PxU8> packet(budget);
+    std::vector<std::vector<PxU8>> delayed;
+    std::vector<PxU32> delayedSize;
+    double bytes = 0.0;
+    PxU32 packets = 0;
+    PxU32 reused = 0;
+    PxU32 skippedTotal = 0;
+    auto ok = true;
+
+    for(PxU32 tick = 0; tick < movingTicks + restTicks && ok; tick++) {
+        // a tenth of the bodies moves, one body is replaced every ten ticks
+        if(tick < movingTicks) {
+            for(PxU32 i = 0; i < handles.size(); i += 10) {
+                poses[i].p += velocities[i];
+                poses[i].q = (PxQuat(0.02f, PxVec3(0.0f, 0.0f, 1.0f)) * poses[i].q).getNormalized();
+            }
+            if(tick % 10 == 5) {
+                auto i = (PxU32)(rng() % handles.size());
+                PxBodyRemap remap;
+                pxBodyTableRemove(table, handles[i], &remap);
+                handles[i] = pxBodyTableAdd(table, NULL, i);
+                poses[i].p = PxVec3(uniform(rng) * 60.0f, uniform(rng) * 60.0f, 10.0f);
+            }
+        }
+        setTablePoses(table, handles, poses);
+        pxCaptureSnapshot(encoder, table);
+
+        for(PxU32 c = 0; c < nbClients; c++) {
+            auto size = pxEncodeSnapshot(encoder, clients[c], packet.data(), budget);
+            // a second packet from the same capture is refused
+            if(pxEncodeSnapshot(encoder, clients[c], packet.data(), budget) != 0) reused++;
+            if(tick < movingTicks) {
+                bytes += size;
+                packets++;
+            }
+
+            if(c == 1 && tick % 3 == 0) continue;
+            if(c == 2) {
+                delayed.push_back(packet);
+                delayedSize.push_back(size);
+                if(delayed.size() <= 3) continue;
+                ok = ok && receive(encoder, clients[c], decoders[c], delayed.front(), delayedSize.front(), &skippedTotal);
+                delayed.erase(delayed.begin());
+                delayedSize.erase(delayedSize.begin());
+                continue;
+            }
+            ok = ok && receive(encoder, clients[c], decoders[c], packet, size, &skippedTotal);
+        }
+    }
+
+    float maxPosition = 0.0f;
+    float maxAngle = 0.0f;
+    for(PxU32 c = 0; c < nbClients; c++) ok = ok && compareBodies(decoders[c], handles, poses, maxPosition, maxAngle);
+    ok = ok && reused == 0 && skippedTotal == 0 && withinQuantization(desc, maxPosition, maxAngle);
+
+    printf("snapshot loopback: %u bodies, %u clients, %.1f bytes per client per tick, "
+        "max position error %g, max rotation error %g rad: %s\n",
+        nbBodies, nbClients, bytes / PxMax(packets, 1u), maxPosition, maxAngle, ok ? "ok" : "FAILED");
+
+    for(auto d : decoders) pxDestroySnapshotDecoder(d);
+    pxDestroySnapshotEncoder(encoder);
+    pxDestroyBodyTable(table);
+    return ok;
+}
+
+// A client whose decoder starts over without the encoder knowing cannot
+// resolve deltas against its old baselines. The skipped slots go back with the
+// ack and have to arrive in full with the next packet.
+static bool checkSnapshotLostBaselines() {
+    const PxU32 nbBodies = 50;
+    const PxU32 budget = 1200;
+    const PxU32 ticks = 40;
+
+    auto desc = snapshotDesc();
+    auto table = pxCreateBodyTable(nbBodies);
+    auto encoder = pxCreateSnapshotEncoder(&desc);
+    auto client = pxAddSnapshotClient(encoder);
+    auto decoder = pxCreateSnapshotDecoder(&desc);
+
+    std::vector<PxBodyHandle> handles;
+    std::vector<PxTransform> poses;
+    for(PxU32 i = 0; i < nbBodies; i++) {
+        handles.push_back(pxBodyTableAdd(table, NULL, i));
+        poses.push_back(PxTransform(PxVec3((float)i, 0.0f, 1.0f)));
+    }
+
+    std::vector<PxU8> packet(budget);
+    PxU32 skippedTotal = 0;
+    PxU32 skippedLast = 0;
+    auto ok = true;
+    for(PxU32 tick = 0; tick < ticks && ok; tick++) {
+        for(auto& p : poses) p.p.z += 0.05f;
+        setTablePoses(table, handles, poses);
+        pxCaptureSnapshot(encoder, table);
+        if(tick == ticks / 2) {
+            pxDestroySnapshotDecoder(decoder);
+            decoder = pxCreateSnapshotDecoder(&desc);
+        }
+        auto size = pxEncodeSnapshot(encoder, client, packet.data(), budget);
+        skippedLast = skippedTotal;
+        ok = receive(encoder, client, decoder, packet, size, &skippedTotal);
+        skippedLast = skippedTotal - skippedLast;
+    }
+
+    float maxPosition = 0.0f;
+    float maxAngle = 0.0f;
+    ok = ok && skippedTotal == nbBodies && skippedLast == 0 && compareBodies(decoder, handles, poses, maxPosition, maxAngle) &&
+        withinQuantization(desc, maxPosition, maxAngle);
+    printf("snapshot lost baselines: %u skipped entries, resent in full: %s\n", skippedTotal, ok ? "ok" : "FAILED");
+
+    pxDestroySnapshotDecoder(decoder);
+    pxDestroySnapshotEncoder(encoder);
+    pxDestroyBodyTable(table);
+    return ok;
+}
+
+static bool sameHandles(const std::vector<PxBodyHandle>& a, const PxBodyHandle* b, PxU32 n) {
+    if(a.size() != n) return false;
+    for(PxU32 i = 0; i < n; i++) {
+        if(a[i].Index != b[i].Index || a[i].Generation != b[i].Generation) return false;
+    }
+    return true;
+}
+
+// Interest sets of spheres and frustums with different update intervals
+// against brute force while bodies and observers move and bodies get replaced.
+// The brute force repeats the float math of the manager, so sets must match
+// exactly, and only observers that are due may report an update.
+static bool checkInterest() {
+    const PxU32 nbBodies = 50000;
+    const PxU32 nbObservers = 100;
+    const PxU32 passes = 10;
+
+    std::mt19937 rng(38);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    auto table = pxCreateBodyTable(nbBodies);
+    std::vector<PxBodyHandle> handles;
+    std::vector<PxTransform> poses;
+    for(PxU32 i = 0; i < nbBodies; i++) {
+        handles.push_back(pxBodyTableAdd(table, NULL, i));
+        poses.push_back(PxTransform(PxVec3(uniform(rng) * 200.0f, uniform(rng) * 200.0f, 10.0f + uniform(rng) * 10.0f)));
+    }
+
+    auto manager = pxCreateInterestManager(16.0f);
+    std::vector<PxObserverDesc> descs(nbObservers);
+    std::vector<PxU32> ids(nbObservers);
+    std::vector<std::vector<PxBodyHandle>> previous(nbObservers);
+    for(PxU32 o = 0; o < nbObservers; o++) {
+        auto& d = descs[o];
+        memset(&d, 0, sizeof(PxObserverDesc));
+        d.Type = o % 2 == 0 ? PxObserverSphere : PxObserverFrustum;
+        d.UpdateInterval = 1 + o % 3;
+        d.Radius = 20.0 + 20.0 * (1.0 + uniform(rng));
+        ids[o] = pxAddObserver(manager, &d);
+    }
+
+    auto ok = true;
+    PxU32 updates = 0, entered = 0, left = 0;
+    for(PxU32 pass = 0; pass < passes && ok; pass++) {
+        for(PxU32 i = 0; i < nbBodies; i++) {
+            poses[i].p += PxVec3(uniform(rng), uniform(rng), 0.0f) * 4.0f;
+            if(i % 97 == pass) {
+                PxBodyRemap remap;
+                pxBodyTableRemove(table, handles[i], &remap);
+                handles[i] = pxBodyTableAdd(table, NULL, i);
+            }
+        }
+        setTablePoses(table, handles, poses);
+
+        // frustums are random half spaces with the observer inside
+        for(PxU32 o = 0; o < nbObservers; o++) {
+            auto& d = descs[o];
+            auto p = PxVec3(uniform(rng) * 150.0f, uniform(rng) * 150.0f, 15.0f);
+            d.Position = { p.x, p.y, p.z };
+            for(auto& plane : d.Planes) {
+                auto n = PxVec3(uniform(rng), uniform(rng), uniform(rng)).getNormalized();
+                plane = { n.x, n.y, n.z, -n.dot(p) + 10.0f * (1.0f + uniform(rng)) };
+            }
+            pxSetObserver(manager, ids[o], &d);
+        }
+
+        pxUpdateInterest(manager, table);
+
+        for(PxU32 o = 0; o < nbObservers && ok; o++) {
+            auto& d = descs[o];
+            PxU32 nbEnter = 0, nbStay = 0, nbLeave = 0;
+            auto updated = pxGetInterestCounts(manager, ids[o], &nbEnter, &nbStay, &nbLeave) != 0;
+            if(updated != ((pass + ids[o]) % d.UpdateInterval == 0)) {
+                ok = false;
+                break;
+            }
+            if(!updated) continue;
+            updates++;
+
+            auto center = toPxVec3(d.Position);
+            auto radius = (float)d.Radius;
+            std::vector<PxBodyHandle> relevant;
+            for(PxU32 i = 0; i < nbBodies; i++) {
+                auto& p = poses[i].p;
+                if((p - center).magnitudeSquared() > radius * radius) continue;
+                auto inside = true;
+                for(PxU32 k = 0; k < 6 && inside && d.Type == PxObserverFrustum; k++) {
+                    auto& v = d.Planes[k];
+                    inside = (float)v.X * p.x + (float)v.Y * p.y + (float)v.Z * p.z + (float)v.W >= 0.0f;
+                }
+                if(inside) relevant.push_back(handles[i]);
+            }
+            auto less = [](const PxBodyHandle& a, const PxBodyHandle& b) {
+                return a.Index < b.Index || (a.Index == b.Index && a.Generation < b.Generation);
+            };
+            std::sort(relevant.begin(), relevant.end(), less);
+
+            std::vector<PxBodyHandle> enter, stay, leave;
+            std::set_difference(relevant.begin(), relevant.end(), previous[o].begin(), previous[o].end(), std::back_inserter(enter), less);
+            std::set_intersection(relevant.begin(), relevant.end(), previous[o].begin(), previous[o].end(), std::back_inserter(stay), less);
+            std::set_difference(previous[o].begin(), previous[o].end(), relevant.begin(), relevant.end(), std::back_inserter(leave), less);
+            previous[o].swap(relevant);
+
+            std::vector<PxBodyHandle> gotEnter(nbEnter), gotStay(nbStay), gotLeave(nbLeave);
+            pxGetInterestSets(manager, ids[o], gotEnter.data(), gotStay.data(), gotLeave.data());
+            ok = sameHandles(enter, gotEnter.data(), nbEnter) && sameHandles(stay, gotStay.data(), nbStay) && sameHandles(leave, gotLeave.data(), nbLeave);
+            entered += nbEnter;
+            left += nbLeave;
+        }
+    }
+
+    printf("interest: %u bodies, %u observers, %u observer updates with %u enters and %u leaves matched brute force: %s\n",
+        nbBodies, nbObservers, updates, entered, left, ok ? "ok" : "FAILED");
+
+    pxDestroyInterestManager(manager);
+    pxDestroyBodyTable(table);
+    return ok;
+}
+
+int main() {
+    // the shared dispatcher needs a foundation
+    auto handle = pxInit();
+    if(!handle) return 1;
+
+    int failed = 0;
+    if(!checkParticleReadback(handle)) failed++;
+    if(!checkParticleEmitters(handle)) failed++;
+    if(!checkParticleIndex()) failed++;
+    if(!checkFluidSurface()) failed++;
+    if(!checkSnapshotLoopback()) failed++;
+    if(!checkSnapshotLostBaselines()) failed++;
+    if(!checkInterest()) failed++;
+
+    pxDestroy(handle);
+    return failed;
+}
@@ -0,0 +1,145 @@
+#include "PoseStream.h"
+#include "Parallel.h"
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace physx;
+
+static const PxU32 PublishGrain = 4096;
+
+static_assert(sizeof(PxStreamPose) == sizeof(PxTransform), "PxStreamPose must match PxTransform");
+static_assert(sizeof(PxStreamBodyId) == sizeof(PxBodyHandle), "PxStreamBodyId must match PxBodyHandle");
+
+static PX_FORCE_INLINE PxU64 alignUp(PxU64 v, PxU64 a) {
+    return (v + a - 1) & ~(a - 1);
+}
+
+PoseStream* PoseStream::create(const char* name, PxU32 slotCount, PxU32 maxBodies) {
+    if(slotCount < 2) slotCount = 2;
+
+    // slots start on their own cache lines so a reader of one slot does not
+    // share lines with the slot being written
+    auto headerSize = alignUp(sizeof(PxPoseStreamHeader), 64);
+    auto posesOffset = alignUp(sizeof(PxPoseSlotHeader), 64);
+    auto idsOffset = alignUp(posesOffset + (PxU64)maxBodies * sizeof(PxStreamPose), 64);
+    auto slotSize = alignUp(idsOffset + (PxU64)maxBodies * sizeof(PxStreamBodyId), 64);
+    auto size = (size_t)(headerSize + slotCount * slotSize);
+
+    auto stream = new PoseStream();
+    stream->Name = name;
+    stream->Size = size;
+
+#ifdef _WIN32
+    auto mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)((PxU64)size >> 32), (DWORD)size, name);
+    if(!mapping) { delete stream; return NULL; }
+    auto memory = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, size);
+    if(!memory) { CloseHandle(mapping); delete stream; return NULL; }
+    stream->Mapping = mapping;
+#else
+    // a stale stream of a crashed publisher is replaced
+    shm_unlink(name);
+    auto fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if(fd < 0) { delete stream; return NULL; }
+    if(ftruncate(fd, (off_t)size) != 0) { close(fd); shm_unlink(name); delete stream; return NULL; }
+    auto memory = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if(memory == MAP_FAILED) { shm_unlink(name); delete stream; return NULL; }
+#endif
+
+    memset(memory, 0, size);
+    auto h = (PxPoseStreamHeader*)memory;
+    h->Version = PX_POSE_STREAM_VERSION;
+    h->SlotCount = slotCount;
+    h->MaxBodies = maxBodies;
+    h->HeaderSize = headerSize;
+    h->SlotSize = slotSize;
+    h->PosesOffset = posesOffset;
+    h->IdsOffset = idsOffset;
+    h->Latest = 0;
+    pxStreamFenceRelease();
+    h->Magic = PX_POSE_STREAM_MAGIC;
+    stream->Header = h;
+    return stream;
+}
+
+PoseStream::~PoseStream() {
+    if(!Header) return;
+#ifdef _WIN32
+    UnmapViewOfFile(Header);
+    CloseHandle((HANDLE)Mapping);
+#else
+    munmap(Header, Size);
+    // readers keep their mappings, new readers can no longer open the stream
+    shm_unlink(Name.c_str());
+#endif
+}
+
+template<typename F>
+PxU64 PoseStream::write(PxU32 count, double time, const F& fill) {
+    auto frame = ++Frame;
+    auto slot = pxPoseStreamSlot(Header, frame);
+
+    // seqlock: odd while written, readers that overlap this see a changed Seq
+    slot->Seq = (frame << 1) | 1;
+    pxStreamFenceRelease();
+
+    auto n = PxMin(count, Header->MaxBodies);
+    slot->Time = time;
+    slot->Count = n;
+    slot->TotalCount = count;
+    fill(pxPoseSlotPoses(Header, slot), pxPoseSlotIds(Header, slot), n);
+
+    pxStreamStoreRelease(&slot->Seq, frame << 1);
+    pxStreamStoreRelease(&Header->Latest, frame);
+    return frame;
+}
+
+PxU64 PoseStream::publish(const BodyTable& table, double time, PxCpuDispatcher* dispatcher) {
+    return write(table.size(), time, [&](PxStreamPose* poses, PxStreamBodyId* ids, PxU32 n) {
+        parallelFor(dispatcher, n, PublishGrain, [&](PxU32 begin, PxU32 end) {
+            memcpy(poses + begin, table.Poses.data() + begin, (end - begin) * sizeof(PxStreamPose));
+            for(PxU32 i = begin; i < end; i++) {
+                auto slot = table.DenseToSlot[i];
+                ids[i].Index = slot;
+                ids[i].Generation = table.Generations[slot];
+            }
+        });
+    });
+}
+
+PxU64 PoseStream::publish(const PxTransform* poses, const PxStreamBodyId* ids, PxU32 count, double time, PxCpuDispatcher* dispatcher) {
+    return write(count, time, [&](PxStreamPose* outPoses, PxStreamBodyId* outIds, PxU32 n) {
+        parallelFor(dispatcher, n, PublishGrain, [&](PxU32 begin, PxU32 end) {
+            memcpy(outPoses + begin, poses + begin, (end - begin) * sizeof(PxStreamPose));
+            if(ids) memcpy(outIds + begin, ids + begin, (end - begin) * sizeof(PxStreamBodyId));
+            else memset(outIds + begin, 0, (end - begin) * sizeof(PxStreamBodyId));
+        });
+    });
+}
+
+
+DllExport(PoseStream*) pxCreatePoseStream(const char* name, PxU32 slotCount, PxU32 maxBodies) {
+    return PoseStream::create(name, slotCount, maxBodies);
+}
+
+DllExport(void) pxDestroyPoseStream(PoseStream* stream) {
+    delete stream;
+}
+
+DllExport(PxU64) pxPublishPoseStream(PoseStream* stream, BodyTable* table, double time) {
+    return stream->publish(*table, time, sharedDispatcher());
+}
+
+DllExport(PxU64) pxPublishPoses(PoseStream* stream, PxU32 count, const Euclidean3d* poses, const PxBodyHandle* ids, double time) {
+    std::vector<PxTransform> transforms(count);
+    for(PxU32 i = 0; i < count; i++) transforms[i] = toPxTransform(poses[i]);
+    return stream->publish(transforms.data(), (const PxStreamBodyId*)ids, count, time, sharedDispatcher());
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include "PoseStreamReader.h"
+#include "BodyTable.h"
+#include <string>
+
+// Publishes body poses into a shared-memory ring (shm_open/mmap, a named file
+// mapping on Windows) for renderers and recorders in other processes. The
+// layout and the seqlock protocol are described in PoseStreamReader.h, readers
+// link the C library built from PoseStreamReader.c.
+class PoseStream {
+public:
+    ~PoseStream();
+
+    // returns NULL if the shared memory cannot be created
+    static PoseStream* create(const char* name, physx::PxU32 slotCount, physx::PxU32 maxBodies);
+
+    PxPoseStreamHeader* Header;
+    physx::PxU64 Frame;
+
+    // returns the published frame
+    physx::PxU64 publish(const BodyTable& table, double time, physx::PxCpuDispatcher* dispatcher);
+    physx::PxU64 publish(const physx::PxTransform* poses, const PxStreamBodyId* ids, physx::PxU32 count, double time, physx::PxCpuDispatcher* dispatcher);
+
+private:
+    PoseStream() : Header(NULL), Frame(0), Size(0), Mapping(NULL) {}
+
+    template<typename F>
+    physx::PxU64 write(physx::PxU32 count, double time, const F& fill);
+
+    std::string Name;
+    size_t Size;
+    void* Mapping;  // file mapping handle on Windows
+};
+
+DllExport(PoseStream*) pxCreatePoseStream(const char* name, physx::PxU32 slotCount, physx::PxU32 maxBodies);
+DllExport(void) pxDestroyPoseStream(PoseStream* stream);
+DllExport(physx::PxU64) pxPublishPoseStream(PoseStream* stream, BodyTable* table, double time);
+DllExport(physx::PxU64) pxPublishPoses(PoseStream* stream, physx::PxU32 count, const Euclidean3d* poses, const PxBodyHandle* ids, double time);
@@ -0,0 +1,136 @@
+#include "PoseStreamReader.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+/* a torn read is retried this often before giving up */
+#define PX_POSE_STREAM_RETRIES 8
+
+struct PxPoseStreamReader {
+    const PxPoseStreamHeader* Header;
+    size_t Size;
+#ifdef _WIN32
+    HANDLE Mapping;
+#endif
+};
+
+PxPoseStreamReader* pxPoseStreamOpen(const char* name) {
+    PxPoseStreamReader* reader;
+    const PxPoseStreamHeader* header;
+    size_t size;
+#ifdef _WIN32
+    HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, FALSE, name);
+    MEMORY_BASIC_INFORMATION info;
+    if(!mapping) return NULL;
+    header = (const PxPoseStreamHeader*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(!header) { CloseHandle(mapping); return NULL; }
+    VirtualQuery(header, &info, sizeof(info));
+    size = info.RegionSize;
+#else
+    struct stat st;
+    int fd = shm_open(name, O_RDONLY, 0);
+    if(fd < 0) return NULL;
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(PxPoseStreamHeader)) { close(fd); return NULL; }
+    size = (size_t)st.st_size;
+    header = (const PxPoseStreamHeader*)mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(header == MAP_FAILED) return NULL;
+#endif
+
+    /* the publisher writes the magic last */
+    pxStreamFenceAcquire();
+    if(header->Magic != PX_POSE_STREAM_MAGIC || header->Version != PX_POSE_STREAM_VERSION ||
+       header->HeaderSize + header->SlotCount * header->SlotSize > size) {
+#ifdef _WIN32
+        UnmapViewOfFile(header);
+        CloseHandle(mapping);
+#else
+        munmap((void*)header, size);
+#endif
+        return NULL;
+    }
+
+    reader = (PxPoseStreamReader*)malloc(sizeof(PxPoseStreamReader));
+    reader->Header = header;
+    reader->Size = size;
+#ifdef _WIN32
+    reader->Mapping = mapping;
+#endif
+    return reader;
+}
+
+void pxPoseStreamClose(PxPoseStreamReader* reader) {
+    if(!reader) return;
+#ifdef _WIN32
+    UnmapViewOfFile(reader->Header);
+    CloseHandle(reader->Mapping);
+#else
+    munmap((void*)reader->Header, reader->Size);
+#endif
+    free(reader);
+}
+
+const PxPoseStreamHeader* pxPoseStreamHeader(const PxPoseStreamReader* reader) {
+    return reader->Header;
+}
+
+uint64_t pxPoseStreamLatest(const PxPoseStreamReader* reader) {
+    return pxStreamLoadAcquire(&reader->Header->Latest);
+}
+
+const PxPoseSlotHeader* pxPoseStreamBegin(const PxPoseStreamReader* reader, uint64_t* seq) {
+    const PxPoseStreamHeader* h = reader->Header;
+    uint64_t frame = pxStreamLoadAcquire(&h->Latest);
+    const PxPoseSlotHeader* slot;
+    uint64_t s;
+    if(frame == 0) return NULL;
+
+    slot = pxPoseStreamSlot(h, frame);
+    s = pxStreamLoadAcquire(&slot->Seq);
+    /* odd while written, a newer frame means the slot was already reused */
+    if((s & 1) || (s >> 1) != frame) return NULL;
+    *seq = s;
+    return slot;
+}
+
+int pxPoseStreamValidate(const PxPoseSlotHeader* slot, uint64_t seq) {
+    pxStreamFenceAcquire();
+    return pxStreamLoadAcquire(&slot->Seq) == seq;
+}
+
+uint64_t pxPoseStreamRead(const PxPoseStreamReader* reader, uint64_t afterFrame, double* time, uint32_t* count,
+        PxStreamPose* poses, PxStreamBodyId* ids, uint32_t maxBodies) {
+    const PxPoseStreamHeader* h = reader->Header;
+    int attempt;
+    for(attempt = 0; attempt < PX_POSE_STREAM_RETRIES; attempt++) {
+        uint64_t seq;
+        const PxPoseSlotHeader* slot;
+        double t;
+        uint32_t n;
+
+        if(pxPoseStreamLatest(reader) <= afterFrame) return 0;
+        slot = pxPoseStreamBegin(reader, &seq);
+        if(!slot) continue;
+
+        t = slot->Time;
+        n = slot->Count;
+        if(n > maxBodies) n = maxBodies;
+        if(n > h->MaxBodies) n = h->MaxBodies;
+        if(poses) memcpy(poses, pxPoseSlotPoses(h, slot), n * sizeof(PxStreamPose));
+        if(ids) memcpy(ids, pxPoseSlotIds(h, slot), n * sizeof(PxStreamBodyId));
+
+        if(!pxPoseStreamValidate(slot, seq)) continue;
+        if(time) *time = t;
+        if(count) *count = n;
+        return seq >> 1;
+    }
+    return 0;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+/*
+ * Shared-memory pose stream, reader side. Plain C without PhysX dependencies so
+ * renderers and recorders in other processes can link it directly.
+ *
+ * The mapping starts with a PxPoseStreamHeader followed by SlotCount slots of
+ * SlotSize bytes. Every slot holds a PxPoseSlotHeader, MaxBodies poses and
+ * MaxBodies body ids. The publisher writes frame f into slot f % SlotCount and
+ * guards it with a seqlock: Seq is (f << 1) | 1 while the slot is written and
+ * f << 1 once it is complete. A reader that sees the same even Seq before and
+ * after looking at a slot has read a consistent snapshot.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PX_POSE_STREAM_MAGIC 0x53505850u   /* "PXPS" */
+#define PX_POSE_STREAM_VERSION 1u
+
+typedef struct {
+    uint32_t Magic;         /* written last, readers must not use the stream before it matches */
+    uint32_t Version;
+    uint32_t SlotCount;
+    uint32_t MaxBodies;
+    uint64_t HeaderSize;    /* offset of the first slot */
+    uint64_t SlotSize;
+    uint64_t PosesOffset;   /* offsets inside a slot */
+    uint64_t IdsOffset;
+    volatile uint64_t Latest;   /* last completed frame, 0 before the first publish */
+} PxPoseStreamHeader;
+
+typedef struct {
+    volatile uint64_t Seq;
+    double Time;
+    uint32_t Count;         /* poses in this slot */
+    uint32_t TotalCount;    /* bodies at publish time, larger than Count if MaxBodies was exceeded */
+} PxPoseSlotHeader;
+
+/* same layout as PxTransform */
+typedef struct {
+    float Rot[4];   /* x, y, z, w */
+    float Trans[3];
+} PxStreamPose;
+
+/* same layout as PxBodyHandle */
+typedef struct {
+    uint32_t Index;
+    uint32_t Generation;
+} PxStreamBodyId;
+
+#if defined(_MSC_VER) && !defined(__cplusplus)
+#define PX_STREAM_INLINE static __inline
+#else
+#define PX_STREAM_INLINE static inline
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+/* x86/x64 only, loads and stores are not reordered with each other by the CPU */
+PX_STREAM_INLINE uint64_t pxStreamLoadAcquire(const volatile uint64_t* p) { uint64_t v = *p; _ReadWriteBarrier(); return v; }
+PX_STREAM_INLINE void pxStreamStoreRelease(volatile uint64_t* p, uint64_t v) { _ReadWriteBarrier(); *p = v; }
+PX_STREAM_INLINE void pxStreamFenceAcquire(void) { _ReadWriteBarrier(); }
+PX_STREAM_INLINE void pxStreamFenceRelease(void) { _ReadWriteBarrier(); }
+#else
+PX_STREAM_INLINE uint64_t pxStreamLoadAcquire(const volatile uint64_t* p) { return __atomic_load_n(p, __ATOMIC_ACQUIRE); }
+PX_STREAM_INLINE void pxStreamStoreRelease(volatile uint64_t* p, uint64_t v) { __atomic_store_n(p, v, __ATOMIC_RELEASE); }
+PX_STREAM_INLINE void pxStreamFenceAcquire(void) { __atomic_thread_fence(__ATOMIC_ACQUIRE); }
+PX_STREAM_INLINE void pxStreamFenceRelease(void) { __atomic_thread_fence(__ATOMIC_RELEASE); }
+#endif
+
+PX_STREAM_INLINE PxPoseSlotHeader* pxPoseStreamSlot(const PxPoseStreamHeader* h, uint64_t frame) {
+    return (PxPoseSlotHeader*)((char*)h + h->HeaderSize + (frame % h->SlotCount) * h->SlotSize);
+}
+
+PX_STREAM_INLINE PxStreamPose* pxPoseSlotPoses(const PxPoseStreamHeader* h, const PxPoseSlotHeader* slot) {
+    return (PxStreamPose*)((char*)slot + h->PosesOffset);
+}
+
+PX_STREAM_INLINE PxStreamBodyId* pxPoseSlotIds(const PxPoseStreamHeader* h, const PxPoseSlotHeader* slot) {
+    return (PxStreamBodyId*)((char*)slot + h->IdsOffset);
+}
+
+typedef struct PxPoseStreamReader PxPoseStreamReader;
+
+/* opens an existing stream (POSIX names start with '/'), NULL if it does not exist or is not ready */
+PxPoseStreamReader* pxPoseStreamOpen(const char* name);
+void pxPoseStreamClose(PxPoseStreamReader* reader);
+const PxPoseStreamHeader* pxPoseStreamHeader(const PxPoseStreamReader* reader);
+
+/* last completed frame, 0 if nothing was published yet */
+uint64_t pxPoseStreamLatest(const PxPoseStreamReader* reader);
+
+/*
+ * Zero-copy access: pxPoseStreamBegin returns the slot of the latest frame and
+ * its sequence, the slot may then be read in place. pxPoseStreamValidate
+ * returns 1 if the slot was not overwritten in the meantime, everything read
+ * from it must be discarded otherwise. Returns NULL if no complete frame is
+ * available right now.
+ */
+const PxPoseSlotHeader* pxPoseStreamBegin(const PxPoseStreamReader* reader, uint64_t* seq);
+int pxPoseStreamValidate(const PxPoseSlotHeader* slot, uint64_t seq);
+
+/*
+ * Copies the latest frame newer than afterFrame. Returns the frame, 0 if there
+ * is no newer one, or if every attempt was torn by the publisher lapping the
+ * ring. poses and ids may be NULL, at most maxBodies entries are copied and
+ * count receives the number copied.
+ */
+uint64_t pxPoseStreamRead(const PxPoseStreamReader* reader, uint64_t afterFrame, double* time, uint32_t* count,
+    PxStreamPose* poses, PxStreamBodyId* ids, uint32_t maxBodies);
+
+#ifdef __cplusplus
+}
+#endif
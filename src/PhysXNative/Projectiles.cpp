@@ -0,0 +1,168 @@
+#include "Projectiles.h"
+#include "Parallel.h"
+#include <cstring>
+#include <extensions/PxRigidBodyExt.h>
+#include <extensions/PxSceneQueryExt.h>
+
+using namespace physx;
+
+static const PxU32 ProjectileGrain = 128;
+
+enum ProjectileState : PxU8 {
+    ProjectileFlying = 0,
+    ProjectileHit = 1,
+    ProjectileExpired = 2
+};
+
+PxU32 ProjectileManager::spawn(const PxProjectileDesc& desc) {
+    auto id = NextId++;
+    Positions.push_back(toPxVec3(desc.Position));
+    Velocities.push_back(toPxVec3(desc.Velocity));
+    Radii.push_back(desc.Radius);
+    Drags.push_back(desc.Drag);
+    Masses.push_back(desc.Mass);
+    Lifetimes.push_back(desc.Lifetime);
+    UserData.push_back(desc.UserData);
+    Ids.push_back(id);
+    return id;
+}
+
+PxU32 ProjectileManager::step(PxScene* scene, float dt, PxCpuDispatcher* dispatcher) {
+    auto n = size();
+    Hits.resize(n);
+    States.resize(n);
+    Impacts.clear();
+
+    // scene queries only read, so every chunk runs its own batch of sweeps concurrently
+    Sweeps.resize(n);
+    Results.resize(n);
+    parallelFor(dispatcher, n, ProjectileGrain, [&](PxU32 begin, PxU32 end) {
+        auto batch = PxCreateBatchQueryExt(*scene, NULL, NULL, 0, NULL, 0, Sweeps.data() + begin, end - begin, NULL, 0, NULL, 0, NULL, 0);
+        PxQueryFilterData filter(PxQueryFlag::eSTATIC | PxQueryFlag::eDYNAMIC);
+        for(PxU32 i = begin; i < end; i++) {
+            // explicit Euler drag, clamped so that a large step stops the projectile instead of reversing it
+            auto v = Velocities[i];
+            auto drag = PxMin(Drags[i] * v.magnitude() * dt, 1.0f);
+            v = v * (1.0f - drag) + Gravity * dt;
+            Velocities[i] = v;
+
+            auto delta = v * dt;
+            auto distance = delta.magnitude();
+            Lifetimes[i] -= dt;
+            States[i] = Lifetimes[i] <= 0.0f ? ProjectileExpired : ProjectileFlying;
+            Results[i] = NULL;
+            if(distance <= 0.0f) continue;
+
+            PxSphereGeometry sphere(Radii[i]);
+            auto dir = delta / distance;
+            if(batch) {
+                Results[i] = batch->sweep(sphere, PxTransform(Positions[i]), dir, distance, 0, PxHitFlag::eDEFAULT, filter);
+            }
+            else {
+                // the batch could not be allocated, sweep one by one
+                scene->sweep(sphere, PxTransform(Positions[i]), dir, distance, Sweeps[i], PxHitFlag::eDEFAULT, filter);
+                Results[i] = &Sweeps[i];
+            }
+        }
+        if(batch) {
+            batch->execute();
+            batch->release();
+        }
+
+        for(PxU32 i = begin; i < end; i++) {
+            if(!Results[i]) continue;
+            if(Results[i]->hasBlock) {
+                Hits[i] = Results[i]->block;
+                States[i] = ProjectileHit;
+            }
+            else Positions[i] += Velocities[i] * dt;
+        }
+    });
+
+    // impulses write to the scene and projectiles are compacted in order, both run serially
+    PxU32 alive = 0;
+    for(PxU32 i = 0; i < n; i++) {
+        if(States[i] == ProjectileHit) {
+            auto& hit = Hits[i];
+            PxProjectileImpact impact;
+            impact.Projectile = Ids[i];
+            impact.Reserved = 0;
+            impact.Actor = hit.actor;
+            impact.Shape = hit.shape;
+            impact.Position = toV3d(hit.position);
+            impact.Normal = toV3d(hit.normal);
+            impact.Velocity = toV3d(Velocities[i]);
+            impact.UserData = UserData[i];
+            Impacts.push_back(impact);
+
+            auto body = hit.actor ? hit.actor->is<PxRigidBody>() : nullptr;
+            if(ImpulseScale > 0.0f && body && !(body->getRigidBodyFlags() & PxRigidBodyFlag::eKINEMATIC)) {
+                PxRigidBodyExt::addForceAtPos(*body, Velocities[i] * (Masses[i] * ImpulseScale), hit.position, PxForceMode::eIMPULSE);
+            }
+            continue;
+        }
+        if(States[i] == ProjectileExpired) continue;
+
+        if(alive != i) {
+            Positions[alive] = Positions[i];
+            Velocities[alive] = Velocities[i];
+            Radii[alive] = Radii[i];
+            Drags[alive] = Drags[i];
+            Masses[alive] = Masses[i];
+            Lifetimes[alive] = Lifetimes[i];
+            UserData[alive] = UserData[i];
+            Ids[alive] = Ids[i];
+        }
+        alive++;
+    }
+
+    Positions.resize(alive);
+    Velocities.resize(alive);
+    Radii.resize(alive);
+    Drags.resize(alive);
+    Masses.resize(alive);
+    Lifetimes.resize(alive);
+    UserData.resize(alive);
+    Ids.resize(alive);
+    return (PxU32)Impacts.size();
+}
+
+
+DllExport(ProjectileManager*) pxCreateProjectileManager(V3d gravity, float impulseScale) {
+    return new ProjectileManager(toPxVec3(gravity), impulseScale);
+}
+
+DllExport(void) pxDestroyProjectileManager(ProjectileManager* manager) {
+    delete manager;
+}
+
+DllExport(void) pxSpawnProjectiles(ProjectileManager* manager, PxU32 count, const PxProjectileDesc* descs, PxU32* ids) {
+    for(PxU32 i = 0; i < count; i++) {
+        auto id = manager->spawn(descs[i]);
+        if(ids) ids[i] = id;
+    }
+}
+
+DllExport(PxU32) pxStepProjectiles(ProjectileManager* manager, PxSceneHandle* scene, float dt) {
+    return manager->step(scene->Scene, dt, sharedDispatcher());
+}
+
+DllExport(PxU32) pxGetProjectileImpacts(ProjectileManager* manager, PxProjectileImpact* impacts, PxU32 maxImpacts) {
+    auto n = PxMin(maxImpacts, (PxU32)manager->Impacts.size());
+    if(n) memcpy(impacts, manager->Impacts.data(), n * sizeof(PxProjectileImpact));
+    return n;
+}
+
+DllExport(PxU32) pxGetProjectileCount(ProjectileManager* manager) {
+    return manager->size();
+}
+
+DllExport(PxU32) pxGetProjectiles(ProjectileManager* manager, V3d* positions, V3d* velocities, PxU32* ids, PxU32 maxProjectiles) {
+    auto n = PxMin(maxProjectiles, manager->size());
+    for(PxU32 i = 0; i < n; i++) {
+        if(positions) positions[i] = toV3d(manager->Positions[i]);
+        if(velocities) velocities[i] = toV3d(manager->Velocities[i]);
+        if(ids) ids[i] = manager->Ids[i];
+    }
+    return n;
+}
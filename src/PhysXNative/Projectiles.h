@@ -0,0 +1,75 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include <vector>
+
+typedef struct {
+    V3d Position;
+    V3d Velocity;
+    float Radius;
+    float Drag;         // quadratic, deceleration is Drag * |v| * v
+    float Mass;         // impulse on impact is ImpulseScale * Mass * velocity
+    float Lifetime;     // seconds until the projectile expires without a hit
+    physx::PxU64 UserData;
+} PxProjectileDesc;
+
+typedef struct {
+    physx::PxU32 Projectile;
+    physx::PxU32 Reserved;
+    physx::PxRigidActor* Actor;
+    physx::PxShape* Shape;
+    V3d Position;
+    V3d Normal;
+    V3d Velocity;       // of the projectile at impact
+    physx::PxU64 UserData;
+} PxProjectileImpact;
+
+// Projectiles as plain data instead of scene actors. Each step advances them
+// under gravity and drag and sweeps a sphere along the way against the scene,
+// one PxBatchQueryExt per parallel chunk, so fast projectiles cannot tunnel
+// and cost only grows with the number of sweeps. A projectile is removed on
+// its first hit and reported as an impact; with a positive ImpulseScale the
+// hit dynamic body receives an impulse at the impact point.
+class ProjectileManager {
+public:
+    ProjectileManager(const physx::PxVec3& gravity, float impulseScale) : Gravity(gravity), ImpulseScale(impulseScale), NextId(0) {}
+
+    physx::PxVec3 Gravity;
+    float ImpulseScale;
+
+    // structure of arrays, compacted when projectiles die
+    std::vector<physx::PxVec3> Positions;
+    std::vector<physx::PxVec3> Velocities;
+    std::vector<float> Radii;
+    std::vector<float> Drags;
+    std::vector<float> Masses;
+    std::vector<float> Lifetimes;
+    std::vector<physx::PxU64> UserData;
+    std::vector<physx::PxU32> Ids;
+
+    std::vector<PxProjectileImpact> Impacts;
+
+    physx::PxU32 size() const { return (physx::PxU32)Ids.size(); }
+    physx::PxU32 spawn(const PxProjectileDesc& desc);
+    // returns the number of impacts, the scene must not be simulating
+    physx::PxU32 step(physx::PxScene* scene, float dt, physx::PxCpuDispatcher* dispatcher);
+
+private:
+    physx::PxU32 NextId;
+
+    // per projectile results of the sweep pass
+    std::vector<physx::PxSweepHit> Hits;
+    std::vector<physx::PxU8> States;
+    // result storage of the batched sweeps, NULL for projectiles that did not move
+    std::vector<physx::PxSweepBuffer> Sweeps;
+    std::vector<physx::PxSweepBuffer*> Results;
+};
+
+DllExport(ProjectileManager*) pxCreateProjectileManager(V3d gravity, float impulseScale);
+DllExport(void) pxDestroyProjectileManager(ProjectileManager* manager);
+DllExport(void) pxSpawnProjectiles(ProjectileManager* manager, physx::PxU32 count, const PxProjectileDesc* descs, physx::PxU32* ids);
+DllExport(physx::PxU32) pxStepProjectiles(ProjectileManager* manager, PxSceneHandle* scene, float dt);
+DllExport(physx::PxU32) pxGetProjectileImpacts(ProjectileManager* manager, PxProjectileImpact* impacts, physx::PxU32 maxImpacts);
+DllExport(physx::PxU32) pxGetProjectileCount(ProjectileManager* manager);
+// positions, velocities and ids may be NULL
+DllExport(physx::PxU32) pxGetProjectiles(ProjectileManager* manager, V3d* positions, V3d* velocities, physx::PxU32* ids, physx::PxU32 maxProjectiles);
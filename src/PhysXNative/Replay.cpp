@@ -0,0 +1,424 @@
+#include "Replay.h"
+#include "BitPacking.h"
+#include "Parallel.h"
+#include <cstring>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace physx;
+
+static const PxU32 ConvertGrain = 4096;
+
+// per body: 3 position steps, largest quaternion component, 3 quaternion components
+static const PxU32 QuantizedSize = 7;
+
+static void quantizePose(const PositionQuantizer& pq, PxU32 rotationBits, const PxTransform& pose, PxU32* q) {
+    pq.quantize(pose.p, q);
+    q[3] = quantizeQuat(pose.q, rotationBits, q + 4);
+}
+
+static PxTransform dequantizePose(const PositionQuantizer& pq, PxU32 rotationBits, const PxU32* q) {
+    return PxTransform(pq.dequantize(q), dequantizeQuat(q[3], q + 4, rotationBits));
+}
+
+static void writeRotation(BitWriter& w, PxU32 rotationBits, const PxU32* q) {
+    w.write(q[3], 2);
+    for(PxU32 c = 0; c < 3; c++) w.write(q[4 + c], rotationBits);
+}
+
+static void readRotation(BitReader& r, PxU32 rotationBits, PxU32* q) {
+    q[3] = r.read(2);
+    for(PxU32 c = 0; c < 3; c++) q[4 + c] = r.read(rotationBits);
+}
+
+// components as deltas against the previous rotation s while the largest
+// component stays on the same axis, the full rotation otherwise
+static void writeRotationDelta(BitWriter& w, PxU32 rotationBits, PxU32 deltaBits, const PxU32* q, const PxU32* s) {
+    auto sameAxis = q[3] == s[3];
+    w.write(sameAxis ? 1 : 0, 1);
+    if(!sameAxis) {
+        writeRotation(w, rotationBits, q);
+        return;
+    }
+    for(PxU32 c = 0; c < 3; c++) w.write(zigZag((PxI32)(q[4 + c] - s[4 + c])), deltaBits);
+}
+
+static void readRotationDelta(BitReader& r, PxU32 rotationBits, PxU32 deltaBits, PxU32* q) {
+    if(!r.read(1)) {
+        readRotation(r, rotationBits, q);
+        return;
+    }
+    for(PxU32 c = 0; c < 3; c++) q[4 + c] += (PxU32)unZigZag(r.read(deltaBits));
+}
+
+ReplayRecorder* ReplayRecorder::create(const char* path, PxU32 keyframeInterval, PxU32 positionBits, PxU32 rotationBits) {
+    auto file = fopen(path, "wb");
+    if(!file) return NULL;
+
+    auto rec = new ReplayRecorder();
+    memset(&rec->Header, 0, sizeof(ReplayFileHeader));
+    rec->Header.Magic = ReplayFileMagic;
+    rec->Header.Version = ReplayVersion;
+    rec->Header.PositionBits = PxClamp(positionBits, 4u, 24u);
+    rec->Header.RotationBits = PxClamp(rotationBits, 4u, 16u);
+    rec->Header.KeyframeInterval = PxMax(keyframeInterval, 1u);
+    rec->File = file;
+    fwrite(&rec->Header, sizeof(ReplayFileHeader), 1, file);
+    fflush(file);
+    rec->Writer = std::thread([rec]() { rec->writerLoop(); });
+    return rec;
+}
+
+ReplayRecorder::~ReplayRecorder() {
+    flush();
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Stop = true;
+    }
+    Wake.notify_all();
+    Writer.join();
+    fclose(File);
+}
+
+void ReplayRecorder::beginChunk(const PxBodyHandle* ids, PxU32 count) {
+    Pending.FirstFrame = Frame;
+    Pending.Ids.assign(ids, ids + count);
+    Pending.Poses.clear();
+    Pending.Times.clear();
+}
+
+void ReplayRecorder::record(const PxTransform* poses, const PxBodyHandle* ids, PxU32 count, double time) {
+    // a different body set starts a new chunk with a keyframe
+    auto sameBodies = !Pending.Times.empty() && Pending.Ids.size() == count &&
+        (count == 0 || memcmp(Pending.Ids.data(), ids, count * sizeof(PxBodyHandle)) == 0);
+    if(!sameBodies) {
+        flush();
+        beginChunk(ids, count);
+    }
+
+    Pending.Poses.insert(Pending.Poses.end(), poses, poses + count);
+    Pending.Times.push_back(time);
+    Frame++;
+    if(Pending.Times.size() >= Header.KeyframeInterval) flush();
+}
+
+void ReplayRecorder::record(const BodyTable& table, double time) {
+    std::vector<PxBodyHandle> ids(table.size());
+    for(PxU32 i = 0; i < table.size(); i++) ids[i] = table.handleOf(i);
+    record(table.Poses.data(), ids.data(), table.size(), time);
+}
+
+void ReplayRecorder::flush() {
+    if(Pending.Times.empty()) return;
+    {
+        std::lock_guard<std::mutex> lock(Mutex);
+        Queue.push_back(std::move(Pending));
+    }
+    Pending = ReplayChunk();
+    Wake.notify_one();
+}
+
+void ReplayRecorder::writerLoop() {
+    std::vector<PxU8> bytes;
+    for(;;) {
+        ReplayChunk chunk;
+        {
+            std::unique_lock<std::mutex> lock(Mutex);
+            Wake.wait(lock, [this]() { return Stop || !Queue.empty(); });
+            if(Queue.empty()) return;
+            chunk = std::move(Queue.front());
+            Queue.pop_front();
+        }
+        encode(chunk, bytes);
+        // whole chunks only, a live file can be opened for playback at any time
+        fwrite(bytes.data(), 1, bytes.size(), File);
+        fflush(File);
+    }
+}
+
+void ReplayRecorder::encode(const ReplayChunk& chunk, std::vector<PxU8>& out) const {
+    auto n = (PxU32)chunk.Ids.size();
+    auto frames = (PxU32)chunk.Times.size();
+    auto rb = Header.RotationBits;
+
+    auto bounds = PxBounds3::empty();
+    for(auto& p : chunk.Poses) bounds.include(p.p);
+    if(bounds.isEmpty()) bounds = PxBounds3(PxVec3(0.0f), PxVec3(0.0f));
+    PositionQuantizer pq(bounds, Header.PositionBits);
+
+    out.resize(sizeof(ReplayChunkHeader));
+    auto idBytes = (const PxU8*)chunk.Ids.data();
+    out.insert(out.end(), idBytes, idBytes + n * sizeof(PxBodyHandle));
+    auto timeBytes = (const PxU8*)chunk.Times.data();
+    out.insert(out.end(), timeBytes, timeBytes + frames * sizeof(double));
+
+    std::vector<PxU32> state((size_t)n * QuantizedSize);
+    std::vector<PxU32> current((size_t)n * QuantizedSize);
+    std::vector<PxU8> changed(n);
+    BitWriter w(out);
+
+    for(PxU32 f = 0; f < frames; f++) {
+        auto poses = &chunk.Poses[(size_t)f * n];
+        if(f == 0) {
+            for(PxU32 i = 0; i < n; i++) {
+                auto q = &state[(size_t)i * QuantizedSize];
+                quantizePose(pq, rb, poses[i], q);
+                for(PxU32 a = 0; a < 3; a++) w.write(q[a], pq.Bits);
+                writeRotation(w, rb, q);
+            }
+            continue;
+        }
+
+        // only bodies whose quantized pose changed are stored, positions and
+        // rotations as deltas with the smallest widths that fit every delta
+        // of this frame
+        PxU32 deltaBits = 0;
+        PxU32 rotationDeltaBits = 0;
+        bool any = false;
+        for(PxU32 i = 0; i < n; i++) {
+            auto q = &current[(size_t)i * QuantizedSize];
+            auto s = &state[(size_t)i * QuantizedSize];
+            quantizePose(pq, rb, poses[i], q);
+            changed[i] = memcmp(q, s, QuantizedSize * sizeof(PxU32)) != 0;
+            if(!changed[i]) continue;
+            any = true;
+            for(PxU32 a = 0; a < 3; a++) deltaBits = PxMax(deltaBits, bitWidth(zigZag((PxI32)(q[a] - s[a]))));
+            if(q[3] != s[3]) continue;
+            for(PxU32 c = 0; c < 3; c++) rotationDeltaBits = PxMax(rotationDeltaBits, bitWidth(zigZag((PxI32)(q[4 + c] - s[4 + c]))));
+        }
+
+        w.write(any ? 1 : 0, 1);
+        if(!any) continue;
+        w.write(deltaBits, 5);
+        w.write(rotationDeltaBits, 5);
+        for(PxU32 i = 0; i < n; i++) {
+            w.write(changed[i], 1);
+            if(!changed[i]) continue;
+            auto q = &current[(size_t)i * QuantizedSize];
+            auto s = &state[(size_t)i * QuantizedSize];
+            for(PxU32 a = 0; a < 3; a++) w.write(zigZag((PxI32)(q[a] - s[a])), deltaBits);
+            writeRotationDelta(w, rb, rotationDeltaBits, q, s);
+            memcpy(s, q, QuantizedSize * sizeof(PxU32));
+        }
+    }
+    w.flush();
+
+    ReplayChunkHeader header;
+    header.Magic = ReplayChunkMagic;
+    header.Size = (PxU32)out.size();
+    header.FirstFrame = chunk.FirstFrame;
+    header.FrameCount = frames;
+    header.BodyCount = n;
+    for(PxU32 a = 0; a < 3; a++) {
+        header.BoundsMin[a] = bounds.minimum[a];
+        header.BoundsMax[a] = bounds.maximum[a];
+    }
+    memcpy(out.data(), &header, sizeof(ReplayChunkHeader));
+}
+
+
+ReplayReader* ReplayReader::open(const char* path) {
+    const PxU8* data;
+    size_t size;
+    void* mapping = NULL;
+#ifdef _WIN32
+    auto file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if(file == INVALID_HANDLE_VALUE) return NULL;
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(file, &fileSize);
+    size = (size_t)fileSize.QuadPart;
+    mapping = size >= sizeof(ReplayFileHeader) ? CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+    CloseHandle(file);
+    if(!mapping) return NULL;
+    data = (const PxU8*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if(!data) { CloseHandle(mapping); return NULL; }
+#else
+    auto fd = ::open(path, O_RDONLY);
+    if(fd < 0) return NULL;
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(ReplayFileHeader)) { close(fd); return NULL; }
+    size = (size_t)st.st_size;
+    auto memory = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(memory == MAP_FAILED) return NULL;
+    data = (const PxU8*)memory;
+#endif
+
+    auto reader = new ReplayReader();
+    reader->Data = data;
+    reader->Size = size;
+    reader->Mapping = mapping;
+    memcpy(&reader->Header, data, sizeof(ReplayFileHeader));
+    if(reader->Header.Magic != ReplayFileMagic || reader->Header.Version != ReplayVersion) {
+        delete reader;
+        return NULL;
+    }
+
+    // index the chunks by hopping over their headers
+    size_t offset = sizeof(ReplayFileHeader);
+    while(offset + sizeof(ReplayChunkHeader) <= size) {
+        ReplayChunkHeader header;
+        memcpy(&header, data + offset, sizeof(ReplayChunkHeader));
+        if(header.Magic != ReplayChunkMagic || header.Size < sizeof(ReplayChunkHeader) || offset + header.Size > size) break;
+        if(header.FirstFrame != reader->FrameCount) break;
+
+        ReplayChunkInfo info;
+        info.Offset = offset;
+        info.FirstFrame = header.FirstFrame;
+        info.FrameCount = header.FrameCount;
+        info.BodyCount = header.BodyCount;
+        reader->Chunks.push_back(info);
+        reader->FrameCount += header.FrameCount;
+        reader->MaxBodies = PxMax(reader->MaxBodies, header.BodyCount);
+        offset += header.Size;
+    }
+    return reader;
+}
+
+ReplayReader::~ReplayReader() {
+#ifdef _WIN32
+    UnmapViewOfFile(Data);
+    CloseHandle((HANDLE)Mapping);
+#else
+    munmap((void*)Data, Size);
+#endif
+}
+
+PxU32 ReplayReader::chunkOf(PxU64 frame) const {
+    // last chunk starting at or before frame
+    PxU32 lo = 0, hi = (PxU32)Chunks.size();
+    while(hi - lo > 1) {
+        auto mid = (lo + hi) / 2;
+        if(Chunks[mid].FirstFrame <= frame) lo = mid;
+        else hi = mid;
+    }
+    return lo;
+}
+
+void ReplayReader::decodeChunk(const ReplayChunkInfo& chunk, PxU64 first, PxU64 end, PxTransform* poses,
+        PxBodyHandle* ids, size_t stride, PxU32* counts, double* times) const {
+    ReplayChunkHeader header;
+    memcpy(&header, Data + chunk.Offset, sizeof(ReplayChunkHeader));
+    auto n = header.BodyCount;
+    auto rb = Header.RotationBits;
+    PositionQuantizer pq(PxBounds3(PxVec3(header.BoundsMin[0], header.BoundsMin[1], header.BoundsMin[2]),
+        PxVec3(header.BoundsMax[0], header.BoundsMax[1], header.BoundsMax[2])), Header.PositionBits);
+
+    auto idData = Data + chunk.Offset + sizeof(ReplayChunkHeader);
+    auto timeData = idData + (size_t)n * sizeof(PxBodyHandle);
+    auto bits = timeData + (size_t)header.FrameCount * sizeof(double);
+    BitReader r(bits, Data + chunk.Offset + header.Size - bits);
+
+    std::vector<PxU32> state((size_t)n * QuantizedSize);
+    std::vector<PxTransform> current(n);
+    auto lastFrame = PxMin(end, chunk.FirstFrame + chunk.FrameCount);
+    auto written = (PxU32)PxMin((size_t)n, stride);
+
+    for(auto frame = chunk.FirstFrame; frame < lastFrame; frame++) {
+        if(frame == chunk.FirstFrame) {
+            for(PxU32 i = 0; i < n; i++) {
+                auto q = &state[(size_t)i * QuantizedSize];
+                for(PxU32 a = 0; a < 3; a++) q[a] = r.read(pq.Bits);
+                readRotation(r, rb, q);
+                current[i] = dequantizePose(pq, rb, q);
+            }
+        }
+        else if(r.read(1)) {
+            auto deltaBits = r.read(5);
+            auto rotationDeltaBits = r.read(5);
+            for(PxU32 i = 0; i < n; i++) {
+                if(!r.read(1)) continue;
+                auto q = &state[(size_t)i * QuantizedSize];
+                for(PxU32 a = 0; a < 3; a++) q[a] += (PxU32)unZigZag(r.read(deltaBits));
+                readRotationDelta(r, rb, rotationDeltaBits, q);
+                current[i] = dequantizePose(pq, rb, q);
+            }
+        }
+
+        if(frame < first) continue;
+        auto o = (size_t)(frame - first);
+        memcpy((void*)(poses + o * stride), current.data(), written * sizeof(PxTransform));
+        if(ids) memcpy(ids + o * stride, idData, written * sizeof(PxBodyHandle));
+        if(counts) counts[o] = n;
+        if(times) memcpy(times + o, timeData + (size_t)(frame - chunk.FirstFrame) * sizeof(double), sizeof(double));
+    }
+}
+
+void ReplayReader::decode(PxU64 first, PxU64 count, PxTransform* poses, PxBodyHandle* ids, size_t stride,
+        PxU32* counts, double* times, PxCpuDispatcher* dispatcher) const {
+    if(first >= FrameCount) return;
+    auto end = PxMin(first + count, FrameCount);
+    auto c0 = chunkOf(first);
+    auto c1 = chunkOf(end - 1);
+    parallelFor(dispatcher, c1 - c0 + 1, 1, [&](PxU32 begin, PxU32 stop) {
+        for(auto c = begin; c < stop; c++) decodeChunk(Chunks[c0 + c], first, end, poses, ids, stride, counts, times);
+    });
+}
+
+
+DllExport(ReplayRecorder*) pxCreateReplayRecorder(const char* path, PxU32 keyframeInterval, PxU32 positionBits, PxU32 rotationBits) {
+    return ReplayRecorder::create(path, keyframeInterval, positionBits, rotationBits);
+}
+
+DllExport(void) pxDestroyReplayRecorder(ReplayRecorder* recorder) {
+    delete recorder;
+}
+
+DllExport(void) pxRecordReplayFrame(ReplayRecorder* recorder, BodyTable* table, double time) {
+    recorder->record(*table, time);
+}
+
+DllExport(void) pxRecordReplayPoses(ReplayRecorder* recorder, PxU32 count, const Euclidean3d* poses, const PxBodyHandle* ids, double time) {
+    std::vector<PxTransform> transforms(count);
+    std::vector<PxBodyHandle> defaultIds;
+    for(PxU32 i = 0; i < count; i++) transforms[i] = toPxTransform(poses[i]);
+    if(!ids) {
+        // without ids bodies are identified by their position in the array
+        defaultIds.resize(count);
+        for(PxU32 i = 0; i < count; i++) defaultIds[i] = { i, 0 };
+        ids = defaultIds.data();
+    }
+    recorder->record(transforms.data(), ids, count, time);
+}
+
+DllExport(void) pxFlushReplayRecorder(ReplayRecorder* recorder) {
+    recorder->flush();
+}
+
+DllExport(ReplayReader*) pxOpenReplay(const char* path) {
+    return ReplayReader::open(path);
+}
+
+DllExport(void) pxCloseReplay(ReplayReader* reader) {
+    delete reader;
+}
+
+DllExport(void) pxGetReplayInfo(ReplayReader* reader, PxU64* frameCount, PxU32* maxBodies) {
+    if(frameCount) *frameCount = reader->FrameCount;
+    if(maxBodies) *maxBodies = reader->MaxBodies;
+}
+
+DllExport(void) pxDecodeReplayFrames(ReplayReader* reader, PxU64 first, PxU64 count, Euclidean3d* poses,
+        PxBodyHandle* ids, PxU32 stride, PxU32* counts, double* times) {
+    if(first >= reader->FrameCount) return;
+    count = PxMin(count, reader->FrameCount - first);
+    std::vector<PxTransform> transforms((size_t)count * stride);
+    std::vector<PxU32> decoded(count);
+    auto dispatcher = sharedDispatcher();
+    reader->decode(first, count, transforms.data(), ids, stride, decoded.data(), times, dispatcher);
+
+    parallelFor(dispatcher, (PxU32)count, PxMax(1u, ConvertGrain / PxMax(stride, 1u)), [&](PxU32 begin, PxU32 end) {
+        for(PxU32 f = begin; f < end; f++) {
+            auto n = PxMin(decoded[f], stride);
+            for(PxU32 i = 0; i < n; i++) poses[(size_t)f * stride + i] = toEuclidean3d(transforms[(size_t)f * stride + i]);
+        }
+    });
+    if(counts) memcpy(counts, decoded.data(), (size_t)count * sizeof(PxU32));
+}
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include "BodyTable.h"
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Replay files start with a ReplayFileHeader followed by self-contained chunks.
+// A chunk covers up to KeyframeInterval frames of a fixed body set: the
+// ReplayChunkHeader, the body ids, one time per frame and a bit stream. The
+// first frame of a chunk is a keyframe with every pose, the others only store
+// bodies whose quantized pose changed. Positions are quantized relative to the
+// bounds of the whole chunk, rotations use smallest-three encoding. After the
+// keyframe both are stored as deltas against the previous frame, a rotation
+// whose largest component changed axis is stored in full.
+static const physx::PxU32 ReplayFileMagic = 0x50525850;    // "PXRP"
+static const physx::PxU32 ReplayChunkMagic = 0x4B435052;   // "RPCK"
+static const physx::PxU32 ReplayVersion = 2;
+
+typedef struct {
+    physx::PxU32 Magic;
+    physx::PxU32 Version;
+    physx::PxU32 PositionBits;
+    physx::PxU32 RotationBits;
+    physx::PxU32 KeyframeInterval;
+    physx::PxU32 Reserved[3];
+} ReplayFileHeader;
+
+typedef struct {
+    physx::PxU32 Magic;
+    physx::PxU32 Size;          // bytes including this header
+    physx::PxU64 FirstFrame;
+    physx::PxU32 FrameCount;
+    physx::PxU32 BodyCount;
+    float BoundsMin[3];
+    float BoundsMax[3];
+} ReplayChunkHeader;
+
+struct ReplayChunk {
+    physx::PxU64 FirstFrame;
+    std::vector<PxBodyHandle> Ids;
+    std::vector<physx::PxTransform> Poses;  // frame major
+    std::vector<double> Times;
+};
+
+// Appends frames to a replay file. Frames are collected until a chunk is full
+// or the body set changes, encoding and writing happen on a background thread
+// so recording does not stall the step.
+class ReplayRecorder {
+public:
+    ~ReplayRecorder();
+
+    // returns NULL if the file cannot be created
+    static ReplayRecorder* create(const char* path, physx::PxU32 keyframeInterval, physx::PxU32 positionBits, physx::PxU32 rotationBits);
+
+    ReplayFileHeader Header;
+    physx::PxU64 Frame;
+
+    void record(const physx::PxTransform* poses, const PxBodyHandle* ids, physx::PxU32 count, double time);
+    void record(const BodyTable& table, double time);
+    // hands the pending chunk to the writer
+    void flush();
+
+private:
+    ReplayRecorder() : Frame(0), File(NULL), Stop(false) {}
+
+    void beginChunk(const PxBodyHandle* ids, physx::PxU32 count);
+    void writerLoop();
+    void encode(const ReplayChunk& chunk, std::vector<physx::PxU8>& out) const;
+
+    FILE* File;
+    ReplayChunk Pending;
+    std::deque<ReplayChunk> Queue;
+    std::mutex Mutex;
+    std::condition_variable Wake;
+    std::thread Writer;
+    bool Stop;
+};
+
+struct ReplayChunkInfo {
+    physx::PxU64 Offset;
+    physx::PxU64 FirstFrame;
+    physx::PxU32 FrameCount;
+    physx::PxU32 BodyCount;
+};
+
+// Memory-mapped replay playback, never touches a scene. Decoding a frame
+// needs its chunk up to that frame, ranges decode their chunks in parallel.
+class ReplayReader {
+public:
+    ~ReplayReader();
+
+    // returns NULL if the file cannot be mapped or is not a replay, a chunk cut
+    // short by a crash ends the replay before it
+    static ReplayReader* open(const char* path);
+
+    ReplayFileHeader Header;
+    physx::PxU64 FrameCount;
+    physx::PxU32 MaxBodies;
+    std::vector<ReplayChunkInfo> Chunks;
+
+    physx::PxU32 chunkOf(physx::PxU64 frame) const;
+
+    // Decodes frames [first, first + count). Frame i of the range writes its
+    // poses to poses + i * stride, ids (may be NULL) likewise, counts[i] and
+    // times[i] (may be NULL) receive body count and time.
+    void decode(physx::PxU64 first, physx::PxU64 count, physx::PxTransform* poses, PxBodyHandle* ids, size_t stride,
+        physx::PxU32* counts, double* times, physx::PxCpuDispatcher* dispatcher) const;
+
+private:
+    ReplayReader() : FrameCount(0), MaxBodies(0), Data(NULL), Size(0), Mapping(NULL) {}
+
+    void decodeChunk(const ReplayChunkInfo& chunk, physx::PxU64 first, physx::PxU64 end, physx::PxTransform* poses,
+        PxBodyHandle* ids, size_t stride, physx::PxU32* counts, double* times) const;
+
+    const physx::PxU8* Data;
+    size_t Size;
+    void* Mapping;  // file mapping handle on Windows
+};
+
+DllExport(ReplayRecorder*) pxCreateReplayRecorder(const char* path, physx::PxU32 keyframeInterval, physx::PxU32 positionBits, physx::PxU32 rotationBits);
+DllExport(void) pxDestroyReplayRecorder(ReplayRecorder* recorder);
+DllExport(void) pxRecordReplayFrame(ReplayRecorder* recorder, BodyTable* table, double time);
+DllExport(void) pxRecordReplayPoses(ReplayRecorder* recorder, physx::PxU32 count, const Euclidean3d* poses, const PxBodyHandle* ids, double time);
+DllExport(void) pxFlushReplayRecorder(ReplayRecorder* recorder);
+
+DllExport(ReplayReader*) pxOpenReplay(const char* path);
+DllExport(void) pxCloseReplay(ReplayReader* reader);
+DllExport(void) pxGetReplayInfo(ReplayReader* reader, physx::PxU64* frameCount, physx::PxU32* maxBodies);
+DllExport(void) pxDecodeReplayFrames(ReplayReader* reader, physx::PxU64 first, physx::PxU64 count, Euclidean3d* poses,
+    PxBodyHandle* ids, physx::PxU32 stride, physx::PxU32* counts, double* times);
@@ -0,0 +1,238 @@
+#include "SceneBatch.h"
+#include "Parallel.h"
+#include "CollisionLayers.h"
+#include <cstdlib>
+#include <cstring>
+#include <extensions/PxCollectionExt.h>
+#include <extensions/PxDefaultStreams.h>
+#include <extensions/PxSerialization.h>
+
+using namespace physx;
+
+static const PxU32 BodyGrain = 1024;
+
+static void* allocAligned(size_t size, void*& raw) {
+    raw = malloc(size + PX_SERIAL_FILE_ALIGN);
+    if(!raw) return NULL;
+    return (void*)(((size_t)raw + PX_SERIAL_FILE_ALIGN - 1) & ~(size_t)(PX_SERIAL_FILE_ALIGN - 1));
+}
+
+// copies simulate like the source scene, without a source like pxCreateScene made them
+static void describeCopy(const PxScene* source, PxSceneDesc& desc) {
+    if(source) {
+        // the copies run on the CPU only
+        desc.flags = source->getFlags();
+        desc.flags.clear(PxSceneFlag::eENABLE_GPU_DYNAMICS);
+        desc.filterShader = source->getFilterShader();
+        desc.filterShaderData = source->getFilterShaderData();
+        desc.filterShaderDataSize = source->getFilterShaderDataSize();
+        desc.filterCallback = source->getFilterCallback();
+    }
+    else {
+        desc.flags |= PxSceneFlag::eENABLE_ACTIVE_ACTORS;
+        desc.flags |= PxSceneFlag::eENABLE_CCD;
+        desc.filterShader = layerFilterShader;
+        desc.filterShaderData = defaultCollisionLayers().data();
+        desc.filterShaderDataSize = defaultCollisionLayers().size();
+    }
+}
+
+SceneBatch* SceneBatch::create(PxHandle* handle, const PxScene* source, const void* data, size_t size, PxU32 count, const PxVec3& gravity) {
+    auto physics = handle->Physics;
+    auto registry = PxSerialization::createSerializationRegistry(*physics);
+    auto batch = new SceneBatch();
+
+    for(PxU32 c = 0; c < count; c++) {
+        BatchCopy copy;
+        memset(&copy, 0, sizeof(BatchCopy));
+
+        // deserialized objects live inside the memory block, every copy needs its own
+        auto block = allocAligned(size, copy.Memory);
+        if(!block) break;
+        memcpy(block, data, size);
+        copy.Collection = PxSerialization::createCollectionFromBinary(block, *registry);
+        if(!copy.Collection) {
+            free(copy.Memory);
+            break;
+        }
+
+        PxSceneDesc desc(physics->getTolerancesScale());
+        describeCopy(source, desc);
+        desc.gravity = gravity;
+        desc.cpuDispatcher = sharedDispatcher();
+        copy.Scene = physics->createScene(desc);
+        if(!copy.Scene) {
+            PxCollectionExt::releaseObjects(*copy.Collection);
+            copy.Collection->release();
+            free(copy.Memory);
+            break;
+        }
+        copy.Scene->addCollection(*copy.Collection);
+        batch->Copies.push_back(copy);
+
+        PxU32 bodies = 0;
+        for(PxU32 i = 0; i < copy.Collection->getNbObjects(); i++) {
+            auto& object = copy.Collection->getObject(i);
+            if(auto body = object.is<PxRigidDynamic>()) {
+                batch->Bodies.push_back(body);
+                bodies++;
+            }
+        }
+        if(c == 0) batch->BodyCount = bodies;
+    }
+    registry->release();
+
+    if(batch->Copies.size() != count) {
+        delete batch;
+        return NULL;
+    }
+
+    auto n = batch->BodyCount;
+    batch->InitialPoses.resize(n);
+    batch->InitialLinear.resize(n);
+    batch->InitialAngular.resize(n);
+    for(PxU32 b = 0; b < n; b++) {
+        auto body = batch->Bodies[b];
+        batch->InitialPoses[b] = body->getGlobalPose();
+        batch->InitialLinear[b] = body->getLinearVelocity();
+        batch->InitialAngular[b] = body->getAngularVelocity();
+    }
+    return batch;
+}
+
+SceneBatch::~SceneBatch() {
+    for(auto& copy : Copies) {
+        copy.Scene->release();
+        PxCollectionExt::releaseObjects(*copy.Collection);
+        copy.Collection->release();
+        free(copy.Memory);
+    }
+}
+
+static PX_FORCE_INLINE bool isDynamic(PxRigidDynamic* body) {
+    return !(body->getRigidBodyFlags() & PxRigidBodyFlag::eKINEMATIC);
+}
+
+void SceneBatch::applyActions(const float* actions, PxU32 mode, PxCpuDispatcher* dispatcher) {
+    // writes to one scene must not run concurrently, so work is split by copy
+    parallelFor(dispatcher, (PxU32)Copies.size(), 1, [&](PxU32 begin, PxU32 end) {
+        for(auto i = (size_t)begin * BodyCount; i < (size_t)end * BodyCount; i++) {
+            auto body = Bodies[i];
+            if(!isDynamic(body)) continue;
+            auto a = actions + i * BatchActionSize;
+            PxVec3 linear(a[0], a[1], a[2]);
+            PxVec3 angular(a[3], a[4], a[5]);
+            switch(mode) {
+                case PxBatchActionForce:
+                    body->addForce(linear, PxForceMode::eFORCE);
+                    body->addTorque(angular, PxForceMode::eFORCE);
+                    break;
+                case PxBatchActionImpulse:
+                    body->addForce(linear, PxForceMode::eIMPULSE);
+                    body->addTorque(angular, PxForceMode::eIMPULSE);
+                    break;
+                case PxBatchActionVelocityChange:
+                    body->addForce(linear, PxForceMode::eVELOCITY_CHANGE);
+                    body->addTorque(angular, PxForceMode::eVELOCITY_CHANGE);
+                    break;
+                case PxBatchActionSetVelocity:
+                    body->setLinearVelocity(linear);
+                    body->setAngularVelocity(angular);
+                    break;
+                default:
+                    break;
+            }
+        }
+    });
+}
+
+void SceneBatch::observe(float* observations, PxCpuDispatcher* dispatcher) const {
+    parallelFor(dispatcher, (PxU32)Bodies.size(), BodyGrain, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 i = begin; i < end; i++) {
+            auto body = Bodies[i];
+            auto o = observations + (size_t)i * BatchObservationSize;
+            auto pose = body->getGlobalPose();
+            auto v = body->getLinearVelocity();
+            auto w = body->getAngularVelocity();
+            o[0] = pose.p.x; o[1] = pose.p.y; o[2] = pose.p.z;
+            o[3] = pose.q.x; o[4] = pose.q.y; o[5] = pose.q.z; o[6] = pose.q.w;
+            o[7] = v.x; o[8] = v.y; o[9] = v.z;
+            o[10] = w.x; o[11] = w.y; o[12] = w.z;
+        }
+    });
+}
+
+void SceneBatch::step(float dt, PxU32 substeps, const float* actions, PxU32 mode, float* observations, PxCpuDispatcher* dispatcher) {
+    if(actions) applyActions(actions, mode, dispatcher);
+
+    substeps = PxMax(substeps, 1u);
+    auto h = dt / (float)substeps;
+    for(PxU32 s = 0; s < substeps; s++) {
+        // simulate only kicks off the tasks, so all copies run on the shared pool at once
+        for(auto& copy : Copies) copy.Scene->simulate(h);
+        for(auto& copy : Copies) copy.Scene->fetchResults(true);
+    }
+
+    if(observations) observe(observations, dispatcher);
+}
+
+void SceneBatch::reset(const PxU32* copies, PxU32 count, PxCpuDispatcher* dispatcher) {
+    parallelFor(dispatcher, count, 1, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 k = begin; k < end; k++) {
+            auto c = copies[k];
+            if(c >= Copies.size()) continue;
+            for(PxU32 b = 0; b < BodyCount; b++) {
+                auto body = Bodies[(size_t)c * BodyCount + b];
+                body->setGlobalPose(InitialPoses[b]);
+                if(!isDynamic(body)) continue;
+                body->setLinearVelocity(InitialLinear[b]);
+                body->setAngularVelocity(InitialAngular[b]);
+                body->clearForce();
+                body->clearTorque();
+            }
+        }
+    });
+}
+
+
+DllExport(PxU64) pxSerializeScene(PxSceneHandle* scene, PxU8* data, PxU64 capacity) {
+    auto physics = scene->Physics;
+    auto registry = PxSerialization::createSerializationRegistry(*physics);
+    auto collection = PxCollectionExt::createCollection(*scene->Scene);
+    // shapes, materials and meshes the actors need
+    PxSerialization::complete(*collection, *registry);
+
+    PxDefaultMemoryOutputStream stream;
+    auto ok = PxSerialization::serializeCollectionToBinary(stream, *collection, *registry);
+    collection->release();
+    registry->release();
+    if(!ok) return 0;
+
+    if(data && capacity >= stream.getSize()) memcpy(data, stream.getData(), stream.getSize());
+    return stream.getSize();
+}
+
+DllExport(SceneBatch*) pxCreateSceneBatch(PxHandle* handle, PxSceneHandle* source, const PxU8* data, PxU64 size, PxU32 count, V3d gravity) {
+    return SceneBatch::create(handle, source ? source->Scene : NULL, data, (size_t)size, count, toPxVec3(gravity));
+}
+
+DllExport(void) pxDestroySceneBatch(SceneBatch* batch) {
+    delete batch;
+}
+
+DllExport(void) pxGetSceneBatchInfo(SceneBatch* batch, PxU32* copies, PxU32* bodies) {
+    if(copies) *copies = (PxU32)batch->Copies.size();
+    if(bodies) *bodies = batch->BodyCount;
+}
+
+DllExport(void) pxStepSceneBatch(SceneBatch* batch, float dt, PxU32 substeps, const float* actions, PxU32 mode, float* observations) {
+    batch->step(dt, substeps, actions, mode, observations, sharedDispatcher());
+}
+
+DllExport(void) pxObserveSceneBatch(SceneBatch* batch, float* observations) {
+    batch->observe(observations, sharedDispatcher());
+}
+
+DllExport(void) pxResetSceneBatch(SceneBatch* batch, const PxU32* copies, PxU32 count) {
+    batch->reset(copies, count, sharedDispatcher());
+}
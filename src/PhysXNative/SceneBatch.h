@@ -0,0 +1,65 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include <vector>
+
+// floats per body in observation tensors: position, rotation (xyzw), linear and angular velocity
+static const physx::PxU32 BatchObservationSize = 13;
+// floats per body in action tensors: two vectors whose meaning depends on the action mode
+static const physx::PxU32 BatchActionSize = 6;
+
+enum PxBatchActionMode {
+    PxBatchActionForce = 0,             // force and torque for the step
+    PxBatchActionImpulse = 1,           // linear and angular impulse
+    PxBatchActionVelocityChange = 2,    // added linear and angular velocity
+    PxBatchActionSetVelocity = 3        // linear and angular velocity replace the current ones
+};
+
+struct BatchCopy {
+    physx::PxScene* Scene;
+    physx::PxCollection* Collection;
+    void* Memory;   // backing store of the deserialized collection, freed after it
+};
+
+// Many independent copies of one template scene, deserialized from a binary
+// collection into one PxScene each. All scenes run their tasks on the shared
+// dispatcher and are stepped together. Bodies are the rigid dynamics of the
+// template in collection order, so body b of every copy is the same object.
+class SceneBatch {
+public:
+    ~SceneBatch();
+
+    // returns NULL if the data is not a valid binary collection or a scene cannot be created.
+    // Copies take the flags and filter shader (with its data) of source, NULL uses the pxCreateScene defaults.
+    static SceneBatch* create(PxHandle* handle, const physx::PxScene* source, const void* data, size_t size, physx::PxU32 count, const physx::PxVec3& gravity);
+
+    std::vector<BatchCopy> Copies;
+    physx::PxU32 BodyCount;
+    std::vector<physx::PxRigidDynamic*> Bodies;     // copy major
+
+    // actions and observations are [copies x bodies x size] tensors, NULL skips them
+    void step(float dt, physx::PxU32 substeps, const float* actions, physx::PxU32 mode, float* observations, physx::PxCpuDispatcher* dispatcher);
+    void applyActions(const float* actions, physx::PxU32 mode, physx::PxCpuDispatcher* dispatcher);
+    void observe(float* observations, physx::PxCpuDispatcher* dispatcher) const;
+    // puts the bodies of the given copies back into the template state
+    void reset(const physx::PxU32* copies, physx::PxU32 count, physx::PxCpuDispatcher* dispatcher);
+
+private:
+    SceneBatch() : BodyCount(0) {}
+
+    // template state of every body
+    std::vector<physx::PxTransform> InitialPoses;
+    std::vector<physx::PxVec3> InitialLinear;
+    std::vector<physx::PxVec3> InitialAngular;
+};
+
+// writes a binary collection of all actors in the scene, returns its size;
+// data may be NULL to query the size
+DllExport(physx::PxU64) pxSerializeScene(PxSceneHandle* scene, physx::PxU8* data, physx::PxU64 capacity);
+// source is the scene the template was serialized from, or NULL
+DllExport(SceneBatch*) pxCreateSceneBatch(PxHandle* handle, PxSceneHandle* source, const physx::PxU8* data, physx::PxU64 size, physx::PxU32 count, V3d gravity);
+DllExport(void) pxDestroySceneBatch(SceneBatch* batch);
+DllExport(void) pxGetSceneBatchInfo(SceneBatch* batch, physx::PxU32* copies, physx::PxU32* bodies);
+DllExport(void) pxStepSceneBatch(SceneBatch* batch, float dt, physx::PxU32 substeps, const float* actions, physx::PxU32 mode, float* observations);
+DllExport(void) pxObserveSceneBatch(SceneBatch* batch, float* observations);
+DllExport(void) pxResetSceneBatch(SceneBatch* batch, const physx::PxU32* copies, physx::PxU32 count);
@@ -0,0 +1,46 @@
+#include "SceneEvents.h"
+
+using namespace physx;
+
+void SceneEvents::clear() {
+    BrokenJoints.clear();
+    Contacts.clear();
+    Step++;
+}
+
+void SceneEvents::onConstraintBreak(PxConstraintInfo* constraints, PxU32 count) {
+    for(PxU32 i = 0; i < count; i++) {
+        auto& c = constraints[i];
+        if(c.type == PxConstraintExtIDs::eJOINT) BrokenJoints.push_back(static_cast<PxJoint*>(c.externalReference));
+    }
+}
+
+void SceneEvents::onContact(const PxContactPairHeader& header, const PxContactPair* pairs, PxU32 count) {
+    if(header.flags & (PxContactPairHeaderFlag::eREMOVED_ACTOR_0 | PxContactPairHeaderFlag::eREMOVED_ACTOR_1)) return;
+    for(PxU32 i = 0; i < count; i++) {
+        auto& pair = pairs[i];
+        if(pair.contactCount == 0 || (pair.flags & (PxContactPairFlag::eREMOVED_SHAPE_0 | PxContactPairFlag::eREMOVED_SHAPE_1))) continue;
+
+        Points.resize(pair.contactCount);
+        auto n = pair.extractContacts(Points.data(), pair.contactCount);
+        if(n == 0) continue;
+        PxVec3 point(0.0f);
+        float impulse = 0.0f;
+        for(PxU32 c = 0; c < n; c++) {
+            point += Points[c].position;
+            impulse += Points[c].impulse.magnitude();
+        }
+        point *= 1.0f / (float)n;
+
+        Contacts.push_back({ pair.shapes[0], header.actors[0], point, impulse });
+        Contacts.push_back({ pair.shapes[1], header.actors[1], point, impulse });
+    }
+}
+
+SceneEvents* sceneEventsOf(PxSceneHandle* scene) {
+    if(!scene->Events) {
+        scene->Events = new SceneEvents();
+        scene->Scene->setSimulationEventCallback(scene->Events);
+    }
+    return scene->Events;
+}
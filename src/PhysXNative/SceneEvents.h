@@ -0,0 +1,41 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include <vector>
+
+// One shape of a reported contact pair, impulses summed over the pair's contact points.
+struct SceneContact {
+    physx::PxShape* Shape;
+    physx::PxActor* Actor;
+    physx::PxVec3 Point;        // mean contact point
+    float Impulse;
+};
+
+// Simulation events of one scene, installed as its PxSimulationEventCallback by
+// the first subsystem that needs them. Events arrive during fetchResults and
+// are kept until the next step begins, so every subsystem can read the events
+// of the last step in bulk instead of registering its own callback.
+class SceneEvents : public physx::PxSimulationEventCallback {
+public:
+    // joints whose break force or torque was exceeded in the last step
+    std::vector<physx::PxJoint*> BrokenJoints;
+    // both shapes of every pair whose layers notify, see CollisionLayers::setNotify
+    std::vector<SceneContact> Contacts;
+    // counts clear calls, readers that must consume the events of a step once compare it
+    physx::PxU32 Step = 0;
+
+    // before simulate
+    void clear();
+
+    void onConstraintBreak(physx::PxConstraintInfo* constraints, physx::PxU32 count) override;
+    void onWake(physx::PxActor**, physx::PxU32) override {}
+    void onSleep(physx::PxActor**, physx::PxU32) override {}
+    void onContact(const physx::PxContactPairHeader& header, const physx::PxContactPair* pairs, physx::PxU32 count) override;
+    void onTrigger(physx::PxTriggerPair*, physx::PxU32) override {}
+    void onAdvance(const physx::PxRigidBody* const*, const physx::PxTransform*, const physx::PxU32) override {}
+
+private:
+    std::vector<physx::PxContactPairPoint> Points;
+};
+
+SceneEvents* sceneEventsOf(PxSceneHandle* scene);
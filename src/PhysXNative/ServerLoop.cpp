@@ -0,0 +1,239 @@
+#include "ServerLoop.h"
+#include "PoseStream.h"
+#include "Replay.h"
+#include "Parallel.h"
+#include <chrono>
+#include <cstring>
+
+#ifndef _WIN32
+#include <cerrno>
+#include <time.h>
+#endif
+
+using namespace physx;
+
+static PxU64 monotonicNanos() {
+#ifdef _WIN32
+    return (PxU64)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#else
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (PxU64)ts.tv_sec * 1000000000ull + (PxU64)ts.tv_nsec;
+#endif
+}
+
+static void sleepUntil(PxU64 deadline) {
+#ifdef _WIN32
+    std::this_thread::sleep_until(std::chrono::steady_clock::time_point(std::chrono::nanoseconds(deadline)));
+#else
+    // absolute deadlines do not drift with the time spent in the tick
+    timespec ts;
+    ts.tv_sec = (time_t)(deadline / 1000000000ull);
+    ts.tv_nsec = (long)(deadline % 1000000000ull);
+    while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {}
+#endif
+}
+
+ServerLoop::ServerLoop(PxSceneHandle* scene, BodyTable* table, const PxServerDesc& desc)
+    : Scene(scene), Table(table), Desc(desc), Stream(NULL), Recorder(NULL), Running(false), CurrentTick(0), SnapshotTick(0), LatenessSum(0.0) {
+    if(Desc.TickRate <= 0.0) Desc.TickRate = 60.0;
+    memset(&Stats, 0, sizeof(PxServerStats));
+}
+
+ServerLoop::~ServerLoop() {
+    stop();
+}
+
+void ServerLoop::start() {
+    if(Running.exchange(true)) return;
+    Thread = std::thread([this]() { run(); });
+}
+
+void ServerLoop::stop() {
+    if(!Running.exchange(false)) return;
+    Thread.join();
+}
+
+void ServerLoop::enqueue(const PxServerCommand* commands, PxU32 count) {
+    std::lock_guard<std::mutex> lock(QueueMutex);
+    Queue.insert(Queue.end(), commands, commands + count);
+}
+
+void ServerLoop::run() {
+    auto period = (PxU64)(1e9 / Desc.TickRate);
+    auto next = monotonicNanos() + period;
+    while(Running.load()) {
+        sleepUntil(next);
+        auto woke = monotonicNanos();
+        auto late = woke > next ? woke - next : 0;
+
+        // after a stall the missed ticks are stepped back to back up to
+        // MaxCatchUpTicks, beyond that they are dropped and the schedule restarts
+        PxU64 dropped = 0;
+        if(late > (PxU64)Desc.MaxCatchUpTicks * period) {
+            dropped = late / period;
+            next += dropped * period;
+        }
+
+        tick();
+        auto done = monotonicNanos();
+        next += period;
+
+        auto stepMs = (done - woke) * 1e-6;
+        auto lateMs = late * 1e-6;
+        std::lock_guard<std::mutex> lock(StatsMutex);
+        Stats.Tick = CurrentTick;
+        if(done - woke > period) Stats.Overruns++;
+        Stats.DroppedTicks += dropped;
+        Stats.LastStepMs = stepMs;
+        Stats.MaxStepMs = PxMax(Stats.MaxStepMs, stepMs);
+        LatenessSum += lateMs;
+        Stats.MeanLatenessMs = LatenessSum / (double)CurrentTick;
+        Stats.MaxLatenessMs = PxMax(Stats.MaxLatenessMs, lateMs);
+    }
+}
+
+void ServerLoop::apply(const PxServerCommand& c) {
+    auto dense = Table->denseIndex(c.Body);
+    if(dense == PxInvalidBodyIndex) {
+        Stats.CommandsRejected++;
+        return;
+    }
+
+    auto actor = Table->Actors[dense];
+    auto body = actor->is<PxRigidDynamic>();
+    auto kinematic = body && (body->getRigidBodyFlags() & PxRigidBodyFlag::eKINEMATIC);
+    auto dynamic = body && !kinematic;
+    auto v = toPxVec3(c.Value);
+    switch(c.Type) {
+        case PxServerSetPose:
+            actor->setGlobalPose(toPxTransform(c.Pose));
+            Table->Poses[dense] = actor->getGlobalPose();
+            break;
+        case PxServerSetKinematicTarget:
+            if(kinematic) body->setKinematicTarget(toPxTransform(c.Pose));
+            break;
+        case PxServerSetLinearVelocity:
+            if(dynamic) body->setLinearVelocity(v);
+            break;
+        case PxServerSetAngularVelocity:
+            if(dynamic) body->setAngularVelocity(v);
+            break;
+        case PxServerAddForce:
+            if(dynamic) body->addForce(v, PxForceMode::eFORCE);
+            break;
+        case PxServerAddImpulse:
+            if(dynamic) body->addForce(v, PxForceMode::eIMPULSE);
+            break;
+        case PxServerAddTorque:
+            if(dynamic) body->addTorque(v, PxForceMode::eFORCE);
+            break;
+        case PxServerWakeUp:
+            if(dynamic) body->wakeUp();
+            break;
+        default:
+            Stats.CommandsRejected++;
+            return;
+    }
+    Stats.CommandsApplied++;
+}
+
+void ServerLoop::tick() {
+    {
+        std::lock_guard<std::mutex> lock(QueueMutex);
+        Due.swap(Queue);
+        Queue.clear();
+    }
+
+    std::lock_guard<std::mutex> lock(TickMutex);
+    auto t = ++CurrentTick;
+    auto dt = 1.0 / Desc.TickRate;
+
+    // commands for later ticks wait in Deferred, in the order they arrived
+    Due.insert(Due.begin(), Deferred.begin(), Deferred.end());
+    Deferred.clear();
+    {
+        std::lock_guard<std::mutex> statsLock(StatsMutex);
+        for(auto& c : Due) {
+            if(c.Tick > t) Deferred.push_back(c);
+            else apply(c);
+        }
+    }
+    Due.clear();
+
+    stepScene(Scene, (float)dt);
+    Table->sync(Scene->Scene);
+
+    auto time = (double)t * dt;
+    if(Stream) Stream->publish(*Table, time, sharedDispatcher());
+    if(Recorder) Recorder->record(*Table, time);
+
+    std::lock_guard<std::mutex> snapshotLock(SnapshotMutex);
+    SnapshotTick = t;
+    SnapshotPoses.assign(Table->Poses.begin(), Table->Poses.end());
+    SnapshotIds.resize(Table->size());
+    for(PxU32 i = 0; i < Table->size(); i++) SnapshotIds[i] = Table->handleOf(i);
+}
+
+PxServerStats ServerLoop::stats() {
+    std::lock_guard<std::mutex> lock(StatsMutex);
+    return Stats;
+}
+
+PxU32 ServerLoop::snapshot(PxU64& tick, Euclidean3d* poses, PxBodyHandle* ids, PxU32 maxBodies) {
+    std::lock_guard<std::mutex> lock(SnapshotMutex);
+    tick = SnapshotTick;
+    auto n = PxMin(maxBodies, (PxU32)SnapshotPoses.size());
+    for(PxU32 i = 0; i < n; i++) {
+        if(poses) poses[i] = toEuclidean3d(SnapshotPoses[i]);
+        if(ids) ids[i] = SnapshotIds[i];
+    }
+    return (PxU32)SnapshotPoses.size();
+}
+
+
+DllExport(ServerLoop*) pxCreateServer(PxSceneHandle* scene, BodyTable* table, const PxServerDesc* desc) {
+    return new ServerLoop(scene, table, *desc);
+}
+
+DllExport(void) pxDestroyServer(ServerLoop* server) {
+    delete server;
+}
+
+DllExport(void) pxSetServerOutputs(ServerLoop* server, PoseStream* stream, ReplayRecorder* recorder) {
+    server->lock();
+    server->Stream = stream;
+    server->Recorder = recorder;
+    server->unlock();
+}
+
+DllExport(void) pxStartServer(ServerLoop* server) {
+    server->start();
+}
+
+DllExport(void) pxStopServer(ServerLoop* server) {
+    server->stop();
+}
+
+DllExport(void) pxEnqueueServerCommands(ServerLoop* server, PxU32 count, const PxServerCommand* commands) {
+    server->enqueue(commands, count);
+}
+
+DllExport(void) pxLockServer(ServerLoop* server) {
+    server->lock();
+}
+
+DllExport(void) pxUnlockServer(ServerLoop* server) {
+    server->unlock();
+}
+
+DllExport(void) pxGetServerStats(ServerLoop* server, PxServerStats* stats) {
+    *stats = server->stats();
+}
+
+DllExport(PxU32) pxGetServerSnapshot(ServerLoop* server, PxU64* tick, Euclidean3d* poses, PxBodyHandle* ids, PxU32 maxBodies) {
+    PxU64 t;
+    auto n = server->snapshot(t, poses, ids, maxBodies);
+    if(tick) *tick = t;
+    return n;
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include "BodyTable.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class PoseStream;
+class ReplayRecorder;
+
+enum PxServerCommandType {
+    PxServerSetPose = 0,
+    PxServerSetKinematicTarget = 1,
+    PxServerSetLinearVelocity = 2,
+    PxServerSetAngularVelocity = 3,
+    PxServerAddForce = 4,       // Value in N, applied for the tick
+    PxServerAddImpulse = 5,     // Value in Ns
+    PxServerAddTorque = 6,
+    PxServerWakeUp = 7
+};
+
+typedef struct {
+    physx::PxU32 Type;
+    physx::PxU32 Reserved;
+    physx::PxU64 Tick;          // applied before this tick is stepped, 0 or a past tick means the next one
+    PxBodyHandle Body;
+    V3d Value;
+    Euclidean3d Pose;
+} PxServerCommand;
+
+typedef struct {
+    double TickRate;                // ticks per second
+    physx::PxU32 MaxCatchUpTicks;   // ticks stepped back to back after a stall before the schedule is reset
+    physx::PxU32 Reserved;
+} PxServerDesc;
+
+typedef struct {
+    physx::PxU64 Tick;              // ticks stepped so far
+    physx::PxU64 Overruns;          // ticks whose work took longer than the period
+    physx::PxU64 DroppedTicks;      // ticks skipped when the loop fell too far behind
+    physx::PxU64 CommandsApplied;
+    physx::PxU64 CommandsRejected;  // stale body handles
+    double LastStepMs;
+    double MaxStepMs;
+    double MeanLatenessMs;          // wake-up lateness against the schedule
+    double MaxLatenessMs;
+} PxServerStats;
+
+// Runs the step loop on its own thread at a fixed tick rate. Every tick applies
+// the queued commands that are due, steps the scene by exactly 1 / TickRate,
+// syncs the body table and publishes the poses to the attached stream and
+// recorder and into a snapshot hosts can copy. The scene and the body table
+// belong to the loop while it runs, hosts use commands or lock() for anything
+// else, e.g. adding bodies.
+class ServerLoop {
+public:
+    ServerLoop(PxSceneHandle* scene, BodyTable* table, const PxServerDesc& desc);
+    ~ServerLoop();
+
+    PxSceneHandle* Scene;
+    BodyTable* Table;
+    PxServerDesc Desc;
+    PoseStream* Stream;
+    ReplayRecorder* Recorder;
+
+    void start();
+    void stop();
+    void enqueue(const PxServerCommand* commands, physx::PxU32 count);
+
+    // holds off the next tick until unlock
+    void lock() { TickMutex.lock(); }
+    void unlock() { TickMutex.unlock(); }
+
+    PxServerStats stats();
+    // copies the latest snapshot, returns its body count
+    physx::PxU32 snapshot(physx::PxU64& tick, Euclidean3d* poses, PxBodyHandle* ids, physx::PxU32 maxBodies);
+
+private:
+    void run();
+    void tick();
+    void apply(const PxServerCommand& command);
+
+    std::thread Thread;
+    std::atomic<bool> Running;
+    physx::PxU64 CurrentTick;   // loop thread only
+    std::mutex TickMutex;
+
+    std::mutex QueueMutex;
+    std::vector<PxServerCommand> Queue;
+    std::vector<PxServerCommand> Due;
+    std::vector<PxServerCommand> Deferred;
+
+    std::mutex SnapshotMutex;
+    physx::PxU64 SnapshotTick;
+    std::vector<physx::PxTransform> SnapshotPoses;
+    std::vector<PxBodyHandle> SnapshotIds;
+
+    std::mutex StatsMutex;
+    PxServerStats Stats;
+    double LatenessSum;
+};
+
+DllExport(ServerLoop*) pxCreateServer(PxSceneHandle* scene, BodyTable* table, const PxServerDesc* desc);
+DllExport(void) pxDestroyServer(ServerLoop* server);
+DllExport(void) pxSetServerOutputs(ServerLoop* server, PoseStream* stream, ReplayRecorder* recorder);
+DllExport(void) pxStartServer(ServerLoop* server);
+DllExport(void) pxStopServer(ServerLoop* server);
+DllExport(void) pxEnqueueServerCommands(ServerLoop* server, physx::PxU32 count, const PxServerCommand* commands);
+DllExport(void) pxLockServer(ServerLoop* server);
+DllExport(void) pxUnlockServer(ServerLoop* server);
+DllExport(void) pxGetServerStats(ServerLoop* server, PxServerStats* stats);
+DllExport(physx::PxU32) pxGetServerSnapshot(ServerLoop* server, physx::PxU64* tick, Euclidean3d* poses, PxBodyHandle* ids, physx::PxU32 maxBodies);
@@ -0,0 +1,385 @@
+#include "SnapshotCodec.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace physx;
+
+static const PxU32 CaptureGrain = 2048;
+static const PxU32 HeaderBits = 32 + 5 + 16;
+static const PxU32 MaxEntries = 0xFFFF;
+static const PxU32 MaxBaselineAge = 255;
+
+static PxBounds3 boundsOf(const PxSnapshotDesc& desc) {
+    return PxBounds3(toPxVec3(desc.BoundsMin), toPxVec3(desc.BoundsMax));
+}
+
+static PxSnapshotDesc sanitize(PxSnapshotDesc desc) {
+    desc.PositionBits = PxClamp(desc.PositionBits, 4u, 24u);
+    desc.RotationBits = PxClamp(desc.RotationBits, 4u, 16u);
+    desc.DeltaBits = PxClamp(desc.DeltaBits, 2u, desc.PositionBits);
+    if(desc.MaxBodies == 0) desc.MaxBodies = 1u << 20;
+    return desc;
+}
+
+SnapshotEncoder::SnapshotEncoder(const PxSnapshotDesc& desc)
+    : Desc(sanitize(desc)), Seq(0), Quantizer(boundsOf(Desc), Desc.PositionBits) {}
+
+PxU32 SnapshotEncoder::addClient() {
+    for(PxU32 i = 0; i < Clients.size(); i++) {
+        if(!Clients[i]) {
+            Clients[i].reset(new SnapshotClient());
+            return i;
+        }
+    }
+    Clients.emplace_back(new SnapshotClient());
+    return (PxU32)Clients.size() - 1;
+}
+
+void SnapshotEncoder::removeClient(PxU32 client) {
+    if(client < Clients.size()) Clients[client].reset();
+}
+
+PxU32 SnapshotEncoder::capture(const BodyTable& table, PxCpuDispatcher* dispatcher) {
+    auto nbSlots = (PxU32)table.Generations.size();
+    Generations.assign(table.Generations.begin(), table.Generations.end());
+    Alive.assign(nbSlots, 0);
+    Current.resize((size_t)nbSlots * SnapshotQuantized);
+
+    parallelFor(dispatcher, table.size(), CaptureGrain, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 i = begin; i < end; i++) {
+            auto slot = table.DenseToSlot[i];
+            auto q = &Current[(size_t)slot * SnapshotQuantized];
+            auto& pose = table.Poses[i];
+            Quantizer.quantize(pose.p, q);
+            q[3] = quantizeQuat(pose.q, Desc.RotationBits, q + 4);
+            Alive[slot] = 1;
+        }
+    });
+    return ++Seq;
+}
+
+PxU32 SnapshotEncoder::encode(PxU32 client, PxU8* buffer, PxU32 budget) {
+    if(client >= Clients.size() || !Clients[client] || budget * 8 < HeaderBits) return 0;
+    auto& c = *Clients[client];
+    // one packet per capture and client, a second one would replace the first
+    // in Sent while the client may still ack it
+    auto& packet = c.Sent[Seq % SnapshotHistory];
+    if(Seq == 0 || packet.Seq == Seq) return 0;
+
+    auto nbSlots = PxMax((PxU32)Generations.size(), (PxU32)c.Known.size());
+    SnapshotClientBody none;
+    memset(&none, 0, sizeof(SnapshotClientBody));
+    c.Known.resize(nbSlots, none);
+    c.Priority.resize(nbSlots, 0.0f);
+    auto indexBits = PxMax(1u, bitWidth(nbSlots > 0 ? nbSlots - 1 : 0));
+    auto rotationBits = 2 + 3 * Desc.RotationBits;
+    auto deltaLimit = (PxI32)(1u << (Desc.DeltaBits - 1));
+
+    // accumulate priorities of everything the client does not have yet
+    Candidates.clear();
+    for(PxU32 slot = 0; slot < nbSlots; slot++) {
+        auto& k = c.Known[slot];
+        auto alive = slot < Alive.size() && Alive[slot];
+        float weight;
+        if(alive) {
+            auto q = &Current[(size_t)slot * SnapshotQuantized];
+            auto sameBody = k.Present && k.Generation == Generations[slot];
+            if(sameBody && memcmp(k.Q, q, sizeof(k.Q)) == 0) {
+                c.Priority[slot] = 0.0f;
+                continue;
+            }
+            weight = 1.0f;
+            if(sameBody) {
+                // bodies that moved further catch up faster
+                PxI32 error = 0;
+                for(PxU32 a = 0; a < 3; a++) error = PxMax(error, PxAbs((PxI32)(q[a] - k.Q[a])));
+                weight += PxMin((float)error / (float)deltaLimit, 4.0f);
+            }
+            else weight += 4.0f;
+        }
+        else if(k.Present) weight = 8.0f;
+        else {
+            c.Priority[slot] = 0.0f;
+            continue;
+        }
+        c.Priority[slot] += weight;
+        Candidates.push_back({ c.Priority[slot], slot });
+    }
+    std::sort(Candidates.begin(), Candidates.end(), [](const Candidate& a, const Candidate& b) {
+        return a.Priority > b.Priority || (a.Priority == b.Priority && a.Slot < b.Slot);
+    });
+
+    packet.Seq = Seq;
+    packet.Acked = false;
+    packet.Entries.clear();
+
+    // take candidates in priority order while they fit into the budget
+    auto budgetBits = (size_t)budget * 8;
+    size_t used = HeaderBits;
+    for(auto& cand : Candidates) {
+        if(packet.Entries.size() >= MaxEntries) break;
+        auto slot = cand.Slot;
+        auto& k = c.Known[slot];
+        SnapshotEntry e;
+        memset(&e, 0, sizeof(SnapshotEntry));
+        e.Slot = slot;
+        size_t bits = indexBits + 1;
+        if(slot >= Alive.size() || !Alive[slot]) {
+            e.Removed = 1;
+            e.Generation = k.Generation;
+        }
+        else {
+            e.Generation = Generations[slot];
+            memcpy(e.Q, &Current[(size_t)slot * SnapshotQuantized], sizeof(e.Q));
+            bits += 1 + rotationBits;
+            auto age = Seq - k.Seq;
+            if(k.Present && k.Generation == e.Generation && k.Seq > 0 && age <= MaxBaselineAge) {
+                auto small = true;
+                for(PxU32 a = 0; a < 3; a++) {
+                    auto d = (PxI32)(e.Q[a] - k.Q[a]);
+                    if(d >= deltaLimit || d < -deltaLimit) small = false;
+                }
+                bits += 8 + 1 + 3 * (small ? Desc.DeltaBits : Desc.PositionBits);
+            }
+            else bits += 32 + 3 * Desc.PositionBits;
+        }
+        if(used + bits > budgetBits) continue;
+        used += bits;
+        packet.Entries.push_back(e);
+        c.Priority[slot] = 0.0f;
+    }
+    std::sort(packet.Entries.begin(), packet.Entries.end(), [](const SnapshotEntry& a, const SnapshotEntry& b) { return a.Slot < b.Slot; });
+
+    Bytes.clear();
+    BitWriter w(Bytes);
+    w.write(Seq, 32);
+    w.write(indexBits, 5);
+    w.write((PxU32)packet.Entries.size(), 16);
+    for(auto& e : packet.Entries) {
+        w.write(e.Slot, indexBits);
+        w.write(e.Removed, 1);
+        if(e.Removed) continue;
+
+        auto& k = c.Known[e.Slot];
+        auto age = Seq - k.Seq;
+        auto hasBaseline = k.Present && k.Generation == e.Generation && k.Seq > 0 && age <= MaxBaselineAge;
+        w.write(hasBaseline ? 1 : 0, 1);
+        if(hasBaseline) {
+            auto small = true;
+            for(PxU32 a = 0; a < 3; a++) {
+                auto d = (PxI32)(e.Q[a] - k.Q[a]);
+                if(d >= deltaLimit || d < -deltaLimit) small = false;
+            }
+            w.write(age, 8);
+            w.write(small ? 1 : 0, 1);
+            for(PxU32 a = 0; a < 3; a++) {
+                if(small) w.write(zigZag((PxI32)(e.Q[a] - k.Q[a])), Desc.DeltaBits);
+                else w.write(e.Q[a], Desc.PositionBits);
+            }
+        }
+        else {
+            w.write(e.Generation, 32);
+            for(PxU32 a = 0; a < 3; a++) w.write(e.Q[a], Desc.PositionBits);
+        }
+        w.write(e.Q[3], 2);
+        for(PxU32 a = 0; a < 3; a++) w.write(e.Q[4 + a], Desc.RotationBits);
+    }
+    w.flush();
+
+    memcpy(buffer, Bytes.data(), Bytes.size());
+    return (PxU32)Bytes.size();
+}
+
+void SnapshotEncoder::ack(PxU32 client, PxU32 seq, const PxU32* skipped, PxU32 skippedCount) {
+    if(client >= Clients.size() || !Clients[client]) return;
+    auto& c = *Clients[client];
+    auto& packet = c.Sent[seq % SnapshotHistory];
+    if(packet.Seq != seq || packet.Acked) return;
+    packet.Acked = true;
+
+    // acks may arrive out of order, a body keeps the newest acknowledged state
+    PxU32 s = 0;
+    for(auto& e : packet.Entries) {
+        if(e.Slot >= c.Known.size()) continue;
+        auto& k = c.Known[e.Slot];
+        if(k.Seq >= seq) continue;
+        k.Seq = seq;
+        while(s < skippedCount && skipped[s] < e.Slot) s++;
+        if(s < skippedCount && skipped[s] == e.Slot) {
+            // the client lacked the baseline and kept its old state, generation 0
+            // is never issued so the body goes out in full next time
+            k.Generation = 0;
+            continue;
+        }
+        k.Generation = e.Generation;
+        k.Present = !e.Removed;
+        memcpy(k.Q, e.Q, sizeof(k.Q));
+    }
+}
+
+
+SnapshotDecoder::SnapshotDecoder(const PxSnapshotDesc& desc)
+    : Desc(sanitize(desc)), MissingBaselines(0), Quantizer(boundsOf(Desc), Desc.PositionBits) {
+    for(auto& p : History) {
+        p.Seq = 0;
+        p.Acked = false;
+    }
+}
+
+PxTransform SnapshotDecoder::pose(const PxU32* q) const {
+    return PxTransform(Quantizer.dequantize(q), dequantizeQuat(q[3], q + 4, Desc.RotationBits));
+}
+
+bool SnapshotDecoder::decode(const PxU8* data, PxU32 size, PxU32& seq) {
+    Updates.clear();
+    Skipped.clear();
+    MissingBaselines = 0;
+    BitReader r(data, size);
+    seq = r.read(32);
+    auto indexBits = r.read(5);
+    auto count = r.read(16);
+    if(r.overrun() || seq == 0) return false;
+    // slots size Bodies, a packet must not make us allocate for more than MaxBodies
+    if(indexBits > PxMax(1u, bitWidth(Desc.MaxBodies - 1))) return false;
+
+    auto& packet = History[seq % SnapshotHistory];
+    packet.Seq = seq;
+    packet.Entries.clear();
+
+    for(PxU32 i = 0; i < count; i++) {
+        SnapshotEntry e;
+        memset(&e, 0, sizeof(SnapshotEntry));
+        e.Slot = r.read(indexBits);
+        e.Removed = r.read(1);
+        if(e.Slot >= Desc.MaxBodies) return false;
+        if(e.Slot >= Bodies.size()) {
+            SnapshotClientBody none;
+            memset(&none, 0, sizeof(SnapshotClientBody));
+            Bodies.resize(e.Slot + 1, none);
+        }
+        auto& b = Bodies[e.Slot];
+
+        auto valid = true;
+        if(e.Removed) {
+            e.Generation = b.Generation;
+        }
+        else if(r.read(1)) {
+            auto age = r.read(8);
+            auto small = r.read(1);
+            PxU32 d[3];
+            for(PxU32 a = 0; a < 3; a++) d[a] = r.read(small ? Desc.DeltaBits : Desc.PositionBits);
+
+            // the baseline is the entry of this body in an earlier packet
+            const SnapshotEntry* base = NULL;
+            auto& bp = History[(seq - age) % SnapshotHistory];
+            if(bp.Seq == seq - age) {
+                auto it = std::lower_bound(bp.Entries.begin(), bp.Entries.end(), e.Slot,
+                    [](const SnapshotEntry& x, PxU32 slot) { return x.Slot < slot; });
+                if(it != bp.Entries.end() && it->Slot == e.Slot && !it->Removed) base = &*it;
+            }
+            if(base) {
+                e.Generation = base->Generation;
+                for(PxU32 a = 0; a < 3; a++) e.Q[a] = small ? base->Q[a] + (PxU32)unZigZag(d[a]) : d[a];
+            }
+            else {
+                MissingBaselines++;
+                Skipped.push_back(e.Slot);
+                valid = false;
+            }
+        }
+        else {
+            e.Generation = r.read(32);
+            for(PxU32 a = 0; a < 3; a++) e.Q[a] = r.read(Desc.PositionBits);
+        }
+        if(!e.Removed) {
+            e.Q[3] = r.read(2);
+            for(PxU32 a = 0; a < 3; a++) e.Q[4 + a] = r.read(Desc.RotationBits);
+        }
+        if(r.overrun()) return false;
+        if(!valid) continue;
+
+        packet.Entries.push_back(e);
+        // packets may arrive out of order, only newer state is applied
+        if(b.Seq >= seq) continue;
+        b.Seq = seq;
+        b.Generation = e.Generation;
+        b.Present = !e.Removed;
+        memcpy(b.Q, e.Q, sizeof(b.Q));
+        Updates.push_back(e);
+    }
+    return true;
+}
+
+
+DllExport(SnapshotEncoder*) pxCreateSnapshotEncoder(const PxSnapshotDesc* desc) {
+    return new SnapshotEncoder(*desc);
+}
+
+DllExport(void) pxDestroySnapshotEncoder(SnapshotEncoder* encoder) {
+    delete encoder;
+}
+
+DllExport(PxU32) pxAddSnapshotClient(SnapshotEncoder* encoder) {
+    return encoder->addClient();
+}
+
+DllExport(void) pxRemoveSnapshotClient(SnapshotEncoder* encoder, PxU32 client) {
+    encoder->removeClient(client);
+}
+
+DllExport(PxU32) pxCaptureSnapshot(SnapshotEncoder* encoder, BodyTable* table) {
+    return encoder->capture(*table, sharedDispatcher());
+}
+
+DllExport(PxU32) pxEncodeSnapshot(SnapshotEncoder* encoder, PxU32 client, PxU8* buffer, PxU32 budget) {
+    return encoder->encode(client, buffer, budget);
+}
+
+DllExport(void) pxAckSnapshot(SnapshotEncoder* encoder, PxU32 client, PxU32 seq, const PxU32* skipped, PxU32 skippedCount) {
+    encoder->ack(client, seq, skipped, skipped ? skippedCount : 0);
+}
+
+DllExport(SnapshotDecoder*) pxCreateSnapshotDecoder(const PxSnapshotDesc* desc) {
+    return new SnapshotDecoder(*desc);
+}
+
+DllExport(void) pxDestroySnapshotDecoder(SnapshotDecoder* decoder) {
+    delete decoder;
+}
+
+DllExport(int) pxDecodeSnapshot(SnapshotDecoder* decoder, const PxU8* data, PxU32 size, PxU32* seq) {
+    PxU32 s = 0;
+    auto ok = decoder->decode(data, size, s);
+    if(seq) *seq = s;
+    return ok ? (int)decoder->Updates.size() : -1;
+}
+
+DllExport(void) pxGetSnapshotUpdates(SnapshotDecoder* decoder, PxBodyHandle* ids, Euclidean3d* poses, int* removed) {
+    for(PxU32 i = 0; i < decoder->Updates.size(); i++) {
+        auto& e = decoder->Updates[i];
+        if(ids) ids[i] = { e.Slot, e.Generation };
+        if(removed) removed[i] = (int)e.Removed;
+        if(poses && !e.Removed) poses[i] = toEuclidean3d(decoder->pose(e.Q));
+    }
+}
+
+DllExport(PxU32) pxGetSnapshotSkipped(SnapshotDecoder* decoder, PxU32* slots) {
+    auto n = (PxU32)decoder->Skipped.size();
+    if(slots && n > 0) memcpy(slots, decoder->Skipped.data(), n * sizeof(PxU32));
+    return n;
+}
+
+DllExport(PxU32) pxGetSnapshotBodies(SnapshotDecoder* decoder, PxBodyHandle* ids, Euclidean3d* poses, PxU32 maxBodies) {
+    PxU32 n = 0;
+    for(PxU32 slot = 0; slot < decoder->Bodies.size(); slot++) {
+        auto& b = decoder->Bodies[slot];
+        if(!b.Present) continue;
+        if(n < maxBodies) {
+            if(ids) ids[n] = { slot, b.Generation };
+            if(poses) poses[n] = toEuclidean3d(decoder->pose(b.Q));
+        }
+        n++;
+    }
+    return n;
+}
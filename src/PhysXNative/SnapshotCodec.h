@@ -0,0 +1,134 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include "BodyTable.h"
+#include "BitPacking.h"
+#include <memory>
+#include <vector>
+
+typedef struct {
+    V3d BoundsMin;              // positions are quantized inside these bounds
+    V3d BoundsMax;
+    physx::PxU32 PositionBits;  // per axis
+    physx::PxU32 RotationBits;  // per smallest-three component
+    physx::PxU32 DeltaBits;     // per axis for small position deltas against a baseline
+    physx::PxU32 MaxBodies;     // decoders reject packets with higher slots, 0 allows 2^20
+} PxSnapshotDesc;
+
+static const physx::PxU32 SnapshotHistory = 256;
+static const physx::PxU32 SnapshotQuantized = 7;
+
+// A body update as sent in a packet, quantized.
+struct SnapshotEntry {
+    physx::PxU32 Slot;
+    physx::PxU32 Generation;
+    physx::PxU32 Removed;
+    physx::PxU32 Q[SnapshotQuantized];
+};
+
+struct SnapshotPacket {
+    physx::PxU32 Seq;
+    bool Acked;
+    std::vector<SnapshotEntry> Entries;   // sorted by slot
+};
+
+// What the encoder knows a client has, per body slot.
+struct SnapshotClientBody {
+    physx::PxU32 Seq;       // acked packet that delivered it, 0 if the client has nothing
+    physx::PxU32 Generation;
+    physx::PxU32 Present;
+    physx::PxU32 Q[SnapshotQuantized];
+};
+
+struct SnapshotClient {
+    std::vector<SnapshotClientBody> Known;
+    std::vector<float> Priority;
+    SnapshotPacket Sent[SnapshotHistory];
+};
+
+// Encodes the bulk body state for many clients. capture() quantizes the state
+// once per tick, encode() then writes only bodies that differ from what the
+// client acknowledged, in order of their priority accumulators until the
+// byte budget is used. Bodies that did not fit keep accumulating and go first
+// next time. Positions are sent as small deltas against the acknowledged
+// state of the body where possible, rotations as smallest-three.
+class SnapshotEncoder {
+public:
+    explicit SnapshotEncoder(const PxSnapshotDesc& desc);
+
+    PxSnapshotDesc Desc;
+    physx::PxU32 Seq;
+
+    physx::PxU32 addClient();
+    void removeClient(physx::PxU32 client);
+
+    // returns the sequence number packets encoded from this state will carry
+    physx::PxU32 capture(const BodyTable& table, physx::PxCpuDispatcher* dispatcher);
+    // returns the number of bytes written, at most budget, and 0 if the client
+    // already got a packet from the current capture
+    physx::PxU32 encode(physx::PxU32 client, physx::PxU8* buffer, physx::PxU32 budget);
+    // acknowledges the entries of packet seq except the skipped slots the
+    // decoder reported (ascending), those are resent without a baseline
+    void ack(physx::PxU32 client, physx::PxU32 seq, const physx::PxU32* skipped, physx::PxU32 skippedCount);
+
+private:
+    PositionQuantizer Quantizer;
+    std::vector<std::unique_ptr<SnapshotClient>> Clients;
+
+    // captured state per body slot
+    std::vector<physx::PxU32> Generations;
+    std::vector<physx::PxU8> Alive;
+    std::vector<physx::PxU32> Current;
+
+    struct Candidate {
+        float Priority;
+        physx::PxU32 Slot;
+    };
+    std::vector<Candidate> Candidates;
+    std::vector<physx::PxU8> Bytes;
+};
+
+// Client side of SnapshotEncoder. Keeps the decoded entries of the last
+// SnapshotHistory packets as baselines and the newest state of every body.
+class SnapshotDecoder {
+public:
+    explicit SnapshotDecoder(const PxSnapshotDesc& desc);
+
+    PxSnapshotDesc Desc;
+
+    // returns false for malformed packets, seq receives the sequence to acknowledge
+    bool decode(const physx::PxU8* data, physx::PxU32 size, physx::PxU32& seq);
+
+    // bodies changed by the last decode, removed ones have Removed set
+    std::vector<SnapshotEntry> Updates;
+    // entries whose baseline was no longer available, they are skipped and
+    // their slots (ascending) have to go back with the ack
+    physx::PxU32 MissingBaselines;
+    std::vector<physx::PxU32> Skipped;
+
+    // current state per slot
+    std::vector<SnapshotClientBody> Bodies;
+
+    physx::PxTransform pose(const physx::PxU32* q) const;
+
+private:
+    PositionQuantizer Quantizer;
+    SnapshotPacket History[SnapshotHistory];
+};
+
+DllExport(SnapshotEncoder*) pxCreateSnapshotEncoder(const PxSnapshotDesc* desc);
+DllExport(void) pxDestroySnapshotEncoder(SnapshotEncoder* encoder);
+DllExport(physx::PxU32) pxAddSnapshotClient(SnapshotEncoder* encoder);
+DllExport(void) pxRemoveSnapshotClient(SnapshotEncoder* encoder, physx::PxU32 client);
+DllExport(physx::PxU32) pxCaptureSnapshot(SnapshotEncoder* encoder, BodyTable* table);
+DllExport(physx::PxU32) pxEncodeSnapshot(SnapshotEncoder* encoder, physx::PxU32 client, physx::PxU8* buffer, physx::PxU32 budget);
+DllExport(void) pxAckSnapshot(SnapshotEncoder* encoder, physx::PxU32 client, physx::PxU32 seq, const physx::PxU32* skipped, physx::PxU32 skippedCount);
+
+DllExport(SnapshotDecoder*) pxCreateSnapshotDecoder(const PxSnapshotDesc* desc);
+DllExport(void) pxDestroySnapshotDecoder(SnapshotDecoder* decoder);
+// returns the number of updated bodies or -1 for a malformed packet
+DllExport(int) pxDecodeSnapshot(SnapshotDecoder* decoder, const physx::PxU8* data, physx::PxU32 size, physx::PxU32* seq);
+DllExport(void) pxGetSnapshotUpdates(SnapshotDecoder* decoder, PxBodyHandle* ids, Euclidean3d* poses, int* removed);
+// slots skipped by the last decode, to be passed to pxAckSnapshot; returns the count
+DllExport(physx::PxU32) pxGetSnapshotSkipped(SnapshotDecoder* decoder, physx::PxU32* slots);
+DllExport(physx::PxU32) pxGetSnapshotBodies(SnapshotDecoder* decoder, PxBodyHandle* ids, Euclidean3d* poses, physx::PxU32 maxBodies);
@@ -0,0 +1,204 @@
+#include "TriggerManager.h"
+#include "Parallel.h"
+#include "World.h"
+#include <algorithm>
+#include <cstring>
+#include <cooking/PxCooking.h>
+#include <geometry/PxGeometryQuery.h>
+
+using namespace physx;
+
+static const PxU32 TriggerGrain = 256;
+
+static PxGeometryHolder triggerGeometry(const PxTriggerDesc& desc) {
+    if(desc.Type == PxTriggerSphere) return PxGeometryHolder(PxSphereGeometry((float)desc.HalfExtents.X));
+    return PxGeometryHolder(PxBoxGeometry(toPxVec3(desc.HalfExtents)));
+}
+
+struct TriggerHits : PxBVH::OverlapCallback {
+    std::vector<PxU32>& Hits;
+    explicit TriggerHits(std::vector<PxU32>& hits) : Hits(hits) {}
+    virtual bool reportHit(PxU32 boundsIndex) override {
+        Hits.push_back(boundsIndex);
+        return true;
+    }
+};
+
+TriggerManager::~TriggerManager() {
+    if(Tree) Tree->release();
+}
+
+PxU32 TriggerManager::add(const PxTriggerDesc& desc) {
+    TriggerVolume volume;
+    volume.Desc = desc;
+    volume.Geometry = triggerGeometry(desc);
+    volume.Pose = toPxTransform(desc.Pose);
+    volume.Alive = true;
+    Triggers.push_back(volume);
+    Dirty = true;
+    return (PxU32)Triggers.size() - 1;
+}
+
+bool TriggerManager::remove(PxU32 id) {
+    if(id >= Triggers.size() || !Triggers[id].Alive) return false;
+    Triggers[id].Alive = false;
+    Dirty = true;
+    return true;
+}
+
+void TriggerManager::rebuild() {
+    if(Tree) Tree->release();
+    Tree = nullptr;
+    TreeToTrigger.clear();
+    Dirty = false;
+
+    std::vector<PxBounds3> bounds;
+    for(PxU32 id = 0; id < Triggers.size(); id++) {
+        auto& t = Triggers[id];
+        if(!t.Alive) continue;
+        bounds.push_back(PxGeometryQuery::getWorldBounds(t.Geometry.any(), t.Pose, 1.0f));
+        TreeToTrigger.push_back(id);
+    }
+    if(bounds.empty()) return;
+
+    PxBVHDesc desc;
+    desc.bounds.count = (PxU32)bounds.size();
+    desc.bounds.stride = sizeof(PxBounds3);
+    desc.bounds.data = bounds.data();
+    desc.enlargement = 0.0f;
+    Tree = PxCreateBVH(desc);
+}
+
+void TriggerManager::testBody(const BodyTable& table, PxU32 dense, std::vector<PxU32>& hits, std::vector<PxTriggerEvent>& events) {
+    auto bounds = table.Actors[dense]->getWorldBounds();
+    PxBoxGeometry box(bounds.getExtents());
+    PxTransform boxPose(bounds.getCenter());
+
+    hits.clear();
+    if(Tree) {
+        TriggerHits cb(hits);
+        Tree->overlap(box, boxPose, cb);
+    }
+
+    // the BVH only knows trigger bounds, rotated boxes and spheres need the exact test
+    size_t n = 0;
+    for(auto h : hits) {
+        auto id = TreeToTrigger[h];
+        auto& t = Triggers[id];
+        if(PxGeometryQuery::overlap(t.Geometry.any(), t.Pose, box, boxPose)) hits[n++] = id;
+    }
+    hits.resize(n);
+    std::sort(hits.begin(), hits.end());
+
+    auto slot = table.DenseToSlot[dense];
+    auto& occ = Occupancy[slot];
+    auto generation = table.Generations[slot];
+    if(occ.Generation != generation) {
+        // the slot was reused, the previous body left everything it was in
+        for(auto id : occ.Inside) events.push_back({ { slot, occ.Generation }, id, PxTriggerLeave, Triggers[id].Desc.UserData });
+        occ.Inside.clear();
+        occ.Generation = generation;
+    }
+
+    PxBodyHandle body = { slot, generation };
+    size_t i = 0, j = 0;
+    while(i < hits.size() || j < occ.Inside.size()) {
+        if(j == occ.Inside.size() || (i < hits.size() && hits[i] < occ.Inside[j])) {
+            events.push_back({ body, hits[i], PxTriggerEnter, Triggers[hits[i]].Desc.UserData });
+            i++;
+        }
+        else if(i == hits.size() || occ.Inside[j] < hits[i]) {
+            events.push_back({ body, occ.Inside[j], PxTriggerLeave, Triggers[occ.Inside[j]].Desc.UserData });
+            j++;
+        }
+        else {
+            i++;
+            j++;
+        }
+    }
+    occ.Inside.swap(hits);
+}
+
+PxU32 TriggerManager::update(BodyTable& table, PxScene* const* scenes, PxU32 sceneCount, PxCpuDispatcher* dispatcher) {
+    if(Dirty) rebuild();
+
+    Active.clear();
+    for(PxU32 s = 0; s < sceneCount; s++) {
+        PxU32 count = 0;
+        auto actors = scenes[s]->getActiveActors(count);
+        for(PxU32 i = 0; i < count; i++) {
+            auto dense = table.denseIndexOf(actors[i]);
+            if(dense != PxInvalidBodyIndex) Active.push_back(dense);
+        }
+    }
+
+    if(Occupancy.size() < table.Generations.size()) Occupancy.resize(table.Generations.size(), { 0, {} });
+
+    // removed bodies never show up as active again, their slot generation moved on
+    Events.clear();
+    for(auto slot : Occupied) {
+        auto& occ = Occupancy[slot];
+        if(occ.Generation == table.Generations[slot]) continue;
+        for(auto id : occ.Inside) Events.push_back({ { slot, occ.Generation }, id, PxTriggerLeave, Triggers[id].Desc.UserData });
+        occ.Inside.clear();
+        occ.Generation = table.Generations[slot];
+    }
+
+    auto chunks = ((PxU32)Active.size() + TriggerGrain - 1) / TriggerGrain;
+    if(ChunkEvents.size() < chunks) ChunkEvents.resize(chunks);
+    for(auto& events : ChunkEvents) events.clear();
+
+    // every body owns its occupancy slot, chunks only share the read-only tree
+    parallelFor(dispatcher, (PxU32)Active.size(), TriggerGrain, [&](PxU32 begin, PxU32 end) {
+        std::vector<PxU32> hits;
+        auto& events = ChunkEvents[begin / TriggerGrain];
+        for(PxU32 i = begin; i < end; i++) testBody(table, Active[i], hits, events);
+    });
+
+    for(auto& events : ChunkEvents) Events.insert(Events.end(), events.begin(), events.end());
+
+    size_t n = 0;
+    for(auto slot : Occupied) if(!Occupancy[slot].Inside.empty()) Occupied[n++] = slot;
+    Occupied.resize(n);
+    for(auto dense : Active) {
+        auto slot = table.DenseToSlot[dense];
+        if(!Occupancy[slot].Inside.empty()) Occupied.push_back(slot);
+    }
+    std::sort(Occupied.begin(), Occupied.end());
+    Occupied.erase(std::unique(Occupied.begin(), Occupied.end()), Occupied.end());
+    return (PxU32)Events.size();
+}
+
+
+DllExport(TriggerManager*) pxCreateTriggerManager() {
+    return new TriggerManager();
+}
+
+DllExport(void) pxDestroyTriggerManager(TriggerManager* manager) {
+    delete manager;
+}
+
+DllExport(void) pxAddTriggers(TriggerManager* manager, PxU32 count, const PxTriggerDesc* descs, PxU32* ids) {
+    for(PxU32 i = 0; i < count; i++) {
+        auto id = manager->add(descs[i]);
+        if(ids) ids[i] = id;
+    }
+}
+
+DllExport(int) pxRemoveTrigger(TriggerManager* manager, PxU32 id) {
+    return manager->remove(id) ? 1 : 0;
+}
+
+DllExport(PxU32) pxUpdateTriggers(TriggerManager* manager, BodyTable* table, PxSceneHandle* scene) {
+    return manager->update(*table, &scene->Scene, 1, sharedDispatcher());
+}
+
+DllExport(PxU32) pxUpdateWorldTriggers(TriggerManager* manager, PartitionedWorld* world) {
+    return manager->update(world->Table, world->Cells.data(), (PxU32)world->Cells.size(), sharedDispatcher());
+}
+
+DllExport(PxU32) pxGetTriggerEvents(TriggerManager* manager, PxTriggerEvent* events, PxU32 maxEvents) {
+    auto n = PxMin(maxEvents, (PxU32)manager->Events.size());
+    if(n) memcpy(events, manager->Events.data(), n * sizeof(PxTriggerEvent));
+    return n;
+}
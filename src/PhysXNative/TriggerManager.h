@@ -0,0 +1,89 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include "BodyTable.h"
+#include <geometry/PxGeometryHelpers.h>
+#include <vector>
+
+class PartitionedWorld;
+
+enum PxTriggerType {
+    PxTriggerBox = 0,       // HalfExtents
+    PxTriggerSphere = 1     // radius in HalfExtents.X
+};
+
+enum PxTriggerEventType {
+    PxTriggerEnter = 0,
+    PxTriggerLeave = 1
+};
+
+typedef struct {
+    physx::PxU32 Type;
+    physx::PxU32 Reserved;
+    Euclidean3d Pose;
+    V3d HalfExtents;
+    physx::PxU64 UserData;
+} PxTriggerDesc;
+
+typedef struct {
+    PxBodyHandle Body;
+    physx::PxU32 Trigger;
+    physx::PxU32 Type;      // PxTriggerEventType
+    physx::PxU64 UserData;  // of the trigger
+} PxTriggerEvent;
+
+struct TriggerVolume {
+    PxTriggerDesc Desc;
+    physx::PxGeometryHolder Geometry;
+    physx::PxTransform Pose;
+    bool Alive;
+};
+
+// triggers a body slot is inside of, sorted by id
+struct TriggerOccupancy {
+    physx::PxU32 Generation;
+    std::vector<physx::PxU32> Inside;
+};
+
+// Static trigger volumes kept outside the simulation in their own PxBVH.
+// Every update only the bodies that moved in the last step (the active actors)
+// are tested: their bounds are culled against the BVH and refined against the
+// exact volume, in parallel. Cost follows the number of moving bodies, not the
+// number of triggers. Ids are never reused; removing a trigger reports leave
+// events for bodies inside it once they move again. Bodies removed from the
+// table leave all their triggers in the next update.
+class TriggerManager {
+public:
+    TriggerManager() : Tree(nullptr), Dirty(false) {}
+    ~TriggerManager();
+
+    std::vector<TriggerVolume> Triggers;
+    std::vector<PxTriggerEvent> Events;
+
+    physx::PxU32 add(const PxTriggerDesc& desc);
+    bool remove(physx::PxU32 id);
+
+    // scenes must have eENABLE_ACTIVE_ACTORS and be done with fetchResults, returns the number of events
+    physx::PxU32 update(BodyTable& table, physx::PxScene* const* scenes, physx::PxU32 sceneCount, physx::PxCpuDispatcher* dispatcher);
+
+private:
+    void rebuild();
+    void testBody(const BodyTable& table, physx::PxU32 dense, std::vector<physx::PxU32>& hits, std::vector<PxTriggerEvent>& events);
+
+    physx::PxBVH* Tree;
+    bool Dirty;
+    std::vector<physx::PxU32> TreeToTrigger;
+    std::vector<TriggerOccupancy> Occupancy;   // indexed by body slot
+    std::vector<physx::PxU32> Occupied;         // slots inside any trigger after the last update
+
+    std::vector<physx::PxU32> Active;           // dense indices of moved bodies
+    std::vector<std::vector<PxTriggerEvent>> ChunkEvents;
+};
+
+DllExport(TriggerManager*) pxCreateTriggerManager();
+DllExport(void) pxDestroyTriggerManager(TriggerManager* manager);
+DllExport(void) pxAddTriggers(TriggerManager* manager, physx::PxU32 count, const PxTriggerDesc* descs, physx::PxU32* ids);
+DllExport(int) pxRemoveTrigger(TriggerManager* manager, physx::PxU32 id);
+DllExport(physx::PxU32) pxUpdateTriggers(TriggerManager* manager, BodyTable* table, PxSceneHandle* scene);
+DllExport(physx::PxU32) pxUpdateWorldTriggers(TriggerManager* manager, PartitionedWorld* world);
+DllExport(physx::PxU32) pxGetTriggerEvents(TriggerManager* manager, PxTriggerEvent* events, physx::PxU32 maxEvents);
@@ -0,0 +1,753 @@
+#include "Vehicles.h"
+#include "Parallel.h"
+#include <mutex>
+
+using namespace physx;
+using namespace physx::vehicle2;
+
+static const PxU32 VehicleGrain = 8;
+
+Vehicle::Vehicle(const PxVehicleDesc& desc, const PxVehicleWheelDesc* wheels, PxPhysics* physics,
+        const PxCookingParams& cooking, const PxVec3& gravity) : Drive(desc.Drive), UserData(desc.UserData) {
+    auto n = PxMin(desc.WheelCount, (PxU32)MaxWheels);
+    auto cmass = toPxVec3(desc.CenterOfMass);
+    auto sweep = desc.Query == PxVehicleQuerySweep;
+    PxVehicleFrame frame;
+    frame.setToDefault();
+
+    // one wheel per axle keeps the axle description independent of the wheel layout
+    Axles.setToDefault();
+    for(PxU32 i = 0; i < n; i++) Axles.addAxle(1, &i);
+
+    auto e = toPxVec3(desc.HalfExtents);
+    RigidBody.mass = desc.Mass;
+    RigidBody.moi = PxVec3(e.y * e.y + e.z * e.z, e.x * e.x + e.z * e.z, e.x * e.x + e.y * e.y) * (desc.Mass / 3.0f);
+
+    PxVec3 offsets[MaxWheels];
+    PxReal sprung[MaxWheels];
+    for(PxU32 i = 0; i < n; i++) offsets[i] = toPxVec3(wheels[i].Attachment) - cmass;
+    PxVehicleComputeSprungMasses(n, offsets, desc.Mass, PxVehicleAxes::eNegZ, sprung);
+
+    SuspensionCalculation.suspensionJounceCalculationType = sweep ? PxVehicleSuspensionJounceCalculationType::eSWEEP : PxVehicleSuspensionJounceCalculationType::eRAYCAST;
+    SuspensionCalculation.limitSuspensionExpansionVelocity = false;
+
+    BrakeResponse[0].maxResponse = desc.MaxBrakeTorque;
+    BrakeResponse[1].maxResponse = desc.MaxHandbrakeTorque;
+    SteerResponse.maxResponse = desc.MaxSteer;
+    ThrottleResponse.maxResponse = desc.MaxDriveTorque;
+
+    PxReal driveSum = 0.0f;
+    for(PxU32 i = 0; i < n; i++) driveSum += PxAbs(wheels[i].DriveMultiplier);
+
+    Differential.setToDefault();
+    for(PxU32 i = 0; i < n; i++) {
+        auto& w = wheels[i];
+        Wheels[i].radius = w.Radius;
+        Wheels[i].halfWidth = w.HalfWidth;
+        Wheels[i].mass = w.Mass;
+        Wheels[i].moi = 0.5f * w.Mass * w.Radius * w.Radius;
+        Wheels[i].dampingRate = w.DampingRate;
+
+        Suspensions[i].suspensionAttachment = PxTransform(offsets[i]);
+        Suspensions[i].suspensionTravelDir = PxVec3(0.0f, 0.0f, -1.0f);
+        Suspensions[i].suspensionTravelDist = w.TravelDist;
+        Suspensions[i].wheelAttachment = PxTransform(PxIdentity);
+
+        Compliances[i].wheelToeAngle.addPair(0.0f, 0.0f);
+        Compliances[i].wheelCamberAngle.addPair(0.0f, 0.0f);
+        Compliances[i].suspForceAppPoint.addPair(0.0f, PxVec3(0.0f));
+        Compliances[i].tireForceAppPoint.addPair(0.0f, PxVec3(0.0f));
+
+        SuspensionForces[i].stiffness = w.Stiffness;
+        SuspensionForces[i].damping = w.Damping;
+        SuspensionForces[i].sprungMass = sprung[i];
+
+        auto load = sprung[i] * gravity.magnitude();
+        auto& tire = Tires[i];
+        tire.latStiffX = 1.0f;
+        tire.latStiffY = w.LatStiff > 0.0f ? w.LatStiff : 20.0f * load;
+        tire.longStiff = w.LongStiff > 0.0f ? w.LongStiff : 5.0f * load;
+        tire.camberStiff = 0.0f;
+        tire.restLoad = load;
+        const PxReal frictionVsSlip[3][2] = { { 0.0f, 1.0f }, { 0.1f, 1.0f }, { 1.0f, 1.0f } };
+        const PxReal loadFilter[2][2] = { { 0.0f, 0.23f }, { 3.0f, 3.0f } };
+        PxMemCopy(tire.frictionVsSlip, frictionVsSlip, sizeof(frictionVsSlip));
+        PxMemCopy(tire.loadFilter, loadFilter, sizeof(loadFilter));
+        Friction[i].materialFrictions = nullptr;
+        Friction[i].nbMaterialFrictions = 0;
+        Friction[i].defaultFriction = desc.TireFriction;
+
+        SuspensionLimits[i].restitution = 0.0f;
+        SuspensionLimits[i].directionForSuspensionLimitConstraint = PxVehiclePhysXSuspensionLimitConstraintParams::eROAD_GEOMETRY_NORMAL;
+        WheelShapePoses[i] = PxTransform(PxIdentity);
+
+        SteerResponse.wheelResponseMultipliers[i] = w.SteerMultiplier;
+        BrakeResponse[0].wheelResponseMultipliers[i] = w.BrakeMultiplier;
+        BrakeResponse[1].wheelResponseMultipliers[i] = w.HandbrakeMultiplier;
+        ThrottleResponse.wheelResponseMultipliers[i] = w.DriveMultiplier;
+        if(driveSum > 0.0f) {
+            Differential.torqueRatios[i] = w.DriveMultiplier / driveSum;
+            Differential.aveWheelSpeedRatios[i] = PxAbs(w.DriveMultiplier) / driveSum;
+        }
+    }
+
+    // engine drive, the flat torque curve and autobox thresholds follow the vehicle2 samples
+    Engine.torqueCurve.addPair(0.0f, 1.0f);
+    Engine.torqueCurve.addPair(0.33f, 1.0f);
+    Engine.torqueCurve.addPair(1.0f, 1.0f);
+    Engine.moi = 1.0f;
+    Engine.peakTorque = desc.MaxDriveTorque;
+    Engine.idleOmega = 0.0f;
+    Engine.maxOmega = desc.MaxOmega > 0.0f ? desc.MaxOmega : 600.0f;
+    Engine.dampingRateFullThrottle = 0.15f;
+    Engine.dampingRateZeroThrottleClutchEngaged = 2.0f;
+    Engine.dampingRateZeroThrottleClutchDisengaged = 0.35f;
+
+    auto gears = PxClamp(desc.GearCount, 1u, (PxU32)PxVehicleGearboxParams::eMAX_NB_GEARS - 2);
+    Gearbox.neutralGear = 1;
+    Gearbox.ratios[0] = desc.ReverseRatio < 0.0f ? desc.ReverseRatio : -4.0f;
+    Gearbox.ratios[1] = 0.0f;
+    for(PxU32 g = 0; g < gears; g++) {
+        auto t = gears > 1 ? (PxReal)g / (PxReal)(gears - 1) : 0.0f;
+        Gearbox.ratios[2 + g] = desc.FirstRatio * PxPow(desc.TopRatio / desc.FirstRatio, t);
+    }
+    Gearbox.finalRatio = desc.FinalRatio;
+    Gearbox.nbRatios = gears + 2;
+    Gearbox.switchTime = 0.5f;
+
+    for(PxU32 g = 0; g < PxVehicleGearboxParams::eMAX_NB_GEARS; g++) {
+        Autobox.upRatios[g] = 0.65f;
+        Autobox.downRatios[g] = 0.5f;
+    }
+    Autobox.latency = 2.0f;
+
+    Clutch.accuracyMode = vehicle2::PxVehicleClutchAccuracyMode::eBEST_POSSIBLE;
+    Clutch.estimateIterations = 5;
+    ClutchResponse.maxResponse = 10.0f;
+
+    // states
+    Commands.setToDefault();
+    Commands.nbBrakes = 2;
+    DirectTransmission.setToDefault();
+    DirectTransmission.gear = PxVehicleDirectDriveTransmissionCommandState::eFORWARD;
+    EngineTransmission.setToDefault();
+    EngineTransmission.targetGear = PxVehicleEngineDriveTransmissionCommandState::eAUTOMATIC_GEAR;
+    RigidBodyState.setToDefault();
+    for(PxU32 i = 0; i < MaxWheels; i++) {
+        BrakeResponseStates[i] = ThrottleResponseStates[i] = SteerResponseStates[i] = 0.0f;
+        ActuationStates[i].setToDefault();
+        RoadStates[i].setToDefault();
+        QueryStates[i].setToDefault();
+        SuspensionStates[i].setToDefault();
+        ComplianceStates[i].setToDefault();
+        SuspensionForceStates[i].setToDefault();
+        TireGripStates[i].setToDefault();
+        TireDirectionStates[i].setToDefault();
+        TireSpeedStates[i].setToDefault();
+        TireSlipStates[i].setToDefault();
+        TireCamberStates[i].setToDefault();
+        TireStickyStates[i].setToDefault();
+        TireForces[i].setToDefault();
+        WheelBodyStates[i].setToDefault();
+        WheelPoses[i].setToDefault();
+    }
+    EngineThrottleState.setToDefault();
+    ClutchResponseState.setToDefault();
+    EngineState.setToDefault();
+    EngineState.rotationSpeed = Engine.idleOmega;
+    GearboxState.setToDefault();
+    GearboxState.currentGear = GearboxState.targetGear = Gearbox.neutralGear + 1;
+    AutoboxState.setToDefault();
+    DifferentialState.setToDefault();
+    ConstraintGroupState.setToDefault();
+    ClutchSlipState.setToDefault();
+    SteerState.setToDefault();
+
+    // chassis box for simulation and queries, wheel shapes are only posed for rendering
+    Actor.setToDefault();
+    Constraints.setToDefault();
+    PxBoxGeometry box(e);
+    PxTransform boxPose(PxIdentity);
+    PxFilterData filter;
+    PxVehiclePhysXRigidActorParams actorParams(RigidBody, nullptr);
+    PxVehiclePhysXRigidActorShapeParams shapeParams(box, boxPose, *desc.Material,
+        PxShapeFlag::eSIMULATION_SHAPE | PxShapeFlag::eSCENE_QUERY_SHAPE, filter, filter);
+    PxVehiclePhysXWheelParams wheelParams(Axles, Wheels);
+    PxVehiclePhysXWheelShapeParams wheelShapeParams(*desc.Material, PxShapeFlags(0), filter, filter);
+    PxVehiclePhysXActorCreate(frame, actorParams, PxTransform(cmass), shapeParams, wheelParams, wheelShapeParams,
+        *physics, cooking, Actor);
+    PxVehicleConstraintsCreate(Axles, *physics, *Actor.rigidBody, Constraints);
+    Actor.rigidBody->setGlobalPose(toPxTransform(desc.Pose));
+
+    Filter.Self = Actor.rigidBody;
+    RoadQuery.roadGeometryQueryType = sweep ? PxVehiclePhysXRoadGeometryQueryType::eSWEEP : PxVehiclePhysXRoadGeometryQueryType::eRAYCAST;
+    RoadQuery.filterData = PxQueryFilterData(PxQueryFlag::eSTATIC | PxQueryFlag::eDYNAMIC | PxQueryFlag::ePREFILTER);
+    RoadQuery.filterCallback = &Filter;
+
+    if(Drive == PxVehicleDriveEngine) {
+        Sequence.add(static_cast<PxVehicleEngineDriveCommandResponseComponent*>(this));
+        Sequence.add(static_cast<PxVehicleMultiWheelDriveDifferentialStateComponent*>(this));
+        Sequence.add(static_cast<PxVehicleEngineDriveActuationStateComponent*>(this));
+    }
+    else {
+        Sequence.add(static_cast<PxVehicleDirectDriveCommandResponseComponent*>(this));
+        Sequence.add(static_cast<PxVehicleDirectDriveActuationStateComponent*>(this));
+    }
+    Sequence.add(static_cast<PxVehiclePhysXRoadGeometrySceneQueryComponent*>(this));
+    Sequence.beginSubstepGroup((PxU8)PxClamp(desc.Substeps, 1u, 255u));
+    Sequence.add(static_cast<PxVehicleSuspensionComponent*>(this));
+    Sequence.add(static_cast<PxVehicleTireComponent*>(this));
+    Sequence.add(static_cast<PxVehiclePhysXConstraintComponent*>(this));
+    if(Drive == PxVehicleDriveEngine) Sequence.add(static_cast<PxVehicleEngineDrivetrainComponent*>(this));
+    else Sequence.add(static_cast<PxVehicleDirectDrivetrainComponent*>(this));
+    Sequence.add(static_cast<PxVehicleRigidBodyComponent*>(this));
+    Sequence.endSubstepGroup();
+    Sequence.add(static_cast<PxVehicleWheelComponent*>(this));
+}
+
+Vehicle::~Vehicle() {
+    PxVehicleConstraintsDestroy(Constraints);
+    // releases the actor and removes it from its scene
+    PxVehiclePhysXActorDestroy(Actor);
+}
+
+void Vehicle::setCommand(const PxVehicleCommand& command) {
+    Commands.throttle = PxClamp(command.Throttle, 0.0f, 1.0f);
+    Commands.brakes[0] = PxClamp(command.Brake, 0.0f, 1.0f);
+    Commands.brakes[1] = PxClamp(command.Handbrake, 0.0f, 1.0f);
+    Commands.nbBrakes = 2;
+    Commands.steer = PxClamp(command.Steer, -1.0f, 1.0f);
+
+    if(command.Gear < 0) {
+        DirectTransmission.gear = PxVehicleDirectDriveTransmissionCommandState::eREVERSE;
+        EngineTransmission.targetGear = 0;
+    }
+    else if(command.Gear == 0) {
+        DirectTransmission.gear = PxVehicleDirectDriveTransmissionCommandState::eNEUTRAL;
+        EngineTransmission.targetGear = Gearbox.neutralGear;
+    }
+    else {
+        DirectTransmission.gear = PxVehicleDirectDriveTransmissionCommandState::eFORWARD;
+        EngineTransmission.targetGear = PxVehicleEngineDriveTransmissionCommandState::eAUTOMATIC_GEAR;
+    }
+}
+
+void Vehicle::getStatus(PxVehicleStatus& status) const {
+    auto pose = Actor.rigidBody->getGlobalPose();
+    auto velocity = Actor.rigidBody->getLinearVelocity();
+    status.Pose = toEuclidean3d(pose);
+    status.LinearVelocity = toV3d(velocity);
+    status.ForwardSpeed = velocity.dot(pose.q.getBasisVector0());
+
+    if(Drive == PxVehicleDriveEngine) {
+        status.EngineOmega = EngineState.rotationSpeed;
+        status.Gear = (PxI32)GearboxState.currentGear - (PxI32)Gearbox.neutralGear;
+    }
+    else {
+        status.EngineOmega = 0.0f;
+        status.Gear = DirectTransmission.gear == PxVehicleDirectDriveTransmissionCommandState::eREVERSE ? -1
+            : DirectTransmission.gear == PxVehicleDirectDriveTransmissionCommandState::eNEUTRAL ? 0 : 1;
+    }
+
+    status.WheelsOnGround = 0;
+    for(PxU32 i = 0; i < Axles.nbWheels; i++) {
+        if(RoadStates[i].hitState && SuspensionStates[i].separation <= 0.0f) status.WheelsOnGround++;
+    }
+}
+
+void Vehicle::getDataForRigidBodyComponent(
+        const PxVehicleAxleDescription*& axleDescription,
+        const PxVehicleRigidBodyParams*& rigidBodyParams,
+        PxVehicleArrayData<const PxVehicleSuspensionForce>& suspensionForces,
+        PxVehicleArrayData<const PxVehicleTireForce>& tireForces,
+        const PxVehicleAntiRollTorque*& antiRollTorque,
+        PxVehicleRigidBodyState*& rigidBodyState) {
+    axleDescription = &Axles;
+    rigidBodyParams = &RigidBody;
+    suspensionForces.setData(SuspensionForceStates);
+    tireForces.setData(TireForces);
+    antiRollTorque = nullptr;
+    rigidBodyState = &RigidBodyState;
+}
+
+void Vehicle::getDataForSuspensionComponent(
+        const PxVehicleAxleDescription*& axleDescription,
+        const PxVehicleRigidBodyParams*& rigidBodyParams,
+        const PxVehicleSuspensionStateCalculationParams*& suspensionStateCalculationParams,
+        PxVehicleArrayData<const PxReal>& steerResponseStates,
+        const PxVehicleRigidBodyState*& rigidBodyState,
+        PxVehicleArrayData<const PxVehicleWheelParams>& wheelParams,
+        PxVehicleArrayData<const PxVehicleSuspensionParams>& suspensionParams,
+        PxVehicleArrayData<const PxVehicleSuspensionComplianceParams>& suspensionComplianceParams,
+        PxVehicleArrayData<const PxVehicleSuspensionForceParams>& suspensionForceParams,
+        PxVehicleSizedArrayData<const PxVehicleAntiRollForceParams>& antiRollForceParams,
+        PxVehicleArrayData<const PxVehicleRoadGeometryState>& wheelRoadGeomStates,
+        PxVehicleArrayData<PxVehicleSuspensionState>& suspensionStates,
+        PxVehicleArrayData<PxVehicleSuspensionComplianceState>& suspensionComplianceStates,
+        PxVehicleArrayData<PxVehicleSuspensionForce>& suspensionForces,
+        PxVehicleAntiRollTorque*& antiRollTorque) {
+    axleDescription = &Axles;
+    rigidBodyParams = &RigidBody;
+    suspensionStateCalculationParams = &SuspensionCalculation;
+    steerResponseStates.setData(SteerResponseStates);
+    rigidBodyState = &RigidBodyState;
+    wheelParams.setData(Wheels);
+    suspensionParams.setData(Suspensions);
+    suspensionComplianceParams.setData(Compliances);
+    suspensionForceParams.setData(SuspensionForces);
+    antiRollForceParams.setEmpty();
+    wheelRoadGeomStates.setData(RoadStates);
+    suspensionStates.setData(SuspensionStates);
+    suspensionComplianceStates.setData(ComplianceStates);
+    suspensionForces.setData(SuspensionForceStates);
+    antiRollTorque = nullptr;
+}
+
+void Vehicle::getDataForTireComponent(
+        const PxVehicleAxleDescription*& axleDescription,
+        PxVehicleArrayData<const PxReal>& steerResponseStates,
+        const PxVehicleRigidBodyState*& rigidBodyState,
+        PxVehicleArrayData<const PxVehicleWheelActuationState>& actuationStates,
+        PxVehicleArrayData<const PxVehicleWheelParams>& wheelParams,
+        PxVehicleArrayData<const PxVehicleSuspensionParams>& suspensionParams,
+        PxVehicleArrayData<const PxVehicleTireForceParams>& tireForceParams,
+        PxVehicleArrayData<const PxVehicleRoadGeometryState>& roadGeomStates,
+        PxVehicleArrayData<const PxVehicleSuspensionState>& suspensionStates,
+        PxVehicleArrayData<const PxVehicleSuspensionComplianceState>& suspensionComplianceStates,
+        PxVehicleArrayData<const PxVehicleSuspensionForce>& suspensionForces,
+        PxVehicleArrayData<const PxVehicleWheelRigidBody1dState>& wheelRigidBody1DStates,
+        PxVehicleArrayData<PxVehicleTireGripState>& tireGripStates,
+        PxVehicleArrayData<PxVehicleTireDirectionState>& tireDirectionStates,
+        PxVehicleArrayData<PxVehicleTireSpeedState>& tireSpeedStates,
+        PxVehicleArrayData<PxVehicleTireSlipState>& tireSlipStates,
+        PxVehicleArrayData<PxVehicleTireCamberAngleState>& tireCamberAngleStates,
+        PxVehicleArrayData<PxVehicleTireStickyState>& tireStickyStates,
+        PxVehicleArrayData<PxVehicleTireForce>& tireForces) {
+    axleDescription = &Axles;
+    steerResponseStates.setData(SteerResponseStates);
+    rigidBodyState = &RigidBodyState;
+    actuationStates.setData(ActuationStates);
+    wheelParams.setData(Wheels);
+    suspensionParams.setData(Suspensions);
+    tireForceParams.setData(Tires);
+    roadGeomStates.setData(RoadStates);
+    suspensionStates.setData(SuspensionStates);
+    suspensionComplianceStates.setData(ComplianceStates);
+    suspensionForces.setData(SuspensionForceStates);
+    wheelRigidBody1DStates.setData(WheelBodyStates);
+    tireGripStates.setData(TireGripStates);
+    tireDirectionStates.setData(TireDirectionStates);
+    tireSpeedStates.setData(TireSpeedStates);
+    tireSlipStates.setData(TireSlipStates);
+    tireCamberAngleStates.setData(TireCamberStates);
+    tireStickyStates.setData(TireStickyStates);
+    tireForces.setData(TireForces);
+}
+
+void Vehicle::getDataForWheelComponent(
+        const PxVehicleAxleDescription*& axleDescription,
+        PxVehicleArrayData<const PxReal>& steerResponseStates,
+        PxVehicleArrayData<const PxVehicleWheelParams>& wheelParams,
+        PxVehicleArrayData<const PxVehicleSuspensionParams>& suspensionParams,
+        PxVehicleArrayData<const PxVehicleWheelActuationState>& actuationStates,
+        PxVehicleArrayData<const PxVehicleSuspensionState>& suspensionStates,
+        PxVehicleArrayData<const PxVehicleSuspensionComplianceState>& suspensionComplianceStates,
+        PxVehicleArrayData<const PxVehicleTireSpeedState>& tireSpeedStates,
+        PxVehicleArrayData<PxVehicleWheelRigidBody1dState>& wheelRigidBody1dStates,
+        PxVehicleArrayData<PxVehicleWheelLocalPose>& wheelLocalPoses) {
+    axleDescription = &Axles;
+    steerResponseStates.setData(SteerResponseStates);
+    wheelParams.setData(Wheels);
+    suspensionParams.setData(Suspensions);
+    actuationStates.setData(ActuationStates);
+    suspensionStates.setData(SuspensionStates);
+    suspensionComplianceStates.setData(ComplianceStates);
+    tireSpeedStates.setData(TireSpeedStates);
+    wheelRigidBody1dStates.setData(WheelBodyStates);
+    wheelLocalPoses.setData(WheelPoses);
+}
+
+void Vehicle::getDataForPhysXRoadGeometrySceneQueryComponent(
+        const PxVehicleAxleDescription*& axleDescription,
+        const PxVehiclePhysXRoadGeometryQueryParams*& roadGeomParams,
+        PxVehicleArrayData<const PxReal>& steerResponseStates,
+        const PxVehicleRigidBodyState*& rigidBodyState,
+        PxVehicleArrayData<const PxVehicleWheelParams>& wheelParams,
+        PxVehicleArrayData<const PxVehicleSuspensionParams>& suspensionParams,
+        PxVehicleArrayData<const PxVehiclePhysXMaterialFrictionParams>& materialFrictionParams,
+        PxVehicleArrayData<PxVehicleRoadGeometryState>& roadGeometryStates,
+        PxVehicleArrayData<PxVehiclePhysXRoadGeometryQueryState>& physxRoadGeometryStates) {
+    axleDescription = &Axles;
+    roadGeomParams = &RoadQuery;
+    steerResponseStates.setData(SteerResponseStates);
+    rigidBodyState = &RigidBodyState;
+    wheelParams.setData(Wheels);
+    suspensionParams.setData(Suspensions);
+    materialFrictionParams.setData(Friction);
+    roadGeometryStates.setData(RoadStates);
+    physxRoadGeometryStates.setData(QueryStates);
+}
+
+void Vehicle::getDataForPhysXActorBeginComponent(
+        const PxVehicleAxleDescription*& axleDescription,
+        const PxVehicleCommandState*& commands,
+        const PxVehicleEngineDriveTransmissionCommandState*& transmissionCommands,
+        const PxVehicleGearboxParams*& gearParams,
+        const PxVehicleGearboxState*& gearState,
+        const PxVehicleEngineParams*& engineParams,
+        PxVehiclePhysXActor*& physxActor,
+        PxVehiclePhysXSteerState*& physxSteerState,
+        PxVehiclePhysXConstraints*& physxConstraints,
+        PxVehicleRigidBodyState*& rigidBodyState,
+        PxVehicleArrayData<PxVehicleWheelRigidBody1dState>& wheelRigidBody1dStates,
+        PxVehicleEngineState*& engineState) {
+    auto engine = Drive == PxVehicleDriveEngine;
+    axleDescription = &Axles;
+    commands = &Commands;
+    transmissionCommands = engine ? &EngineTransmission : nullptr;
+    gearParams = engine ? &Gearbox : nullptr;
+    gearState = engine ? &GearboxState : nullptr;
+    engineParams = engine ? &Engine : nullptr;
+    physxActor = &Actor;
+    physxSteerState = &SteerState;
+    physxConstraints = &Constraints;
+    rigidBodyState = &RigidBodyState;
+    wheelRigidBody1dStates.setData(WheelBodyStates);
+    engineState = engine ? &EngineState : nullptr;
+}
+
+void Vehicle::getDataForPhysXActorEndComponent(
+        const PxVehicleAxleDescription*& axleDescription,
+        const PxVehicleRigidBodyState*& rigidBodyState,
+        PxVehicleArrayData<const PxVehicleWheelParams>& wheelParams,
+        PxVehicleArrayData<const PxTransform>& wheelShapeLocalPoses,
+        PxVehicleArrayData<const PxVehicleWheelRigidBody1dState>& wheelRigidBody1dStates,
+        PxVehicleArrayData<const PxVehicleWheelLocalPose>& wheelLocalPoses,
+        const PxVehicleGearboxState*& gearState,
+        PxVehiclePhysXActor*& physxActor) {
+    axleDescription = &Axles;
+    rigidBodyState = &RigidBodyState;
+    wheelParams.setData(Wheels);
+    wheelShapeLocalPoses.setData(WheelShapePoses);
+    wheelRigidBody1dStates.setData(WheelBodyStates);
+    wheelLocalPoses.setData(WheelPoses);
+    gearState = Drive == PxVehicleDriveEngine ? &GearboxState : nullptr;
+    physxActor = &Actor;
+}
+
+void Vehicle::getDataForPhysXConstraintComponent(
+        const PxVehicleAxleDescription*& axleDescription,
+        const PxVehicleRigidBodyState*& rigidBodyState,
+        PxVehicleArrayData<const PxVehicleSuspensionParams>& suspensionParams,
+        PxVehicleArrayData<const PxVehiclePhysXSuspensionLimitConstraintParams>& suspensionLimitParams,
+        PxVehicleArrayData<const PxVehicleSuspensionState>& suspensionStates,
+        PxVehicleArrayData<const PxVehicleSuspensionComplianceState>& suspensionComplianceStates,
+        PxVehicleArrayData<const PxVehicleRoadGeometryState>& wheelRoadGeomStates,
+        PxVehicleArrayData<const PxVehicleTireDirectionState>& tireDirectionStates,
+        PxVehicleArrayData<const PxVehicleTireStickyState>& tireStickyStates,
+        PxVehiclePhysXConstraints*& constraints) {
+    axleDescription = &Axles;
+    rigidBodyState = &RigidBodyState;
+    suspensionParams.setData(Suspensions);
+    suspensionLimitParams.setData(SuspensionLimits);
+    suspensionStates.setData(SuspensionStates);
+    suspensionComplianceStates.setData(ComplianceStates);
+    wheelRoadGeomStates.setData(RoadStates);
+    tireDirectionStates.setData(TireDirectionStates);
+    tireStickyStates.setData(TireStickyStates);
+    constraints = &Constraints;
+}
+
+void Vehicle::getDataForDirectDriveCommandResponseComponent(
+        const PxVehicleAxleDescription*& axleDescription,
+        PxVehicleSizedArrayData<const PxVehicleBrakeCommandResponseParams>& brakeResponseParams,
+        const PxVehicleDirectDriveThrottleCommandResponseParams*& throttleResponseParams,
+        const PxVehicleSteerCommandResponseParams*& steerResponseParams,
+        PxVehicleSizedArrayData<const PxVehicleAckermannParams>& ackermannParams,
+        const PxVehicleCommandState*& commands,
+        const PxVehicleDirectDriveTransmissionCommandState*& transmissionCommands,
+        const PxVehicleRigidBodyState*& rigidBodyState,
+        PxVehicleArrayData<PxReal>& brakeResponseStates,
+        PxVehicleArrayData<PxReal>& throttleResponseStates,
+        PxVehicleArrayData<PxReal>& steerResponseStates) {
+    axleDescription = &Axles;
+    brakeResponseParams.setDataAndCount(BrakeResponse, 2);
+    throttleResponseParams = &ThrottleResponse;
+    steerResponseParams = &SteerResponse;
+    ackermannParams.setEmpty();
+    commands = &Commands;
+    transmissionCommands = &DirectTransmission;
+    rigidBodyState = &RigidBodyState;
+    brakeResponseStates.setData(BrakeResponseStates);
+    throttleResponseStates.setData(ThrottleResponseStates);
+    steerResponseStates.setData(SteerResponseStates);
+}
+
+void Vehicle::getDataForDirectDriveActuationStateComponent(
+        const PxVehicleAxleDescription*& axleDescription,
+        PxVehicleArrayData<const PxReal>& brakeResponseStates,
+        PxVehicleArrayData<const PxReal>& throttleResponseStates,
+        PxVehicleArrayData<PxVehicleWheelActuationState>& actuationStates) {
+    axleDescription = &Axles;
+    brakeResponseStates.setData(BrakeResponseStates);
+    throttleResponseStates.setData(ThrottleResponseStates);
+    actuationStates.setData(ActuationStates);
+}
+
+void Vehicle::getDataForDirectDrivetrainComponent(
+        const PxVehicleAxleDescription*& axleDescription,
+        PxVehicleArrayData<const PxReal>& brakeResponseStates,
+        PxVehicleArrayData<const PxReal>& throttleResponseStates,
+        PxVehicleArrayData<const PxVehicleWheelParams>& wheelParams,
+        PxVehicleArrayData<const PxVehicleWheelActuationState>& actuationStates,
+        PxVehicleArrayData<const PxVehicleTireForce>& tireForces,
+        PxVehicleArrayData<PxVehicleWheelRigidBody1dState>& wheelRigidBody1dStates) {
+    axleDescription = &Axles;
+    brakeResponseStates.setData(BrakeResponseStates);
+    throttleResponseStates.setData(ThrottleResponseStates);
+    wheelParams.setData(Wheels);
+    actuationStates.setData(ActuationStates);
+    tireForces.setData(TireForces);
+    wheelRigidBody1dStates.setData(WheelBodyStates);
+}
+
+void Vehicle::getDataForEngineDriveCommandResponseComponent(
+        const PxVehicleAxleDescription*& axleDescription,
+        PxVehicleSizedArrayData<const PxVehicleBrakeCommandResponseParams>& brakeResponseParams,
+        const PxVehicleSteerCommandResponseParams*& steerResponseParams,
+        PxVehicleSizedArrayData<const PxVehicleAckermannParams>& ackermannParams,
+        const PxVehicleGearboxParams*& gearboxParams,
+        const PxVehicleClutchCommandResponseParams*& clutchResponseParams,
+        const PxVehicleEngineParams*& engineParams,
+        const PxVehicleRigidBodyState*& rigidBodyState,
+        const PxVehicleEngineState*& engineState,
+        const PxVehicleAutoboxParams*& autoboxParams,
+        const PxVehicleCommandState*& commands,
+        const PxVehicleEngineDriveTransmissionCommandState*& transmissionCommands,
+        PxVehicleArrayData<PxReal>& brakeResponseStates,
+        PxVehicleEngineDriveThrottleCommandResponseState*& throttleResponseState,
+        PxVehicleArrayData<PxReal>& steerResponseStates,
+        PxVehicleGearboxState*& gearboxResponseState,
+        PxVehicleClutchCommandResponseState*& clutchResponseState,
+        PxVehicleAutoboxState*& autoboxState) {
+    axleDescription = &Axles;
+    brakeResponseParams.setDataAndCount(BrakeResponse, 2);
+    steerResponseParams = &SteerResponse;
+    ackermannParams.setEmpty();
+    gearboxParams = &Gearbox;
+    clutchResponseParams = &ClutchResponse;
+    engineParams = &Engine;
+    rigidBodyState = &RigidBodyState;
+    engineState = &EngineState;
+    autoboxParams = &Autobox;
+    commands = &Commands;
+    transmissionCommands = &EngineTransmission;
+    brakeResponseStates.setData(BrakeResponseStates);
+    throttleResponseState = &EngineThrottleState;
+    steerResponseStates.setData(SteerResponseStates);
+    gearboxResponseState = &GearboxState;
+    clutchResponseState = &ClutchResponseState;
+    autoboxState = &AutoboxState;
+}
+
+void Vehicle::getDataForMultiWheelDriveDifferentialStateComponent(
+        const PxVehicleAxleDescription*& axleDescription,
+        const PxVehicleMultiWheelDriveDifferentialParams*& differentialParams,
+        PxVehicleDifferentialState*& differentialState) {
+    axleDescription = &Axles;
+    differentialParams = &Differential;
+    differentialState = &DifferentialState;
+}
+
+void Vehicle::getDataForEngineDriveActuationStateComponent(
+        const PxVehicleAxleDescription*& axleDescription,
+        const PxVehicleGearboxParams*& gearboxParams,
+        PxVehicleArrayData<const PxReal>& brakeResponseStates,
+        const PxVehicleEngineDriveThrottleCommandResponseState*& throttleResponseState,
+        const PxVehicleGearboxState*& gearboxState,
+        const PxVehicleDifferentialState*& differentialState,
+        const PxVehicleClutchCommandResponseState*& clutchResponseState,
+        PxVehicleArrayData<PxVehicleWheelActuationState>& actuationStates) {
+    axleDescription = &Axles;
+    gearboxParams = &Gearbox;
+    brakeResponseStates.setData(BrakeResponseStates);
+    throttleResponseState = &EngineThrottleState;
+    gearboxState = &GearboxState;
+    differentialState = &DifferentialState;
+    clutchResponseState = &ClutchResponseState;
+    actuationStates.setData(ActuationStates);
+}
+
+void Vehicle::getDataForEngineDrivetrainComponent(
+        const PxVehicleAxleDescription*& axleDescription,
+        PxVehicleArrayData<const PxVehicleWheelParams>& wheelParams,
+        const PxVehicleEngineParams*& engineParams,
+        const PxVehicleClutchParams*& clutchParams,
+        const PxVehicleGearboxParams*& gearboxParams,
+        PxVehicleArrayData<const PxReal>& brakeResponseStates,
+        PxVehicleArrayData<const PxVehicleWheelActuationState>& actuationStates,
+        PxVehicleArrayData<const PxVehicleTireForce>& tireForces,
+        const PxVehicleEngineDriveThrottleCommandResponseState*& throttleResponseState,
+        const PxVehicleClutchCommandResponseState*& clutchResponseState,
+        const PxVehicleDifferentialState*& differentialState,
+        const PxVehicleWheelConstraintGroupState*& constraintGroupState,
+        PxVehicleArrayData<PxVehicleWheelRigidBody1dState>& wheelRigidBody1dStates,
+        PxVehicleEngineState*& engineState,
+        PxVehicleGearboxState*& gearboxState,
+        PxVehicleClutchSlipState*& clutchState) {
+    axleDescription = &Axles;
+    wheelParams.setData(Wheels);
+    engineParams = &Engine;
+    clutchParams = &Clutch;
+    gearboxParams = &Gearbox;
+    brakeResponseStates.setData(BrakeResponseStates);
+    actuationStates.setData(ActuationStates);
+    tireForces.setData(TireForces);
+    throttleResponseState = &EngineThrottleState;
+    clutchResponseState = &ClutchResponseState;
+    differentialState = &DifferentialState;
+    // the multi wheel differential does not couple wheels into constraint groups
+    constraintGroupState = nullptr;
+    wheelRigidBody1dStates.setData(WheelBodyStates);
+    engineState = &EngineState;
+    gearboxState = &GearboxState;
+    clutchState = &ClutchSlipState;
+}
+
+// the vehicle extension is process global, the first fleet opens it and the last one closes it
+static std::mutex ExtensionMutex;
+static PxU32 ExtensionUsers = 0;
+
+VehicleFleet::VehicleFleet(PxSceneHandle* scene) : Scene(scene->Scene), Physics(scene->Physics), SweepMesh(nullptr) {
+    {
+        std::lock_guard<std::mutex> lock(ExtensionMutex);
+        if(ExtensionUsers++ == 0) PxInitVehicleExtension(*scene->Foundation);
+    }
+    Context.setToDefault();
+    Context.gravity = Scene->getGravity();
+    Context.physxScene = Scene;
+    Context.physxActorUpdateMode = PxVehiclePhysXActorUpdateMode::eAPPLY_ACCELERATION;
+}
+
+VehicleFleet::~VehicleFleet() {
+    for(auto v : Vehicles) delete v;
+    if(SweepMesh) PxVehicleUnitCylinderSweepMeshDestroy(SweepMesh);
+    std::lock_guard<std::mutex> lock(ExtensionMutex);
+    if(--ExtensionUsers == 0) PxCloseVehicleExtension();
+}
+
+PxU32 VehicleFleet::create(const PxVehicleDesc& desc, const PxVehicleWheelDesc* wheels) {
+    if(!desc.Material || desc.WheelCount == 0 || desc.WheelCount > Vehicle::MaxWheels) return 0xFFFFFFFF;
+
+    PxCookingParams cooking(Physics->getTolerancesScale());
+    if(desc.Query == PxVehicleQuerySweep && !SweepMesh) {
+        SweepMesh = PxVehicleUnitCylinderSweepMeshCreate(Context.frame, *Physics, cooking);
+        Context.physxUnitCylinderSweepMesh = SweepMesh;
+    }
+
+    auto vehicle = new Vehicle(desc, wheels, Physics, cooking, Context.gravity);
+    Scene->addActor(*vehicle->Actor.rigidBody);
+
+    PxU32 id;
+    if(FreeIds.empty()) {
+        id = (PxU32)Vehicles.size();
+        Vehicles.push_back(vehicle);
+    }
+    else {
+        id = FreeIds.back();
+        FreeIds.pop_back();
+        Vehicles[id] = vehicle;
+    }
+    return id;
+}
+
+void VehicleFleet::release(PxU32 id) {
+    auto vehicle = get(id);
+    if(!vehicle) return;
+    delete vehicle;
+    Vehicles[id] = nullptr;
+    FreeIds.push_back(id);
+}
+
+void VehicleFleet::step(float dt, PxCpuDispatcher* dispatcher) {
+    // the begin component may wake the actor, so it runs serially; sleeping vehicles drop out here
+    Active.clear();
+    for(auto v : Vehicles) {
+        if(v && static_cast<PxVehiclePhysXActorBeginComponent*>(v)->update(dt, Context)) Active.push_back(v);
+    }
+
+    // The sequences write per vehicle state and only read the scene for the road
+    // queries. Those stay one query per wheel inside the road geometry component:
+    // it turns each hit into the road plane, friction and velocity (with the
+    // initial overlap case and the scaled cylinder for sweeps), and a
+    // PxBatchQueryExt would only collect the same scene queries and run them one
+    // by one in execute(). Chunks already query the scene concurrently.
+    auto n = (PxU32)Active.size();
+    parallelFor(dispatcher, n, VehicleGrain, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 i = begin; i < end; i++) Active[i]->Sequence.update(dt, Context);
+    });
+
+    // actor velocities, wheel shape poses and constraint flags are scene writes
+    for(auto v : Active) {
+        static_cast<PxVehiclePhysXActorEndComponent*>(v)->update(dt, Context);
+        PxVehicleConstraintsDirtyStateUpdate(v->Constraints);
+    }
+}
+
+
+DllExport(VehicleFleet*) pxCreateVehicleFleet(PxSceneHandle* scene) {
+    return new VehicleFleet(scene);
+}
+
+DllExport(void) pxDestroyVehicleFleet(VehicleFleet* fleet) {
+    delete fleet;
+}
+
+DllExport(void) pxCreateVehicles(VehicleFleet* fleet, PxU32 count, const PxVehicleDesc* descs, const PxVehicleWheelDesc* wheels, PxU32* ids) {
+    for(PxU32 i = 0; i < count; i++) {
+        auto id = fleet->create(descs[i], wheels);
+        wheels += descs[i].WheelCount;
+        if(ids) ids[i] = id;
+    }
+}
+
+DllExport(void) pxReleaseVehicles(VehicleFleet* fleet, PxU32 count, const PxU32* ids) {
+    for(PxU32 i = 0; i < count; i++) fleet->release(ids[i]);
+}
+
+DllExport(void) pxStepVehicles(VehicleFleet* fleet, float dt, PxU32 count, const PxU32* ids, const PxVehicleCommand* commands) {
+    for(PxU32 i = 0; i < count; i++) {
+        auto vehicle = fleet->get(ids[i]);
+        if(vehicle) vehicle->setCommand(commands[i]);
+    }
+    fleet->step(dt, sharedDispatcher());
+}
+
+DllExport(void) pxGetVehicleStatus(VehicleFleet* fleet, PxU32 count, const PxU32* ids, PxVehicleStatus* status) {
+    for(PxU32 i = 0; i < count; i++) {
+        auto vehicle = fleet->get(ids[i]);
+        if(vehicle) vehicle->getStatus(status[i]);
+        else status[i] = PxVehicleStatus();
+    }
+}
+
+DllExport(PxU32) pxGetVehicleWheelPoses(VehicleFleet* fleet, PxU32 count, const PxU32* ids, Euclidean3d* poses, PxU32 maxPoses) {
+    PxU32 written = 0;
+    for(PxU32 i = 0; i < count; i++) {
+        auto vehicle = fleet->get(ids[i]);
+        if(!vehicle) continue;
+        auto n = vehicle->Axles.nbWheels;
+        if(written + n > maxPoses) break;
+        auto pose = vehicle->Actor.rigidBody->getGlobalPose();
+        for(PxU32 w = 0; w < n; w++) {
+            auto shape = vehicle->Actor.wheelShapes[w];
+            poses[written++] = toEuclidean3d(shape ? pose * shape->getLocalPose() : pose);
+        }
+    }
+    return written;
+}
+
+DllExport(PxRigidDynamic*) pxGetVehicleActor(VehicleFleet* fleet, PxU32 id) {
+    auto vehicle = fleet->get(id);
+    return vehicle ? vehicle->Actor.rigidBody->is<PxRigidDynamic>() : nullptr;
+}
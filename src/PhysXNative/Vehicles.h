@@ -0,0 +1,410 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include <vehicle2/PxVehicleAPI.h>
+#include <vector>
+
+enum PxVehicleDriveType {
+    PxVehicleDriveDirect = 0,   // MaxDriveTorque straight at the driven wheels, no gears
+    PxVehicleDriveEngine = 1    // engine, clutch, automatic gearbox and a multi wheel differential
+};
+
+enum PxVehicleQueryType {
+    PxVehicleQueryRaycast = 0,
+    PxVehicleQuerySweep = 1     // cylinder sweep per wheel, smoother over curbs and edges
+};
+
+typedef struct {
+    V3d Attachment;             // top of the suspension travel in the chassis frame
+    float Radius;
+    float HalfWidth;
+    float Mass;
+    float DampingRate;
+    float TravelDist;           // downwards along -Z from Attachment
+    float Stiffness;
+    float Damping;
+    float LatStiff;             // tire stiffness, 0 derives it from the load on the wheel
+    float LongStiff;
+    float SteerMultiplier;      // share of the steer, brake, handbrake and drive response of this wheel
+    float BrakeMultiplier;
+    float HandbrakeMultiplier;
+    float DriveMultiplier;
+} PxVehicleWheelDesc;
+
+typedef struct {
+    Euclidean3d Pose;
+    V3d HalfExtents;            // box chassis, X forward, Y left, Z up
+    V3d CenterOfMass;           // in the chassis frame
+    float Mass;
+    float TireFriction;
+    float MaxSteer;             // radians
+    float MaxBrakeTorque;
+    float MaxHandbrakeTorque;
+    float MaxDriveTorque;       // direct: wheel torque, engine: peak engine torque
+    float MaxOmega;             // engine: max rotation speed in rad/s
+    float FirstRatio;           // engine: forward gear ratios run from FirstRatio down to TopRatio
+    float TopRatio;
+    float ReverseRatio;         // engine: negative
+    float FinalRatio;
+    physx::PxU32 GearCount;     // engine: forward gears
+    physx::PxU32 Drive;
+    physx::PxU32 Query;
+    physx::PxU32 Substeps;      // of the suspension, tire and rigid body group, 0 means 1
+    physx::PxU32 WheelCount;    // wheels are taken in order from the wheel array
+    physx::PxMaterial* Material;
+    physx::PxU64 UserData;
+} PxVehicleDesc;
+
+typedef struct {
+    float Throttle;             // [0, 1]
+    float Brake;                // [0, 1]
+    float Handbrake;            // [0, 1]
+    float Steer;                // [-1, 1], positive turns left
+    physx::PxI32 Gear;          // < 0 reverse, 0 neutral, > 0 forward, shifting automatically with engine drive
+} PxVehicleCommand;
+
+typedef struct {
+    Euclidean3d Pose;
+    V3d LinearVelocity;
+    float ForwardSpeed;
+    float EngineOmega;          // 0 for direct drive
+    physx::PxI32 Gear;          // < 0 reverse, 0 neutral, > 0 forward gear
+    physx::PxU32 WheelsOnGround;
+} PxVehicleStatus;
+
+// skips the vehicle's own chassis in its suspension queries
+class VehicleQueryFilter : public physx::PxQueryFilterCallback {
+public:
+    const physx::PxRigidActor* Self = nullptr;
+
+    physx::PxQueryHitType::Enum preFilter(const physx::PxFilterData&, const physx::PxShape*,
+        const physx::PxRigidActor* actor, physx::PxHitFlags&) override {
+        return actor == Self ? physx::PxQueryHitType::eNONE : physx::PxQueryHitType::eBLOCK;
+    }
+    physx::PxQueryHitType::Enum postFilter(const physx::PxFilterData&, const physx::PxQueryHit&,
+        const physx::PxShape*, const physx::PxRigidActor*) override {
+        return physx::PxQueryHitType::eBLOCK;
+    }
+};
+
+// One PhysX actor driven by the vehicle2 components. The component sequence
+// covers commands, drivetrain, road queries, suspension, tires and wheels; the
+// begin and end components that read and write the actor run outside of it.
+class Vehicle
+    : public physx::vehicle2::PxVehicleRigidBodyComponent
+    , public physx::vehicle2::PxVehicleSuspensionComponent
+    , public physx::vehicle2::PxVehicleTireComponent
+    , public physx::vehicle2::PxVehicleWheelComponent
+    , public physx::vehicle2::PxVehiclePhysXRoadGeometrySceneQueryComponent
+    , public physx::vehicle2::PxVehiclePhysXActorBeginComponent
+    , public physx::vehicle2::PxVehiclePhysXActorEndComponent
+    , public physx::vehicle2::PxVehiclePhysXConstraintComponent
+    , public physx::vehicle2::PxVehicleDirectDriveCommandResponseComponent
+    , public physx::vehicle2::PxVehicleDirectDriveActuationStateComponent
+    , public physx::vehicle2::PxVehicleDirectDrivetrainComponent
+    , public physx::vehicle2::PxVehicleEngineDriveCommandResponseComponent
+    , public physx::vehicle2::PxVehicleMultiWheelDriveDifferentialStateComponent
+    , public physx::vehicle2::PxVehicleEngineDriveActuationStateComponent
+    , public physx::vehicle2::PxVehicleEngineDrivetrainComponent {
+public:
+    static const physx::PxU32 MaxWheels = physx::vehicle2::PxVehicleLimits::eMAX_NB_WHEELS;
+
+    Vehicle(const PxVehicleDesc& desc, const PxVehicleWheelDesc* wheels, physx::PxPhysics* physics,
+        const physx::PxCookingParams& cooking, const physx::PxVec3& gravity);
+    ~Vehicle();
+
+    physx::PxU32 Drive;
+    physx::PxU64 UserData;
+    physx::vehicle2::PxVehicleComponentSequence Sequence;
+
+    // params
+    physx::vehicle2::PxVehicleAxleDescription Axles;
+    physx::vehicle2::PxVehicleRigidBodyParams RigidBody;
+    physx::vehicle2::PxVehicleSuspensionStateCalculationParams SuspensionCalculation;
+    physx::vehicle2::PxVehicleBrakeCommandResponseParams BrakeResponse[2];
+    physx::vehicle2::PxVehicleSteerCommandResponseParams SteerResponse;
+    physx::vehicle2::PxVehicleDirectDriveThrottleCommandResponseParams ThrottleResponse;
+    physx::vehicle2::PxVehicleWheelParams Wheels[MaxWheels];
+    physx::vehicle2::PxVehicleSuspensionParams Suspensions[MaxWheels];
+    physx::vehicle2::PxVehicleSuspensionComplianceParams Compliances[MaxWheels];
+    physx::vehicle2::PxVehicleSuspensionForceParams SuspensionForces[MaxWheels];
+    physx::vehicle2::PxVehicleTireForceParams Tires[MaxWheels];
+    physx::vehicle2::PxVehiclePhysXSuspensionLimitConstraintParams SuspensionLimits[MaxWheels];
+    physx::vehicle2::PxVehiclePhysXRoadGeometryQueryParams RoadQuery;
+    physx::vehicle2::PxVehiclePhysXMaterialFrictionParams Friction[MaxWheels];
+    physx::PxTransform WheelShapePoses[MaxWheels];
+    VehicleQueryFilter Filter;
+
+    physx::vehicle2::PxVehicleEngineParams Engine;
+    physx::vehicle2::PxVehicleGearboxParams Gearbox;
+    physx::vehicle2::PxVehicleAutoboxParams Autobox;
+    physx::vehicle2::PxVehicleClutchParams Clutch;
+    physx::vehicle2::PxVehicleClutchCommandResponseParams ClutchResponse;
+    physx::vehicle2::PxVehicleMultiWheelDriveDifferentialParams Differential;
+
+    // states
+    physx::vehicle2::PxVehicleCommandState Commands;
+    physx::vehicle2::PxVehicleDirectDriveTransmissionCommandState DirectTransmission;
+    physx::vehicle2::PxVehicleEngineDriveTransmissionCommandState EngineTransmission;
+    physx::vehicle2::PxVehicleRigidBodyState RigidBodyState;
+    physx::PxReal BrakeResponseStates[MaxWheels];
+    physx::PxReal ThrottleResponseStates[MaxWheels];
+    physx::PxReal SteerResponseStates[MaxWheels];
+    physx::vehicle2::PxVehicleWheelActuationState ActuationStates[MaxWheels];
+    physx::vehicle2::PxVehicleRoadGeometryState RoadStates[MaxWheels];
+    physx::vehicle2::PxVehiclePhysXRoadGeometryQueryState QueryStates[MaxWheels];
+    physx::vehicle2::PxVehicleSuspensionState SuspensionStates[MaxWheels];
+    physx::vehicle2::PxVehicleSuspensionComplianceState ComplianceStates[MaxWheels];
+    physx::vehicle2::PxVehicleSuspensionForce SuspensionForceStates[MaxWheels];
+    physx::vehicle2::PxVehicleTireGripState TireGripStates[MaxWheels];
+    physx::vehicle2::PxVehicleTireDirectionState TireDirectionStates[MaxWheels];
+    physx::vehicle2::PxVehicleTireSpeedState TireSpeedStates[MaxWheels];
+    physx::vehicle2::PxVehicleTireSlipState TireSlipStates[MaxWheels];
+    physx::vehicle2::PxVehicleTireCamberAngleState TireCamberStates[MaxWheels];
+    physx::vehicle2::PxVehicleTireStickyState TireStickyStates[MaxWheels];
+    physx::vehicle2::PxVehicleTireForce TireForces[MaxWheels];
+    physx::vehicle2::PxVehicleWheelRigidBody1dState WheelBodyStates[MaxWheels];
+    physx::vehicle2::PxVehicleWheelLocalPose WheelPoses[MaxWheels];
+
+    physx::vehicle2::PxVehicleEngineDriveThrottleCommandResponseState EngineThrottleState;
+    physx::vehicle2::PxVehicleClutchCommandResponseState ClutchResponseState;
+    physx::vehicle2::PxVehicleEngineState EngineState;
+    physx::vehicle2::PxVehicleGearboxState GearboxState;
+    physx::vehicle2::PxVehicleAutoboxState AutoboxState;
+    physx::vehicle2::PxVehicleDifferentialState DifferentialState;
+    physx::vehicle2::PxVehicleWheelConstraintGroupState ConstraintGroupState;
+    physx::vehicle2::PxVehicleClutchSlipState ClutchSlipState;
+
+    physx::vehicle2::PxVehiclePhysXActor Actor;
+    physx::vehicle2::PxVehiclePhysXSteerState SteerState;
+    physx::vehicle2::PxVehiclePhysXConstraints Constraints;
+
+    void setCommand(const PxVehicleCommand& command);
+    void getStatus(PxVehicleStatus& status) const;
+
+    void getDataForRigidBodyComponent(
+        const physx::vehicle2::PxVehicleAxleDescription*& axleDescription,
+        const physx::vehicle2::PxVehicleRigidBodyParams*& rigidBodyParams,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleSuspensionForce>& suspensionForces,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleTireForce>& tireForces,
+        const physx::vehicle2::PxVehicleAntiRollTorque*& antiRollTorque,
+        physx::vehicle2::PxVehicleRigidBodyState*& rigidBodyState) override;
+
+    void getDataForSuspensionComponent(
+        const physx::vehicle2::PxVehicleAxleDescription*& axleDescription,
+        const physx::vehicle2::PxVehicleRigidBodyParams*& rigidBodyParams,
+        const physx::vehicle2::PxVehicleSuspensionStateCalculationParams*& suspensionStateCalculationParams,
+        physx::vehicle2::PxVehicleArrayData<const physx::PxReal>& steerResponseStates,
+        const physx::vehicle2::PxVehicleRigidBodyState*& rigidBodyState,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleWheelParams>& wheelParams,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleSuspensionParams>& suspensionParams,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleSuspensionComplianceParams>& suspensionComplianceParams,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleSuspensionForceParams>& suspensionForceParams,
+        physx::vehicle2::PxVehicleSizedArrayData<const physx::vehicle2::PxVehicleAntiRollForceParams>& antiRollForceParams,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleRoadGeometryState>& wheelRoadGeomStates,
+        physx::vehicle2::PxVehicleArrayData<physx::vehicle2::PxVehicleSuspensionState>& suspensionStates,
+        physx::vehicle2::PxVehicleArrayData<physx::vehicle2::PxVehicleSuspensionComplianceState>& suspensionComplianceStates,
+        physx::vehicle2::PxVehicleArrayData<physx::vehicle2::PxVehicleSuspensionForce>& suspensionForces,
+        physx::vehicle2::PxVehicleAntiRollTorque*& antiRollTorque) override;
+
+    void getDataForTireComponent(
+        const physx::vehicle2::PxVehicleAxleDescription*& axleDescription,
+        physx::vehicle2::PxVehicleArrayData<const physx::PxReal>& steerResponseStates,
+        const physx::vehicle2::PxVehicleRigidBodyState*& rigidBodyState,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleWheelActuationState>& actuationStates,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleWheelParams>& wheelParams,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleSuspensionParams>& suspensionParams,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleTireForceParams>& tireForceParams,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleRoadGeometryState>& roadGeomStates,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleSuspensionState>& suspensionStates,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleSuspensionComplianceState>& suspensionComplianceStates,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleSuspensionForce>& suspensionForces,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleWheelRigidBody1dState>& wheelRigidBody1DStates,
+        physx::vehicle2::PxVehicleArrayData<physx::vehicle2::PxVehicleTireGripState>& tireGripStates,
+        physx::vehicle2::PxVehicleArrayData<physx::vehicle2::PxVehicleTireDirectionState>& tireDirectionStates,
+        physx::vehicle2::PxVehicleArrayData<physx::vehicle2::PxVehicleTireSpeedState>& tireSpeedStates,
+        physx::vehicle2::PxVehicleArrayData<physx::vehicle2::PxVehicleTireSlipState>& tireSlipStates,
+        physx::vehicle2::PxVehicleArrayData<physx::vehicle2::PxVehicleTireCamberAngleState>& tireCamberAngleStates,
+        physx::vehicle2::PxVehicleArrayData<physx::vehicle2::PxVehicleTireStickyState>& tireStickyStates,
+        physx::vehicle2::PxVehicleArrayData<physx::vehicle2::PxVehicleTireForce>& tireForces) override;
+
+    void getDataForWheelComponent(
+        const physx::vehicle2::PxVehicleAxleDescription*& axleDescription,
+        physx::vehicle2::PxVehicleArrayData<const physx::PxReal>& steerResponseStates,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleWheelParams>& wheelParams,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleSuspensionParams>& suspensionParams,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleWheelActuationState>& actuationStates,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleSuspensionState>& suspensionStates,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleSuspensionComplianceState>& suspensionComplianceStates,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleTireSpeedState>& tireSpeedStates,
+        physx::vehicle2::PxVehicleArrayData<physx::vehicle2::PxVehicleWheelRigidBody1dState>& wheelRigidBody1dStates,
+        physx::vehicle2::PxVehicleArrayData<physx::vehicle2::PxVehicleWheelLocalPose>& wheelLocalPoses) override;
+
+    void getDataForPhysXRoadGeometrySceneQueryComponent(
+        const physx::vehicle2::PxVehicleAxleDescription*& axleDescription,
+        const physx::vehicle2::PxVehiclePhysXRoadGeometryQueryParams*& roadGeomParams,
+        physx::vehicle2::PxVehicleArrayData<const physx::PxReal>& steerResponseStates,
+        const physx::vehicle2::PxVehicleRigidBodyState*& rigidBodyState,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleWheelParams>& wheelParams,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleSuspensionParams>& suspensionParams,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehiclePhysXMaterialFrictionParams>& materialFrictionParams,
+        physx::vehicle2::PxVehicleArrayData<physx::vehicle2::PxVehicleRoadGeometryState>& roadGeometryStates,
+        physx::vehicle2::PxVehicleArrayData<physx::vehicle2::PxVehiclePhysXRoadGeometryQueryState>& physxRoadGeometryStates) override;
+
+    void getDataForPhysXActorBeginComponent(
+        const physx::vehicle2::PxVehicleAxleDescription*& axleDescription,
+        const physx::vehicle2::PxVehicleCommandState*& commands,
+        const physx::vehicle2::PxVehicleEngineDriveTransmissionCommandState*& transmissionCommands,
+        const physx::vehicle2::PxVehicleGearboxParams*& gearParams,
+        const physx::vehicle2::PxVehicleGearboxState*& gearState,
+        const physx::vehicle2::PxVehicleEngineParams*& engineParams,
+        physx::vehicle2::PxVehiclePhysXActor*& physxActor,
+        physx::vehicle2::PxVehiclePhysXSteerState*& physxSteerState,
+        physx::vehicle2::PxVehiclePhysXConstraints*& physxConstraints,
+        physx::vehicle2::PxVehicleRigidBodyState*& rigidBodyState,
+        physx::vehicle2::PxVehicleArrayData<physx::vehicle2::PxVehicleWheelRigidBody1dState>& wheelRigidBody1dStates,
+        physx::vehicle2::PxVehicleEngineState*& engineState) override;
+
+    void getDataForPhysXActorEndComponent(
+        const physx::vehicle2::PxVehicleAxleDescription*& axleDescription,
+        const physx::vehicle2::PxVehicleRigidBodyState*& rigidBodyState,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleWheelParams>& wheelParams,
+        physx::vehicle2::PxVehicleArrayData<const physx::PxTransform>& wheelShapeLocalPoses,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleWheelRigidBody1dState>& wheelRigidBody1dStates,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleWheelLocalPose>& wheelLocalPoses,
+        const physx::vehicle2::PxVehicleGearboxState*& gearState,
+        physx::vehicle2::PxVehiclePhysXActor*& physxActor) override;
+
+    void getDataForPhysXConstraintComponent(
+        const physx::vehicle2::PxVehicleAxleDescription*& axleDescription,
+        const physx::vehicle2::PxVehicleRigidBodyState*& rigidBodyState,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleSuspensionParams>& suspensionParams,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehiclePhysXSuspensionLimitConstraintParams>& suspensionLimitParams,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleSuspensionState>& suspensionStates,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleSuspensionComplianceState>& suspensionComplianceStates,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleRoadGeometryState>& wheelRoadGeomStates,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleTireDirectionState>& tireDirectionStates,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleTireStickyState>& tireStickyStates,
+        physx::vehicle2::PxVehiclePhysXConstraints*& constraints) override;
+
+    void getDataForDirectDriveCommandResponseComponent(
+        const physx::vehicle2::PxVehicleAxleDescription*& axleDescription,
+        physx::vehicle2::PxVehicleSizedArrayData<const physx::vehicle2::PxVehicleBrakeCommandResponseParams>& brakeResponseParams,
+        const physx::vehicle2::PxVehicleDirectDriveThrottleCommandResponseParams*& throttleResponseParams,
+        const physx::vehicle2::PxVehicleSteerCommandResponseParams*& steerResponseParams,
+        physx::vehicle2::PxVehicleSizedArrayData<const physx::vehicle2::PxVehicleAckermannParams>& ackermannParams,
+        const physx::vehicle2::PxVehicleCommandState*& commands,
+        const physx::vehicle2::PxVehicleDirectDriveTransmissionCommandState*& transmissionCommands,
+        const physx::vehicle2::PxVehicleRigidBodyState*& rigidBodyState,
+        physx::vehicle2::PxVehicleArrayData<physx::PxReal>& brakeResponseStates,
+        physx::vehicle2::PxVehicleArrayData<physx::PxReal>& throttleResponseStates,
+        physx::vehicle2::PxVehicleArrayData<physx::PxReal>& steerResponseStates) override;
+
+    void getDataForDirectDriveActuationStateComponent(
+        const physx::vehicle2::PxVehicleAxleDescription*& axleDescription,
+        physx::vehicle2::PxVehicleArrayData<const physx::PxReal>& brakeResponseStates,
+        physx::vehicle2::PxVehicleArrayData<const physx::PxReal>& throttleResponseStates,
+        physx::vehicle2::PxVehicleArrayData<physx::vehicle2::PxVehicleWheelActuationState>& actuationStates) override;
+
+    void getDataForDirectDrivetrainComponent(
+        const physx::vehicle2::PxVehicleAxleDescription*& axleDescription,
+        physx::vehicle2::PxVehicleArrayData<const physx::PxReal>& brakeResponseStates,
+        physx::vehicle2::PxVehicleArrayData<const physx::PxReal>& throttleResponseStates,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleWheelParams>& wheelParams,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleWheelActuationState>& actuationStates,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleTireForce>& tireForces,
+        physx::vehicle2::PxVehicleArrayData<physx::vehicle2::PxVehicleWheelRigidBody1dState>& wheelRigidBody1dStates) override;
+
+    void getDataForEngineDriveCommandResponseComponent(
+        const physx::vehicle2::PxVehicleAxleDescription*& axleDescription,
+        physx::vehicle2::PxVehicleSizedArrayData<const physx::vehicle2::PxVehicleBrakeCommandResponseParams>& brakeResponseParams,
+        const physx::vehicle2::PxVehicleSteerCommandResponseParams*& steerResponseParams,
+        physx::vehicle2::PxVehicleSizedArrayData<const physx::vehicle2::PxVehicleAckermannParams>& ackermannParams,
+        const physx::vehicle2::PxVehicleGearboxParams*& gearboxParams,
+        const physx::vehicle2::PxVehicleClutchCommandResponseParams*& clutchResponseParams,
+        const physx::vehicle2::PxVehicleEngineParams*& engineParams,
+        const physx::vehicle2::PxVehicleRigidBodyState*& rigidBodyState,
+        const physx::vehicle2::PxVehicleEngineState*& engineState,
+        const physx::vehicle2::PxVehicleAutoboxParams*& autoboxParams,
+        const physx::vehicle2::PxVehicleCommandState*& commands,
+        const physx::vehicle2::PxVehicleEngineDriveTransmissionCommandState*& transmissionCommands,
+        physx::vehicle2::PxVehicleArrayData<physx::PxReal>& brakeResponseStates,
+        physx::vehicle2::PxVehicleEngineDriveThrottleCommandResponseState*& throttleResponseState,
+        physx::vehicle2::PxVehicleArrayData<physx::PxReal>& steerResponseStates,
+        physx::vehicle2::PxVehicleGearboxState*& gearboxResponseState,
+        physx::vehicle2::PxVehicleClutchCommandResponseState*& clutchResponseState,
+        physx::vehicle2::PxVehicleAutoboxState*& autoboxState) override;
+
+    void getDataForMultiWheelDriveDifferentialStateComponent(
+        const physx::vehicle2::PxVehicleAxleDescription*& axleDescription,
+        const physx::vehicle2::PxVehicleMultiWheelDriveDifferentialParams*& differentialParams,
+        physx::vehicle2::PxVehicleDifferentialState*& differentialState) override;
+
+    void getDataForEngineDriveActuationStateComponent(
+        const physx::vehicle2::PxVehicleAxleDescription*& axleDescription,
+        const physx::vehicle2::PxVehicleGearboxParams*& gearboxParams,
+        physx::vehicle2::PxVehicleArrayData<const physx::PxReal>& brakeResponseStates,
+        const physx::vehicle2::PxVehicleEngineDriveThrottleCommandResponseState*& throttleResponseState,
+        const physx::vehicle2::PxVehicleGearboxState*& gearboxState,
+        const physx::vehicle2::PxVehicleDifferentialState*& differentialState,
+        const physx::vehicle2::PxVehicleClutchCommandResponseState*& clutchResponseState,
+        physx::vehicle2::PxVehicleArrayData<physx::vehicle2::PxVehicleWheelActuationState>& actuationStates) override;
+
+    void getDataForEngineDrivetrainComponent(
+        const physx::vehicle2::PxVehicleAxleDescription*& axleDescription,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleWheelParams>& wheelParams,
+        const physx::vehicle2::PxVehicleEngineParams*& engineParams,
+        const physx::vehicle2::PxVehicleClutchParams*& clutchParams,
+        const physx::vehicle2::PxVehicleGearboxParams*& gearboxParams,
+        physx::vehicle2::PxVehicleArrayData<const physx::PxReal>& brakeResponseStates,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleWheelActuationState>& actuationStates,
+        physx::vehicle2::PxVehicleArrayData<const physx::vehicle2::PxVehicleTireForce>& tireForces,
+        const physx::vehicle2::PxVehicleEngineDriveThrottleCommandResponseState*& throttleResponseState,
+        const physx::vehicle2::PxVehicleClutchCommandResponseState*& clutchResponseState,
+        const physx::vehicle2::PxVehicleDifferentialState*& differentialState,
+        const physx::vehicle2::PxVehicleWheelConstraintGroupState*& constraintGroupState,
+        physx::vehicle2::PxVehicleArrayData<physx::vehicle2::PxVehicleWheelRigidBody1dState>& wheelRigidBody1dStates,
+        physx::vehicle2::PxVehicleEngineState*& engineState,
+        physx::vehicle2::PxVehicleGearboxState*& gearboxState,
+        physx::vehicle2::PxVehicleClutchSlipState*& clutchState) override;
+};
+
+// All vehicles of one scene, updated with one call before simulate. Vehicles
+// only touch their own state and read the scene during the component
+// sequence, so the sequences of different vehicles run on the shared
+// dispatcher; the actor reads and writes around them stay serial.
+class VehicleFleet {
+public:
+    explicit VehicleFleet(PxSceneHandle* scene);
+    ~VehicleFleet();
+
+    physx::PxScene* Scene;
+    physx::PxPhysics* Physics;
+    physx::vehicle2::PxVehiclePhysXSimulationContext Context;
+
+    // indexed by vehicle id, NULL for released ones
+    std::vector<Vehicle*> Vehicles;
+    std::vector<physx::PxU32> FreeIds;
+
+    physx::PxU32 create(const PxVehicleDesc& desc, const PxVehicleWheelDesc* wheels);
+    void release(physx::PxU32 id);
+    Vehicle* get(physx::PxU32 id) const { return id < Vehicles.size() ? Vehicles[id] : nullptr; }
+
+    void step(float dt, physx::PxCpuDispatcher* dispatcher);
+
+private:
+    physx::PxConvexMesh* SweepMesh;
+    std::vector<Vehicle*> Active;
+};
+
+DllExport(VehicleFleet*) pxCreateVehicleFleet(PxSceneHandle* scene);
+DllExport(void) pxDestroyVehicleFleet(VehicleFleet* fleet);
+// vehicle i uses the next descs[i].WheelCount entries of wheels
+DllExport(void) pxCreateVehicles(VehicleFleet* fleet, physx::PxU32 count, const PxVehicleDesc* descs, const PxVehicleWheelDesc* wheels, physx::PxU32* ids);
+DllExport(void) pxReleaseVehicles(VehicleFleet* fleet, physx::PxU32 count, const physx::PxU32* ids);
+// commands stay in effect until replaced, count may be 0
+DllExport(void) pxStepVehicles(VehicleFleet* fleet, float dt, physx::PxU32 count, const physx::PxU32* ids, const PxVehicleCommand* commands);
+DllExport(void) pxGetVehicleStatus(VehicleFleet* fleet, physx::PxU32 count, const physx::PxU32* ids, PxVehicleStatus* status);
+// world poses, WheelCount entries per vehicle
+DllExport(physx::PxU32) pxGetVehicleWheelPoses(VehicleFleet* fleet, physx::PxU32 count, const physx::PxU32* ids, Euclidean3d* poses, physx::PxU32 maxPoses);
+DllExport(physx::PxRigidDynamic*) pxGetVehicleActor(VehicleFleet* fleet, physx::PxU32 id);
@@ -0,0 +1,277 @@
+#include "World.h"
+#include "Parallel.h"
+#include <algorithm>
+#include <cstring>
+#include <extensions/PxRigidActorExt.h>
+#include <extensions/PxSimpleFactory.h>
+
+using namespace physx;
+
+static const PxU32 BodyGrain = 512;
+
+PartitionedWorld::PartitionedWorld(PxPhysics* physics, const PxWorldDesc& desc) : Desc(desc), Physics(physics) {
+    Desc.CellsX = PxMax(Desc.CellsX, 1u);
+    Desc.CellsY = PxMax(Desc.CellsY, 1u);
+    Desc.CellsZ = PxMax(Desc.CellsZ, 1u);
+    if(Desc.CellSize <= 0.0) Desc.CellSize = 1.0;
+    memset(&Stats, 0, sizeof(PxWorldStats));
+
+    auto count = Desc.CellsX * Desc.CellsY * Desc.CellsZ;
+    for(PxU32 c = 0; c < count; c++) {
+        PxSceneDesc sceneDesc(physics->getTolerancesScale());
+        sceneDesc.gravity = toPxVec3(Desc.Gravity);
+        sceneDesc.cpuDispatcher = sharedDispatcher();
+        sceneDesc.filterShader = layerFilterShader;
+        sceneDesc.filterShaderData = defaultCollisionLayers().data();
+        sceneDesc.filterShaderDataSize = defaultCollisionLayers().size();
+        sceneDesc.flags |= PxSceneFlag::eENABLE_ACTIVE_ACTORS | PxSceneFlag::eENABLE_CCD;
+        Cells.push_back(physics->createScene(sceneDesc));
+    }
+    Stats.Cells = count;
+}
+
+PartitionedWorld::~PartitionedWorld() {
+    for(auto& body : Slots) releaseGhosts(body);
+    for(auto actor : Table.Actors) actor->release();
+    for(auto actor : Statics) actor->release();
+    for(auto scene : Cells) scene->release();
+}
+
+static PX_FORCE_INLINE PxU32 cellCoord(float v, double origin, double size, PxU32 count) {
+    auto c = (PxI32)PxFloor((float)((v - origin) / size));
+    return (PxU32)PxClamp(c, 0, (PxI32)count - 1);
+}
+
+PxU32 PartitionedWorld::cellOf(const PxVec3& p) const {
+    auto x = cellCoord(p.x, Desc.Origin.X, Desc.CellSize, Desc.CellsX);
+    auto y = cellCoord(p.y, Desc.Origin.Y, Desc.CellSize, Desc.CellsY);
+    auto z = cellCoord(p.z, Desc.Origin.Z, Desc.CellSize, Desc.CellsZ);
+    return (z * Desc.CellsY + y) * Desc.CellsX + x;
+}
+
+// ascending cell indices overlapped by the bounds, except the given one
+void PartitionedWorld::cellsOverlapping(const PxBounds3& bounds, PxU32 except, std::vector<PxU32>& cells) const {
+    const double origin[3] = { Desc.Origin.X, Desc.Origin.Y, Desc.Origin.Z };
+    const PxU32 count[3] = { Desc.CellsX, Desc.CellsY, Desc.CellsZ };
+    PxU32 lo[3], hi[3];
+    for(PxU32 a = 0; a < 3; a++) {
+        lo[a] = cellCoord(bounds.minimum[a], origin[a], Desc.CellSize, count[a]);
+        hi[a] = cellCoord(bounds.maximum[a], origin[a], Desc.CellSize, count[a]);
+    }
+
+    cells.clear();
+    for(auto z = lo[2]; z <= hi[2]; z++)
+        for(auto y = lo[1]; y <= hi[1]; y++)
+            for(auto x = lo[0]; x <= hi[0]; x++) {
+                auto c = (z * Desc.CellsY + y) * Desc.CellsX + x;
+                if(c != except) cells.push_back(c);
+            }
+}
+
+PxRigidDynamic* PartitionedWorld::createGhost(PxRigidDynamic* owner, PxU32 cell) {
+    auto ghost = Physics->createRigidDynamic(owner->getGlobalPose());
+    ghost->setRigidBodyFlag(PxRigidBodyFlag::eKINEMATIC, true);
+
+    std::vector<PxShape*> shapes(owner->getNbShapes());
+    owner->getShapes(shapes.data(), (PxU32)shapes.size());
+    std::vector<PxMaterial*> materials;
+    for(auto shape : shapes) {
+        // ghosts only take part in the simulation, queries and rendering see the owner
+        auto flags = shape->getFlags();
+        if(!(flags & PxShapeFlag::eSIMULATION_SHAPE)) continue;
+        flags.clear(PxShapeFlag::eSCENE_QUERY_SHAPE);
+        flags.clear(PxShapeFlag::eVISUALIZATION);
+
+        materials.resize(shape->getNbMaterials());
+        shape->getMaterials(materials.data(), (PxU32)materials.size());
+        auto copy = PxRigidActorExt::createExclusiveShape(*ghost, shape->getGeometry(), materials.data(), (PxU16)materials.size(), flags);
+        if(!copy) continue;
+        copy->setLocalPose(shape->getLocalPose());
+        copy->setSimulationFilterData(shape->getSimulationFilterData());
+        copy->setContactOffset(shape->getContactOffset());
+        copy->setRestOffset(shape->getRestOffset());
+    }
+
+    // ghosts are never added to the table, so BodyTable::sync skips them
+    Cells[cell]->addActor(*ghost);
+    return ghost;
+}
+
+void PartitionedWorld::releaseGhosts(WorldBody& body) {
+    for(auto& ghost : body.Ghosts) ghost.Actor->release();
+    Stats.Ghosts -= (PxU32)body.Ghosts.size();
+    body.Ghosts.clear();
+}
+
+// wanted holds the sorted cells that need a ghost of the body
+void PartitionedWorld::updateGhosts(PxU32 dense, const PxU32* wanted, PxU32 count) {
+    auto& body = Slots[Table.DenseToSlot[dense]];
+    auto owner = Table.Actors[dense]->is<PxRigidDynamic>();
+
+    std::vector<WorldGhost> next;
+    next.reserve(count);
+    size_t g = 0;
+    for(PxU32 i = 0; i < count; i++) {
+        while(g < body.Ghosts.size() && body.Ghosts[g].Cell < wanted[i]) {
+            body.Ghosts[g++].Actor->release();
+            Stats.Ghosts--;
+        }
+        if(g < body.Ghosts.size() && body.Ghosts[g].Cell == wanted[i]) next.push_back(body.Ghosts[g++]);
+        else {
+            next.push_back({ wanted[i], createGhost(owner, wanted[i]) });
+            Stats.Ghosts++;
+        }
+    }
+    for(; g < body.Ghosts.size(); g++) {
+        body.Ghosts[g].Actor->release();
+        Stats.Ghosts--;
+    }
+    body.Ghosts.swap(next);
+}
+
+PxBodyHandle PartitionedWorld::addBody(PxRigidDynamic* actor, PxU64 userData) {
+    auto cell = cellOf(actor->getGlobalPose().p);
+    Cells[cell]->addActor(*actor);
+    auto handle = Table.add(actor, userData);
+    if(Slots.size() < Table.Generations.size()) Slots.resize(Table.Generations.size());
+    Slots[handle.Index].Cell = cell;
+    Stats.Bodies++;
+
+    auto bounds = actor->getWorldBounds();
+    bounds.fattenFast((float)Desc.GhostMargin);
+    std::vector<PxU32> wanted;
+    cellsOverlapping(bounds, cell, wanted);
+    updateGhosts(Table.denseIndex(handle), wanted.data(), (PxU32)wanted.size());
+    return handle;
+}
+
+bool PartitionedWorld::removeBody(PxBodyHandle handle) {
+    auto dense = Table.denseIndex(handle);
+    if(dense == PxInvalidBodyIndex) return false;
+
+    auto actor = Table.Actors[dense];
+    releaseGhosts(Slots[handle.Index]);
+    Slots[handle.Index].Cell = PxInvalidBodyIndex;
+
+    PxBodyRemap remap;
+    Table.remove(handle, remap);
+    actor->release();
+    Stats.Bodies--;
+    return true;
+}
+
+void PartitionedWorld::addStatic(PxRigidStatic* actor) {
+    std::vector<PxU32> cells;
+    cellsOverlapping(actor->getWorldBounds(), PxInvalidBodyIndex, cells);
+    for(size_t i = 0; i < cells.size(); i++) {
+        auto copy = i == 0 ? actor : PxCloneStatic(*Physics, actor->getGlobalPose(), *actor);
+        Cells[cells[i]]->addActor(*copy);
+        Statics.push_back(copy);
+    }
+}
+
+// pose of the body after dt, ghosts are driven there so they arrive together with their owner
+static PxTransform predictPose(const PxTransform& pose, const PxVec3& v, const PxVec3& w, float dt) {
+    PxTransform next(pose.p + v * dt, pose.q);
+    auto angle = w.magnitude() * dt;
+    if(angle > 1e-6f) next.q = (PxQuat(angle, w.getNormalized()) * pose.q).getNormalized();
+    return next;
+}
+
+void PartitionedWorld::step(float dt, PxCpuDispatcher* dispatcher) {
+    for(PxU32 i = 0; i < Table.size(); i++) {
+        auto& ghosts = Slots[Table.DenseToSlot[i]].Ghosts;
+        // a target keeps the ghost awake, so ghosts of sleeping bodies are left alone
+        if(ghosts.empty() || static_cast<PxRigidDynamic*>(Table.Actors[i])->isSleeping()) continue;
+        auto target = predictPose(Table.Poses[i], Table.LinearVelocities[i], Table.AngularVelocities[i], dt);
+        for(auto& ghost : ghosts) ghost.Actor->setKinematicTarget(target);
+    }
+
+    // simulate only kicks off the tasks, so all cells run on the shared pool at once
+    for(auto scene : Cells) scene->simulate(dt);
+    for(auto scene : Cells) scene->fetchResults(true);
+
+    // an owner lives in exactly one cell, so cells write disjoint table entries
+    parallelFor(dispatcher, (PxU32)Cells.size(), 1, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 c = begin; c < end; c++) Table.sync(Cells[c]);
+    });
+
+    auto n = Table.size();
+    TargetCells.resize(n);
+    Bounds.resize(n);
+    auto margin = (float)Desc.GhostMargin;
+    parallelFor(dispatcher, n, BodyGrain, [&](PxU32 begin, PxU32 end) {
+        for(PxU32 i = begin; i < end; i++) {
+            TargetCells[i] = cellOf(Table.Poses[i].p);
+            Bounds[i] = Table.Actors[i]->getWorldBounds();
+            Bounds[i].fattenFast(margin);
+        }
+    });
+
+    // scenes are not thread safe for insertion and removal, migrations run serially
+    Stats.Migrations = 0;
+    std::vector<PxU32> wanted;
+    for(PxU32 i = 0; i < n; i++) {
+        auto& body = Slots[Table.DenseToSlot[i]];
+        auto actor = Table.Actors[i];
+        if(TargetCells[i] != body.Cell) {
+            Cells[body.Cell]->removeActor(*actor, false);
+            Cells[TargetCells[i]]->addActor(*actor);
+            body.Cell = TargetCells[i];
+            Stats.Migrations++;
+        }
+
+        cellsOverlapping(Bounds[i], body.Cell, wanted);
+        // nothing to do for the common case of a body well inside its cell
+        if(wanted.empty() && body.Ghosts.empty()) continue;
+        updateGhosts(i, wanted.data(), (PxU32)wanted.size());
+    }
+    Stats.TotalMigrations += Stats.Migrations;
+}
+
+
+DllExport(PartitionedWorld*) pxCreateWorld(PxHandle* handle, const PxWorldDesc* desc) {
+    return new PartitionedWorld(handle->Physics, *desc);
+}
+
+DllExport(void) pxDestroyWorld(PartitionedWorld* world) {
+    delete world;
+}
+
+DllExport(PxBodyHandle) pxWorldAddBody(PartitionedWorld* world, PxRigidDynamic* actor, PxU64 userData) {
+    return world->addBody(actor, userData);
+}
+
+DllExport(int) pxWorldRemoveBody(PartitionedWorld* world, PxBodyHandle handle) {
+    return world->removeBody(handle) ? 1 : 0;
+}
+
+DllExport(void) pxWorldAddStatic(PartitionedWorld* world, PxRigidStatic* actor) {
+    world->addStatic(actor);
+}
+
+DllExport(void) pxWorldStep(PartitionedWorld* world, float dt) {
+    world->step(dt, sharedDispatcher());
+}
+
+DllExport(void) pxWorldApplyCollisionLayers(PartitionedWorld* world, CollisionLayers* layers, int refilter) {
+    for(auto scene : world->Cells) layers->apply(scene, refilter != 0);
+}
+
+DllExport(BodyTable*) pxWorldGetBodyTable(PartitionedWorld* world) {
+    return &world->Table;
+}
+
+DllExport(PxU32) pxWorldGetBodyCell(PartitionedWorld* world, PxBodyHandle handle) {
+    if(world->Table.denseIndex(handle) == PxInvalidBodyIndex) return PxInvalidBodyIndex;
+    return world->Slots[handle.Index].Cell;
+}
+
+DllExport(void) pxWorldGetCellCounts(PartitionedWorld* world, PxU32* counts) {
+    memset(counts, 0, world->Cells.size() * sizeof(PxU32));
+    for(PxU32 i = 0; i < world->Table.size(); i++) counts[world->Slots[world->Table.DenseToSlot[i]].Cell]++;
+}
+
+DllExport(void) pxWorldGetStats(PartitionedWorld* world, PxWorldStats* stats) {
+    *stats = world->Stats;
+}
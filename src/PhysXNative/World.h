@@ -0,0 +1,91 @@
+#pragma once
+
+#include "PhysXNative.h"
+#include "BodyTable.h"
+#include "CollisionLayers.h"
+#include <vector>
+
+typedef struct {
+    V3d Origin;             // minimum corner of cell (0, 0, 0)
+    double CellSize;
+    physx::PxU32 CellsX;
+    physx::PxU32 CellsY;
+    physx::PxU32 CellsZ;
+    double GhostMargin;     // bounds are inflated by this before ghosts are placed in neighbor cells
+    V3d Gravity;
+} PxWorldDesc;
+
+typedef struct {
+    physx::PxU32 Cells;
+    physx::PxU32 Bodies;
+    physx::PxU32 Ghosts;
+    physx::PxU32 Migrations;        // during the last step
+    physx::PxU64 TotalMigrations;
+} PxWorldStats;
+
+struct WorldGhost {
+    physx::PxU32 Cell;
+    physx::PxRigidDynamic* Actor;
+};
+
+// per body slot, indexed by PxBodyHandle::Index like BodyTable::Generations
+struct WorldBody {
+    physx::PxU32 Cell;                  // owning cell, PxInvalidBodyIndex for a free slot
+    std::vector<WorldGhost> Ghosts;     // sorted by cell
+};
+
+// A large world split into a regular grid of cells with one CPU PxScene each.
+// All cells run on the shared dispatcher and are stepped together. A body is
+// simulated in the cell that contains its center and is mirrored by kinematic
+// ghosts in every neighbor cell its inflated bounds reach, so bodies on both
+// sides of a border still collide. Ghosts follow their owner one way, they push
+// bodies in other cells but are not pushed back. A body whose center leaves its
+// cell migrates to the new one after the step. Handles come from one body
+// table across all cells and stay valid through migrations. The world owns
+// every actor added to it.
+class PartitionedWorld {
+public:
+    PartitionedWorld(physx::PxPhysics* physics, const PxWorldDesc& desc);
+    ~PartitionedWorld();
+
+    PxWorldDesc Desc;
+    std::vector<physx::PxScene*> Cells;
+    BodyTable Table;
+    std::vector<WorldBody> Slots;
+    PxWorldStats Stats;
+
+    physx::PxU32 cellOf(const physx::PxVec3& p) const;
+
+    PxBodyHandle addBody(physx::PxRigidDynamic* actor, physx::PxU64 userData);
+    bool removeBody(PxBodyHandle handle);
+    // static actors are cloned into every cell their bounds overlap
+    void addStatic(physx::PxRigidStatic* actor);
+
+    void step(float dt, physx::PxCpuDispatcher* dispatcher);
+
+private:
+    void cellsOverlapping(const physx::PxBounds3& bounds, physx::PxU32 except, std::vector<physx::PxU32>& cells) const;
+    physx::PxRigidDynamic* createGhost(physx::PxRigidDynamic* owner, physx::PxU32 cell);
+    void releaseGhosts(WorldBody& body);
+    void updateGhosts(physx::PxU32 dense, const physx::PxU32* wanted, physx::PxU32 count);
+
+    physx::PxPhysics* Physics;
+    std::vector<physx::PxRigidStatic*> Statics;
+
+    // per dense body, computed in parallel after each step
+    std::vector<physx::PxU32> TargetCells;
+    std::vector<physx::PxBounds3> Bounds;
+};
+
+DllExport(PartitionedWorld*) pxCreateWorld(PxHandle* handle, const PxWorldDesc* desc);
+DllExport(void) pxDestroyWorld(PartitionedWorld* world);
+DllExport(PxBodyHandle) pxWorldAddBody(PartitionedWorld* world, physx::PxRigidDynamic* actor, physx::PxU64 userData);
+DllExport(int) pxWorldRemoveBody(PartitionedWorld* world, PxBodyHandle handle);
+DllExport(void) pxWorldAddStatic(PartitionedWorld* world, physx::PxRigidStatic* actor);
+DllExport(void) pxWorldStep(PartitionedWorld* world, float dt);
+DllExport(void) pxWorldApplyCollisionLayers(PartitionedWorld* world, CollisionLayers* layers, int refilter);
+// the shared body table, read it with pxBodyTableGetPoses and friends
+DllExport(BodyTable*) pxWorldGetBodyTable(PartitionedWorld* world);
+DllExport(physx::PxU32) pxWorldGetBodyCell(PartitionedWorld* world, PxBodyHandle handle);
+DllExport(void) pxWorldGetCellCounts(PartitionedWorld* world, physx::PxU32* counts);
+DllExport(void) pxWorldGetStats(PartitionedWorld* world, PxWorldStats* stats);